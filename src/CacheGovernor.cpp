@@ -0,0 +1,113 @@
+#include "CacheGovernor.h"
+#include "sqlitetablemodel.h"
+
+#include <QThread>
+
+#include <algorithm>
+#include <numeric>
+
+CacheGovernor& CacheGovernor::instance()
+{
+    static CacheGovernor governor;
+    return governor;
+}
+
+CacheGovernor::CacheGovernor()
+    : m_mostRecent(nullptr)
+    , m_budget(0)
+    , m_clock(0)
+    , m_enforcing(false)
+{
+}
+
+void CacheGovernor::registerModel(SqliteTableModel* model)
+{
+    Q_ASSERT(QThread::currentThread() == thread());
+
+    m_models.push_back({model, 0, ++m_clock});
+    m_mostRecent = model;
+}
+
+void CacheGovernor::unregisterModel(SqliteTableModel* model)
+{
+    Q_ASSERT(QThread::currentThread() == thread());
+
+    if(m_mostRecent == model)
+        m_mostRecent = nullptr;
+    m_models.erase(std::remove_if(m_models.begin(), m_models.end(), [model](const Entry& e) { return e.model == model; }), m_models.end());
+    emit usageChanged();
+}
+
+void CacheGovernor::reportUsage(SqliteTableModel* model, size_t bytes)
+{
+    Q_ASSERT(QThread::currentThread() == thread());
+
+    auto it = std::find_if(m_models.begin(), m_models.end(), [model](const Entry& e) { return e.model == model; });
+    if(it == m_models.end() || it->bytes == bytes)
+        return;
+
+    it->bytes = bytes;
+    enforceBudget(model);
+    emit usageChanged();
+}
+
+void CacheGovernor::touch(const SqliteTableModel* model)
+{
+    Q_ASSERT(QThread::currentThread() == thread());
+
+    // This is called for every cell which is shown, so don't do more than necessary. Usually the same model is touched again.
+    if(model == m_mostRecent)
+        return;
+
+    for(auto& e : m_models)
+    {
+        if(e.model == model)
+        {
+            e.lastViewed = ++m_clock;
+            m_mostRecent = model;
+            return;
+        }
+    }
+}
+
+void CacheGovernor::setBudget(size_t bytes)
+{
+    if(bytes == m_budget)
+        return;
+
+    m_budget = bytes;
+    enforceBudget(nullptr);
+}
+
+size_t CacheGovernor::totalUsage() const
+{
+    return std::accumulate(m_models.begin(), m_models.end(), size_t(0), [](size_t r, const Entry& e) { return r + e.bytes; });
+}
+
+std::vector<CacheGovernor::Usage> CacheGovernor::usage() const
+{
+    std::vector<Entry> entries = m_models;
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.lastViewed > b.lastViewed; });
+
+    std::vector<Usage> result;
+    for(const auto& e : entries)
+        result.push_back({e.model, e.bytes});
+    return result;
+}
+
+void CacheGovernor::enforceBudget(const SqliteTableModel* growing)
+{
+    // Releasing memory makes the models report their new usage, so make sure we don't end up here again while doing so
+    if(m_enforcing || m_budget == 0 || totalUsage() <= m_budget)
+        return;
+    m_enforcing = true;
+
+    // Start with the least recently viewed model. The most recently viewed one keeps its current rows and so does
+    // the model which has just grown because it is probably still loading data for someone.
+    std::vector<Entry> order = m_models;
+    std::sort(order.begin(), order.end(), [](const Entry& a, const Entry& b) { return a.lastViewed < b.lastViewed; });
+    for(size_t i=0;i<order.size() && totalUsage() > m_budget;i++)
+        order[i].model->releaseCache(i + 1 == order.size() || order[i].model == growing);
+
+    m_enforcing = false;
+}
@@ -0,0 +1,83 @@
+#ifndef CACHE_GOVERNOR_H
+#define CACHE_GOVERNOR_H
+
+#include <QObject>
+#include <vector>
+
+class SqliteTableModel;
+
+/**
+
+   keeps track of the memory taken up by the row caches of all
+   SqliteTableModel instances and enforces a common budget for them.
+
+   the models report their memory usage whenever it changes. When the
+   total exceeds the budget, the caches of the models which haven't
+   been viewed for the longest time are released first. The model which
+   has been viewed most recently only gives up the caches it keeps for
+   previously browsed tables but never the rows it is currently showing,
+   so the budget can be exceeded by a single large result set.
+
+   all models live in the GUI thread, so this must only be used from
+   there. The governor is created by the first model, so it lives in
+   the same thread. It doesn't rely on a QCoreApplication object being
+   there, which the unit tests don't create.
+
+**/
+class CacheGovernor : public QObject
+{
+    Q_OBJECT
+
+public:
+    static CacheGovernor& instance();
+
+    void registerModel(SqliteTableModel* model);
+    void unregisterModel(SqliteTableModel* model);
+
+    /// set the number of bytes currently used by \param model and
+    /// release the caches of other models if the budget is exceeded
+    void reportUsage(SqliteTableModel* model, size_t bytes);
+
+    /// mark \param model as viewed just now
+    void touch(const SqliteTableModel* model);
+
+    size_t budget() const { return m_budget; }
+    void setBudget(size_t bytes);
+
+    /// \returns the number of bytes used by all models together
+    size_t totalUsage() const;
+
+    struct Usage
+    {
+        const SqliteTableModel* model;
+        size_t bytes;
+    };
+
+    /// \returns the memory usage of each model, most recently viewed first
+    std::vector<Usage> usage() const;
+
+signals:
+    void usageChanged();
+
+private:
+    CacheGovernor();
+
+    struct Entry
+    {
+        SqliteTableModel* model;
+        size_t bytes;
+        quint64 lastViewed;
+    };
+    std::vector<Entry> m_models;
+    const SqliteTableModel* m_mostRecent;   // model which has been touched last, so touching it again is cheap
+
+    size_t m_budget;
+    quint64 m_clock;
+    bool m_enforcing;
+
+    /// release caches until the budget is met again. The current rows of
+    /// \param growing are kept.
+    void enforceBudget(const SqliteTableModel* growing);
+};
+
+#endif
@@ -0,0 +1,215 @@
+#ifndef CACHED_ROW_H
+#define CACHED_ROW_H
+
+#include <vector>
+#include <algorithm>
+
+#include <QByteArray>
+#include <QString>
+#include <QTextCodec>
+
+#include "Data.h"
+
+/**
+
+   prepares the text which is shown for a cell in the table view. This
+   is done once when the cell is fetched (on the worker thread) instead
+   of every time the cell is painted.
+
+   the text codec for the encoding is only looked up once.
+
+**/
+class CellFormatter
+{
+public:
+    explicit CellFormatter(const QString& encoding = QString(), int symbol_limit = 5000)
+        : m_encoding(encoding)
+        , m_codec(encoding.isEmpty() ? nullptr : QTextCodec::codecForName(encoding.toUtf8()))
+        , m_symbolLimit(std::max(symbol_limit, 0))
+    {}
+
+    const QString& encoding() const { return m_encoding; }
+    int symbolLimit() const { return m_symbolLimit; }
+
+    bool operator==(const CellFormatter& other) const { return m_encoding == other.m_encoding && m_symbolLimit == other.m_symbolLimit; }
+    bool operator!=(const CellFormatter& other) const { return !(*this == other); }
+
+    /// \returns the decoded and truncated text for \param value of the
+    /// given \param type. For NULL values and for binary data a null string
+    /// is returned; \param binary is set accordingly.
+    QString displayText(const QByteArray& value, CellType type, bool& binary) const
+    {
+        binary = false;
+        if(type == CellType::Null || value.isNull())
+            return QString();
+
+        // Numbers are always plain ASCII, so only text and blobs need to be checked for binary data
+        if((type == CellType::Text || type == CellType::Blob) && !isTextOnly(value, m_encoding, true))
+        {
+            binary = true;
+            return QString();
+        }
+
+        // Only decode the part of the value which is going to be shown. No character takes up more than four bytes, so
+        // this still leaves us with more characters than the limit if the value is too long.
+        const QByteArray head = value.size() > 4 * (m_symbolLimit + 1) ? value.left(4 * (m_symbolLimit + 1)) : value;
+        QString text = m_codec ? m_codec->toUnicode(head) : QString::fromUtf8(head);
+        if(text.size() > m_symbolLimit)
+        {
+            // Add "..." to the end of truncated strings
+            text.truncate(m_symbolLimit);
+            text.append(" ...");
+        }
+        return text;
+    }
+
+private:
+    QString m_encoding;
+    QTextCodec* m_codec;
+    int m_symbolLimit;
+};
+
+/**
+
+   a single row of a result set as it is kept in the RowCache of
+   SqliteTableModel.
+
+   besides the raw cell values, the row holds the display text of each
+   cell and a tag with its storage class and whether it contains binary
+   data. The tags take four bits per cell; they allow checking for NULL
+   and binary values without looking at the cell contents again. The
+   display texts and the binary flags are prepared using a
+   CellFormatter when the cell is set.
+
+   for wide tables only the columns which are currently of interest
+   (i.e. visible and not hidden) are fetched from the database. The
+   remaining cells are fetched lazily when they are needed. The
+   'loaded' vector keeps track of which cells are available; an empty
+   vector means that all cells of the row have been fetched, which is
+   the common case and doesn't cost any extra memory.
+
+**/
+struct CachedRow
+{
+    std::vector<QByteArray> cells;
+    std::vector<QString> display;
+    std::vector<uint8_t> tags;
+    std::vector<bool> loaded;
+    size_t num_missing = 0;
+
+    CachedRow() = default;
+
+    /// constructs a row with all cells loaded
+    CachedRow(std::vector<QByteArray> cells_, const std::vector<CellType>& types, const CellFormatter& formatter)
+        : cells(std::move(cells_))
+        , display(cells.size())
+        , tags((cells.size() + 1) / 2, 0)
+    {
+        for(size_t i=0;i<cells.size();i++)
+            format(i, types.at(i), formatter);
+    }
+
+    /// constructs a row with \param num_columns cells of which none is
+    /// loaded yet
+    static CachedRow unloaded(size_t num_columns)
+    {
+        CachedRow r;
+        r.cells.resize(num_columns);
+        r.display.resize(num_columns);
+        r.tags.resize((num_columns + 1) / 2, 0);
+        r.loaded.resize(num_columns, false);
+        r.num_missing = num_columns;
+        return r;
+    }
+
+    size_t size() const { return cells.size(); }
+
+    /// \returns true if the specified cell has been fetched
+    bool isLoaded(size_t column) const { return loaded.empty() || loaded.at(column); }
+
+    /// \returns true if all cells have been fetched
+    bool isComplete() const { return loaded.empty(); }
+
+    /// \returns the storage class of the specified cell
+    CellType type(size_t column) const { return static_cast<CellType>(tag(column) & TypeMask); }
+
+    /// \returns true if the specified cell contains binary data
+    bool isBinary(size_t column) const { return tag(column) & BinaryFlag; }
+
+    /// assigns a value of the given type to the specified cell and marks
+    /// it as loaded
+    void set(size_t column, QByteArray value, CellType type, const CellFormatter& formatter)
+    {
+        cells.at(column) = std::move(value);
+        format(column, type, formatter);
+        markLoaded(column);
+    }
+
+    /// moves the specified cell along with its display text from
+    /// \param other, which has to be formatted the same way, and marks
+    /// it as loaded
+    void take(size_t column, CachedRow& other)
+    {
+        cells.at(column) = std::move(other.cells.at(column));
+        display.at(column) = std::move(other.display.at(column));
+        setTag(column, other.tag(column));
+        markLoaded(column);
+    }
+
+    /// prepares the display texts of all cells again, e.g. after the
+    /// encoding has been changed
+    void reformat(const CellFormatter& formatter)
+    {
+        for(size_t i=0;i<cells.size();i++)
+            format(i, type(i), formatter);
+    }
+
+    const QByteArray& at(size_t column) const { return cells.at(column); }
+
+    /// \returns the approximate number of bytes taken up by the row
+    size_t memoryUsage() const
+    {
+        size_t bytes = sizeof(CachedRow) + tags.capacity() + loaded.capacity() / 8;
+        for(size_t i=0;i<cells.size();i++)
+        {
+            bytes += sizeof(QByteArray) + static_cast<size_t>(cells[i].capacity());
+            bytes += sizeof(QString) + static_cast<size_t>(display[i].capacity()) * sizeof(QChar);
+        }
+        return bytes;
+    }
+
+private:
+    static const uint8_t TypeMask = 0x07;
+    static const uint8_t BinaryFlag = 0x08;
+
+    uint8_t tag(size_t column) const
+    {
+        return (tags.at(column / 2) >> ((column % 2) * 4)) & 0x0F;
+    }
+
+    void setTag(size_t column, uint8_t t)
+    {
+        const unsigned shift = (column % 2) * 4;
+        uint8_t& packed = tags.at(column / 2);
+        packed = static_cast<uint8_t>((packed & ~(0x0F << shift)) | ((t & 0x0F) << shift));
+    }
+
+    void markLoaded(size_t column)
+    {
+        if(!loaded.empty() && !loaded[column])
+        {
+            loaded[column] = true;
+            if(--num_missing == 0)
+                loaded.clear();
+        }
+    }
+
+    void format(size_t column, CellType type, const CellFormatter& formatter)
+    {
+        bool binary;
+        display[column] = formatter.displayText(cells[column], type, binary);
+        setTag(column, static_cast<uint8_t>(static_cast<uint8_t>(type) | (binary ? BinaryFlag : 0)));
+    }
+};
+
+#endif
@@ -0,0 +1,212 @@
+#include "CompletionTrie.h"
+
+#include <algorithm>
+
+std::string CompletionTrie::fold(const std::string& word)
+{
+    std::string key(word);
+    for(char& c : key)
+    {
+        if(c >= 'A' && c <= 'Z')
+            c = static_cast<char>(c - 'A' + 'a');
+    }
+    return key;
+}
+
+CompletionTrie::CompletionTrie()
+{
+    clear();
+}
+
+void CompletionTrie::clear()
+{
+    m_nodes.clear();
+    m_words.clear();
+    m_size = 0;
+    m_unused = 0;
+
+    // The root node doesn't have a label
+    addNode(std::string());
+}
+
+int CompletionTrie::addNode(const std::string& label)
+{
+    m_nodes.push_back({label, -1, -1, -1});
+    return static_cast<int>(m_nodes.size()) - 1;
+}
+
+void CompletionTrie::insert(const std::string& word)
+{
+    insert(word, 1);
+}
+
+void CompletionTrie::insert(const std::string& word, unsigned int references)
+{
+    const std::string key = fold(word);
+
+    // Walk down the tree as far as the key matches, splitting edges and adding a new leaf where it doesn't match anymore.
+    // Careful: adding nodes invalidates all references into m_nodes, so only indices are kept across these calls.
+    int node = 0;
+    size_t pos = 0;
+    while(pos < key.size())
+    {
+        int previous = -1;
+        int child = m_nodes[static_cast<size_t>(node)].firstChild;
+        while(child != -1 && m_nodes[static_cast<size_t>(child)].label[0] < key[pos])
+        {
+            previous = child;
+            child = m_nodes[static_cast<size_t>(child)].nextSibling;
+        }
+
+        int next;
+        if(child == -1 || m_nodes[static_cast<size_t>(child)].label[0] != key[pos])
+        {
+            // No edge starts with this character. Add a leaf for the rest of the key
+            next = addNode(key.substr(pos));
+            m_nodes[static_cast<size_t>(next)].nextSibling = child;
+            pos = key.size();
+        } else {
+            const std::string& label = m_nodes[static_cast<size_t>(child)].label;
+            size_t common = 1;
+            while(common < label.size() && pos + common < key.size() && label[common] == key[pos + common])
+                common++;
+
+            if(common == label.size())
+            {
+                // The whole edge matches. Continue with its node
+                node = child;
+                pos += common;
+                continue;
+            }
+
+            // Only the beginning of the edge matches. Split it up
+            next = addNode(label.substr(0, common));
+            Node& split = m_nodes[static_cast<size_t>(next)];
+            Node& old = m_nodes[static_cast<size_t>(child)];
+            split.firstChild = child;
+            split.nextSibling = old.nextSibling;
+            old.nextSibling = -1;
+            old.label.erase(0, common);
+            pos += common;
+        }
+
+        if(previous == -1)
+            m_nodes[static_cast<size_t>(node)].firstChild = next;
+        else
+            m_nodes[static_cast<size_t>(previous)].nextSibling = next;
+        node = next;
+    }
+
+    // Add the reference to the spelling
+    int last = -1;
+    for(int w=m_nodes[static_cast<size_t>(node)].word;w!=-1;w=m_words[static_cast<size_t>(w)].next)
+    {
+        Word& spelling = m_words[static_cast<size_t>(w)];
+        if(spelling.text == word)
+        {
+            if(spelling.references == 0)
+            {
+                m_unused--;
+                m_size++;
+            }
+            spelling.references += references;
+            return;
+        }
+        last = w;
+    }
+
+    m_words.push_back({word, references, -1});
+    const int added = static_cast<int>(m_words.size()) - 1;
+    if(last == -1)
+        m_nodes[static_cast<size_t>(node)].word = added;
+    else
+        m_words[static_cast<size_t>(last)].next = added;
+    m_size++;
+}
+
+int CompletionTrie::findNode(const std::string& key) const
+{
+    // Returns the node at which the key ends. If the key ends in the middle of an edge, this is the node the edge leads to
+    int node = 0;
+    size_t pos = 0;
+    while(pos < key.size())
+    {
+        int child = m_nodes[static_cast<size_t>(node)].firstChild;
+        while(child != -1 && m_nodes[static_cast<size_t>(child)].label[0] < key[pos])
+            child = m_nodes[static_cast<size_t>(child)].nextSibling;
+        if(child == -1)
+            return -1;
+
+        const std::string& label = m_nodes[static_cast<size_t>(child)].label;
+        size_t length = std::min(label.size(), key.size() - pos);
+        if(label.compare(0, length, key, pos, length) != 0)
+            return -1;
+
+        node = child;
+        pos += length;
+    }
+
+    return node;
+}
+
+bool CompletionTrie::remove(const std::string& word)
+{
+    const std::string key = fold(word);
+    int node = findNode(key);
+    if(node == -1)
+        return false;
+
+    for(int w=m_nodes[static_cast<size_t>(node)].word;w!=-1;w=m_words[static_cast<size_t>(w)].next)
+    {
+        Word& spelling = m_words[static_cast<size_t>(w)];
+        if(spelling.text == word && spelling.references)
+        {
+            if(--spelling.references == 0)
+            {
+                m_size--;
+                m_unused++;
+
+                // Nodes and spellings aren't freed one by one. Instead the trie is rebuilt once most of it is unused
+                if(m_unused > 64 && m_unused > m_size)
+                    compact();
+            }
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void CompletionTrie::complete(const std::string& prefix, std::vector<std::string>& words, size_t limit) const
+{
+    int node = findNode(fold(prefix));
+    if(node != -1)
+        collect(node, words, limit);
+}
+
+void CompletionTrie::collect(int node, std::vector<std::string>& words, size_t limit) const
+{
+    const Node& n = m_nodes[static_cast<size_t>(node)];
+    for(int w=n.word;w!=-1 && words.size()<limit;w=m_words[static_cast<size_t>(w)].next)
+    {
+        const Word& spelling = m_words[static_cast<size_t>(w)];
+        if(spelling.references)
+            words.push_back(spelling.text);
+    }
+
+    for(int child=n.firstChild;child!=-1 && words.size()<limit;child=m_nodes[static_cast<size_t>(child)].nextSibling)
+        collect(child, words, limit);
+}
+
+void CompletionTrie::compact()
+{
+    std::vector<Word> words;
+    words.swap(m_words);
+
+    clear();
+    for(const Word& w : words)
+    {
+        if(w.references)
+            insert(w.text, w.references);
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef COMPLETIONTRIE_H
+#define COMPLETIONTRIE_H
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief The CompletionTrie class
+ * A compressed prefix tree of words for auto completion. Lookups ignore the case of ASCII letters just like SQLite does
+ * when comparing identifiers, but the words are returned in the spelling in which they were inserted. Each spelling is
+ * reference counted, so the same word can be inserted once for every object it belongs to and stays in the trie until
+ * it has been removed as often as it was inserted.
+ */
+class CompletionTrie
+{
+public:
+    CompletionTrie();
+
+    /// Adds one reference to the word
+    void insert(const std::string& word);
+
+    /// Removes one reference to the word. \returns false if the word isn't in the trie
+    bool remove(const std::string& word);
+
+    void clear();
+
+    /// \returns the number of distinct spellings in the trie
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    /// Appends all words starting with prefix to words until words holds limit elements
+    void complete(const std::string& prefix, std::vector<std::string>& words, size_t limit) const;
+
+    /// \returns the word with all ASCII letters in lower case. This is the form in which words are compared
+    static std::string fold(const std::string& word);
+
+private:
+    struct Node
+    {
+        std::string label;      // Folded characters on the edge leading to this node
+        int firstChild;
+        int nextSibling;        // Siblings are sorted by the first character of their labels
+        int word;               // First spelling of the word ending here or -1
+    };
+
+    struct Word
+    {
+        std::string text;
+        unsigned int references;
+        int next;               // Next spelling of the same word or -1
+    };
+
+    std::vector<Node> m_nodes;
+    std::vector<Word> m_words;
+    size_t m_size;
+    size_t m_unused;            // Spellings without references which are still allocated
+
+    int addNode(const std::string& label);
+    int findNode(const std::string& key) const;
+    void insert(const std::string& word, unsigned int references);
+    void collect(int node, std::vector<std::string>& words, size_t limit) const;
+    void compact();
+};
+
+#endif
@@ -2,6 +2,9 @@
 
 #include <QTextCodec>
 #include <algorithm>
+#include <json.hpp>
+
+using json = nlohmann::json;
 
 // Note that these aren't all possible BOMs. But they are probably the most common ones.
 // The size is needed at least for the ones with character zero in them.
@@ -53,6 +56,38 @@ bool startsWithBom(const QByteArray& data)
         return false;
 }
 
+bool isImageData(const QByteArray& data)
+{
+    static const QByteArray png("\x89PNG\r\n\x1A\n", 8);
+    static const QByteArray jpeg("\xFF\xD8\xFF", 3);
+    static const QByteArray gif87("GIF87a");
+    static const QByteArray gif89("GIF89a");
+    static const QByteArray bmp("BM");
+    static const QByteArray ico("\x00\x00\x01\x00", 4);
+    static const QByteArray tiff_le("II*\x00", 4);
+    static const QByteArray tiff_be("MM\x00*", 4);
+
+    if(data.startsWith(png) || data.startsWith(jpeg) || data.startsWith(gif87) || data.startsWith(gif89) ||
+            data.startsWith(ico) || data.startsWith(tiff_le) || data.startsWith(tiff_be))
+        return true;
+
+    // The BMP signature is very short, so also check that the file size in the header matches
+    if(data.startsWith(bmp) && data.size() >= 6)
+    {
+        const quint32 size = static_cast<quint8>(data.at(2)) | static_cast<quint8>(data.at(3)) << 8 |
+                static_cast<quint32>(static_cast<quint8>(data.at(4))) << 16 | static_cast<quint32>(static_cast<quint8>(data.at(5))) << 24;
+        return size == static_cast<quint32>(data.size());
+    }
+
+    // WebP images are stored in a RIFF container
+    if(data.startsWith("RIFF") && data.mid(8, 4) == "WEBP")
+        return true;
+
+    // SVG images are text, so look for the root element near the beginning
+    const QByteArray head = data.left(1024).trimmed();
+    return (head.startsWith("<svg") || head.startsWith("<?xml")) && head.contains("<svg");
+}
+
 QByteArray removeBom(QByteArray& data)
 {
     if(data.startsWith(bom3))
@@ -96,3 +131,41 @@ QByteArray decodeString(const QByteArray& str, const QString& encoding)
     else
         return QTextCodec::codecForName(encoding.toUtf8())->toUnicode(str).toUtf8();
 }
+
+// Converts a single value of a composite rowid into its JSON representation, keeping its storage class
+static json compositeRowidValue(const QByteArray& value, CellType type)
+{
+    switch(type)
+    {
+    case CellType::Null:
+        return nullptr;
+    case CellType::Integer:
+        return value.toLongLong();
+    case CellType::Float:
+        return value.toDouble();
+    case CellType::Blob:
+        // Blobs aren't necessarily valid UTF-8, so they are stored as hex
+        return json{{"blob", value.toHex().toStdString()}};
+    default:
+        return value.toStdString();
+    }
+}
+
+QByteArray makeCompositeRowid(const std::vector<QByteArray>& values, const std::vector<CellType>& types)
+{
+    json array = json::array();
+    for(size_t i=0;i<values.size();i++)
+        array.push_back(compositeRowidValue(values.at(i), types.at(i)));
+
+    return QByteArray::fromStdString(array.dump(-1, ' ', false, json::error_handler_t::replace));
+}
+
+QByteArray replaceCompositeRowidValue(const QByteArray& rowid, size_t index, const QByteArray& value, CellType type)
+{
+    json array = json::parse(rowid.toStdString(), nullptr, false);
+    if(!array.is_array() || index >= array.size())
+        return QByteArray();
+
+    array[index] = compositeRowidValue(value, type);
+    return QByteArray::fromStdString(array.dump(-1, ' ', false, json::error_handler_t::replace));
+}
@@ -4,6 +4,19 @@
 #include <QString>
 #include <QByteArray>
 
+#include <cstdint>
+#include <vector>
+
+// Storage class of a cell as reported by SQLite when fetching it
+enum class CellType : uint8_t
+{
+    Null = 0,
+    Integer,
+    Float,
+    Text,
+    Blob
+};
+
 // This returns false if the data in the data parameter contains binary data. If it is text only, the function returns
 // true. If the second parameter is specified, it will be used to convert the data from the given encoding to Unicode
 // before doing the check. The third parameter can be used to only check the first couple of bytes which speeds up the
@@ -18,10 +31,25 @@ bool startsWithBom(const QByteArray& data);
 // with a BOM an empty byte array is returned and the original data is not modified.
 QByteArray removeBom(QByteArray& data);
 
+// This returns true if the data in the data parameter starts with the signature of one of the common image formats. Only
+// the first couple of bytes are looked at, so this is a lot faster than trying to load the image but it doesn't guarantee
+// that the rest of the data is a valid image, too.
+bool isImageData(const QByteArray& data);
+
 QStringList toStringList(const QList<QByteArray>& list);
 
 QByteArray encodeString(const QByteArray& str, const QString& encoding);
 
 QByteArray decodeString(const QByteArray& str, const QString& encoding);
 
+// This combines the values of a multi-column primary key into a single value which is then used as the rowid of the row.
+// The result is a JSON array in which numbers are stored as numbers, blobs as objects with the hex encoded value in their
+// "blob" member and everything else as strings. This way the values can be bound using the right types again when looking
+// up the row by its primary key. Floating point values need to be passed with enough digits to be read back exactly.
+QByteArray makeCompositeRowid(const std::vector<QByteArray>& values, const std::vector<CellType>& types);
+
+// This replaces the value at position index of a rowid created by makeCompositeRowid(). The other values are kept as they are.
+// If the rowid isn't a composite one or has fewer values, a null byte array is returned.
+QByteArray replaceCompositeRowidValue(const QByteArray& rowid, size_t index, const QByteArray& value, CellType type);
+
 #endif
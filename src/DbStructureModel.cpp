@@ -7,8 +7,10 @@
 #include <QMimeData>
 #include <QMessageBox>
 #include <QApplication>
-#include <unordered_map>
+#include <algorithm>
+#include <iterator>
 #include <map>
+#include <unordered_set>
 
 DbStructureModel::DbStructureModel(DBBrowserDB& db, QObject* parent)
     : QAbstractItemModel(parent),
@@ -122,10 +124,15 @@ QModelIndex DbStructureModel::parent(const QModelIndex& index) const
     QTreeWidgetItem* childItem = static_cast<QTreeWidgetItem*>(index.internalPointer());
     QTreeWidgetItem* parentItem = childItem->parent();
 
-    if(parentItem == rootItem)
+    return itemIndex(parentItem);
+}
+
+QModelIndex DbStructureModel::itemIndex(QTreeWidgetItem* item) const
+{
+    if(item == rootItem)
         return QModelIndex();
     else
-        return createIndex(0, 0, parentItem);
+        return createIndex(item->parent()->indexOfChild(item), 0, item);
 }
 
 int DbStructureModel::rowCount(const QModelIndex& parent) const
@@ -139,6 +146,45 @@ int DbStructureModel::rowCount(const QModelIndex& parent) const
         return static_cast<QTreeWidgetItem*>(parent.internalPointer())->childCount();
 }
 
+bool DbStructureModel::hasChildren(const QModelIndex& parent) const
+{
+    // Objects which haven't been parsed yet get their field nodes when they are expanded
+    if(canFetchMore(parent))
+        return true;
+    return QAbstractItemModel::hasChildren(parent);
+}
+
+bool DbStructureModel::canFetchMore(const QModelIndex& parent) const
+{
+    if(!parent.isValid())
+        return false;
+
+    return static_cast<QTreeWidgetItem*>(parent.internalPointer())->data(ColumnName, FieldsPendingRole).toBool();
+}
+
+void DbStructureModel::fetchMore(const QModelIndex& parent)
+{
+    if(!canFetchMore(parent))
+        return;
+
+    QTreeWidgetItem* item = static_cast<QTreeWidgetItem*>(parent.internalPointer());
+    item->setData(ColumnName, FieldsPendingRole, QVariant());
+
+    // This parses the object
+    const std::string schema = item->text(ColumnSchema).toStdString();
+    sqlb::ObjectPtr object = m_db.getObjectByName(sqlb::ObjectIdentifier(schema, item->text(ColumnName).toStdString()));
+    if(!object)
+        return;
+
+    const int count = static_cast<int>(object->fieldInformation().size());
+    if(count == 0)
+        return;
+
+    beginInsertRows(parent.sibling(parent.row(), 0), 0, count - 1);
+    addFieldNodes(item, object, schema);
+    endInsertRows();
+}
+
 void DbStructureModel::reloadData()
 {
     beginResetModel();
@@ -146,6 +192,7 @@ void DbStructureModel::reloadData()
     // Remove all data except for the root item
     while(rootItem->childCount())
         delete rootItem->child(0);
+    browsablesRootItem = nullptr;
 
     // Return here if no DB is opened
     if(!m_db.isOpen())
@@ -163,39 +210,87 @@ void DbStructureModel::reloadData()
     browsablesRootItem->setIcon(ColumnName, QIcon(QString(":/icons/view")));
     browsablesRootItem->setText(ColumnName, tr("Browsables"));
 
-    // Make sure to always load the main schema first
+    // The main schema doesn't get a node of its own. Its object nodes go directly into the 'all' node.
     QTreeWidgetItem* itemAll = new QTreeWidgetItem(rootItem);
     itemAll->setIcon(ColumnName, QIcon(QString(":/icons/database")));
     itemAll->setText(ColumnName, tr("All"));
     itemAll->setText(ColumnObjectType, "database");
-    buildTree(itemAll, "main");
+    itemAll->setData(ColumnName, SchemaRole, "main");
+    addGroupNodes(itemAll);
 
-    // Add the temporary database as a node if it isn't empty. Make sure it's always second if it exists.
-    if(!m_db.schemata["temp"].empty())
+    endResetModel();
+
+    // The other schemata and all the objects are added just like for any later change
+    updateData();
+}
+
+void DbStructureModel::updateData()
+{
+    // Without any nodes there is nothing to update. This also takes care of opening and closing the database.
+    if(!m_db.isOpen() || !browsablesRootItem)
     {
-        QTreeWidgetItem* itemTemp = new QTreeWidgetItem(itemAll);
-        itemTemp->setIcon(ColumnName, QIcon(QString(":/icons/database")));
-        itemTemp->setText(ColumnName, tr("Temporary"));
-        itemTemp->setText(ColumnObjectType, "database");
-        buildTree(itemTemp, "temp");
+        reloadData();
+        return;
     }
 
-    // Now load all the other schemata last
+    // Make sure to always show the main schema first and the temporary schema second but only if it isn't empty.
+    // All the other schemata follow in alphabetical order.
+    std::vector<std::string> schemata = {"main"};
+    auto temp = m_db.schemata.find("temp");
+    if(temp != m_db.schemata.end() && !temp->second.empty())
+        schemata.push_back("temp");
     for(const auto& it : m_db.schemata)
     {
-        // Don't load the main and temp schema again
         if(it.first != "main" && it.first != "temp")
+            schemata.push_back(it.first);
+    }
+
+    // The schemata other than main have a node of their own which follows the four group nodes of the main schema
+    QTreeWidgetItem* itemAll = rootItem->child(1);
+    const int first_schema_row = 4;
+
+    // Remove the nodes of detached schemata
+    for(int row=itemAll->childCount()-1;row>=first_schema_row;row--)
+    {
+        if(!contains(schemata, itemAll->child(row)->data(ColumnName, SchemaRole).toString().toStdString()))
         {
-            QTreeWidgetItem* itemSchema = new QTreeWidgetItem(itemAll);
-            itemSchema->setIcon(ColumnName, QIcon(QString(":/icons/database")));
-            itemSchema->setText(ColumnName, QString::fromStdString(it.first));
-            itemSchema->setText(ColumnObjectType, "database");
-            buildTree(itemSchema, it.first);
+            beginRemoveRows(itemIndex(itemAll), row, row);
+            delete itemAll->takeChild(row);
+            endRemoveRows();
         }
     }
 
-    // Refresh the view
-    endResetModel();
+    // Add nodes for the new schemata and update the object nodes of all schemata
+    std::vector<SchemaObject> browsables;
+    for(size_t i=0;i<schemata.size();i++)
+    {
+        const std::string& schema = schemata.at(i);
+
+        QTreeWidgetItem* item = itemAll;
+        if(schema != "main")
+        {
+            const int row = first_schema_row + static_cast<int>(i) - 1;
+            item = itemAll->child(row);
+            if(!item || item->data(ColumnName, SchemaRole).toString().toStdString() != schema)
+            {
+                item = new QTreeWidgetItem;
+                item->setIcon(ColumnName, QIcon(QString(":/icons/database")));
+                item->setText(ColumnName, schema == "temp" ? tr("Temporary") : QString::fromStdString(schema));
+                item->setText(ColumnObjectType, "database");
+                item->setData(ColumnName, SchemaRole, QString::fromStdString(schema));
+                addGroupNodes(item);
+
+                beginInsertRows(itemIndex(itemAll), row, row);
+                itemAll->insertChild(row, item);
+                endInsertRows();
+            }
+        }
+
+        updateSchemaNodes(item, schema, browsables);
+    }
+
+    updateObjectNodes(browsablesRootItem, browsables, false);
+
     emit structureUpdated();
 }
 
@@ -302,105 +397,252 @@ bool DbStructureModel::dropMimeData(const QMimeData* data, Qt::DropAction action
     }
 }
 
-static long calc_number_of_objects_by_type(const objectMap& objmap, const std::string& type)
-{
-    auto objects = objmap.equal_range(type);
-    if(objects.first == objmap.end())
-        return 0;
-    else
-        return std::distance(objects.first, objects.second);
-}
-
-void DbStructureModel::buildTree(QTreeWidgetItem* parent, const std::string& schema)
+void DbStructureModel::addGroupNodes(QTreeWidgetItem* parent)
 {
-    // Build a map from object type to tree node to simplify finding the correct tree node later
-    std::unordered_map<std::string, QTreeWidgetItem*> typeToParentItem;
-
-    // Get object map for the given schema
-    objectMap objmap = m_db.schemata[schema];
-
-    // Prepare tree
+    // The order of these nodes needs to match the one in updateSchemaNodes()
     QTreeWidgetItem* itemTables = new QTreeWidgetItem(parent);
     itemTables->setIcon(ColumnName, QIcon(QString(":/icons/table")));
-    itemTables->setText(ColumnName, tr("Tables (%1)").arg(calc_number_of_objects_by_type(objmap, "table")));
-    typeToParentItem.insert({"table", itemTables});
 
     QTreeWidgetItem* itemIndices = new QTreeWidgetItem(parent);
     itemIndices->setIcon(ColumnName, QIcon(QString(":/icons/index")));
-    itemIndices->setText(ColumnName, tr("Indices (%1)").arg(calc_number_of_objects_by_type(objmap, "index")));
-    typeToParentItem.insert({"index", itemIndices});
 
     QTreeWidgetItem* itemViews = new QTreeWidgetItem(parent);
     itemViews->setIcon(ColumnName, QIcon(QString(":/icons/view")));
-    itemViews->setText(ColumnName, tr("Views (%1)").arg(calc_number_of_objects_by_type(objmap, "view")));
-    typeToParentItem.insert({"view", itemViews});
 
     QTreeWidgetItem* itemTriggers = new QTreeWidgetItem(parent);
     itemTriggers->setIcon(ColumnName, QIcon(QString(":/icons/trigger")));
-    itemTriggers->setText(ColumnName, tr("Triggers (%1)").arg(calc_number_of_objects_by_type(objmap, "trigger")));
-    typeToParentItem.insert({"trigger", itemTriggers});
+}
 
-    // Get all database objects and sort them by their name
-    std::map<std::string, sqlb::ObjectPtr> dbobjs;
-    for(const auto& it : objmap)
-        dbobjs.insert({it.second->name(), it.second});
+void DbStructureModel::updateSchemaNodes(QTreeWidgetItem* parent, const std::string& schema, std::vector<SchemaObject>& browsables)
+{
+    // Get all database objects of each type and sort them by their name
+    std::map<std::string, std::vector<SchemaObject>> objects;
+    for(const auto& it : m_db.schemata.at(schema))
+        objects[sqlb::Object::typeToString(it.second->type())].emplace_back(schema, it.second);
+    for(auto& it : objects)
+    {
+        std::stable_sort(it.second.begin(), it.second.end(), [](const SchemaObject& a, const SchemaObject& b) {
+            return a.second->name() < b.second->name();
+        });
+    }
 
-    // Add the database objects to the tree nodes
-    for(const auto& obj : dbobjs)
+    const std::vector<std::pair<std::string, QString>> groups = {
+        {"table", tr("Tables (%1)")},
+        {"index", tr("Indices (%1)")},
+        {"view", tr("Views (%1)")},
+        {"trigger", tr("Triggers (%1)")},
+    };
+    for(size_t i=0;i<groups.size();i++)
     {
-        sqlb::ObjectPtr it = obj.second;
+        const std::vector<SchemaObject>& group_objects = objects[groups.at(i).first];
+        QTreeWidgetItem* group = parent->child(static_cast<int>(i));
 
-        // Object node
-        QTreeWidgetItem* item = addNode(typeToParentItem.at(sqlb::Object::typeToString(it->type())), it, schema);
+        setItemText(group, ColumnName, groups.at(i).second.arg(group_objects.size()));
+        updateObjectNodes(group, group_objects, true);
+    }
 
-        // If it is a table or view add the field nodes, add an extra node for the browsable section
-        if(it->type() == sqlb::Object::Types::Table || it->type() == sqlb::Object::Types::View)
-            addNode(browsablesRootItem, it, schema);
+    // Tables and views also show up in the browsable section, sorted by their names
+    std::vector<SchemaObject> schema_browsables;
+    std::merge(objects["table"].begin(), objects["table"].end(), objects["view"].begin(), objects["view"].end(),
+               std::back_inserter(schema_browsables), [](const SchemaObject& a, const SchemaObject& b) {
+        return a.second->name() < b.second->name();
+    });
+    browsables.insert(browsables.end(), schema_browsables.begin(), schema_browsables.end());
+}
+
+static std::string nodeKey(const std::string& schema, const std::string& type, const std::string& name)
+{
+    return schema + '\0' + type + '\0' + name;
+}
 
-        // Add field nodes if there are any
-        sqlb::FieldInfoList fieldList = it->fieldInformation();
-        if(!fieldList.empty())
+static std::string nodeKey(const QTreeWidgetItem* item)
+{
+    return nodeKey(item->text(DbStructureModel::ColumnSchema).toStdString(),
+                   item->text(DbStructureModel::ColumnObjectType).toStdString(),
+                   item->text(DbStructureModel::ColumnName).toStdString());
+}
+
+static std::string nodeKey(const std::pair<std::string, sqlb::ObjectPtr>& object)
+{
+    return nodeKey(object.first, sqlb::Object::typeToString(object.second->type()), object.second->name());
+}
+
+void DbStructureModel::updateObjectNodes(QTreeWidgetItem* parent, const std::vector<SchemaObject>& objects, bool withFields)
+{
+    // The child nodes of the parent are sorted in the same way as the list of objects. So after removing the nodes of all objects
+    // which don't exist anymore, the remaining nodes are in the right order and the nodes for new objects only need to be inserted
+    // at the right positions. Consecutive nodes are removed or inserted in one go.
+
+    std::unordered_set<std::string> keys;
+    for(const auto& object : objects)
+        keys.insert(nodeKey(object));
+
+    for(int row=parent->childCount()-1;row>=0;)
+    {
+        const int last = row;
+        while(row >= 0 && !keys.count(nodeKey(parent->child(row))))
+            row--;
+
+        if(row == last)
         {
-            sqlb::StringVector pk_columns;
-            if(it->type() == sqlb::Object::Types::Table)
-                pk_columns = std::dynamic_pointer_cast<sqlb::Table>(it)->primaryKey();
-            for(const sqlb::FieldInfo& field : fieldList)
-            {
-                QTreeWidgetItem *fldItem = new QTreeWidgetItem(item);
-                bool isFK = false;
-                if(it->type() == sqlb::Object::Types::Table)
-                    isFK = std::dynamic_pointer_cast<sqlb::Table>(it)->constraint({field.name}, sqlb::Constraint::ForeignKeyConstraintType) != nullptr;
-
-                fldItem->setText(ColumnName, QString::fromStdString(field.name));
-                fldItem->setText(ColumnObjectType, "field");
-                fldItem->setText(ColumnDataType, QString::fromStdString(field.type));
-                fldItem->setText(ColumnSQL, QString::fromStdString(field.sql));
-                fldItem->setText(ColumnSchema, QString::fromStdString(schema));
-                if(contains(pk_columns, field.name))
-                    fldItem->setIcon(ColumnName, QIcon(":/icons/field_key"));
-                else if(isFK)
-                    fldItem->setIcon(ColumnName, QIcon(":/icons/field_fk"));
-                else
-                    fldItem->setIcon(ColumnName, QIcon(":/icons/field"));
-            }
+            row--;
+        } else {
+            beginRemoveRows(itemIndex(parent), row + 1, last);
+            for(int i=last;i>row;i--)
+                delete parent->takeChild(i);
+            endRemoveRows();
+        }
+    }
+
+    int row = 0;
+    for(size_t i=0;i<objects.size();)
+    {
+        QTreeWidgetItem* item = parent->child(row);
+        const std::string item_key = item ? nodeKey(item) : std::string();
+        if(item && item_key == nodeKey(objects.at(i)))
+        {
+            updateNode(item, objects.at(i).second, objects.at(i).first, withFields);
+            row++;
+            i++;
+        } else {
+            // All objects up to the one of the current node are new
+            size_t end = i;
+            while(end < objects.size() && (!item || nodeKey(objects.at(end)) != item_key))
+                end++;
+
+            QList<QTreeWidgetItem*> items;
+            for(;i<end;i++)
+                items.push_back(createNode(objects.at(i).second, objects.at(i).first, withFields));
+
+            beginInsertRows(itemIndex(parent), row, row + items.size() - 1);
+            parent->insertChildren(row, items);
+            endInsertRows();
+            row += items.size();
         }
     }
 }
 
-QTreeWidgetItem* DbStructureModel::addNode(QTreeWidgetItem* parent, const sqlb::ObjectPtr& object, const std::string& schema)
+QTreeWidgetItem* DbStructureModel::createNode(const sqlb::ObjectPtr& object, const std::string& schema, bool withFields)
 {
     QString type = QString::fromStdString(sqlb::Object::typeToString(object->type()));
 
-    QTreeWidgetItem *item = new QTreeWidgetItem(parent);
+    QTreeWidgetItem *item = new QTreeWidgetItem;
     item->setIcon(ColumnName, QIcon(QString(":/icons/%1").arg(type)));
     item->setText(ColumnName, QString::fromStdString(object->name()));
     item->setText(ColumnObjectType, type);
     item->setText(ColumnSQL, QString::fromStdString(object->originalSql()));
     item->setText(ColumnSchema, QString::fromStdString(schema));
 
+    // Add field nodes if there are any. For stubs this is done when they are expanded.
+    if(withFields)
+    {
+        if(m_db.isParsed(schema, object))
+            addFieldNodes(item, object, schema);
+        else
+            item->setData(ColumnName, FieldsPendingRole, true);
+    }
+
     return item;
 }
 
+void DbStructureModel::updateNode(QTreeWidgetItem* item, const sqlb::ObjectPtr& object, const std::string& schema, bool withFields)
+{
+    const QString sql = QString::fromStdString(object->originalSql());
+    const bool sql_changed = item->text(ColumnSQL) != sql;
+    setItemText(item, ColumnSQL, sql);
+
+    // Nothing to do if the field nodes haven't been added yet. They are added for the current object when the node is expanded.
+    if(!withFields || item->data(ColumnName, FieldsPendingRole).toBool())
+        return;
+
+    if(!m_db.isParsed(schema, object))
+    {
+        // The object has been replaced by a stub, so wait for the node to be expanded again
+        removeFieldNodes(item);
+        item->setData(ColumnName, FieldsPendingRole, true);
+        return;
+    }
+
+    // The columns of views can change without their SQL changing, so compare the field nodes, too
+    bool fields_changed = sql_changed;
+    if(!fields_changed)
+    {
+        const sqlb::FieldInfoList fields = object->fieldInformation();
+        fields_changed = static_cast<int>(fields.size()) != item->childCount();
+        for(int i=0;!fields_changed && i<item->childCount();i++)
+        {
+            const QTreeWidgetItem* field = item->child(i);
+            const sqlb::FieldInfo& info = fields.at(static_cast<size_t>(i));
+            fields_changed = field->text(ColumnName).toStdString() != info.name ||
+                    field->text(ColumnDataType).toStdString() != info.type ||
+                    field->text(ColumnSQL).toStdString() != info.sql;
+        }
+    }
+
+    if(fields_changed)
+    {
+        removeFieldNodes(item);
+
+        const int count = static_cast<int>(object->fieldInformation().size());
+        if(count)
+        {
+            beginInsertRows(itemIndex(item), 0, count - 1);
+            addFieldNodes(item, object, schema);
+            endInsertRows();
+        }
+    }
+}
+
+void DbStructureModel::setItemText(QTreeWidgetItem* item, int column, const QString& text)
+{
+    if(item->text(column) == text)
+        return;
+
+    item->setText(column, text);
+    QModelIndex index = itemIndex(item);
+    emit dataChanged(index.sibling(index.row(), column), index.sibling(index.row(), column));
+}
+
+void DbStructureModel::removeFieldNodes(QTreeWidgetItem* item)
+{
+    if(item->childCount() == 0)
+        return;
+
+    beginRemoveRows(itemIndex(item), 0, item->childCount() - 1);
+    qDeleteAll(item->takeChildren());
+    endRemoveRows();
+}
+
+void DbStructureModel::addFieldNodes(QTreeWidgetItem* item, const sqlb::ObjectPtr& object, const std::string& schema)
+{
+    sqlb::FieldInfoList fieldList = object->fieldInformation();
+    if(fieldList.empty())
+        return;
+
+    sqlb::StringVector pk_columns;
+    if(object->type() == sqlb::Object::Types::Table)
+        pk_columns = std::dynamic_pointer_cast<sqlb::Table>(object)->primaryKey();
+    for(const sqlb::FieldInfo& field : fieldList)
+    {
+        QTreeWidgetItem *fldItem = new QTreeWidgetItem(item);
+        bool isFK = false;
+        if(object->type() == sqlb::Object::Types::Table)
+            isFK = std::dynamic_pointer_cast<sqlb::Table>(object)->constraint({field.name}, sqlb::Constraint::ForeignKeyConstraintType) != nullptr;
+
+        fldItem->setText(ColumnName, QString::fromStdString(field.name));
+        fldItem->setText(ColumnObjectType, "field");
+        fldItem->setText(ColumnDataType, QString::fromStdString(field.type));
+        fldItem->setText(ColumnSQL, QString::fromStdString(field.sql));
+        fldItem->setText(ColumnSchema, QString::fromStdString(schema));
+        if(contains(pk_columns, field.name))
+            fldItem->setIcon(ColumnName, QIcon(":/icons/field_key"));
+        else if(isFK)
+            fldItem->setIcon(ColumnName, QIcon(":/icons/field_fk"));
+        else
+            fldItem->setIcon(ColumnName, QIcon(":/icons/field"));
+    }
+}
+
 QString DbStructureModel::getNameForDropping(const QString& domain, const QString& object, const QString& field) const
 {
     // Take into account the drag&drop options for composing a name.  Commas are included for composing a
@@ -3,6 +3,9 @@
 
 #include <QAbstractItemModel>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 class DBBrowserDB;
 class QTreeWidgetItem;
@@ -23,6 +26,9 @@ public:
     QModelIndex parent(const QModelIndex& index) const override;
     int rowCount(const QModelIndex& parent = QModelIndex()) const override;
     int columnCount(const QModelIndex& = QModelIndex()) const override;
+    bool hasChildren(const QModelIndex& parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
 
     QStringList mimeTypes() const override;
     QMimeData* mimeData(const QModelIndexList& indices) const override;
@@ -39,6 +45,10 @@ public:
 
 public slots:
     void reloadData();
+
+    /// Brings the tree in line with the current schema of the database. Unlike reloadData() this only inserts, removes or updates
+    /// the nodes of objects which have changed, so the views keep their expanded nodes and their selection.
+    void updateData();
     void setDropQualifiedNames(bool value) { m_dropQualifiedNames = value; }
     void setDropEnquotedNames(bool value) { m_dropEnquotedNames = value; }
 
@@ -46,14 +56,28 @@ signals:
     void structureUpdated();
 
 private:
+    // Set for object items whose field nodes are only added when they are expanded
+    static const int FieldsPendingRole = Qt::UserRole;
+    // The schema name of database items
+    static const int SchemaRole = Qt::UserRole + 1;
+
+    using SchemaObject = std::pair<std::string, sqlb::ObjectPtr>;
+
     DBBrowserDB& m_db;
     QTreeWidgetItem* rootItem;
     QTreeWidgetItem* browsablesRootItem;
     bool m_dropQualifiedNames;
     bool m_dropEnquotedNames;
 
-    void buildTree(QTreeWidgetItem* parent, const std::string& schema);
-    QTreeWidgetItem* addNode(QTreeWidgetItem* parent, const sqlb::ObjectPtr& object, const std::string& schema);
+    QModelIndex itemIndex(QTreeWidgetItem* item) const;
+    void addGroupNodes(QTreeWidgetItem* parent);
+    void updateSchemaNodes(QTreeWidgetItem* parent, const std::string& schema, std::vector<SchemaObject>& browsables);
+    void updateObjectNodes(QTreeWidgetItem* parent, const std::vector<SchemaObject>& objects, bool withFields);
+    QTreeWidgetItem* createNode(const sqlb::ObjectPtr& object, const std::string& schema, bool withFields);
+    void updateNode(QTreeWidgetItem* item, const sqlb::ObjectPtr& object, const std::string& schema, bool withFields);
+    void setItemText(QTreeWidgetItem* item, int column, const QString& text);
+    void addFieldNodes(QTreeWidgetItem* item, const sqlb::ObjectPtr& object, const std::string& schema);
+    void removeFieldNodes(QTreeWidgetItem* item);
     QString getNameForDropping(const QString& domain, const QString& object, const QString& field) const;
 };
 
@@ -1,6 +1,7 @@
 #include "EditDialog.h"
 #include "ui_EditDialog.h"
 #include "sqlitedb.h"
+#include "sqlitetablemodel.h"
 #include "Settings.h"
 #include "qhexedit.h"
 #include "docktextedit.h"
@@ -88,7 +89,7 @@ void EditDialog::setCurrentIndex(const QModelIndex& idx)
     currentIndex = QPersistentModelIndex(idx);
 
     QByteArray bArrData = idx.data(Qt::EditRole).toByteArray();
-    loadData(bArrData);
+    loadData(bArrData, idx);
     updateCellInfoAndMode(bArrData);
 
     ui->buttonApply->setDisabled(true);
@@ -113,7 +114,7 @@ void EditDialog::reject()
 }
 
 // Loads data from a cell into the Edit Cell window
-void EditDialog::loadData(const QByteArray& bArrdata)
+void EditDialog::loadData(const QByteArray& bArrdata, const QModelIndex& source)
 {
     QImage img;
     QString textData;
@@ -122,7 +123,7 @@ void EditDialog::loadData(const QByteArray& bArrdata)
     removedBom.clear();
 
     // Determine the data type, saving that info in the class variable
-    dataType = checkDataType(bArrdata);
+    dataType = checkDataType(bArrdata, source);
 
     // Get the current editor mode (eg text, hex, image, json or xml mode)
     int editMode = ui->comboMode->currentIndex();
@@ -732,7 +733,7 @@ void EditDialog::setMustIndentAndCompact(bool enable)
 }
 
 // Determine the type of data in the cell
-int EditDialog::checkDataType(const QByteArray& bArrdata)
+int EditDialog::checkDataType(const QByteArray& bArrdata, const QModelIndex& source)
 {
     QByteArray cellData = bArrdata;
 
@@ -741,6 +742,13 @@ int EditDialog::checkDataType(const QByteArray& bArrdata)
         return Null;
     }
 
+    // If the data comes from a table model, it already knows the storage class of the cell and whether it contains binary data.
+    // Numbers are always edited as text; without this they would be taken for JSON values.
+    const SqliteTableModel* model = qobject_cast<const SqliteTableModel*>(source.model());
+    if(model && (model->cellType(source) == CellType::Integer || model->cellType(source) == CellType::Float))
+        return Text;
+    const bool binary = model && model->isBinary(source);
+
     // Check if it's an image. First do a quick test by calling canRead() which only checks the first couple of bytes or so. Only if
     // that returned true, do a more sophisticated test of the data. This way we get both, good performance and proper data checking.
     QBuffer imageBuffer(&cellData);
@@ -750,7 +758,7 @@ int EditDialog::checkDataType(const QByteArray& bArrdata)
         return imageFormat == "svg" ? SVG : Image;
 
     // Check if it's text only
-    if(isTextOnly(cellData))
+    if(!binary && isTextOnly(cellData))
     {
         if (cellData.startsWith("<?xml"))
             return XML;
@@ -36,7 +36,7 @@ private slots:
     void setNull();
     void updateApplyButton();
     void accept() override;
-    void loadData(const QByteArray& bArrdata);
+    void loadData(const QByteArray& bArrdata, const QModelIndex& source = QModelIndex());
     void toggleOverwriteMode();
     void editModeChanged(int newMode);
     void editTextChanged();
@@ -89,7 +89,7 @@ private:
         XmlEditor = 4
     };
 
-    int checkDataType(const QByteArray& bArrdata);
+    int checkDataType(const QByteArray& bArrdata, const QModelIndex& source = QModelIndex());
     QString humanReadableSize(double byteCount) const;
     bool promptInvalidData(const QString& data_type, const QString& errorString);
     void setDataInBuffer(const QByteArray& bArrdata, DataSources source);
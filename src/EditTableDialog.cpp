@@ -363,6 +363,7 @@ void EditTableDialog::itemChanged(QTreeWidgetItem *item, int column)
             if(!m_bNewTable)
             {
                 sqlb::StringVector pk = m_table.primaryKey();
+                pdb.ensureAllParsed(curTable.schema(), "table");
                 const auto tables = pdb.schemata[curTable.schema()].equal_range("table");
                 for(auto it=tables.first;it!=tables.second;++it)
                 {
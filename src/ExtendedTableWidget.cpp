@@ -4,6 +4,9 @@
 #include "sql/sqlitetypes.h"
 #include "Settings.h"
 #include "sqlitedb.h"
+#include "Data.h"
+#include "csvparser.h"
+#include "sqlite.h"
 
 #include <QApplication>
 #include <QClipboard>
@@ -22,8 +25,21 @@
 #include <QTextDocument>
 #include <QCompleter>
 #include <QComboBox>
-
+#include <QTableView>
+#include <QDebug>
+#include <QStringListModel>
+#include <QTextStream>
+#include <QProgressDialog>
+#include <QEventLoop>
+#include <QTimer>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <atomic>
+#include <iterator>
 #include <limits>
+#include <memory>
+#include <mutex>
 
 using BufferRow = std::vector<QByteArray>;
 std::vector<BufferRow> ExtendedTableWidget::m_buffer;
@@ -34,88 +50,649 @@ namespace
 
 std::vector<BufferRow> parseClipboard(QString clipboard)
 {
-    // Remove trailing line break from the clipboard text. This is necessary because some applications append an extra
-    // line break to the clipboard contents which we would then interpret as regular data, setting the first field of the
-    // first row after the paste area to NULL. One problem here is that this breaks for those cases where an empty line at
-    // the end of the selection is explicitly copied and the originating application doesn't add an extra line break. However,
-    // there are two reasons for favoring this way: 1) Spreadsheet applications seem to add an extra line break and they are
-    // probably the main source for pasted data, 2) Having to manually delete on extra field seems to be less problematic than
-    // having one extra field deleted without any warning.
-    if(clipboard.endsWith("\n"))
-        clipboard.chop(1);
-    if(clipboard.endsWith("\r"))
-        clipboard.chop(1);
-
     // Make sure there is some data in the clipboard
     std::vector<BufferRow> result;
     if(clipboard.isEmpty())
         return result;
 
-    result.push_back(BufferRow());
-
-    QRegExp re("(\"(?:[^\t\"]+|\"\"[^\"]*\"\")*)\"|(\t|\r?\n)");
-    int offset = 0;
-    int whitespace_offset = 0;
-
-    while (offset >= 0) {
-        QString text;
-        int pos = re.indexIn(clipboard, offset);
-        if (pos < 0) {
-            // insert everything that left
-            text = clipboard.mid(whitespace_offset);
-            if(QRegExp("\".*\"").exactMatch(text))
-                text = text.mid(1, text.length() - 2);
-            text.replace("\"\"", "\"");
-            result.back().push_back(text.toUtf8());
-            break;
+    // Make sure the clipboard text ends with a line break. The parser doesn't create an extra row for the last line break, so this
+    // way a trailing line break is ignored. This is necessary because some applications append an extra line break to the clipboard
+    // contents which we would then interpret as regular data, setting the first field of the first row after the paste area to NULL.
+    // One problem here is that this breaks for those cases where an empty line at the end of the selection is explicitly copied and
+    // the originating application doesn't add an extra line break. However, there are two reasons for favoring this way: 1) Spreadsheet
+    // applications seem to add an extra line break and they are probably the main source for pasted data, 2) Having to manually delete
+    // on extra field seems to be less problematic than having one extra field deleted without any warning.
+    if(!clipboard.endsWith("\n") && !clipboard.endsWith("\r"))
+        clipboard.append("\n");
+
+    // The clipboard contains tab separated values. Spreadsheet applications only put quotes around entire cells which contain tabs,
+    // line breaks or quotes, so quotes in the middle of a cell are taken as they are. Empty cells are inserted as NULL values.
+    const auto parse = [&clipboard, &result](char32_t quote) {
+        CSVParser parser(false, '\t', quote);
+        parser.setQuotesOnlyAtFieldStart(true);
+        QTextStream stream(&clipboard, QIODevice::ReadOnly);
+        result.clear();
+        return parser.parse([&result](size_t, CSVRow data) -> bool {
+            BufferRow row;
+            row.reserve(data.num_fields);
+            for(size_t i=0;i<data.num_fields;i++)
+            {
+                if(data.fields[i].data_length)
+                    row.emplace_back(data.fields[i].data, static_cast<int>(data.fields[i].data_length));
+                else
+                    row.emplace_back();
+            }
+            result.push_back(std::move(row));
+            return true;
+        }, stream);
+    };
+
+    // If a cell starts with a quote that is never closed, the text can't be parsed this way. In this case use the text as it is.
+    if(parse('"') != CSVParser::ParserResultSuccess)
+        parse(0);
+
+    return result;
+}
+
+// Selections with more cells than this are read straight from the database when copying them instead of going through the cache
+const qint64 LargeCopyCells = 100000;
+
+// The HTML version of copied data is only offered up to this size. For larger amounts of data building the HTML and parsing it in
+// the receiving application takes much longer than it's worth.
+const qint64 MaxHtmlCopySize = 32 * 1024 * 1024;
+
+// Maximum number of values fetched for completing the text in a cell editor
+const int CompletionLimit = 100;
+
+// Number of rows fetched at once by the foreign key editor, the number of additional columns of the referenced rows it shows,
+// and the maximum length of their values
+const size_t ForeignKeyPageSize = 100;
+const size_t ForeignKeyDisplayColumns = 2;
+const int ForeignKeyDisplayLength = 50;
+
+// Compares identifiers case-insensitively. compare_ci() only looks at the length of its first argument
+bool sameName(const std::string& a, const std::string& b)
+{
+    return a.size() == b.size() && compare_ci(a, b);
+}
+
+// Format which holds the generator stamp of data copied by us
+const QString GeneratorMimeType("application/x-sqlitebrowser-generator");
+
+const QByteArray fieldSepText("\t");
+#ifdef Q_OS_WIN
+const QByteArray rowSepText("\r\n");
+#else
+const QByteArray rowSepText("\n");
+#endif
+
+// The selected data when copying it
+struct CopiedTable
+{
+    QString tableName;
+    std::vector<QByteArray> headers;
+    std::vector<BufferRow> rows;
+    std::vector<std::vector<bool>> binary;
+    qint64 size = 0;
+};
+
+QString generatorStamp()
+{
+    QString now = QDateTime::currentDateTime().toString("YYYY-MM-DDTHH:mm:ss.zzz");
+    return QString("<meta name=\"generator\" content=\"%1\"><meta name=\"date\" content=\"%2\">").arg(QApplication::applicationName().toHtmlEscaped(), now);
+}
+
+QString copiedText(const CopiedTable& table)
+{
+    // Build the text as UTF-8 and convert it only once in the end
+    QByteArray result;
+    result.reserve(static_cast<int>(std::min(table.size + static_cast<qint64>(table.rows.size()) * 16, MaxHtmlCopySize)));
+
+    if(!table.headers.empty())
+    {
+        for(size_t i=0;i<table.headers.size();i++)
+        {
+            if(i)
+                result.append(fieldSepText);
+            result.append(table.headers[i]);
         }
+        result.append(rowSepText);
+    }
+
+    for(size_t row=0;row<table.rows.size();row++)
+    {
+        if(row)
+            result.append(rowSepText);
+        for(size_t column=0;column<table.rows[row].size();column++)
+        {
+            if(column)
+                result.append(fieldSepText);
 
-        if (re.pos(2) < 0) {
-            offset = pos + re.cap(1).length() + 1;
-            continue;
+            // Binary data is left out of the text version
+            if(!table.binary[row][column])
+                result.append(table.rows[row][column]);
         }
+    }
 
-        QString ws = re.cap(2);
-        // if two whitespaces in row - that's an empty cell
-        if (!(pos - whitespace_offset)) {
-            result.back().push_back(QByteArray());
-        } else {
-            text = clipboard.mid(whitespace_offset, pos - whitespace_offset);
-            if(QRegExp("\".*\"").exactMatch(text))
-                text = text.mid(1, text.length() - 2);
-            text.replace("\"\"", "\"");
-            result.back().push_back(text.toUtf8());
+    return QString::fromUtf8(result);
+}
+
+QString copiedHtml(const CopiedTable& table, const QString& stamp)
+{
+    QString htmlResult = "<!DOCTYPE HTML PUBLIC \"-//W3C//DTD HTML 4.01 Transitional//EN\">";
+    htmlResult.append("<html><head><meta http-equiv=\"content-type\" content=\"text/html; charset=utf-8\">");
+    htmlResult.append("<title></title>");
+    htmlResult.append(stamp);
+    // TODO: is this really needed by Excel, since we use <pre> for multi-line cells?
+    htmlResult.append("<style type=\"text/css\">br{mso-data-placement:same-cell;}</style></head><body>"
+                      "<table border=1 cellspacing=0 cellpadding=2>");
+
+    // Table headers
+    if(!table.headers.empty())
+    {
+        htmlResult.append("<tr><th>");
+        for(size_t i=0;i<table.headers.size();i++)
+        {
+            if(i)
+                htmlResult.append("</th><th>");
+            htmlResult.append(QString::fromUtf8(table.headers[i]).toHtmlEscaped());
         }
+        htmlResult.append("</th></tr>");
+    }
 
-        if (ws.endsWith("\n"))
-            // create new row
-            result.push_back(BufferRow());
+    // Table data rows
+    for(size_t row=0;row<table.rows.size();row++)
+    {
+        htmlResult.append("<tr><td>");
+        for(size_t column=0;column<table.rows[row].size();column++)
+        {
+            if(column)
+                htmlResult.append("</td><td>");
+
+            const QByteArray& data = table.rows[row][column];
 
-        whitespace_offset = offset = pos + ws.length();
+            // Table cell data: image? Store it as an embedded image in HTML. Only try to load the image if the data looks like one.
+            QImage img;
+            if(isImageData(data) && img.loadFromData(data))
+            {
+                QByteArray ba;
+                QBuffer buffer(&ba);
+                buffer.open(QIODevice::WriteOnly);
+                img.save(&buffer, "PNG");
+                buffer.close();
+
+                htmlResult.append("<img src=\"data:image/png;base64,");
+                htmlResult.append(QString(ba.toBase64()));
+                htmlResult.append("\" alt=\"Image\">");
+            } else if(!table.binary[row][column]) {
+                // Table cell data: text
+                if (data.contains('\n') || data.contains('\t'))
+                    htmlResult.append("<pre>" + QString::fromUtf8(data).toHtmlEscaped() + "</pre>");
+                else
+                    htmlResult.append(QString::fromUtf8(data).toHtmlEscaped());
+            }
+        }
+        htmlResult.append("</td></tr>");
     }
 
-    return result;
+    htmlResult.append("</table></body></html>");
+    return htmlResult;
 }
 
+QString copiedSql(const CopiedTable& table)
+{
+    QString sqlInsertStatement = QString("INSERT INTO %1 (").arg(table.tableName);
+    for(size_t i=0;i<table.headers.size();i++)
+    {
+        if(i)
+            sqlInsertStatement.append(", ");
+        sqlInsertStatement.append(sqlb::escapeIdentifier(QString::fromUtf8(table.headers[i])));
+    }
+    sqlInsertStatement.append(") VALUES (");
+
+    QString sqlResult;
+    for(size_t row=0;row<table.rows.size();row++)
+    {
+        if(row)
+            sqlResult.append(QString::fromUtf8(rowSepText));
+        sqlResult.append(sqlInsertStatement);
+        for(size_t column=0;column<table.rows[row].size();column++)
+        {
+            if(column)
+                sqlResult.append(", ");
+
+            if(table.binary[row][column])
+                // Table cell data: binary. Save as BLOB literal in SQL
+                sqlResult.append("X'" + table.rows[row][column].toHex() + "'");
+            else
+                sqlResult.append("'" + QString::fromUtf8(table.rows[row][column]).replace("'", "''") + "'");
+        }
+        sqlResult.append(");");
+    }
+
+    return sqlResult;
 }
 
-UniqueFilterModel::UniqueFilterModel(QObject* parent)
-    : QSortFilterProxyModel(parent)
+// Mime data of large copied selections. The HTML version is only built when it is actually requested.
+class TableMimeData : public QMimeData
 {
+public:
+    TableMimeData(std::shared_ptr<const CopiedTable> table, const QString& stamp)
+        : m_table(table),
+          m_stamp(stamp)
+    {
+    }
+
+    QStringList formats() const override
+    {
+        QStringList result = QMimeData::formats();
+        if(m_table && !result.contains("text/html"))
+            result.push_back("text/html");
+        return result;
+    }
+
+protected:
+    QVariant retrieveData(const QString& mimetype, QVariant::Type preferredType) const override
+    {
+        if(m_table && mimetype == "text/html")
+        {
+            const_cast<TableMimeData*>(this)->setHtml(copiedHtml(*m_table, m_stamp));
+            m_table = nullptr;
+        }
+        return QMimeData::retrieveData(mimetype, preferredType);
+    }
+
+private:
+    mutable std::shared_ptr<const CopiedTable> m_table;
+    QString m_stamp;
+};
+
 }
 
-bool UniqueFilterModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+// State of a running completion query. It's shared with the worker thread so the query can be aborted when the completer is gone.
+struct ColumnCompleter::QueryState
+{
+    std::mutex mutex;
+    sqlite3* db = nullptr;
+    bool cancelled = false;
+};
+
+ColumnCompleter::ColumnCompleter(DBBrowserDB& db, const sqlb::ObjectIdentifier& table, const sqlb::Field& field, QLineEdit* editor)
+    : QCompleter(editor),
+      m_db(db),
+      m_model(new QStringListModel(this)),
+      m_state(std::make_shared<QueryState>()),
+      m_prefixComplete(false)
 {
-    QModelIndex index = sourceModel()->index(sourceRow, filterKeyColumn(), sourceParent);
-    const std::string value = index.data(Qt::EditRole).toString().toStdString();
+    // For text columns with an index, search a range of values instead of using LIKE. This way SQLite can look the values up
+    // in the index. Because the range is case sensitive, the completion has to be case sensitive in this case, too.
+    bool indexed = false;
+    if(field.affinity() == "TEXT" && (field.collation().empty() || QString::fromStdString(field.collation()).compare("BINARY", Qt::CaseInsensitive) == 0))
+    {
+        // Primary keys and unique constraints come with an automatic index which isn't listed in the schema
+        indexed = field.unique();
+        sqlb::TablePtr table_object = db.getObjectByName<sqlb::Table>(table);
+        if(table_object)
+        {
+            for(const auto& constraint : table_object->allConstraints())
+            {
+                if((constraint.second->type() == sqlb::Constraint::PrimaryKeyConstraintType || constraint.second->type() == sqlb::Constraint::UniqueConstraintType)
+                        && !constraint.first.empty() && sameName(constraint.first.front(), field.name()))
+                    indexed = true;
+            }
+        }
 
-    if (!value.empty() && m_uniqueValues.find(value) == m_uniqueValues.end()) {
-        const_cast<UniqueFilterModel*>(this)->m_uniqueValues.insert(value);
-        return true;
+        db.ensureAllParsed(table.schema(), "index");
+        const auto indices = db.schemata[table.schema()].equal_range("index");
+        for(auto it=indices.first;it!=indices.second;++it)
+        {
+            sqlb::IndexPtr idx = std::dynamic_pointer_cast<sqlb::Index>(it->second);
+            if(idx && sameName(idx->baseTable(), table.name()) && !idx->fields.empty() &&
+                    !idx->fields.front().expression() && sameName(idx->fields.front().name(), field.name()))
+                indexed = true;
+        }
     }
+
+    const std::string column = sqlb::escapeIdentifier(field.name());
+    m_query = "SELECT DISTINCT " + column + " FROM " + table.toString() + " WHERE ";
+    if(indexed)
+        m_query += column + " >= ?1 AND " + column + " < ?1 || char(1114111) ORDER BY " + column;
     else
-        return false;
+        m_query += column + " LIKE ?2 || '%' ESCAPE '\\'";
+    m_query += " LIMIT " + std::to_string(CompletionLimit) + ";";
+
+    setModel(m_model);
+    setCompletionMode(QCompleter::PopupCompletion);
+    setCaseSensitivity(indexed ? Qt::CaseSensitive : Qt::CaseInsensitive);
+
+    connect(editor, &QLineEdit::textEdited, this, &ColumnCompleter::fetchValues);
+    connect(&m_watcher, &QFutureWatcher<QStringList>::finished, this, &ColumnCompleter::valuesFetched);
+}
+
+ColumnCompleter::~ColumnCompleter()
+{
+    // Don't wait for a running query to finish but abort it
+    std::lock_guard<std::mutex> lk(m_state->mutex);
+    m_state->cancelled = true;
+    if(m_state->db)
+        sqlite3_interrupt(m_state->db);
+}
+
+void ColumnCompleter::abort()
+{
+    bool running;
+    {
+        std::lock_guard<std::mutex> lk(m_state->mutex);
+        m_state->cancelled = true;
+        running = m_state->db != nullptr;
+        if(running)
+            sqlite3_interrupt(m_state->db);
+    }
+    m_pendingPrefix.clear();
+
+    // A query which is still waiting for the database gives up as soon as it gets it, and its result is ignored anyway. So only wait
+    // for a query which is holding the database. It has just been interrupted and releases it right away.
+    if(running)
+        m_watcher.waitForFinished();
+}
+
+void ColumnCompleter::fetchValues(const QString& prefix)
+{
+    if(prefix.isEmpty() || m_state->cancelled)
+        return;
+
+    // If all values starting with the previous prefix are known, the completer can narrow them down by itself
+    if(m_prefixComplete && prefix.startsWith(m_prefix, caseSensitivity()))
+        return;
+
+    // Only run one query at a time. When typing fast, just remember the latest text and query it afterwards.
+    if(m_watcher.isRunning())
+    {
+        m_pendingPrefix = prefix;
+        return;
+    }
+
+    m_prefix = prefix;
+    m_prefixComplete = false;
+    m_watcher.setFuture(QtConcurrent::run(&ColumnCompleter::queryValues, &m_db, m_query, prefix, m_state));
+}
+
+void ColumnCompleter::valuesFetched()
+{
+    // The values of an aborted query are incomplete and the editor is about to be closed
+    if(m_state->cancelled)
+        return;
+
+    const QStringList values = m_watcher.result();
+    m_model->setStringList(values);
+    m_prefixComplete = values.size() < CompletionLimit;
+
+    if(!m_pendingPrefix.isEmpty())
+    {
+        const QString prefix = m_pendingPrefix;
+        m_pendingPrefix.clear();
+        fetchValues(prefix);
+        if(m_watcher.isRunning())
+            return;
+    }
+
+    // Show the popup for the current text using the new values
+    QLineEdit* editor = qobject_cast<QLineEdit*>(widget());
+    if(editor && editor->hasFocus() && !editor->text().isEmpty())
+    {
+        setCompletionPrefix(editor->text());
+        complete();
+    }
+}
+
+QStringList ColumnCompleter::queryValues(DBBrowserDB* db, const std::string& query, const QString& prefix, std::shared_ptr<QueryState> state)
+{
+    QStringList values;
+
+    auto pDb = db->get(tr("completing values"), true);
+    if(!pDb)
+        return values;
+
+    {
+        std::lock_guard<std::mutex> lk(state->mutex);
+        if(state->cancelled)
+            return values;
+        state->db = pDb.get();
+    }
+
+    db->logSQL(QString::fromStdString(query), kLogMsg_App);
+
+    sqlite3_stmt* stmt;
+    if(sqlite3_prepare_v2(pDb.get(), query.c_str(), static_cast<int>(query.size()), &stmt, nullptr) == SQLITE_OK)
+    {
+        // The first parameter is the prefix as it is, the second one the prefix with all LIKE wildcards escaped
+        const QByteArray text = prefix.toUtf8();
+        QByteArray escaped = text;
+        escaped.replace('\\', "\\\\").replace('%', "\\%").replace('_', "\\_");
+        sqlite3_bind_text(stmt, 1, text.constData(), text.size(), SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, escaped.constData(), escaped.size(), SQLITE_TRANSIENT);
+
+        while(sqlite3_step(stmt) == SQLITE_ROW)
+            values.push_back(QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)), sqlite3_column_bytes(stmt, 0)));
+        sqlite3_finalize(stmt);
+    }
+
+    // Release the database before anyone can see that the query is done
+    std::lock_guard<std::mutex> lk(state->mutex);
+    state->db = nullptr;
+    pDb.reset();
+    return values;
+}
+
+// State of a running page query. It's shared with the worker thread so the query can be aborted when the model is gone.
+struct ForeignKeyModel::QueryState
+{
+    std::mutex mutex;
+    sqlite3* db = nullptr;
+    bool cancelled = false;
+};
+
+ForeignKeyModel::ForeignKeyModel(DBBrowserDB& db, const sqlb::ObjectIdentifier& table, const std::string& column, bool allowNull, QObject* parent)
+    : QAbstractTableModel(parent),
+      m_db(db),
+      m_complete(false),
+      m_state(std::make_shared<QueryState>())
+{
+    // Besides the referenced column show the first couple of other columns of the referenced table to make it easier to pick the right row
+    m_columns.push_back(column);
+    sqlb::TablePtr obj = db.getObjectByName<sqlb::Table>(table);
+    if(obj)
+    {
+        for(const auto& field : obj->fields)
+        {
+            if(m_columns.size() > ForeignKeyDisplayColumns)
+                break;
+            if(!sameName(field.name(), column))
+                m_columns.push_back(field.name());
+        }
+    }
+
+    std::string select = "SELECT ";
+    for(size_t i=0;i<m_columns.size();i++)
+        select += (i ? "," : "") + sqlb::escapeIdentifier(m_columns[i]);
+    select += " FROM " + table.toString() + " WHERE ";
+
+    const std::string key = sqlb::escapeIdentifier(column);
+    const std::string order = " ORDER BY " + key + " LIMIT " + std::to_string(ForeignKeyPageSize) + ";";
+    m_firstPageQuery = select + key + " IS NOT NULL" + order;
+    m_nextPageQuery = select + key + " > ?1" + order;
+
+    // If the column doesn't have a NOT NULL constraint, NULL is offered as the first value
+    if(allowNull)
+        m_rows.push_back(Row{std::vector<QByteArray>(m_columns.size()), SQLITE_NULL});
+
+    connect(&m_watcher, &QFutureWatcher<Page>::finished, this, &ForeignKeyModel::pageFetched);
+
+    // Start fetching the first page right away, so it's there as soon as possible when the list is opened
+    fetchMore(QModelIndex());
+}
+
+ForeignKeyModel::~ForeignKeyModel()
+{
+    // Don't wait for a running query to finish but abort it
+    std::lock_guard<std::mutex> lk(m_state->mutex);
+    m_state->cancelled = true;
+    if(m_state->db)
+        sqlite3_interrupt(m_state->db);
+}
+
+int ForeignKeyModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : static_cast<int>(m_rows.size());
+}
 
+int ForeignKeyModel::columnCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : static_cast<int>(m_columns.size());
+}
+
+QVariant ForeignKeyModel::data(const QModelIndex& index, int role) const
+{
+    if(!index.isValid() || index.row() >= rowCount() || index.column() >= columnCount())
+        return QVariant();
+
+    const QByteArray& value = m_rows[static_cast<size_t>(index.row())].values[static_cast<size_t>(index.column())];
+    if(role == Qt::EditRole)
+        return value.isNull() ? QVariant() : QVariant(value);
+    else if(role == Qt::DisplayRole)
+        return QString::fromUtf8(value);
+    return QVariant();
+}
+
+QVariant ForeignKeyModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if(role != Qt::DisplayRole || orientation != Qt::Horizontal || section < 0 || section >= columnCount())
+        return QVariant();
+    return QString::fromStdString(m_columns[static_cast<size_t>(section)]);
+}
+
+bool ForeignKeyModel::canFetchMore(const QModelIndex& parent) const
+{
+    return !parent.isValid() && !m_complete;
+}
+
+void ForeignKeyModel::fetchMore(const QModelIndex& parent)
+{
+    // Only one page is fetched at a time. The view asks again when the rows have been added and it still needs more.
+    if(parent.isValid() || m_complete || m_watcher.isRunning())
+        return;
+
+    // Continue after the last value of the previous page. Because the referenced column has to be unique, this doesn't skip any rows.
+    Row last{std::vector<QByteArray>(), SQLITE_NULL};
+    if(!m_rows.empty() && m_rows.back().keyType != SQLITE_NULL)
+        last = Row{{m_rows.back().values.front()}, m_rows.back().keyType};
+    const std::string& query = last.keyType != SQLITE_NULL ? m_nextPageQuery : m_firstPageQuery;
+
+    m_db.logSQL(QString::fromStdString(query), kLogMsg_App);
+    m_watcher.setFuture(QtConcurrent::run(&ForeignKeyModel::queryPage, &m_db, query, m_columns.size(), last, m_state));
+}
+
+void ForeignKeyModel::abort()
+{
+    bool running;
+    {
+        std::lock_guard<std::mutex> lk(m_state->mutex);
+        m_state->cancelled = true;
+        running = m_state->db != nullptr;
+        if(running)
+            sqlite3_interrupt(m_state->db);
+    }
+
+    // An interrupted query releases the database right away. A query which is still waiting for the database doesn't get to use it,
+    // so there is no need to wait for it.
+    if(running)
+        m_watcher.waitForFinished();
+}
+
+void ForeignKeyModel::pageFetched()
+{
+    Page page = m_watcher.result();
+    if(!page.read)
+        return;
+
+    m_complete = page.rows.size() < ForeignKeyPageSize;
+    if(page.rows.empty())
+        return;
+
+    beginInsertRows(QModelIndex(), rowCount(), rowCount() + static_cast<int>(page.rows.size()) - 1);
+    std::move(page.rows.begin(), page.rows.end(), std::back_inserter(m_rows));
+    endInsertRows();
+}
+
+ForeignKeyModel::Page ForeignKeyModel::queryPage(DBBrowserDB* db, const std::string& query, size_t columns, const Row& last, std::shared_ptr<QueryState> state)
+{
+    Page page;
+
+    auto pDb = db->get(tr("reading referenced values"), true);
+    if(!pDb)
+        return page;
+
+    {
+        std::lock_guard<std::mutex> lk(state->mutex);
+        if(state->cancelled)
+            return page;
+        state->db = pDb.get();
+    }
+    page.read = true;
+
+    sqlite3_stmt* stmt;
+    if(sqlite3_prepare_v2(pDb.get(), query.c_str(), static_cast<int>(query.size()), &stmt, nullptr) == SQLITE_OK)
+    {
+        // Bind the last value using its original type, so it's compared the same way SQLite compares the values for sorting them
+        if(last.keyType != SQLITE_NULL)
+        {
+            const QByteArray& key = last.values.front();
+            switch(last.keyType)
+            {
+            case SQLITE_INTEGER:
+                sqlite3_bind_int64(stmt, 1, key.toLongLong());
+                break;
+            case SQLITE_FLOAT:
+                sqlite3_bind_double(stmt, 1, key.toDouble());
+                break;
+            case SQLITE_BLOB:
+                sqlite3_bind_blob(stmt, 1, key.constData(), key.size(), SQLITE_TRANSIENT);
+                break;
+            default:
+                sqlite3_bind_text(stmt, 1, key.constData(), key.size(), SQLITE_TRANSIENT);
+                break;
+            }
+        }
+
+        while(sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            Row row{std::vector<QByteArray>(columns), sqlite3_column_type(stmt, 0)};
+            for(size_t i=0;i<columns;i++)
+            {
+                const int column = static_cast<int>(i);
+                if(sqlite3_column_type(stmt, column) == SQLITE_NULL)
+                    continue;
+
+                const int bytes = sqlite3_column_bytes(stmt, column);
+                row.values[i] = bytes ? QByteArray(static_cast<const char*>(sqlite3_column_blob(stmt, column)), bytes) : QByteArray("");
+
+                // The display columns are only meant to help finding the right row, so don't show more than the beginning of them
+                if(i && row.values[i].size() > ForeignKeyDisplayLength)
+                    row.values[i] = row.values[i].left(ForeignKeyDisplayLength) + "...";
+            }
+            page.rows.push_back(std::move(row));
+        }
+        sqlite3_finalize(stmt);
+    } else {
+        // An empty page marks the list as complete, so this isn't tried again
+        qWarning() << "Reading referenced values failed: " << QString::fromStdString(query) << sqlite3_errmsg(pDb.get());
+    }
+
+    // Release the database before anyone can see that the query is done
+    std::lock_guard<std::mutex> lk(state->mutex);
+    state->db = nullptr;
+    pDb.reset();
+    return page;
 }
 
 ExtendedTableWidgetEditorDelegate::ExtendedTableWidgetEditorDelegate(QObject* parent)
@@ -141,40 +718,67 @@ QWidget* ExtendedTableWidgetEditorDelegate::createEditor(QWidget* parent, const
         } else
             column = fk.columns().at(0);
 
+        // If the current column of the current table does NOT have a not-null constraint, NULL is offered as a possible value, too
         sqlb::TablePtr currentTable = m->db().getObjectByName<sqlb::Table>(m->currentTableName());
-        QString query = QString("SELECT %1 FROM %2").arg(QString::fromStdString(sqlb::escapeIdentifier(column))).arg(QString::fromStdString(foreignTable.toString()));
-
-        // if the current column of the current table does NOT have not-null constraint,
-        // the NULL is united to the query to get the possible values in the combo-box.
-        if (!currentTable->fields.at(static_cast<size_t>(index.column())-1).notnull())
-            query.append (" UNION SELECT NULL");
-
-        SqliteTableModel* fkModel = new SqliteTableModel(m->db(), parent, m->chunkSize(), m->encoding());
-        fkModel->setQuery(query);
+        const bool allowNull = !currentTable->fields.at(static_cast<size_t>(index.column())-1).notnull();
 
+        // The referenced values are shown in an editable combo box. The list is fetched lazily while scrolling through it, and values
+        // can be searched for by typing.
         QComboBox* combo = new QComboBox(parent);
-
-        // Complete cache so it is ready when setEditorData is invoked.
-        fkModel->completeCache();
+        combo->setEditable(true);
+        combo->setInsertPolicy(QComboBox::NoInsert);
+
+        ForeignKeyModel* fkModel = new ForeignKeyModel(m->db(), foreignTable, column, allowNull, combo);
+        QTableView* view = new QTableView(combo);
+        view->setSelectionBehavior(QAbstractItemView::SelectRows);
+        view->setSelectionMode(QAbstractItemView::SingleSelection);
+        view->verticalHeader()->hide();
+        view->horizontalHeader()->setStretchLastSection(true);
         combo->setModel(fkModel);
+        combo->setView(view);
+
+        // The rows arrive in the background. When the first ones are added to an empty list, the combo box selects the first row,
+        // which would replace the value which is being edited. So keep the text and select the matching row once it is there.
+        auto text = std::make_shared<QString>();
+        auto sized = std::make_shared<bool>(false);
+        connect(fkModel, &QAbstractItemModel::rowsAboutToBeInserted, combo, [combo, text]() {
+            *text = combo->currentText();
+        });
+        connect(fkModel, &QAbstractItemModel::rowsInserted, combo, [combo, view, text, sized]() {
+            if(!*sized)
+            {
+                view->resizeColumnsToContents();
+                view->setMinimumWidth(view->horizontalHeader()->length());
+                *sized = true;
+            }
+
+            if(combo->currentIndex() >= 0 && combo->itemText(combo->currentIndex()) == *text)
+                return;
+            const int row = combo->findText(*text);
+            if(row >= 0)
+                combo->setCurrentIndex(row);
+            else if(combo->currentText() != *text)
+                combo->setEditText(*text);
+        });
+
+        sqlb::TablePtr foreignObj = m->db().getObjectByName<sqlb::Table>(foreignTable);
+        if(foreignObj)
+        {
+            auto field = sqlb::findField(foreignObj, column);
+            if(field != foreignObj->fields.end())
+                combo->setCompleter(new ColumnCompleter(m->db(), foreignTable, *field, combo->lineEdit()));
+        }
 
         return combo;
     } else {
 
         QLineEdit* editor = new QLineEdit(parent);
-        // If the row count is not greater than the complete threshold setting, set a completer of values based on current values in the column.
-        if (index.model()->rowCount() <= Settings::getValue("databrowser", "complete_threshold").toInt()) {
-            QCompleter* completer = new QCompleter(editor);
-            UniqueFilterModel* completerFilter = new UniqueFilterModel(completer);
-            // Provide a filter for the source model, so only unique and non-empty values are accepted.
-            completerFilter->setSourceModel(const_cast<QAbstractItemModel*>(index.model()));
-            completerFilter->setFilterKeyColumn(index.column());
-            completer->setModel(completerFilter);
-            // Complete on this column, using a popup and case-insensitively.
-            completer->setCompletionColumn(index.column());
-            completer->setCompletionMode(QCompleter::PopupCompletion);
-            completer->setCaseSensitivity(Qt::CaseInsensitive);
-            editor->setCompleter(completer);
+        // Complete the values of this column using the values which are already in the table
+        sqlb::TablePtr currentTable = m->db().getObjectByName<sqlb::Table>(m->currentTableName());
+        if(currentTable && index.column() > 0 && static_cast<size_t>(index.column()) <= currentTable->fields.size())
+        {
+            editor->setCompleter(new ColumnCompleter(m->db(), m->currentTableName(),
+                                                     currentTable->fields.at(static_cast<size_t>(index.column())-1), editor));
         }
         // Set the maximum length to the highest possible value instead of the default 32768.
         editor->setMaxLength(std::numeric_limits<int>::max());
@@ -194,6 +798,9 @@ void ExtendedTableWidgetEditorDelegate::setEditorData(QWidget* editor, const QMo
         if (comboIndex >= 0)
             // if it is valid, adjust the combobox
             combo->setCurrentIndex(comboIndex);
+        else
+            // The value might not have been fetched yet, so just show it
+            combo->setEditText(data);
     } else {
         lineedit->setText(data);
 
@@ -206,9 +813,21 @@ void ExtendedTableWidgetEditorDelegate::setModelData(QWidget* editor, QAbstractI
 {
     // Only apply the data back to the model if the editor is not in read only mode to avoid accidental truncation of the data
     QLineEdit* lineedit = dynamic_cast<QLineEdit*>(editor);
+
+    // A completion query or a query for the referenced values which is still running would keep the database busy while writing the new value
+    QCompleter* completer = lineedit ? lineedit->completer() : static_cast<QComboBox*>(editor)->completer();
+    if(ColumnCompleter* column_completer = qobject_cast<ColumnCompleter*>(completer))
+        column_completer->abort();
+    if(ForeignKeyModel* fkModel = lineedit ? nullptr : qobject_cast<ForeignKeyModel*>(static_cast<QComboBox*>(editor)->model()))
+        fkModel->abort();
+
     if(!lineedit) {
         QComboBox* combo = static_cast<QComboBox*>(editor);
-        model->setData(index, combo->currentData(Qt::EditRole), Qt::EditRole);
+        // Use the value of the selected item, unless a different value has been typed in
+        if(combo->currentIndex() >= 0 && combo->itemText(combo->currentIndex()) == combo->currentText())
+            model->setData(index, combo->currentData(Qt::EditRole), Qt::EditRole);
+        else
+            model->setData(index, combo->currentText(), Qt::EditRole);
     } else
         if(!lineedit->isReadOnly())
             model->setData(index, lineedit->text());
@@ -221,8 +840,12 @@ void ExtendedTableWidgetEditorDelegate::updateEditorGeometry(QWidget* editor, co
 
 
 ExtendedTableWidget::ExtendedTableWidget(QWidget* parent) :
-    QTableView(parent)
+    QTableView(parent),
+    m_visibleColumnsTimer(new QTimer(this))
 {
+    m_visibleColumnsTimer->setSingleShot(true);
+    m_visibleColumnsTimer->setInterval(0);
+
     setHorizontalScrollMode(ExtendedTableWidget::ScrollPerPixel);
     // Force ScrollPerItem, so scrolling shows all table rows
     setVerticalScrollMode(ExtendedTableWidget::ScrollPerItem);
@@ -234,6 +857,12 @@ ExtendedTableWidget::ExtendedTableWidget(QWidget* parent) :
     m_tableHeader = new FilterTableHeader(this);
     setHorizontalHeader(m_tableHeader);
 
+    // Only fetch the columns which are actually visible. Scrolling and resizing emit lots of signals in a row and walking
+    // all columns each time is expensive for wide tables, so only update the columns once control is back in the event loop.
+    connect(m_visibleColumnsTimer, SIGNAL(timeout()), this, SLOT(updateVisibleColumns()));
+    connect(horizontalScrollBar(), SIGNAL(valueChanged(int)), m_visibleColumnsTimer, SLOT(start()));
+    connect(m_tableHeader, SIGNAL(sectionResized(int,int,int)), m_visibleColumnsTimer, SLOT(start()));
+
     // Set up vertical header context menu
     verticalHeader()->setContextMenuPolicy(Qt::CustomContextMenu);
 
@@ -360,8 +989,7 @@ ExtendedTableWidget::ExtendedTableWidget(QWidget* parent) :
     });
 
     connect(nullAction, &QAction::triggered, [&]() {
-        for(const QModelIndex& index : selectedIndexes())
-            model()->setData(index, QVariant());
+        setSelectedCells(QByteArray());
     });
     connect(copyAction, &QAction::triggered, [&]() {
        copy(false, false);
@@ -394,6 +1022,11 @@ void ExtendedTableWidget::reloadSettings()
 
     // Set new default row height depending on the font size
     verticalHeader()->setDefaultSectionSize(verticalHeader()->fontMetrics().height()+10);
+
+    // Update the display settings of the model
+    SqliteTableModel* m = qobject_cast<SqliteTableModel*>(model());
+    if(m)
+        m->reloadSettings();
 }
 
 void ExtendedTableWidget::copyMimeData(const QModelIndexList& fromIndices, QMimeData* mimeData, const bool withHeaders, const bool inSQL)
@@ -421,9 +1054,9 @@ void ExtendedTableWidget::copyMimeData(const QModelIndexList& fromIndices, QMime
     // If a single cell is selected which contains an image, copy it to the clipboard
     if (!inSQL && !withHeaders && indices.size() == 1) {
         QImage img;
-        QVariant varData = m->data(indices.first(), Qt::EditRole);
+        QByteArray data = m->data(indices.first(), Qt::EditRole).toByteArray();
 
-        if (img.loadFromData(varData.toByteArray()))
+        if(isImageData(data) && img.loadFromData(data))
         {
             // If it's an image, copy the image data to the clipboard
             mimeData->setImageData(img);
@@ -434,136 +1067,166 @@ void ExtendedTableWidget::copyMimeData(const QModelIndexList& fromIndices, QMime
     // If we got here, a non-image cell was or multiple cells were selected, or copy with headers was requested.
     // In this case, we copy selected data into internal copy-paste buffer and then
     // we write a table both in HTML and text formats to the system clipboard.
+    CopiedTable table;
+    table.tableName = QString::fromStdString(m->currentTableName().toString());
 
-    // Copy selected data into internal copy-paste buffer
-    int last_row = indices.first().row();
-    BufferRow lst;
-    for(int i=0;i<indices.size();i++)
-    {
-        if(indices.at(i).row() != last_row)
-        {
-            m_buffer.push_back(lst);
-            lst.clear();
+    // Table headers
+    if (withHeaders || inSQL) {
+        for(const QModelIndex& index : indices) {
+            if(index.row() != indices.first().row())
+                break;
+            table.headers.push_back(model()->headerData(index.column(), Qt::Horizontal, Qt::DisplayRole).toByteArray());
         }
-        lst.push_back(indices.at(i).data(Qt::EditRole).toByteArray());
-        last_row = indices.at(i).row();
     }
-    m_buffer.push_back(lst);
 
-    QString sqlResult;
-    QString result;
-    QString htmlResult = "<!DOCTYPE HTML PUBLIC \"-//W3C//DTD HTML 4.01 Transitional//EN\">";
-    htmlResult.append("<html><head><meta http-equiv=\"content-type\" content=\"text/html; charset=utf-8\">");
-    htmlResult.append("<title></title>");
+    // Table data rows
+    int currentRow = -1;
+    for(const QModelIndex& index : indices) {
+        if(index.row() != currentRow) {
+            table.rows.emplace_back();
+            table.binary.emplace_back();
+            currentRow = index.row();
+        }
+
+        table.rows.back().push_back(index.data(Qt::EditRole).toByteArray());
+        table.binary.back().push_back(m->isBinary(index));
+        table.size += table.rows.back().back().size();
+    }
+
+    // Copy selected data into internal copy-paste buffer
+    m_buffer = table.rows;
 
     // The generator-stamp is later used to know whether the data in the system clipboard is still ours.
     // In that case we will give precedence to our internal copy buffer.
-    QString now = QDateTime::currentDateTime().toString("YYYY-MM-DDTHH:mm:ss.zzz");
-    m_generatorStamp = QString("<meta name=\"generator\" content=\"%1\"><meta name=\"date\" content=\"%2\">").arg(QApplication::applicationName().toHtmlEscaped(), now);
-    htmlResult.append(m_generatorStamp);
-    // TODO: is this really needed by Excel, since we use <pre> for multi-line cells?
-    htmlResult.append("<style type=\"text/css\">br{mso-data-placement:same-cell;}</style></head><body>"
-                      "<table border=1 cellspacing=0 cellpadding=2>");
-
-    int currentRow = indices.first().row();
+    m_generatorStamp = generatorStamp();
+    mimeData->setData(GeneratorMimeType, m_generatorStamp.toUtf8());
 
-    const QString fieldSepHtml = "</td><td>";
-    const QString rowSepHtml = "</td></tr><tr><td>";
-    const QString fieldSepText = "\t";
-#ifdef Q_OS_WIN
-    const QString rowSepText = "\r\n";
-#else
-    const QString rowSepText = "\n";
-#endif
+    if ( inSQL )
+    {
+        mimeData->setText(copiedSql(table));
+    } else {
+        mimeData->setHtml(copiedHtml(table, m_generatorStamp));
+        mimeData->setText(copiedText(table));
+    }
+}
 
-    QString sqlInsertStatement = QString("INSERT INTO %1 (").arg(QString::fromStdString(m->currentTableName().toString()));
-    // Table headers
-    if (withHeaders || inSQL) {
-        htmlResult.append("<tr><th>");
-        int firstColumn = indices.front().column();
-        for(int i = firstColumn; i <= indices.back().column(); i++) {
-            QByteArray headerText = model()->headerData(i, Qt::Horizontal, Qt::DisplayRole).toByteArray();
-            if (i != firstColumn) {
-                result.append(fieldSepText);
-                htmlResult.append("</th><th>");
-                sqlInsertStatement.append(", ");
-            }
+bool ExtendedTableWidget::copyLargeSelection(const bool withHeaders, const bool inSQL)
+{
+    // This only handles rectangular selections. For these we know the rows and columns to copy without looking at each selected cell.
+    SqliteTableModel* m = qobject_cast<SqliteTableModel*>(model());
+    const QItemSelection selection = selectionModel()->selection();
+    if(!m || selection.size() != 1)
+        return false;
 
-            result.append(headerText);
-            htmlResult.append(headerText);
-            sqlInsertStatement.append(sqlb::escapeIdentifier(headerText));
-        }
-        result.append(rowSepText);
-        htmlResult.append("</th></tr>");
-        sqlInsertStatement.append(") VALUES (");
+    const QItemSelectionRange range = selection.front();
+    std::vector<int> columns;
+    for(int column=range.left();column<=range.right();column++)
+    {
+        if(!isColumnHidden(column))
+            columns.push_back(column);
     }
 
-    // Table data rows
-    for(const QModelIndex& index : indices) {
-        // Separators. For first cell, only opening table row tags must be added for the HTML and nothing for the text version.
-        if (indices.first() == index) {
-            htmlResult.append("<tr><td>");
-            sqlResult.append(sqlInsertStatement);
-        } else if (index.row() != currentRow) {
-            result.append(rowSepText);
-            htmlResult.append(rowSepHtml);
-            sqlResult.append(");" + rowSepText + sqlInsertStatement);
-        } else {
-            result.append(fieldSepText);
-            htmlResult.append(fieldSepHtml);
-            sqlResult.append(", ");
-        }
-        currentRow = index.row();
+    // Small selections of cached rows are copied the regular way. It doesn't matter whether the rest of the table is cached.
+    // Rows which have been sorted in memory are always copied from the cache because the query returns them in another order.
+    if(columns.empty() || m->isSortedInMemory() ||
+            (static_cast<qint64>(range.height()) * static_cast<qint64>(columns.size()) <= LargeCopyCells &&
+             m->isRangeCached(range.top(), range.bottom() + 1, columns)))
+        return false;
 
-        QImage img;
-        QVariant bArrdata = index.data(Qt::EditRole);
+    const QString query = m->rangeQuery(range.top(), range.bottom() + 1, columns);
+    if(query.isNull())
+        return false;
 
-        // Table cell data: image? Store it as an embedded image in HTML
-        if (!inSQL && img.loadFromData(bArrdata.toByteArray()))
-        {
-            QByteArray ba;
-            QBuffer buffer(&ba);
-            buffer.open(QIODevice::WriteOnly);
-            img.save(&buffer, "PNG");
-            buffer.close();
-
-            QString imageBase64 = ba.toBase64();
-            htmlResult.append("<img src=\"data:image/png;base64,");
-            htmlResult.append(imageBase64);
-            result.append(QString());
-            htmlResult.append("\" alt=\"Image\">");
-        } else {
-            QByteArray text;
-            if (!m->isBinary(index)) {
-                text = bArrdata.toByteArray();
+    auto table = std::make_shared<CopiedTable>();
+    table->tableName = QString::fromStdString(m->currentTableName().toString());
+    if(withHeaders || inSQL)
+    {
+        for(int column : columns)
+            table->headers.push_back(m->headerData(column, Qt::Horizontal, Qt::DisplayRole).toByteArray());
+    }
+    table->rows.reserve(static_cast<size_t>(range.height()));
+    table->binary.reserve(static_cast<size_t>(range.height()));
 
-                // Table cell data: text
-                if (text.contains('\n') || text.contains('\t'))
-                    htmlResult.append("<pre>" + QString(text).toHtmlEscaped() + "</pre>");
-                else
-                    htmlResult.append(QString(text).toHtmlEscaped());
+    // Wait for the model to finish loading data and get exclusive access to the database for reading the rows
+    m->waitUntilIdle();
+    auto pDb = m->db().get(tr("copying data"));
+    if(!pDb)
+        return false;
 
-                result.append(text);
-                sqlResult.append("'" + text.replace("'", "''") + "'");
-            } else
-                // Table cell data: binary. Save as BLOB literal in SQL
-                sqlResult.append( "X'" + bArrdata.toByteArray().toHex() + "'" );
+    // Log the statement here because the log lives in the GUI thread
+    m->db().logSQL(query, kLogMsg_App);
+
+    QProgressDialog progress(tr("Copying data..."), tr("Cancel"), 0, range.height(), this);
+    progress.setWindowModality(Qt::ApplicationModal);
+    progress.setMinimumDuration(500);
+
+    // The rows are read and the text is prepared on a worker thread, so the UI keeps responding and the copying can be cancelled
+    std::atomic<bool> cancel(false);
+    std::atomic<int> rows_done(0);
+    QString text;
+    QFutureWatcher<bool> watcher;
+    QEventLoop loop;
+    QTimer timer;
+    connect(&watcher, &QFutureWatcher<bool>::finished, &loop, &QEventLoop::quit);
+    connect(&progress, &QProgressDialog::canceled, [&cancel]() { cancel = true; });
+    connect(&timer, &QTimer::timeout, [&progress, &rows_done]() { progress.setValue(rows_done); });
+    watcher.setFuture(QtConcurrent::run([&]() {
+        const bool ok = m->readRows(pDb.get(), query, columns,
+                                    [&](const std::vector<QByteArray>& values, const std::vector<bool>& binary) {
+            table->rows.push_back(values);
+            table->binary.push_back(binary);
+            for(const QByteArray& value : values)
+                table->size += value.size();
+            rows_done++;
+            return !cancel;
+        });
+        if(!ok || cancel)
+            return false;
 
-        }
-    }
-    sqlResult.append(");");
+        text = inSQL ? copiedSql(*table) : copiedText(*table);
+        return true;
+    }));
+    timer.start(100);
+    loop.exec();
+    pDb = nullptr;
 
-    if ( inSQL )
+    // When the user cancelled, there is nothing left to do. When reading the rows failed, the regular way of copying is tried instead.
+    if(cancel)
+        return true;
+    if(!watcher.result())
+        return false;
+
+    // A single cell which isn't cached yet may contain an image, too. Copy it like copyMimeData() does for cached cells.
+    if(!inSQL && !withHeaders && table->rows.size() == 1 && table->rows.front().size() == 1)
     {
-        mimeData->setText(sqlResult);
-    } else {
-        mimeData->setHtml(htmlResult + "</td></tr></table></body></html>");
-        mimeData->setText(result);
+        QImage img;
+        const QByteArray& data = table->rows.front().front();
+        if(isImageData(data) && img.loadFromData(data))
+        {
+            m_buffer.clear();
+            QMimeData* mimeData = new QMimeData;
+            mimeData->setImageData(img);
+            qApp->clipboard()->setMimeData(mimeData);
+            return true;
+        }
     }
+
+    m_buffer = table->rows;
+    m_generatorStamp = generatorStamp();
+
+    // The HTML version is only offered for data of a reasonable size, and even then it's only built once another application asks for it
+    TableMimeData* mimeData = new TableMimeData((inSQL || table->size > MaxHtmlCopySize) ? nullptr : table, m_generatorStamp);
+    mimeData->setData(GeneratorMimeType, m_generatorStamp.toUtf8());
+    mimeData->setText(text);
+    qApp->clipboard()->setMimeData(mimeData);
+    return true;
 }
 
 void ExtendedTableWidget::copy(const bool withHeaders, const bool inSQL )
 {
+    if(copyLargeSelection(withHeaders, inSQL))
+        return;
+
     QMimeData *mimeData = new QMimeData;
     copyMimeData(selectionModel()->selectedIndexes(), mimeData, withHeaders, inSQL);
     qApp->clipboard()->setMimeData(mimeData);
@@ -610,7 +1273,7 @@ void ExtendedTableWidget::paste()
     std::vector<BufferRow> clipboardTable;
     std::vector<BufferRow>* source;
 
-    if(mimeClipboard->hasHtml() && mimeClipboard->html().contains(m_generatorStamp) && !m_buffer.empty())
+    if(mimeClipboard->hasFormat(GeneratorMimeType) && QString::fromUtf8(mimeClipboard->data(GeneratorMimeType)) == m_generatorStamp && !m_buffer.empty())
     {
         source = &m_buffer;
     } else {
@@ -638,12 +1301,7 @@ void ExtendedTableWidget::paste()
     // Special case: if there is only one cell of data to be pasted, paste it into all selected fields
     if(rows == 1 && columns == 1)
     {
-        QByteArray bArrdata = source->front().front();
-        for(int row=firstRow;row<firstRow+selectedRows;row++)
-        {
-            for(int column=firstColumn;column<firstColumn+selectedColumns;column++)
-                m->setData(m->index(row, column), bArrdata);
-        }
+        m->setMultipleData(indices, std::vector<QByteArray>(static_cast<size_t>(indices.size()), source->front().front()));
         return;
     }
 
@@ -662,14 +1320,17 @@ void ExtendedTableWidget::paste()
 
     // If we get here, we can definitely start pasting: either the ranges match in their size or the user agreed to paste anyway
 
-    // Copy the data cell by cell and as-is from the source buffer to the table
+    // Copy the data cell by cell and as-is from the source buffer to the table. All cells are written at once.
+    QModelIndexList targetIndices;
+    std::vector<QByteArray> targetValues;
     int row = firstRow;
     for(const auto& source_row : *source)
     {
         int column = firstColumn;
         for(const QByteArray& source_cell : source_row)
         {
-            m->setData(m->index(row, column), source_cell);
+            targetIndices.push_back(m->index(row, column));
+            targetValues.push_back(source_cell);
 
             column++;
             if (column > lastColumn)
@@ -680,6 +1341,20 @@ void ExtendedTableWidget::paste()
         if (row > lastRow)
             break;
     }
+    m->setMultipleData(targetIndices, targetValues);
+}
+
+void ExtendedTableWidget::setSelectedCells(const QByteArray& value)
+{
+    const QModelIndexList indices = selectedIndexes();
+    SqliteTableModel* m = qobject_cast<SqliteTableModel*>(model());
+    if(m)
+    {
+        m->setMultipleData(indices, std::vector<QByteArray>(static_cast<size_t>(indices.size()), value));
+    } else {
+        for(const QModelIndex& index : indices)
+            model()->setData(index, value);
+    }
 }
 
 void ExtendedTableWidget::useAsFilter(const QString& filterOperator, bool binary, const QString& operatorSuffix)
@@ -776,12 +1451,10 @@ void ExtendedTableWidget::keyPressEvent(QKeyEvent* event)
             if(event->modifiers().testFlag(Qt::AltModifier))
             {
                 // When pressing Alt+Delete set the value to NULL
-                for(const QModelIndex& index : selectedIndexes())
-                    model()->setData(index, QVariant());
+                setSelectedCells(QByteArray());
             } else {
                 // When pressing Delete only set the value to empty string
-                for(const QModelIndex& index : selectedIndexes())
-                    model()->setData(index, "");
+                setSelectedCells(QByteArray(""));
             }
         }
     } else if(event->modifiers().testFlag(Qt::ControlModifier) && (event->key() == Qt::Key_PageUp || event->key() == Qt::Key_PageDown)) {
@@ -810,6 +1483,32 @@ void ExtendedTableWidget::updateGeometries()
         if(m && verticalScrollBar()->maximum())
             verticalScrollBar()->setMaximum(m->rowCount() - numVisibleRows() + 1);
     }
+
+    m_visibleColumnsTimer->start();
+}
+
+void ExtendedTableWidget::updateVisibleColumns()
+{
+    SqliteTableModel* m = qobject_cast<SqliteTableModel*>(model());
+    if(!m || m->columnCount() == 0)
+        return;
+
+    // Get the range of columns which are currently shown in the viewport and extend it by the same number of columns to
+    // both sides. This way short horizontal scrolls don't have to wait for new data.
+    const int ncolumns = m->columnCount();
+    int column_first = columnAt(0) == -1 ? 0 : columnAt(0);
+    int column_last = columnAt(viewport()->width() - 1) == -1 ? ncolumns - 1 : columnAt(viewport()->width() - 1);
+    const int margin = column_last - column_first + 1;
+    column_first = std::max(0, column_first - margin);
+    column_last = std::min(ncolumns - 1, column_last + margin);
+
+    std::vector<bool> columns(static_cast<size_t>(ncolumns), false);
+    for(int i=column_first;i<=column_last;i++)
+        columns[static_cast<size_t>(i)] = !isColumnHidden(i);
+
+    // Tell the model and fetch the cells which are missing now
+    m->setVisibleColumns(columns);
+    vscrollbarChanged(verticalScrollBar()->value());
 }
 
 void ExtendedTableWidget::vscrollbarChanged(int value)
@@ -864,6 +1563,14 @@ void ExtendedTableWidget::cellClicked(const QModelIndex& index)
     }
 }
 
+void ExtendedTableWidget::showEvent(QShowEvent* event)
+{
+    QTableView::showEvent(event);
+
+    // The cache of the model might have been released to save memory while we were hidden, so fetch the visible rows again
+    vscrollbarChanged(verticalScrollBar()->value());
+}
+
 void ExtendedTableWidget::dragEnterEvent(QDragEnterEvent* event)
 {
     event->accept();
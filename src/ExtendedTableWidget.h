@@ -3,7 +3,11 @@
 
 #include <QTableView>
 #include <QStyledItemDelegate>
-#include <QSortFilterProxyModel>
+#include <QAbstractTableModel>
+#include <QCompleter>
+#include <QFutureWatcher>
+#include <QStringList>
+#include <memory>
 #include <unordered_set>
 
 #include "sql/Query.h"
@@ -12,20 +16,101 @@ class QMenu;
 class QMimeData;
 class QDropEvent;
 class QDragMoveEvent;
+class QLineEdit;
+class QStringListModel;
+class QTimer;
 
 class FilterTableHeader;
-namespace sqlb { class ObjectIdentifier; }
+class DBBrowserDB;
+namespace sqlb { class ObjectIdentifier; class Field; }
 
-// Filter proxy model that only accepts distinct non-empty values.
-class UniqueFilterModel : public QSortFilterProxyModel
+// Completer for cell editors. It looks up the distinct values of a table column which start with the text typed so far. The values
+// are queried asynchronously while typing and only a limited number of them is fetched, so this works for tables of any size.
+class ColumnCompleter : public QCompleter
 {
     Q_OBJECT
 
 public:
-    explicit UniqueFilterModel(QObject* parent = nullptr);
-    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
- private:
-    std::unordered_set<std::string> m_uniqueValues;
+    ColumnCompleter(DBBrowserDB& db, const sqlb::ObjectIdentifier& table, const sqlb::Field& field, QLineEdit* editor);
+    ~ColumnCompleter() override;
+
+    // Aborts a running query and ignores its result. This needs to be called before writing the edited value because otherwise the
+    // write has to wait for the database and asks the user whether to cancel the query. Only a query which is holding the database
+    // is waited for, which doesn't take long because it is interrupted.
+    void abort();
+
+private slots:
+    void fetchValues(const QString& prefix);
+    void valuesFetched();
+
+private:
+    struct QueryState;
+
+    static QStringList queryValues(DBBrowserDB* db, const std::string& query, const QString& prefix, std::shared_ptr<QueryState> state);
+
+    DBBrowserDB& m_db;
+    std::string m_query;
+    QStringListModel* m_model;
+    QFutureWatcher<QStringList> m_watcher;
+    std::shared_ptr<QueryState> m_state;
+
+    QString m_prefix;           // Prefix of the values in the model
+    bool m_prefixComplete;      // True if the model contains all values starting with m_prefix
+    QString m_pendingPrefix;    // Prefix typed while the previous query was still running
+};
+
+// Model for the editor of foreign key columns. It lists the values of the referenced column together with a few more columns of the
+// referenced rows. The rows are fetched page by page in the order of the referenced column, seeking to the last value of the previous
+// page, so the referenced table is never loaded completely. The pages are queried in a worker thread, so opening the editor or
+// scrolling through the list doesn't block the user interface.
+class ForeignKeyModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    ForeignKeyModel(DBBrowserDB& db, const sqlb::ObjectIdentifier& table, const std::string& column, bool allowNull, QObject* parent = nullptr);
+    ~ForeignKeyModel() override;
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
+
+    // Stops fetching rows. A query which is running is interrupted and waited for, so the database is free for writing the edited value.
+    void abort();
+
+private slots:
+    void pageFetched();
+
+private:
+    struct Row
+    {
+        std::vector<QByteArray> values;     // Referenced value followed by the values of the display columns
+        int keyType;                        // SQLite type of the referenced value
+    };
+
+    struct Page
+    {
+        std::vector<Row> rows;
+        bool read = false;                  // False if the database couldn't be used, so the page should be fetched again later
+    };
+
+    struct QueryState;
+
+    // Runs the query for a page. If the key type of \param last isn't NULL, its value is bound to the query
+    static Page queryPage(DBBrowserDB* db, const std::string& query, size_t columns, const Row& last, std::shared_ptr<QueryState> state);
+
+    DBBrowserDB& m_db;
+    std::vector<std::string> m_columns;
+    std::string m_firstPageQuery;
+    std::string m_nextPageQuery;
+    std::vector<Row> m_rows;
+    bool m_complete;
+    QFutureWatcher<Page> m_watcher;
+    std::shared_ptr<QueryState> m_state;
 };
 
 // We use this class to provide editor widgets for the ExtendedTableWidget. It's used for every cell in the table view.
@@ -74,7 +159,11 @@ signals:
 private:
     void copyMimeData(const QModelIndexList& fromIndices, QMimeData* mimeData, const bool withHeaders, const bool inSQL);
     void copy(const bool withHeaders, const bool inSQL);
+    // Copies a large rectangular selection reading the rows straight from the database. Returns false if the selection
+    // should be copied using copyMimeData() instead.
+    bool copyLargeSelection(const bool withHeaders, const bool inSQL);
     void paste();
+    void setSelectedCells(const QByteArray& value);
 
     void useAsFilter(const QString& filterOperator, bool binary = false, const QString& operatorSuffix = "");
     void duplicateUpperCell();
@@ -84,11 +173,13 @@ private:
 
 private slots:
     void vscrollbarChanged(int value);
+    void updateVisibleColumns();
     void cellClicked(const QModelIndex& index);
 
 protected:
     void keyPressEvent(QKeyEvent* event) override;
     void updateGeometries() override;
+    void showEvent(QShowEvent* event) override;
     void dragEnterEvent(QDragEnterEvent* event) override;
     void dragMoveEvent(QDragMoveEvent* event) override;
     void dropEvent(QDropEvent* event) override;
@@ -96,6 +187,7 @@ protected:
     FilterTableHeader* m_tableHeader;
     QMenu* m_contextMenu;
     ExtendedTableWidgetEditorDelegate* m_editorDelegate;
+    QTimer* m_visibleColumnsTimer;      // Coalesces the updates of the visible columns while scrolling or resizing
 };
 
 #endif
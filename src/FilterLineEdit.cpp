@@ -6,7 +6,7 @@
 #include <QMenu>
 #include <QWhatsThis>
 
-FilterLineEdit::FilterLineEdit(QWidget* parent, std::vector<FilterLineEdit*>* filters, size_t columnnum) : QLineEdit(parent), filterList(filters), columnNumber(columnnum)
+FilterLineEdit::FilterLineEdit(QWidget* parent, size_t columnnum) : QLineEdit(parent), columnNumber(columnnum)
 {
     setPlaceholderText(tr("Filter"));
     setClearButtonEnabled(true);
@@ -63,22 +63,32 @@ void FilterLineEdit::delayedSignalTimerTriggered()
 
 void FilterLineEdit::keyReleaseEvent(QKeyEvent* event)
 {
+    // The line edits only exist for the visible columns, so let the header decide which one to move the focus to
     if(event->key() == Qt::Key_Tab)
     {
-        if(columnNumber < filterList->size() - 1)
-        {
-            filterList->at(columnNumber + 1)->setFocus();
-            event->accept();
-        }
+        emit tabPressed(true);
+        event->accept();
     } else if(event->key() == Qt::Key_Backtab) {
-        if(columnNumber > 0)
-        {
-            filterList->at(columnNumber - 1)->setFocus();
-            event->accept();
-        }
+        emit tabPressed(false);
+        event->accept();
     }
 }
 
+void FilterLineEdit::setColumn(size_t columnnum, const QString& value)
+{
+    // Apply any pending change for the column this line edit has been used for until now
+    if(delaySignalTimer->isActive())
+        delayedSignalTimerTriggered();
+
+    columnNumber = columnnum;
+    setProperty("column", static_cast<int>(columnnum));
+
+    // Set the new value without triggering the delayed signal
+    lastValue = value;
+    QLineEdit::setText(value);
+    delaySignalTimer->stop();
+}
+
 void FilterLineEdit::clear()
 {
     // When programatically clearing the line edit's value make sure the effects are applied immediately, i.e.
@@ -2,7 +2,6 @@
 #define FILTERLINEEDIT_H
 
 #include <QLineEdit>
-#include <vector>
 
 class QTimer;
 class QKeyEvent;
@@ -12,12 +11,17 @@ class FilterLineEdit : public QLineEdit
     Q_OBJECT
 
 public:
-    explicit FilterLineEdit(QWidget* parent, std::vector<FilterLineEdit*>* filters, size_t columnnum);
+    explicit FilterLineEdit(QWidget* parent, size_t columnnum);
 
     // Override methods for programatically changing the value of the line edit
     void clear();
     void setText(const QString& text);
 
+    // Bind the line edit to a different column. Any pending change for the old column is applied first. The new value is set
+    // without emitting any signals.
+    void setColumn(size_t columnnum, const QString& value);
+    size_t column() const { return columnNumber; }
+
 private slots:
     void delayedSignalTimerTriggered();
 
@@ -26,13 +30,13 @@ signals:
     void addFilterAsCondFormat(QString text);
     void clearAllCondFormats();
     void editCondFormats();
+    void tabPressed(bool forward);
 
 protected:
     void keyReleaseEvent(QKeyEvent* event) override;
     void setFilterHelper(const QString& filterOperator, const QString& operatorSuffix = "");
 
 private:
-    std::vector<FilterLineEdit*>* filterList;
     size_t columnNumber;
     QTimer* delaySignalTimer;
     QString lastValue;
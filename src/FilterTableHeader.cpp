@@ -1,12 +1,17 @@
 #include "FilterTableHeader.h"
 #include "FilterLineEdit.h"
+#include "sqlitetablemodel.h"
 
 #include <QApplication>
 #include <QTableView>
 #include <QScrollBar>
 
+#include <algorithm>
+
 FilterTableHeader::FilterTableHeader(QTableView* parent) :
-    QHeaderView(Qt::Horizontal, parent)
+    QHeaderView(Qt::Horizontal, parent),
+    filterCount(0),
+    showFirstFilter(false)
 {
     // Activate the click signals to allow sorting
     setSectionsClickable(true);
@@ -24,43 +29,58 @@ FilterTableHeader::FilterTableHeader(QTableView* parent) :
 
 void FilterTableHeader::generateFilters(size_t number, bool showFirst)
 {
-    // Delete all the current filter widgets
-    qDeleteAll(filterWidgets);
-    filterWidgets.clear();
-
-    // And generate a bunch of new ones
-    for(size_t i=0;i < number; ++i)
+    // The input widgets are kept and reused. They get their values from the model when they are assigned to a column again
+    filterCount = number;
+    showFirstFilter = showFirst;
+
+    // Make sure there is at least one input widget. It is needed for calculating the height of the filter row
+    if(number && filterWidgets.empty())
+        addFilterWidget(0);
+    for(FilterLineEdit* w : filterWidgets)
     {
-        FilterLineEdit* l = new FilterLineEdit(this, &filterWidgets, i);
-        if(!showFirst && i == 0)        // This hides the first input widget which belongs to the hidden rowid column
-            l->setVisible(false);
-        else
-            l->setVisible(true);
-        connect(l, SIGNAL(delayedTextChanged(QString)), this, SLOT(inputChanged(QString)));
-        connect(l, SIGNAL(addFilterAsCondFormat(QString)), this, SLOT(addFilterAsCondFormat(QString)));
-        connect(l, SIGNAL(clearAllCondFormats()), this, SLOT(clearAllCondFormats()));
-        connect(l, SIGNAL(editCondFormats()), this, SLOT(editCondFormats()));
-        filterWidgets.push_back(l);
+        // Don't apply any pending changes of the old filters
+        bool oldState = w->blockSignals(true);
+        w->setColumn(w->column(), QString());
+        w->blockSignals(oldState);
+        w->setVisible(false);
     }
 
     // Position them correctly
     adjustPositions();
 }
 
+FilterLineEdit* FilterTableHeader::addFilterWidget(size_t column)
+{
+    FilterLineEdit* l = new FilterLineEdit(this, column);
+    l->setVisible(false);
+    connect(l, SIGNAL(delayedTextChanged(QString)), this, SLOT(inputChanged(QString)));
+    connect(l, SIGNAL(addFilterAsCondFormat(QString)), this, SLOT(addFilterAsCondFormat(QString)));
+    connect(l, SIGNAL(clearAllCondFormats()), this, SLOT(clearAllCondFormats()));
+    connect(l, SIGNAL(editCondFormats()), this, SLOT(editCondFormats()));
+    connect(l, SIGNAL(tabPressed(bool)), this, SLOT(moveFocus(bool)));
+    filterWidgets.push_back(l);
+    return l;
+}
+
+int FilterTableHeader::filterHeight() const
+{
+    return filterWidgets.empty() ? 0 : filterWidgets.front()->sizeHint().height();
+}
+
 QSize FilterTableHeader::sizeHint() const
 {
     // For the size hint just take the value of the standard implementation and add the height of a input widget to it if necessary
     QSize s = QHeaderView::sizeHint();
-    if(filterWidgets.size())
-        s.setHeight(s.height() + filterWidgets.at(0)->sizeHint().height() + 4); // The 4 adds just adds some extra space
+    if(filterCount)
+        s.setHeight(s.height() + filterHeight() + 4); // The 4 adds just adds some extra space
     return s;
 }
 
 void FilterTableHeader::updateGeometries()
 {
     // If there are any input widgets add a viewport margin to the header to generate some empty space for them which is not affected by scrolling
-    if(filterWidgets.size())
-        setViewportMargins(0, 0, 0, filterWidgets.at(0)->sizeHint().height());
+    if(filterCount)
+        setViewportMargins(0, 0, 0, filterHeight());
     else
         setViewportMargins(0, 0, 0, 0);
 
@@ -69,13 +89,83 @@ void FilterTableHeader::updateGeometries()
     adjustPositions();
 }
 
+QString FilterTableHeader::filterValue(size_t column) const
+{
+    const SqliteTableModel* m = qobject_cast<const SqliteTableModel*>(model());
+    return m ? m->filterValue(column) : QString();
+}
+
+FilterLineEdit* FilterTableHeader::widgetForColumn(size_t column) const
+{
+    for(FilterLineEdit* w : filterWidgets)
+    {
+        if(!w->isHidden() && w->column() == column)
+            return w;
+    }
+    return nullptr;
+}
+
 void FilterTableHeader::adjustPositions()
 {
-    // Loop through all widgets
-    for(int i=0;i < static_cast<int>(filterWidgets.size()); ++i)
+    // Determine the columns which are currently visible. Only those get an input widget.
+    std::vector<size_t> columns;
+    if(filterCount && count() && viewport()->width() > 0)
     {
-        // Get the current widget, move it and resize it
-        QWidget* w = filterWidgets.at(static_cast<size_t>(i));
+        int first = visualIndexAt(0);
+        int last = visualIndexAt(viewport()->width() - 1);
+        if(first == -1)
+            first = 0;
+        if(last == -1)
+            last = count() - 1;
+        for(int v=first;v<=last;v++)
+        {
+            int logical = logicalIndex(v);
+            if(logical < 0 || static_cast<size_t>(logical) >= filterCount || isSectionHidden(logical))
+                continue;
+            if(!showFirstFilter && logical == 0)        // This hides the first input widget which belongs to the hidden rowid column
+                continue;
+            columns.push_back(static_cast<size_t>(logical));
+        }
+    }
+
+    // Keep the widgets which are still showing a visible column as they are. The same goes for the widget which has the
+    // focus so the user isn't interrupted while typing. All other widgets are free to be reused.
+    std::vector<FilterLineEdit*> bound;
+    std::vector<FilterLineEdit*> unbound;
+    for(FilterLineEdit* w : filterWidgets)
+    {
+        bool needed = !w->isHidden() && w->column() < filterCount &&
+                (w->hasFocus() || std::find(columns.begin(), columns.end(), w->column()) != columns.end());
+        if(needed && std::none_of(bound.begin(), bound.end(), [w](const FilterLineEdit* b) { return b->column() == w->column(); }))
+            bound.push_back(w);
+        else
+            unbound.push_back(w);
+    }
+
+    // Assign the free widgets to the columns which don't have one yet. Create new widgets if necessary.
+    for(size_t column : columns)
+    {
+        if(std::any_of(bound.begin(), bound.end(), [column](const FilterLineEdit* b) { return b->column() == column; }))
+            continue;
+
+        FilterLineEdit* w;
+        if(unbound.size())
+        {
+            w = unbound.back();
+            unbound.pop_back();
+        } else {
+            w = addFilterWidget(column);
+        }
+        w->setColumn(column, filterValue(column));
+        bound.push_back(w);
+    }
+    for(FilterLineEdit* w : unbound)
+        w->setVisible(false);
+
+    // Move and resize the widgets
+    for(FilterLineEdit* w : bound)
+    {
+        const int i = static_cast<int>(w->column());
         // The two adds some extra space between the header label and the input widget
         int y = QHeaderView::sizeHint().height() + 2;
         if (QApplication::layoutDirection() == Qt::RightToLeft)
@@ -83,15 +173,44 @@ void FilterTableHeader::adjustPositions()
         else
             w->move(sectionPosition(i) - offset(), y);
         w->resize(sectionSize(i), w->sizeHint().height());
+        w->setVisible(true);
     }
 }
 
 void FilterTableHeader::inputChanged(const QString& new_value)
 {
-    // Just get the column number and the new value and send them to anybody interested in filter changes
+    // Just send the new value along with the column number to anybody interested in filter changes. The model stores it.
     emit filterChanged(sender()->property("column").toInt(), new_value);
 }
 
+void FilterTableHeader::moveFocus(bool forward)
+{
+    // Find the next column which isn't hidden in the given direction
+    int column = sender()->property("column").toInt();
+    do
+    {
+        column += forward ? 1 : -1;
+    } while(column >= 0 && column < static_cast<int>(filterCount) && isSectionHidden(column));
+    if(column < (showFirstFilter ? 0 : 1) || column >= static_cast<int>(filterCount))
+        return;
+
+    // Scroll the column into view which creates an input widget for it, and focus that widget
+    QTableView* view = qobject_cast<QTableView*>(parentWidget());
+    if(view)
+    {
+        QScrollBar* scrollbar = view->horizontalScrollBar();
+        if(sectionPosition(column) < scrollbar->value())
+            scrollbar->setValue(sectionPosition(column));
+        else if(sectionPosition(column) + sectionSize(column) > scrollbar->value() + viewport()->width())
+            scrollbar->setValue(sectionPosition(column) + sectionSize(column) - viewport()->width());
+    }
+    adjustPositions();
+
+    FilterLineEdit* w = widgetForColumn(static_cast<size_t>(column));
+    if(w)
+        w->setFocus();
+}
+
 void FilterTableHeader::addFilterAsCondFormat(const QString& filter)
 {
     // Just get the column number and the new value and send them to anybody interested in new conditional formatting
@@ -112,12 +231,22 @@ void FilterTableHeader::editCondFormats()
 
 void FilterTableHeader::clearFilters()
 {
-    for(FilterLineEdit* filterLineEdit : filterWidgets)
-        filterLineEdit->clear();
+    for(size_t column=0;column<filterCount;column++)
+    {
+        if(!filterValue(column).isEmpty())
+            setFilter(column, QString());
+    }
 }
 
 void FilterTableHeader::setFilter(size_t column, const QString& value)
 {
-    if(column < filterWidgets.size())
-        filterWidgets.at(column)->setText(value);
+    if(column >= filterCount)
+        return;
+
+    // If there is an input widget for this column, set the value there. This takes care of emitting the change signal, too.
+    FilterLineEdit* w = widgetForColumn(column);
+    if(w)
+        w->setText(value);
+    else if(filterValue(column) != value)
+        emit filterChanged(static_cast<int>(column), value);
 }
@@ -14,8 +14,8 @@ class FilterTableHeader : public QHeaderView
 public:
     explicit FilterTableHeader(QTableView* parent = nullptr);
     QSize sizeHint() const override;
-    bool hasFilters() const {return (filterWidgets.size() > 0);}
-    
+    bool hasFilters() const {return (filterCount > 0);}
+
 public slots:
     void generateFilters(size_t number, bool showFirst = false);
     void adjustPositions();
@@ -36,9 +36,19 @@ private slots:
     void addFilterAsCondFormat(const QString& filter);
     void clearAllCondFormats();
     void editCondFormats();
+    void moveFocus(bool forward);
 
 private:
+    // Number of columns in the filter row. There are only input widgets for the columns which are currently visible. They are
+    // recycled when scrolling and get their values from the model, which keeps the filters of all columns.
+    size_t filterCount;
     std::vector<FilterLineEdit*> filterWidgets;
+    bool showFirstFilter;
+
+    FilterLineEdit* addFilterWidget(size_t column);
+    FilterLineEdit* widgetForColumn(size_t column) const;
+    QString filterValue(size_t column) const;
+    int filterHeight() const;
 };
 
 #endif
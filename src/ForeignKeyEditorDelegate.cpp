@@ -81,6 +81,7 @@ ForeignKeyEditorDelegate::ForeignKeyEditorDelegate(const DBBrowserDB& db, sqlb::
     , m_db(db)
     , m_table(table)
 {
+    m_db.ensureAllParsed(std::string(), "table");
     for(const auto& it : m_db.schemata)
     {
         for(const auto& jt : it.second)
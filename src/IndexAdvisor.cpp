@@ -0,0 +1,520 @@
+#include "IndexAdvisor.h"
+#include "QueryPlan.h"
+#include "SqlCompletionIndex.h"
+#include "sqlitedb.h"
+#include "sqlite.h"
+
+#include <QRegExp>
+#include <QStringList>
+
+#include <algorithm>
+
+namespace {
+
+enum class FilterType
+{
+    None,
+    Equality,
+    Range,
+    BothBounds,
+};
+
+// Classifies the conditions generated by CondFormat::filterToSqlCondition(). LIKE, REGEXP and <> can't be looked up in an index.
+FilterType classifyFilter(const std::string& condition)
+{
+    auto starts_with = [&condition](const char* prefix) {
+        return condition.compare(0, std::char_traits<char>::length(prefix), prefix) == 0;
+    };
+
+    if(starts_with("="))
+        return FilterType::Equality;
+    if(starts_with("IS NOT"))
+        return FilterType::None;
+    if(starts_with("IS "))
+        return FilterType::Equality;
+    if(starts_with("BETWEEN"))
+        return FilterType::BothBounds;
+    if(starts_with("<>"))
+        return FilterType::None;
+    if(starts_with("<") || starts_with(">"))
+        return FilterType::Range;
+    return FilterType::None;
+}
+
+// Removes the quotes from an identifier
+QString unquote(const QString& identifier)
+{
+    if(identifier.size() >= 2)
+    {
+        const QChar first = identifier.at(0);
+        const QChar last = identifier.at(identifier.size() - 1);
+        if((first == '"' && last == '"') || (first == '`' && last == '`'))
+            return identifier.mid(1, identifier.size() - 2).replace(QString(2, first), first);
+        if(first == '[' && last == ']')
+            return identifier.mid(1, identifier.size() - 2);
+    }
+    return identifier;
+}
+
+// Skips the comments at the beginning of a statement
+QString stripLeadingComments(QString statement)
+{
+    statement = statement.trimmed();
+    for(;;)
+    {
+        if(statement.startsWith("--"))
+        {
+            const int end = statement.indexOf('\n');
+            statement = end == -1 ? QString() : statement.mid(end + 1).trimmed();
+        } else if(statement.startsWith("/*")) {
+            const int end = statement.indexOf("*/");
+            statement = end == -1 ? QString() : statement.mid(end + 2).trimmed();
+        } else {
+            return statement;
+        }
+    }
+}
+
+// compare_ci() only looks at the length of its first argument
+bool sameName(const std::string& a, const std::string& b)
+{
+    return a.size() == b.size() && compare_ci(a, b);
+}
+
+qint64 estimateRows(qint64 rows, bool equality, bool range, bool both_bounds)
+{
+    if(rows < 0)
+        return -1;
+    if(equality)
+        return std::min<qint64>(rows, 10);
+    if(range)
+        return both_bounds ? rows / 64 : rows / 4;
+    return rows;
+}
+
+}
+
+sqlb::Index IndexSuggestion::index(const DBBrowserDB& db) const
+{
+    std::string name = "idx_" + table.name();
+    for(const auto& column : columns)
+        name += "_" + column.name();
+
+    // Make sure the name is unique in the schema
+    std::string unique_name = name;
+    for(int i=2;!db.getObjectsByName(sqlb::ObjectIdentifier(table.schema(), unique_name)).empty();i++)
+        unique_name = name + "_" + std::to_string(i);
+
+    sqlb::Index index(unique_name);
+    index.setTable(table.name());
+    index.fields = columns;
+    return index;
+}
+
+IndexAdvisor::IndexAdvisor(const DBBrowserDB& db) :
+    m_db(db)
+{
+}
+
+void IndexAdvisor::analyseBrowseQuery(sqlite3* handle, const sqlb::Query& query)
+{
+    const sqlb::TablePtr table = m_db.getObjectByName<sqlb::Table>(query.table());
+    if(!table || table->isVirtual())
+        return;
+
+    // Only the columns which are filtered or sorted directly can be looked up in an index. Filters on columns with a
+    // display format apply to the formatted value instead.
+    const std::vector<std::string> names = query.columnNames();
+    auto usableColumn = [&](size_t column) {
+        if(column >= names.size() || sqlb::findField(table, names.at(column)) == table->fields.end())
+            return false;
+        for(const auto& selected : query.selectedColumns())
+        {
+            if(selected.original_column == names.at(column) && selected.selector != sqlb::escapeIdentifier(selected.original_column))
+                return false;
+        }
+        return true;
+    };
+
+    // The filters are stored in a hash map. Sort them so the suggestions don't depend on its order
+    std::vector<std::pair<size_t, std::string>> filters(query.where().begin(), query.where().end());
+    std::sort(filters.begin(), filters.end());
+
+    Constraints constraints;
+    for(const auto& filter : filters)
+    {
+        if(!usableColumn(filter.first))
+            continue;
+
+        switch(classifyFilter(filter.second))
+        {
+        case FilterType::Equality:
+            constraints.equality.push_back(names.at(filter.first));
+            break;
+        case FilterType::Range:
+        case FilterType::BothBounds:
+            // A range with both bounds is more selective, so prefer it
+            if(constraints.range.empty() || (!constraints.bothBounds && classifyFilter(filter.second) == FilterType::BothBounds))
+            {
+                constraints.range = names.at(filter.first);
+                constraints.bothBounds = classifyFilter(filter.second) == FilterType::BothBounds;
+            }
+            break;
+        case FilterType::None:
+            break;
+        }
+    }
+    for(const auto& sorted_column : query.orderBy())
+    {
+        if(!usableColumn(sorted_column.column))
+        {
+            // The remaining columns can't be sorted by using an index either
+            break;
+        }
+        constraints.sort.emplace_back(names.at(sorted_column.column), sorted_column.direction);
+    }
+
+    if(constraints.equality.empty() && constraints.range.empty() && constraints.sort.empty())
+        return;
+
+    QueryPlan plan;
+    QString error;
+    if(!plan.explain(handle, QString::fromStdString(query.buildQuery(true)), error))
+        return;
+
+    bool scanned = false;
+    bool sorted = false;
+    qint64 rows = -1;
+    for(const QueryPlanStep& step : plan.steps())
+    {
+        if(!step.table.isEmpty() && step.table.compare(QString::fromStdString(table->name()), Qt::CaseInsensitive) == 0)
+        {
+            rows = step.tableRows;
+            if(step.operation == QueryPlanStep::Scan)
+                scanned = true;
+        }
+        if(step.operation == QueryPlanStep::TempBTree && step.detail.contains("ORDER BY"))
+            sorted = true;
+    }
+
+    suggest(query.table(), constraints, rows, scanned, sorted);
+}
+
+void IndexAdvisor::analyseStatement(sqlite3* handle, const QString& statement)
+{
+    // Only statements which look up rows can benefit from an index
+    const QString sql = stripLeadingComments(statement);
+    if(!sql.contains(QRegExp("^(SELECT|WITH|UPDATE|DELETE|INSERT|REPLACE)\\b", Qt::CaseInsensitive)))
+        return;
+
+    QueryPlan plan;
+    QString error;
+    if(!plan.explain(handle, sql, error))
+        return;
+
+    // Finds the table of a step. The schema isn't part of the plan, so use the first table with this name
+    auto findTable = [this](const QString& name, sqlb::ObjectIdentifier& identifier) -> sqlb::TablePtr {
+        for(const auto& schema : m_db.schemata)
+        {
+            identifier = sqlb::ObjectIdentifier(schema.first, name.toStdString());
+            sqlb::TablePtr table = m_db.getObjectByName<sqlb::Table>(identifier);
+            if(table && !table->isVirtual())
+                return table;
+        }
+        return nullptr;
+    };
+
+    // SQLite builds automatic indexes for joins which can't use an index otherwise. The plan lists their constraints.
+    QRegExp constraint_pattern("^([^=<>]+)(=|>=|<=|>|<)\\?$");
+    for(const QueryPlanStep& step : plan.steps())
+    {
+        if(!step.automaticIndex)
+            continue;
+
+        sqlb::ObjectIdentifier identifier;
+        const sqlb::TablePtr table = findTable(step.table, identifier);
+        const int open = step.detail.lastIndexOf('(');
+        if(!table || open == -1 || !step.detail.endsWith(')'))
+            continue;
+
+        IndexSuggestion suggestion;
+        suggestion.table = identifier;
+        suggestion.automaticIndex = true;
+        suggestion.tableRows = step.tableRows;
+        std::string range;
+        for(const QString& term : step.detail.mid(open + 1, step.detail.size() - open - 2).split(" AND "))
+        {
+            if(!constraint_pattern.exactMatch(term))
+                continue;
+            const std::string column = constraint_pattern.cap(1).toStdString();
+            if(constraint_pattern.cap(2) == "=")
+                suggestion.columns.emplace_back(column, false);
+            else if(range.empty())
+                range = column;
+        }
+        const bool equality = !suggestion.columns.empty();
+        if(!range.empty())
+            suggestion.columns.emplace_back(range, false);
+        if(suggestion.columns.empty())
+            continue;
+        suggestion.estimatedRows = estimateRows(step.tableRows, equality, !range.empty(), false);
+        addSuggestion(suggestion);
+    }
+
+    // Full scans and sorts of statements which only use one table
+    const auto references = SqlCompletionIndex::referencedTables(sql.toStdString(), 0);
+    if(references.size() != 1)
+        return;
+    sqlb::ObjectIdentifier identifier;
+    sqlb::TablePtr table;
+    if(references.front().schema.empty())
+    {
+        table = findTable(QString::fromStdString(references.front().table), identifier);
+    } else {
+        identifier = sqlb::ObjectIdentifier(references.front().schema, references.front().table);
+        table = m_db.getObjectByName<sqlb::Table>(identifier);
+    }
+    if(!table || table->isVirtual())
+        return;
+
+    bool scanned = false;
+    bool sorted = false;
+    qint64 rows = -1;
+    for(const QueryPlanStep& step : plan.steps())
+    {
+        if(step.table.compare(QString::fromStdString(table->name()), Qt::CaseInsensitive) == 0)
+        {
+            rows = step.tableRows;
+            if(step.operation == QueryPlanStep::Scan)
+                scanned = true;
+        }
+        if(step.operation == QueryPlanStep::TempBTree && step.detail.contains("ORDER BY"))
+            sorted = true;
+    }
+    if(!scanned && !sorted)
+        return;
+
+    // Find the end of the WHERE clause. This doesn't know about subqueries, which is fine for the simple statements we're
+    // looking for. Conditions combined by OR can't be looked up in one index, so give up in that case.
+    Constraints constraints;
+    QRegExp where_pattern("\\bWHERE\\b(.*)(\\bGROUP\\s+BY\\b|\\bORDER\\s+BY\\b|\\bLIMIT\\b|;|$)", Qt::CaseInsensitive);
+    where_pattern.setMinimal(true);
+    if(where_pattern.indexIn(sql) != -1 && !where_pattern.cap(1).contains(QRegExp("\\bOR\\b", Qt::CaseInsensitive)))
+    {
+        const QString where = where_pattern.cap(1);
+        for(const auto& field : table->fields)
+        {
+            const QString name = QRegExp::escape(QString::fromStdString(field.name()));
+            QRegExp comparison(QString("(?:^|[^\\w\"`\\]])(?:\\w+\\.)?(?:\"%1\"|`%1`|\\[%1\\]|%1)\\s*(==?|IS\\s+(?!NOT\\b)|IN\\b|BETWEEN\\b|[<>]=?(?!>))")
+                               .arg(name), Qt::CaseInsensitive);
+            int bounds = 0;
+            bool equality = false;
+            bool between = false;
+            for(int pos=0;(pos = comparison.indexIn(where, pos)) != -1;pos += comparison.matchedLength())
+            {
+                const QString op = comparison.cap(1).trimmed().toUpper();
+                if(op.startsWith('=') || op.startsWith("IS") || op == "IN")
+                    equality = true;
+                else if(op == "BETWEEN")
+                    between = true;
+                else
+                    bounds++;
+            }
+
+            if(equality)
+            {
+                constraints.equality.push_back(field.name());
+            } else if(between || bounds) {
+                const bool both = between || bounds > 1;
+                if(constraints.range.empty() || (both && !constraints.bothBounds))
+                {
+                    constraints.range = field.name();
+                    constraints.bothBounds = both;
+                }
+            }
+        }
+    }
+
+    // Only plain columns in the ORDER BY clause can be taken from an index
+    QRegExp order_pattern("\\bORDER\\s+BY\\b(.*)(\\bLIMIT\\b|;|$)", Qt::CaseInsensitive);
+    order_pattern.setMinimal(true);
+    if(sorted && order_pattern.lastIndexIn(sql) != -1)
+    {
+        QRegExp term_pattern("(?:\\w+\\.)?(\"(?:[^\"]|\"\")+\"|`[^`]+`|\\[[^\\]]+\\]|\\w+)(?:\\s+(ASC|DESC))?", Qt::CaseInsensitive);
+        for(const QString& term : order_pattern.cap(1).split(','))
+        {
+            if(!term_pattern.exactMatch(term.trimmed()))
+            {
+                constraints.sort.clear();
+                break;
+            }
+            const auto field = sqlb::findField(table, unquote(term_pattern.cap(1)).toStdString());
+            if(field == table->fields.end())
+            {
+                constraints.sort.clear();
+                break;
+            }
+            constraints.sort.emplace_back(field->name(), term_pattern.cap(2).compare("DESC", Qt::CaseInsensitive) == 0 ? sqlb::Descending : sqlb::Ascending);
+        }
+    }
+
+    suggest(identifier, constraints, rows, scanned, sorted);
+}
+
+void IndexAdvisor::analyseStatements(sqlite3* handle, const QString& statements)
+{
+    // Statements end with a semicolon. But the statements in the SQL log don't need to, so a comment or an empty line
+    // ends them too. This is only wrong for strings spanning these lines, which then fail to be explained and are skipped.
+    QString statement;
+    auto flush = [&]() {
+        if(!statement.trimmed().isEmpty())
+            analyseStatement(handle, statement);
+        statement.clear();
+    };
+    for(const QString& line : statements.split('\n'))
+    {
+        const QString trimmed = line.trimmed();
+        if(trimmed.isEmpty() || trimmed.startsWith("--"))
+        {
+            flush();
+            continue;
+        }
+
+        statement += line + '\n';
+        if(trimmed.endsWith(';') && sqlite3_complete(statement.toUtf8().constData()))
+            flush();
+    }
+    flush();
+}
+
+void IndexAdvisor::suggest(const sqlb::ObjectIdentifier& table, const Constraints& constraints, qint64 tableRows, bool scanned, bool sorted)
+{
+    // An index which returns the rows in the requested order. The equality constraints go first because they don't change
+    // the order of the remaining rows.
+    const bool sort_index = sorted && !constraints.sort.empty();
+    if(sort_index)
+    {
+        IndexSuggestion suggestion;
+        suggestion.table = table;
+        suggestion.tableRows = tableRows;
+        suggestion.avoidsScan = scanned && !constraints.equality.empty();
+        suggestion.avoidsSort = true;
+        for(const auto& column : constraints.equality)
+            suggestion.columns.emplace_back(column, false);
+        for(const auto& column : constraints.sort)
+            suggestion.columns.emplace_back(column.first, false, column.second == sqlb::Descending ? "DESC" : "");
+        suggestion.estimatedRows = estimateRows(tableRows, !constraints.equality.empty(), false, false);
+        addSuggestion(suggestion);
+    }
+
+    // An index for the filters. If there are only equality constraints, the index for the sort order above covers them already
+    if(scanned && (!constraints.range.empty() || (!sort_index && !constraints.equality.empty())))
+    {
+        IndexSuggestion suggestion;
+        suggestion.table = table;
+        suggestion.tableRows = tableRows;
+        suggestion.avoidsScan = true;
+        for(const auto& column : constraints.equality)
+            suggestion.columns.emplace_back(column, false);
+        if(!constraints.range.empty())
+            suggestion.columns.emplace_back(constraints.range, false);
+        suggestion.estimatedRows = estimateRows(tableRows, !constraints.equality.empty(), !constraints.range.empty(), constraints.bothBounds);
+        addSuggestion(suggestion);
+    }
+}
+
+void IndexAdvisor::addSuggestion(const IndexSuggestion& suggestion)
+{
+    if(isIndexed(suggestion.table, suggestion.columns))
+        return;
+
+    // Merge suggestions for the same columns
+    auto same = [&suggestion](const IndexSuggestion& other) {
+        return other.table == suggestion.table && other.columns.size() == suggestion.columns.size() &&
+                std::equal(other.columns.begin(), other.columns.end(), suggestion.columns.begin(),
+                           [](const sqlb::IndexedColumn& a, const sqlb::IndexedColumn& b) {
+            return sameName(a.name(), b.name()) && sameName(a.order(), b.order());
+        });
+    };
+    auto existing = std::find_if(m_suggestions.begin(), m_suggestions.end(), same);
+    if(existing == m_suggestions.end())
+    {
+        m_suggestions.push_back(suggestion);
+    } else {
+        existing->statements += suggestion.statements;
+        existing->avoidsScan |= suggestion.avoidsScan;
+        existing->avoidsSort |= suggestion.avoidsSort;
+        existing->automaticIndex |= suggestion.automaticIndex;
+        if(existing->estimatedRows < 0 || (suggestion.estimatedRows >= 0 && suggestion.estimatedRows < existing->estimatedRows))
+            existing->estimatedRows = suggestion.estimatedRows;
+    }
+}
+
+bool IndexAdvisor::isIndexed(const sqlb::ObjectIdentifier& table, const sqlb::IndexedColumnVector& columns) const
+{
+    auto startsWith = [&columns](const std::vector<std::string>& indexed) {
+        return indexed.size() >= columns.size() &&
+                std::equal(columns.begin(), columns.end(), indexed.begin(), [](const sqlb::IndexedColumn& column, const std::string& name) {
+            return sameName(column.name(), name);
+        });
+    };
+
+    // The primary key and unique constraints come with their own indexes
+    const sqlb::TablePtr table_object = m_db.getObjectByName<sqlb::Table>(table);
+    if(!table_object)
+        return false;
+    for(const auto& constraint : table_object->allConstraints())
+    {
+        if((constraint.second->type() == sqlb::Constraint::PrimaryKeyConstraintType || constraint.second->type() == sqlb::Constraint::UniqueConstraintType)
+                && startsWith(constraint.first))
+            return true;
+    }
+
+    // Sorting by the rowid doesn't need an index
+    if(columns.size() == 1 && !table_object->withoutRowidTable() && table_object->rowidColumns() == sqlb::StringVector{columns.front().name()})
+        return true;
+
+    const auto schema = m_db.schemata.find(table.schema());
+    if(schema == m_db.schemata.end())
+        return false;
+    const auto indices = schema->second.equal_range("index");
+    for(auto it=indices.first;it!=indices.second;++it)
+    {
+        m_db.ensureParsed(table.schema(), it->second);
+        const sqlb::IndexPtr index = std::dynamic_pointer_cast<sqlb::Index>(it->second);
+        if(!index || !sameName(index->table(), table.name()) || !index->whereExpr().empty())
+            continue;
+
+        std::vector<std::string> indexed;
+        for(const auto& column : index->fields)
+        {
+            if(column.expression())
+                break;
+            indexed.push_back(column.name());
+        }
+        if(startsWith(indexed))
+            return true;
+    }
+
+    return false;
+}
+
+std::vector<IndexSuggestion> IndexAdvisor::suggestions() const
+{
+    // The benefit is the number of rows which don't have to be read for each statement. Avoiding a sort counts as reading
+    // the rows once more. Suggestions for tables of unknown size come last.
+    auto benefit = [](const IndexSuggestion& suggestion) -> qint64 {
+        if(suggestion.tableRows < 0)
+            return -1;
+        qint64 saved = suggestion.avoidsScan ? suggestion.tableRows - std::max<qint64>(suggestion.estimatedRows, 0) : 0;
+        if(suggestion.avoidsSort || suggestion.automaticIndex)
+            saved += suggestion.tableRows;
+        return saved * suggestion.statements;
+    };
+
+    std::vector<IndexSuggestion> result = m_suggestions;
+    std::stable_sort(result.begin(), result.end(), [&benefit](const IndexSuggestion& a, const IndexSuggestion& b) {
+        return benefit(a) > benefit(b);
+    });
+    return result;
+}
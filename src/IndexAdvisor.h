@@ -0,0 +1,78 @@
+#ifndef INDEXADVISOR_H
+#define INDEXADVISOR_H
+
+#include "sql/ObjectIdentifier.h"
+#include "sql/Query.h"
+#include "sql/sqlitetypes.h"
+
+#include <QString>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+class DBBrowserDB;
+struct sqlite3;
+
+/// An index which would speed up some of the analysed statements
+struct IndexSuggestion
+{
+    sqlb::ObjectIdentifier table;
+    sqlb::IndexedColumnVector columns;
+    bool avoidsScan = false;        // The index replaces a full table scan
+    bool avoidsSort = false;        // The index returns the rows in the requested order, so no temporary B-tree is needed
+    bool automaticIndex = false;    // SQLite builds an index like this one for each execution
+    qint64 tableRows = -1;          // Number of rows of the table according to sqlite_stat1 or -1 if unknown
+    qint64 estimatedRows = -1;      // Estimated number of rows read with the index or -1 if the table size is unknown
+    int statements = 1;             // Number of analysed statements which benefit from the index
+
+    /// \returns an index object for the suggestion with a name which isn't used in the schema yet
+    sqlb::Index index(const DBBrowserDB& db) const;
+};
+
+/**
+ * @brief The IndexAdvisor class
+ * Looks at the query plans of statements and suggests indexes for the tables which SQLite has to scan or sort. For the
+ * queries generated for browsing a table, the filtered and sorted columns are taken from the query object. For other
+ * statements the constraints which SQLite reports for automatic indexes and plain comparisons in the WHERE and ORDER BY
+ * clauses of single-table statements are used.
+ *
+ * The benefit is estimated with the rules of thumb SQLite uses for tables without statistics: an equality constraint on
+ * an index matches about ten rows, a range constraint a quarter of the rows and a range with both bounds one in 64 rows.
+ */
+class IndexAdvisor
+{
+public:
+    explicit IndexAdvisor(const DBBrowserDB& db);
+
+    /// Analyses the query for browsing a table with its filters and sort order
+    void analyseBrowseQuery(sqlite3* handle, const sqlb::Query& query);
+
+    /// Analyses an arbitrary statement, e.g. from the SQL log. Statements which aren't queries are ignored
+    void analyseStatement(sqlite3* handle, const QString& statement);
+
+    /// Splits a sequence of statements like the contents of the SQL log and analyses each of them
+    void analyseStatements(sqlite3* handle, const QString& statements);
+
+    /// \returns the suggestions, the most beneficial ones first
+    std::vector<IndexSuggestion> suggestions() const;
+
+private:
+    // The columns a statement filters and sorts a table by
+    struct Constraints
+    {
+        std::vector<std::string> equality;
+        std::string range;                      // Only one range constraint can be used by an index
+        bool bothBounds = false;                // The range constraint has a lower and an upper bound
+        std::vector<std::pair<std::string, sqlb::SortDirection>> sort;
+    };
+
+    const DBBrowserDB& m_db;
+    std::vector<IndexSuggestion> m_suggestions;
+
+    void suggest(const sqlb::ObjectIdentifier& table, const Constraints& constraints, qint64 tableRows, bool scanned, bool sorted);
+    void addSuggestion(const IndexSuggestion& suggestion);
+    bool isIndexed(const sqlb::ObjectIdentifier& table, const sqlb::IndexedColumnVector& columns) const;
+};
+
+#endif
@@ -0,0 +1,145 @@
+#include "IndexAdvisorDialog.h"
+#include "ui_IndexAdvisorDialog.h"
+#include "sqlitedb.h"
+
+#include <QLocale>
+#include <QMessageBox>
+#include <QPushButton>
+
+IndexAdvisorDialog::IndexAdvisorDialog(DBBrowserDB& db, const sqlb::Query& query, const QString& history, QWidget* parent) :
+    QDialog(parent),
+    ui(new Ui::IndexAdvisorDialog),
+    m_db(db),
+    m_query(query),
+    m_history(history)
+{
+    // Create UI
+    ui->setupUi(this);
+
+    ui->checkHistory->setEnabled(!m_history.trimmed().isEmpty());
+    ui->buttonCreate->setEnabled(false);
+    ui->buttonCreateSession->setEnabled(false);
+
+    connect(ui->checkHistory, &QCheckBox::toggled, this, &IndexAdvisorDialog::analyse);
+    connect(ui->treeSuggestions, &QTreeWidget::currentItemChanged, this, &IndexAdvisorDialog::updatePreview);
+    connect(ui->buttonCreate, &QPushButton::clicked, [this]() { createIndex(false); });
+    connect(ui->buttonCreateSession, &QPushButton::clicked, [this]() { createIndex(true); });
+
+    analyse();
+}
+
+IndexAdvisorDialog::~IndexAdvisorDialog()
+{
+    delete ui;
+}
+
+void IndexAdvisorDialog::analyse()
+{
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+
+    IndexAdvisor advisor(m_db);
+    {
+        auto pDb = m_db.get(tr("analysing queries"));
+        if(pDb)
+        {
+            if(!m_query.table().isEmpty())
+                advisor.analyseBrowseQuery(pDb.get(), m_query);
+            if(ui->checkHistory->isChecked())
+                advisor.analyseStatements(pDb.get(), m_history);
+        }
+    }
+    m_suggestions = advisor.suggestions();
+
+    QApplication::restoreOverrideCursor();
+
+    const QLocale locale;
+    ui->treeSuggestions->clear();
+    for(size_t i=0;i<m_suggestions.size();i++)
+    {
+        const IndexSuggestion& suggestion = m_suggestions.at(i);
+
+        QStringList columns;
+        for(const auto& column : suggestion.columns)
+            columns.push_back(QString::fromStdString(column.toString("", " ")));
+
+        QStringList reasons;
+        if(suggestion.avoidsScan)
+            reasons.push_back(tr("Avoids a full table scan"));
+        if(suggestion.avoidsSort)
+            reasons.push_back(tr("Avoids sorting"));
+        if(suggestion.automaticIndex)
+            reasons.push_back(tr("Replaces an automatic index"));
+        if(suggestion.statements > 1)
+            reasons.push_back(tr("Used by %1 statements").arg(suggestion.statements));
+
+        QString benefit;
+        if(suggestion.tableRows < 0)
+            benefit = tr("Unknown, the table hasn't been analysed");
+        else if(suggestion.avoidsScan && suggestion.estimatedRows >= 0)
+            benefit = tr("Reads about %1 instead of %2 rows").arg(locale.toString(suggestion.estimatedRows)).arg(locale.toString(suggestion.tableRows));
+        else
+            benefit = tr("Saves processing %1 rows").arg(locale.toString(suggestion.tableRows));
+
+        QTreeWidgetItem* item = new QTreeWidgetItem(ui->treeSuggestions);
+        item->setText(0, QString::fromStdString(suggestion.table.toDisplayString()));
+        item->setText(1, columns.join(", "));
+        item->setText(2, reasons.join(", "));
+        item->setText(3, benefit);
+        item->setData(0, Qt::UserRole, static_cast<int>(i));
+    }
+    for(int i=0;i<ui->treeSuggestions->columnCount();i++)
+        ui->treeSuggestions->resizeColumnToContents(i);
+
+    if(m_suggestions.empty())
+    {
+        ui->labelStatus->setText(tr("No index suggestions. The analysed queries don't scan or sort tables which an index could help with."));
+        updatePreview();
+    } else {
+        ui->labelStatus->setText(tr("The estimates are based on the statistics gathered by ANALYZE. Run it first for better estimates."));
+        ui->treeSuggestions->setCurrentItem(ui->treeSuggestions->topLevelItem(0));
+    }
+}
+
+const IndexSuggestion* IndexAdvisorDialog::currentSuggestion() const
+{
+    const QTreeWidgetItem* item = ui->treeSuggestions->currentItem();
+    if(!item)
+        return nullptr;
+    return &m_suggestions.at(static_cast<size_t>(item->data(0, Qt::UserRole).toInt()));
+}
+
+void IndexAdvisorDialog::updatePreview()
+{
+    const IndexSuggestion* suggestion = currentSuggestion();
+    if(suggestion)
+        ui->sqlTextEdit->setText(QString::fromStdString(suggestion->index(m_db).sql(suggestion->table.schema())));
+    else
+        ui->sqlTextEdit->setText(QString());
+
+    // Session indexes are stored as uncommitted changes, so they aren't possible for read only databases either
+    ui->buttonCreate->setEnabled(suggestion && !m_db.readOnly());
+    ui->buttonCreateSession->setEnabled(suggestion && !m_db.readOnly());
+}
+
+void IndexAdvisorDialog::createIndex(bool session)
+{
+    const IndexSuggestion* suggestion = currentSuggestion();
+    if(!suggestion)
+        return;
+
+    const sqlb::Index index = suggestion->index(m_db);
+    const std::string schema = suggestion->table.schema();
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    const bool ok = session ? m_db.createSessionIndex(schema, index) : m_db.executeSQL(QString::fromStdString(index.sql(schema)));
+    QApplication::restoreOverrideCursor();
+
+    if(!ok)
+    {
+        QMessageBox::warning(this, QApplication::applicationName(), tr("Creating the index failed: %1").arg(m_db.lastError()));
+        return;
+    }
+
+    // The new index may make other suggestions obsolete too
+    analyse();
+}
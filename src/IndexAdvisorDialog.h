@@ -0,0 +1,46 @@
+#ifndef INDEXADVISORDIALOG_H
+#define INDEXADVISORDIALOG_H
+
+#include "IndexAdvisor.h"
+
+#include <QDialog>
+
+#include <vector>
+
+namespace Ui {
+class IndexAdvisorDialog;
+}
+
+class DBBrowserDB;
+
+class IndexAdvisorDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief IndexAdvisorDialog Shows the indexes which would speed up browsing a table and the statements of the SQL log
+     * @param db The database
+     * @param query The query currently used for browsing a table, including its filters and sort order
+     * @param history The statements from the SQL log which can be analysed too
+     * @param parent The parent widget
+     */
+    explicit IndexAdvisorDialog(DBBrowserDB& db, const sqlb::Query& query, const QString& history, QWidget* parent = nullptr);
+    ~IndexAdvisorDialog() override;
+
+private:
+    Ui::IndexAdvisorDialog* ui;
+    DBBrowserDB& m_db;
+    sqlb::Query m_query;
+    QString m_history;
+    std::vector<IndexSuggestion> m_suggestions;
+
+    const IndexSuggestion* currentSuggestion() const;
+    void createIndex(bool session);
+
+private slots:
+    void analyse();
+    void updatePreview();
+};
+
+#endif
@@ -14,6 +14,7 @@
 #include "sqlitetablemodel.h"
 #include "SqlExecutionArea.h"
 #include "VacuumDialog.h"
+#include "IndexAdvisorDialog.h"
 #include "DbStructureModel.h"
 #include "version.h"
 #include "sqlite.h"
@@ -30,7 +31,9 @@
 #include "CondFormat.h"
 #include "CondFormatManager.h"
 #include "RunSql.h"
+#include "CacheGovernor.h"
 
+#include <algorithm>
 #include <chrono>
 #include <QFile>
 #include <QApplication>
@@ -57,6 +60,7 @@
 #include <QDataStream>      // This include seems to only be necessary for the Windows build
 #include <QPrinter>
 #include <QPrintPreviewDialog>
+#include <QLocale>
 
 #ifdef Q_OS_MACX //Needed only on macOS
     #include <QOpenGLWidget>
@@ -198,9 +202,24 @@ void MainWindow::init()
         // changing to the Browse Data tab, and then opening another database makes the table browser try to load the old table because the table
         // list wasn't updated yet.
         QString old_table = ui->comboBrowseTable->currentText();
-        dbStructureModel->reloadData();
+        dbStructureModel->updateData();
         populateStructure(old_table);
     }, Qt::QueuedConnection);
+
+    // Collect the tables and views which have changed for updating the auto completion in populateStructure(). The signals
+    // can be emitted from other threads, so don't do more than necessary here.
+    auto collectSchemaChange = [this](bool removed) {
+        return [this, removed](const std::string& schema, sqlb::ObjectPtr object) {
+            if(object->type() != sqlb::Object::Table && object->type() != sqlb::Object::View)
+                return;
+            std::lock_guard<std::mutex> lock(m_pendingSchemaChangesMutex);
+            m_pendingSchemaChanges.push_back({schema, object, removed});
+        };
+    };
+    connect(&db, &DBBrowserDB::objectAdded, this, collectSchemaChange(false), Qt::DirectConnection);
+    connect(&db, &DBBrowserDB::objectChanged, this, collectSchemaChange(false), Qt::DirectConnection);
+    connect(&db, &DBBrowserDB::objectRemoved, this, collectSchemaChange(true), Qt::DirectConnection);
+
     ui->dbTreeWidget->setModel(dbStructureModel);
     ui->dbTreeWidget->setColumnWidth(DbStructureModel::ColumnName, 300);
     ui->dbTreeWidget->setColumnHidden(DbStructureModel::ColumnObjectType, true);
@@ -425,6 +444,13 @@ void MainWindow::init()
     statusEncodingLabel->setToolTip(tr("Database encoding"));
     ui->statusbar->addPermanentWidget(statusEncodingLabel);
 
+    statusMemoryLabel = new QLabel(ui->statusbar);
+    statusMemoryLabel->setEnabled(false);
+    ui->statusbar->addPermanentWidget(statusMemoryLabel);
+    // Use the label as context object because the models report their usage until they are destroyed, which might happen after the label is gone
+    connect(&CacheGovernor::instance(), &CacheGovernor::usageChanged, statusMemoryLabel, [this]() { updateMemoryUsageLabel(); });
+    updateMemoryUsageLabel();
+
     // When changing the text of the toolbar actions, also automatically change their icon text and their tooltip text
     connect(ui->editModifyObjectAction, &QAction::changed, [=]() {
         ui->editModifyObjectAction->setIconText(ui->editModifyObjectAction->text());
@@ -662,27 +688,36 @@ void MainWindow::populateStructure(const QString& old_table)
     if(!db.isOpen())
         return;
 
-    // Update table and column names for syntax highlighting
-    SqlUiLexer::QualifiedTablesMap qualifiedTablesMap;
-    for(const auto& it : db.schemata)
+    // Update table and column names for auto completion and syntax highlighting. Only the tables and views which have been
+    // added, changed or removed since the last update are looked at.
+    std::vector<SchemaChange> changes;
     {
-        SqlUiLexer::TablesAndColumnsMap tablesToColumnsMap;
-        objectMap tab = db.getBrowsableObjects(it.first);
-        for(const auto& jt : tab)
+        std::lock_guard<std::mutex> lock(m_pendingSchemaChangesMutex);
+        changes.swap(m_pendingSchemaChanges);
+    }
+    for(const auto& change : changes)
+    {
+        if(change.removed)
         {
-            QString objectname = QString::fromStdString(jt.second->name());
-
-            sqlb::FieldInfoList fi = jt.second->fieldInformation();
-            for(const sqlb::FieldInfo& f : fi)
-                tablesToColumnsMap[objectname].push_back(QString::fromStdString(f.name));
+            SqlTextEdit::sqlLexer->dropTable(change.schema, change.object->name());
+        } else {
+            std::vector<std::string> columns;
+            for(const sqlb::FieldInfo& f : change.object->fieldInformation())
+                columns.push_back(f.name);
+            SqlTextEdit::sqlLexer->setTable(change.schema, change.object->name(), columns);
         }
-        qualifiedTablesMap[QString::fromStdString(it.first)] = tablesToColumnsMap;
     }
-    SqlTextEdit::sqlLexer->setTableNames(qualifiedTablesMap);
-    ui->editLogApplication->reloadKeywords();
-    ui->editLogUser->reloadKeywords();
-    for(int i=0;i<ui->tabSqlAreas->count();i++)
-        qobject_cast<SqlExecutionArea*>(ui->tabSqlAreas->widget(i))->getEditor()->reloadKeywords();
+    std::vector<std::string> schemata;
+    for(const auto& it : db.schemata)
+        schemata.push_back(it.first);
+    SqlTextEdit::sqlLexer->setSchemata(schemata);
+    if(!changes.empty())
+    {
+        ui->editLogApplication->reloadKeywords();
+        ui->editLogUser->reloadKeywords();
+        for(int i=0;i<ui->tabSqlAreas->count();i++)
+            qobject_cast<SqlExecutionArea*>(ui->tabSqlAreas->widget(i))->getEditor()->reloadKeywords();
+    }
 
     // Resize SQL column to fit contents
     ui->dbTreeWidget->resizeColumnToContents(DbStructureModel::ColumnSQL);
@@ -722,6 +757,10 @@ void MainWindow::populateTable()
     // Get current table name
     sqlb::ObjectIdentifier tablename = currentlyBrowsedTableName();
 
+    // Remember where we were in the previous table so we can go back there when switching back to it
+    if(!m_browseTableModel->currentTableName().isEmpty() && ui->dataTable->model())
+        browseTableScrollPositions[m_browseTableModel->currentTableName()] = ui->dataTable->verticalScrollBar()->value();
+
     // Set model
     bool reconnectSelectionSignals = false;
     if(ui->dataTable->model() == nullptr)
@@ -803,7 +842,10 @@ void MainWindow::populateTable()
 
         // Filters
         for(auto it=storedData.filterValues.constBegin();it!=storedData.filterValues.constEnd();++it)
+        {
             query.where().insert({it.key(), CondFormat::filterToSqlCondition(it.value(), m_browseTableModel->encoding()).toStdString()});
+            query.filterValues().insert({it.key(), it.value().toStdString()});
+        }
 
         // Display formats
         bool only_defaults = true;
@@ -855,6 +897,9 @@ void MainWindow::populateTable()
 
     updateInsertDeleteRecordButton();
 
+    // Restore the scroll position. This only has an effect if the rows are still cached, otherwise the row count isn't known yet.
+    ui->dataTable->verticalScrollBar()->setValue(browseTableScrollPositions.value(tablename, 0));
+
     QApplication::restoreOverrideCursor();
 }
 
@@ -880,20 +925,12 @@ void MainWindow::applyBrowseTableSettings(BrowseDataTableSettings storedData, bo
     for(auto widthIt=storedData.columnWidths.constBegin();widthIt!=storedData.columnWidths.constEnd();++widthIt)
         ui->dataTable->setColumnWidth(widthIt.key(), widthIt.value());
 
-    // Filters
+    // Filters. The filter values are part of the query of the browse table model already and the filter row shows them from there.
     if(!skipFilters)
     {
-        // Set filters blocking signals, since the filter is already applied to the browse table model
-        FilterTableHeader* filterHeader = qobject_cast<FilterTableHeader*>(ui->dataTable->horizontalHeader());
-        bool oldState = filterHeader->blockSignals(true);
-        for(auto filterIt=storedData.filterValues.constBegin();filterIt!=storedData.filterValues.constEnd();++filterIt)
-            filterHeader->setFilter(static_cast<size_t>(filterIt.key()), filterIt.value());
-
         // Conditional formats
         for(auto formatIt=storedData.condFormats.constBegin(); formatIt!=storedData.condFormats.constEnd(); ++formatIt)
             m_browseTableModel->setCondFormats(formatIt.key(), formatIt.value());
-
-      filterHeader->blockSignals(oldState);
     }
 
     // Encoding
@@ -926,9 +963,11 @@ bool MainWindow::fileClose()
 
     // Reset the model for the Browse tab
     m_browseTableModel->reset();
+    m_browseTableModel->clearRetainedCaches();
 
     // Remove all stored table information browse data tab
     browseTableSettings.clear();
+    browseTableScrollPositions.clear();
     defaultBrowseTableEncoding = QString();
 
     // Clear edit dock
@@ -947,7 +986,11 @@ bool MainWindow::fileClose()
     ui->editLogUser->clear();
     ui->editLogErrorLog->clear();
 
-    // Remove completion and highlighting for identifiers
+    // Remove completion and highlighting for identifiers. Changes which haven't been applied yet belong to the closed database.
+    {
+        std::lock_guard<std::mutex> lock(m_pendingSchemaChangesMutex);
+        m_pendingSchemaChanges.clear();
+    }
     SqlTextEdit::sqlLexer->setTableNames(SqlUiLexer::QualifiedTablesMap());
     for(int i=0; i < ui->tabSqlAreas->count(); i++)
         qobject_cast<SqlExecutionArea*>(ui->tabSqlAreas->widget(i))->getEditor()->reloadKeywords();
@@ -1035,17 +1078,34 @@ void MainWindow::deleteRecord()
 {
     if(ui->dataTable->selectionModel()->hasSelection())
     {
+        // Get the selected row ranges. This only depends on the number of selection ranges, not on the number of selected cells.
+        std::vector<std::pair<int, int>> ranges;
+        for(const QItemSelectionRange& range : ui->dataTable->selectionModel()->selection())
+        {
+            if(range.isValid() && !range.isEmpty())
+                ranges.emplace_back(range.top(), range.bottom());
+        }
+
         // If only filter header is selected
-        if(ui->dataTable->selectionModel()->selectedIndexes().isEmpty())
+        if(ranges.empty())
             return;
 
+        // Merge overlapping and adjacent ranges
+        std::sort(ranges.begin(), ranges.end());
+        std::vector<std::pair<int, int>> merged_ranges;
+        for(const auto& range : ranges)
+        {
+            if(!merged_ranges.empty() && range.first <= merged_ranges.back().second + 1)
+                merged_ranges.back().second = std::max(merged_ranges.back().second, range.second);
+            else
+                merged_ranges.push_back(range);
+        }
+
+        // Delete the ranges starting with the last one, so the positions of the remaining ranges don't change
         int old_row = ui->dataTable->currentIndex().row();
-        while(ui->dataTable->selectionModel()->hasSelection())
+        for(auto it=merged_ranges.rbegin();it!=merged_ranges.rend();++it)
         {
-            int first_selected_row = ui->dataTable->selectionModel()->selectedIndexes().first().row();
-            int last_selected_row = ui->dataTable->selectionModel()->selectedIndexes().last().row();
-            int selected_rows_count = last_selected_row - first_selected_row + 1;
-            if(!m_browseTableModel->removeRows(first_selected_row, selected_rows_count))
+            if(!m_browseTableModel->removeRows(it->first, it->second - it->first + 1))
             {
                 QMessageBox::warning(this, QApplication::applicationName(), tr("Error deleting record:\n%1").arg(db.lastError()));
                 break;
@@ -1159,6 +1219,27 @@ void MainWindow::setRecordsetLabel()
     enableEditing(m_browseTableModel->rowCountAvailable() != SqliteTableModel::RowCount::Unknown);
 }
 
+void MainWindow::updateMemoryUsageLabel()
+{
+    const auto mib = [](size_t bytes) { return QString::number(static_cast<double>(bytes) / (1024.0 * 1024.0), 'f', 1); };
+
+    const CacheGovernor& governor = CacheGovernor::instance();
+    statusMemoryLabel->setText(tr("Cache: %1 MiB").arg(mib(governor.totalUsage())));
+
+    // List the memory usage of each data view in the tooltip, most recently viewed first
+    QStringList lines;
+    lines << tr("Memory used for cached rows: %1 of %2 MiB").arg(mib(governor.totalUsage())).arg(mib(governor.budget()));
+    for(const auto& usage : governor.usage())
+    {
+        if(usage.bytes == 0)
+            continue;
+
+        const QString name = usage.model == m_browseTableModel ? tr("Browse Data: %1") : tr("Execute SQL: %1");
+        lines << QString("%1 - %2 MiB").arg(name.arg(usage.model->description().toHtmlEscaped())).arg(mib(usage.bytes));
+    }
+    statusMemoryLabel->setToolTip(lines.join("<br/>"));
+}
+
 void MainWindow::refresh()
 {
     // What the Refresh function does depends on the currently active tab. This way the keyboard shortcuts (F5 and Ctrl+R)
@@ -1531,6 +1612,7 @@ void MainWindow::executeQuery()
     // This means that if the tab is closed all these signals are automatically disconnected so the lambdas won't be called for a not
     // existing execution area.
     execute_sql_worker.reset(new RunSql(db, sql, execute_from_position, execute_to_position, true));
+    execute_sql_worker->setProfiler(sqlWidget->getProfiler());
 
     connect(execute_sql_worker.get(), &RunSql::statementErrored, sqlWidget, [query_logger, this, sqlWidget](const QString& status_message, int from_position, int to_position) {
         sqlWidget->getModel()->reset();
@@ -1582,6 +1664,14 @@ void MainWindow::executeQuery()
             execute_sql_worker->stop();
 
     }, Qt::BlockingQueuedConnection);
+    connect(execute_sql_worker.get(), &RunSql::confirmFullScan, sqlWidget, [this](const QString& table, qint64 rows) {
+        if(QMessageBox::warning(nullptr, QApplication::applicationName(),
+                                tr("This statement reads all %1 rows of the table '%2'. This can take a long time.\n"
+                                   "Are you sure you want to execute it?").arg(QLocale().toString(rows), table),
+                                QMessageBox::Yes,
+                                QMessageBox::No | QMessageBox::Default | QMessageBox::Escape) == QMessageBox::No)
+            execute_sql_worker->stop();
+    }, Qt::BlockingQueuedConnection);
     connect(execute_sql_worker.get(), &RunSql::finished, sqlWidget, [this, current_tab, sqlWidget]() {
         // We work with a pointer to the current tab here instead of its index because the user might reorder the tabs in the meantime
         ui->tabSqlAreas->setTabIcon(ui->tabSqlAreas->indexOf(current_tab), QIcon());
@@ -2038,6 +2128,7 @@ void MainWindow::activateFields(bool enable)
     ui->actionForeignKeyCheck->setEnabled(enable);
     ui->actionOptimize->setEnabled(enable);
     ui->actionClearFilters->setEnabled(enable);
+    ui->actionIndexAdvisor->setEnabled(enable);
     ui->actionSaveFilterAsPopup->setEnabled(enable);
     ui->dockEdit->setEnabled(enable);
     ui->dockPlot->setEnabled(enable);
@@ -3379,6 +3470,12 @@ void MainWindow::on_actionClearFilters_triggered()
     ui->dataTable->filterHeader()->clearFilters();
 }
 
+void MainWindow::on_actionIndexAdvisor_triggered()
+{
+    IndexAdvisorDialog dialog(db, m_browseTableModel->tableQuery(), ui->editLogUser->toPlainText(), this);
+    dialog.exec();
+}
+
 void MainWindow::copyCurrentCreateStatement()
 {
     // Cancel if no field is currently selected
@@ -8,6 +8,7 @@
 #include "sql/Query.h"
 
 #include <memory>
+#include <mutex>
 #include <QMainWindow>
 #include <QMap>
 
@@ -135,6 +136,7 @@ private:
     QMenu* popupBrowseDataHeaderMenu;
 
     QLabel* statusEncodingLabel;
+    QLabel* statusMemoryLabel;
     QLabel* statusEncryptionLabel;
     QLabel* statusReadOnlyLabel;
     QToolButton* statusStopButton;
@@ -142,11 +144,25 @@ private:
 
     DbStructureModel* dbStructureModel;
 
+    /// tables and views which have been added, changed or removed since the
+    /// auto completion was updated last. The schema can be updated from
+    /// other threads, so the changes are collected when they are reported
+    /// and applied in populateStructure().
+    struct SchemaChange
+    {
+        std::string schema;
+        sqlb::ObjectPtr object;
+        bool removed;
+    };
+    std::vector<SchemaChange> m_pendingSchemaChanges;
+    std::mutex m_pendingSchemaChangesMutex;
+
     static const int MaxRecentFiles = 5;
     QAction *recentFileActs[MaxRecentFiles];
     QAction *recentSeparatorAct;
 
     QMap<sqlb::ObjectIdentifier, BrowseDataTableSettings> browseTableSettings;
+    QMap<sqlb::ObjectIdentifier, int> browseTableScrollPositions;
 
     RemoteDatabase* m_remoteDb;
 
@@ -228,6 +244,7 @@ private slots:
     void navigateEnd();
     void navigateGoto();
     void setRecordsetLabel();
+    void updateMemoryUsageLabel();
     void createTable();
     void createIndex();
     void compact();
@@ -280,6 +297,7 @@ private slots:
     void editCondFormats(int column);
     void editEncryption();
     void on_actionClearFilters_triggered();
+    void on_actionIndexAdvisor_triggered();
     void copyCurrentCreateStatement();
     void showDataColumnPopupMenu(const QPoint& pos);
     void showRecordPopupMenu(const QPoint& pos);
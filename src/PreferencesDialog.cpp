@@ -82,6 +82,7 @@ void PreferencesDialog::loadSettings()
     ui->checkHideSchemaLinebreaks->setChecked(Settings::getValue("db", "hideschemalinebreaks").toBool());
     ui->foreignKeysCheckBox->setChecked(Settings::getValue("db", "foreignkeys").toBool());
     ui->spinPrefetchSize->setValue(Settings::getValue("db", "prefetchsize").toInt());
+    ui->spinCacheBudget->setValue(Settings::getValue("db", "cachebudget").toInt());
     ui->editDatabaseDefaultSqlText->setText(Settings::getValue("db", "defaultsqltext").toString());
 
     ui->defaultFieldTypeComboBox->addItems(DBBrowserDB::Datatypes);
@@ -186,6 +187,7 @@ void PreferencesDialog::loadSettings()
     ui->checkCompleteUpper->setChecked(Settings::getValue("editor", "upper_keywords").toBool());
     ui->checkErrorIndicators->setChecked(Settings::getValue("editor", "error_indicators").toBool());
     ui->checkHorizontalTiling->setChecked(Settings::getValue("editor", "horizontal_tiling").toBool());
+    ui->spinFullScanWarning->setValue(Settings::getValue("editor", "full_scan_warning").toInt());
 
     ui->listExtensions->addItems(Settings::getValue("extensions", "list").toStringList());
     ui->checkRegexDisabled->setChecked(Settings::getValue("extensions", "disableregex").toBool());
@@ -209,6 +211,7 @@ void PreferencesDialog::saveSettings()
     Settings::setValue("db", "hideschemalinebreaks", ui->checkHideSchemaLinebreaks->isChecked());
     Settings::setValue("db", "foreignkeys", ui->foreignKeysCheckBox->isChecked());
     Settings::setValue("db", "prefetchsize", ui->spinPrefetchSize->value());
+    Settings::setValue("db", "cachebudget", ui->spinCacheBudget->value());
     Settings::setValue("db", "defaultsqltext", ui->editDatabaseDefaultSqlText->text());
 
     Settings::setValue("db", "defaultfieldtype", ui->defaultFieldTypeComboBox->currentIndex());
@@ -248,6 +251,7 @@ void PreferencesDialog::saveSettings()
     Settings::setValue("editor", "upper_keywords", ui->checkCompleteUpper->isChecked());
     Settings::setValue("editor", "error_indicators", ui->checkErrorIndicators->isChecked());
     Settings::setValue("editor", "horizontal_tiling", ui->checkHorizontalTiling->isChecked());
+    Settings::setValue("editor", "full_scan_warning", ui->spinFullScanWarning->value());
 
     QStringList extList;
     for(const QListWidgetItem* item : ui->listExtensions->findItems(QString("*"), Qt::MatchWrap | Qt::MatchWildcard))
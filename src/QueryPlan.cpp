@@ -0,0 +1,233 @@
+#include "QueryPlan.h"
+#include "SqlCompletionIndex.h"
+#include "sqlite.h"
+#include "sql/ObjectIdentifier.h"
+
+#include <algorithm>
+#include <map>
+
+bool QueryPlanStep::isExpensive() const
+{
+    return (operation == Scan && !table.isEmpty()) || operation == TempBTree || automaticIndex;
+}
+
+bool QueryPlan::explain(sqlite3* db, const QString& statement, QString& error, const TableRows* table_rows)
+{
+    m_steps.clear();
+    error.clear();
+
+    const QByteArray sql = "EXPLAIN QUERY PLAN " + statement.toUtf8();
+    sqlite3_stmt* stmt;
+    if(sqlite3_prepare_v2(db, sql.constData(), sql.size(), &stmt, nullptr) != SQLITE_OK)
+    {
+        error = QString::fromUtf8(sqlite3_errmsg(db));
+        return false;
+    }
+    if(!stmt)
+        return true;
+
+    // Before SQLite 3.24 the plan isn't a tree. The first two columns hold the number of the subquery and the loop instead
+    // of the ids of the step and its parent.
+    const bool tree = sqlite3_libversion_number() >= 3024000;
+    int rc;
+    while((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        QueryPlanStep step = parseDetail(QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3))));
+        if(tree)
+        {
+            step.id = sqlite3_column_int(stmt, 0);
+            step.parent = sqlite3_column_int(stmt, 1);
+        } else {
+            step.id = static_cast<int>(m_steps.size()) + 1;
+        }
+        m_steps.push_back(step);
+    }
+    if(rc != SQLITE_DONE)
+        error = QString::fromUtf8(sqlite3_errmsg(db));
+    sqlite3_finalize(stmt);
+    if(!error.isEmpty())
+        return false;
+
+    // Look up the sizes of the scanned and searched tables
+    if(std::none_of(m_steps.begin(), m_steps.end(), [](const QueryPlanStep& step) { return !step.table.isEmpty(); }))
+        return true;
+
+    const auto references = SqlCompletionIndex::referencedTables(statement.toStdString(), 0);
+    TableRows own_table_rows;
+    if(!table_rows)
+    {
+        own_table_rows = analysedTableRows(db);
+        table_rows = &own_table_rows;
+    }
+    const TableRows& rows = *table_rows;
+    for(QueryPlanStep& step : m_steps)
+    {
+        if(step.table.isEmpty())
+            continue;
+
+        // Since SQLite 3.36 the plan shows the alias instead of the table name if there is one
+        for(const auto& reference : references)
+        {
+            if(!reference.alias.empty() && QString::fromStdString(reference.alias).compare(step.table, Qt::CaseInsensitive) == 0)
+            {
+                step.table = QString::fromStdString(reference.table);
+                break;
+            }
+        }
+
+        auto it = rows.find(step.table.toLower());
+        if(it == rows.end() && step.table.contains('.'))
+        {
+            // The schema name is included if the statement mentions it
+            step.table = step.table.mid(step.table.indexOf('.') + 1);
+            it = rows.find(step.table.toLower());
+        }
+        if(it != rows.end())
+            step.tableRows = it->second;
+    }
+
+    return true;
+}
+
+QueryPlan::TableRows QueryPlan::analysedTableRows(sqlite3* db)
+{
+    // The first number of each stat value is the number of rows in the table, except for partial indexes which cover fewer rows
+    TableRows rows;
+
+    std::vector<std::string> schemata;
+    sqlite3_stmt* stmt;
+    if(sqlite3_prepare_v2(db, "PRAGMA database_list;", -1, &stmt, nullptr) == SQLITE_OK)
+    {
+        while(sqlite3_step(stmt) == SQLITE_ROW)
+            schemata.emplace_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)));
+        sqlite3_finalize(stmt);
+    }
+
+    for(const std::string& schema : schemata)
+    {
+        // This fails if the schema hasn't been analysed, so just skip it then
+        const std::string sql = "SELECT tbl, max(CAST(stat AS INTEGER)) FROM " + sqlb::escapeIdentifier(schema) + ".sqlite_stat1 GROUP BY tbl;";
+        if(sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+            continue;
+
+        while(sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            const QString table = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0))).toLower();
+            const qint64 count = sqlite3_column_int64(stmt, 1);
+            auto it = rows.find(table);
+            if(it == rows.end())
+                rows.emplace(table, count);
+            else
+                it->second = std::max(it->second, count);
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    return rows;
+}
+
+const QueryPlanStep* QueryPlan::largestScan() const
+{
+    const QueryPlanStep* largest = nullptr;
+    for(const QueryPlanStep& step : m_steps)
+    {
+        if(step.operation == QueryPlanStep::Scan && step.tableRows >= 0 && (!largest || step.tableRows > largest->tableRows))
+            largest = &step;
+    }
+    return largest;
+}
+
+QueryPlanStep QueryPlan::parseDetail(const QString& detail)
+{
+    QueryPlanStep step;
+    step.detail = detail;
+
+    QString rest;
+    if(detail.startsWith("SCAN "))
+    {
+        step.operation = QueryPlanStep::Scan;
+        rest = detail.mid(5);
+    } else if(detail.startsWith("SEARCH ")) {
+        step.operation = QueryPlanStep::Search;
+        rest = detail.mid(7);
+    } else {
+        if(detail.startsWith("USE TEMP B-TREE"))
+            step.operation = QueryPlanStep::TempBTree;
+        return step;
+    }
+
+    // Before SQLite 3.36 the word TABLE precedes the table name
+    if(rest.startsWith("TABLE "))
+        rest = rest.mid(6);
+
+    // Subqueries and constant rows aren't tables
+    if(rest.startsWith("SUBQUERY ") || rest.startsWith("CONSTANT ROW") || rest.startsWith("("))
+        return step;
+
+    // Table names aren't quoted, so look for the end of the name instead of splitting the text at the first space
+    int end = rest.size();
+    for(const char* marker : {" AS ", " USING ", " VIRTUAL TABLE "})
+    {
+        const int pos = rest.indexOf(marker);
+        if(pos != -1 && pos < end)
+            end = pos;
+    }
+    step.table = rest.left(end);
+
+    const int using_pos = rest.indexOf(" USING ", end);
+    if(using_pos == -1)
+        return step;
+    QString index = rest.mid(using_pos + 7);
+
+    if(index.startsWith("AUTOMATIC "))
+    {
+        step.automaticIndex = true;
+        step.coveringIndex = index.contains("COVERING INDEX");
+        return step;
+    }
+    if(index.startsWith("COVERING INDEX "))
+    {
+        step.coveringIndex = true;
+        index = index.mid(15);
+    } else if(index.startsWith("INDEX ")) {
+        index = index.mid(6);
+    } else {
+        // INTEGER PRIMARY KEY or PRIMARY KEY
+        return step;
+    }
+
+    // The constraints used for searching the index follow in parentheses
+    const int constraints = index.indexOf(" (");
+    step.index = constraints == -1 ? index : index.left(constraints);
+
+    return step;
+}
+
+bool QueryPlan::statementAt(const QByteArray& sql, int position, int& from, int& to)
+{
+    // Split the text at the semicolons which end a statement. sqlite3_complete() takes care of semicolons in strings,
+    // comments and trigger bodies.
+    int start = 0;
+    for(int i=0;i<sql.size();i++)
+    {
+        if(sql.at(i) != ';')
+            continue;
+
+        const QByteArray statement = sql.mid(start, i - start + 1);
+        if(!sqlite3_complete(statement.constData()))
+            continue;
+
+        if(position <= i + 1)
+        {
+            from = start;
+            to = i + 1;
+            return !statement.left(statement.size() - 1).trimmed().isEmpty();
+        }
+        start = i + 1;
+    }
+
+    // The last statement doesn't need to end with a semicolon
+    from = start;
+    to = sql.size();
+    return !sql.mid(start).trimmed().isEmpty();
+}
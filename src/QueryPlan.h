@@ -0,0 +1,83 @@
+#ifndef QUERYPLAN_H
+#define QUERYPLAN_H
+
+#include <QString>
+
+#include <map>
+#include <vector>
+
+struct sqlite3;
+
+/// One line of the output of EXPLAIN QUERY PLAN
+struct QueryPlanStep
+{
+    enum Operation
+    {
+        Scan,
+        Search,
+        TempBTree,
+        Other,
+    };
+
+    int id = 0;
+    int parent = 0;                 // Id of the parent step or 0 for top-level steps
+    QString detail;                 // The text as reported by SQLite
+    Operation operation = Other;
+    QString table;                  // Table which is scanned or searched. Empty for subqueries, views and other steps
+    QString index;                  // Name of the index used by a scan or search. Empty if none or for automatic indexes
+    bool automaticIndex = false;    // Search using an index which SQLite builds for this statement only
+    bool coveringIndex = false;
+    qint64 tableRows = -1;          // Number of rows of the table according to sqlite_stat1 or -1 if unknown
+
+    /// \returns true for full table scans, temporary B-trees and automatic indexes
+    bool isExpensive() const;
+};
+
+/**
+ * @brief The QueryPlan class
+ * Runs EXPLAIN QUERY PLAN for a statement and breaks down the steps reported by SQLite, so the expensive ones can be
+ * pointed out to the user. The sizes of the scanned tables are taken from the statistics which ANALYZE writes to
+ * sqlite_stat1. Counting the rows instead would mean doing the very full scan we are trying to warn about.
+ */
+class QueryPlan
+{
+public:
+    /// Number of rows per table as recorded in sqlite_stat1. The keys are the table names in lower case.
+    using TableRows = std::map<QString, qint64>;
+
+    /**
+     * @brief explain Gets the query plan of a statement
+     * @param db The connection to use. The statement isn't executed.
+     * @param statement The statement to explain. Only the first statement is used if there are more.
+     * @param error Set to the error message of SQLite if the statement couldn't be prepared
+     * @param table_rows The table sizes as returned by analysedTableRows(). If this is nullptr they are read from the database
+     * @return false on error
+     */
+    bool explain(sqlite3* db, const QString& statement, QString& error, const TableRows* table_rows = nullptr);
+
+    /// \returns the number of rows of each table in all schemata as recorded by ANALYZE. Tables which haven't been analysed are missing.
+    static TableRows analysedTableRows(sqlite3* db);
+
+    const std::vector<QueryPlanStep>& steps() const { return m_steps; }
+
+    /// \returns the full table scan with the most rows or nullptr if no table of known size is scanned
+    const QueryPlanStep* largestScan() const;
+
+    /// Breaks down the detail text of one line of the query plan
+    static QueryPlanStep parseDetail(const QString& detail);
+
+    /**
+     * @brief statementAt Finds the statement surrounding a position
+     * @param sql UTF-8 encoded SQL text possibly holding several statements
+     * @param position Byte position in sql. A position right after a semicolon belongs to the statement ended by it.
+     * @param from Set to the first byte of the statement
+     * @param to Set to the byte after the end of the statement, including its semicolon
+     * @return false if there is only whitespace at the position
+     */
+    static bool statementAt(const QByteArray& sql, int position, int& from, int& to);
+
+private:
+    std::vector<QueryPlanStep> m_steps;
+};
+
+#endif
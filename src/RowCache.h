@@ -54,9 +54,19 @@ public:
     /// delete element; decreases numSet() by one
     void erase (size_t pos);
 
+    /// delete all elements in the given range (end is exclusive) and
+    /// pull forward all later elements; decreases numSet() by the
+    /// number of elements which were set in that range
+    void erase (size_t pos_begin, size_t pos_end);
+
     /// reset to state after construction
     void clear ();
 
+    /// calls \param f with the position and a reference to each cached
+    /// row, in order of increasing position
+    template <typename F>
+    void forEach (F f);
+
     /// given a range of rows (end is exclusive), narrow it in order
     /// to remove already-loaded rows from both ends.
     void smallestNonAvailableRange (size_t & row_begin, size_t & row_end) const;
@@ -231,12 +241,70 @@ void RowCache<T>::erase (size_t pos)
     std::for_each(it, segments.end(), [](Segment &s){ s.pos_begin--; });
 }
 
+template <typename T>
+void RowCache<T>::erase (size_t pos_begin, size_t pos_end)
+{
+    if(pos_end < pos_begin)
+        throw std::invalid_argument("end must be >= begin");
+
+    const size_t count = pos_end - pos_begin;
+    if(count == 0)
+        return;
+
+    Segments result;
+    result.reserve(segments.size() + 1);
+    for(auto & s : segments)
+    {
+        if(s.pos_end() > pos_begin)
+        {
+            if(s.pos_begin >= pos_end)
+            {
+                // segment after the range: pull forward
+                s.pos_begin -= count;
+            } else {
+                // segment overlapping the range: cut out the erased entries. The
+                // remaining entries after the range now start at pos_begin.
+                auto cut_begin = std::max(pos_begin, s.pos_begin) - s.pos_begin;
+                auto cut_end = std::min(pos_end, s.pos_end()) - s.pos_begin;
+                s.entries.erase(s.entries.begin() + static_cast<std::ptrdiff_t>(cut_begin),
+                                s.entries.begin() + static_cast<std::ptrdiff_t>(cut_end));
+                s.pos_begin = std::min(s.pos_begin, pos_begin);
+                if(s.entries.empty())
+                    continue;
+            }
+        }
+
+        // join segments which became adjacent
+        if(!result.empty() && result.back().pos_end() == s.pos_begin)
+        {
+            result.back().entries.insert(result.back().entries.end(),
+                                         std::make_move_iterator(s.entries.begin()),
+                                         std::make_move_iterator(s.entries.end()));
+        } else {
+            result.push_back(std::move(s));
+        }
+    }
+
+    segments = std::move(result);
+}
+
 template <typename T>
 void RowCache<T>::clear ()
 {
     segments.clear();
 }
 
+template <typename T>
+template <typename F>
+void RowCache<T>::forEach (F f)
+{
+    for(auto & s : segments)
+    {
+        for(size_t i = 0; i < s.entries.size(); i++)
+            f(s.pos_begin + i, s.entries[i]);
+    }
+}
+
 template <typename T>
 void RowCache<T>::smallestNonAvailableRange (size_t & row_begin, size_t & row_end) const
 {
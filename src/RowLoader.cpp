@@ -1,7 +1,11 @@
 #include <QDebug>
+#include <numeric>
+#include <unordered_set>
 
 #include "RowLoader.h"
 #include "sqlite.h"
+#include "sql/Query.h"
+#include "StatementProfiler.h"
 
 namespace {
 
@@ -13,6 +17,39 @@ namespace {
         return r;
     }
 
+    // Gets the names of the aggregate and window functions of the connection. Returns false if they can't be listed, e.g. because
+    // the SQLite version doesn't support PRAGMA function_list yet.
+    bool aggregateFunctions(sqlite3* db, std::unordered_set<std::string>& names)
+    {
+        sqlite3_stmt* stmt;
+        if(sqlite3_prepare_v2(db, "PRAGMA function_list;", -1, &stmt, nullptr) != SQLITE_OK)
+            return false;
+
+        // Unknown pragmas are silently ignored, so there are no rows if the pragma isn't supported
+        bool listed = false;
+        while(sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_count(stmt) >= 3)
+        {
+            listed = true;
+            const QString type = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2)));
+            if(type == "a" || type == "w")
+                names.insert(QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0))).toLower().toStdString());
+        }
+        sqlite3_finalize(stmt);
+        return listed;
+    }
+
+    CellType cellType(int sqlite_type)
+    {
+        switch(sqlite_type)
+        {
+        case SQLITE_INTEGER: return CellType::Integer;
+        case SQLITE_FLOAT: return CellType::Float;
+        case SQLITE_TEXT: return CellType::Text;
+        case SQLITE_BLOB: return CellType::Blob;
+        default: return CellType::Null;
+        }
+    }
+
 } // anon ns
 
 
@@ -21,12 +58,16 @@ RowLoader::RowLoader (
     std::function<void(QString)> statement_logger_,
     std::vector<std::string> & headers_,
     QMutex & cache_mutex_,
-    Cache & cache_data_
+    Cache & cache_data_,
+    size_t & cache_bytes_,
+    const CellFormatter & formatter_
     )
     : db_getter(db_getter_), statement_logger(statement_logger_), headers(headers_)
-    , cache_mutex(cache_mutex_), cache_data(cache_data_)
+    , cache_mutex(cache_mutex_), cache_data(cache_data_), cache_bytes(cache_bytes_), formatter(formatter_)
     , query()
     , countQuery()
+    , num_rowid_columns(1)
+    , profiler(nullptr)
     , num_tasks(0)
     , pDb(nullptr)
     , stop_requested(false)
@@ -35,15 +76,19 @@ RowLoader::RowLoader (
 {
 }
 
-void RowLoader::setQuery (const QString& new_query, const QString& newCountQuery)
+void RowLoader::setQuery (const QString& new_query, const QString& newCountQuery, size_t num_rowid_columns_)
 {
     std::lock_guard<std::mutex> lk(m);
     query = new_query;
-    if (newCountQuery.isEmpty())
-        // If it is a normal query - hopefully starting with SELECT - just do a COUNT on it and return the results
-        countQuery = QString("SELECT COUNT(*) FROM (%1);").arg(rtrimChar(query, ';'));
-    else
-        countQuery = newCountQuery;
+    num_rowid_columns = std::max(num_rowid_columns_, size_t(1));
+
+    // If no count query is given, it is built from the query once the connection is available. See countRows().
+    countQuery = newCountQuery;
+}
+
+void RowLoader::setProfiler(StatementProfiler* profiler_)
+{
+    profiler = profiler_;
 }
 
 void RowLoader::triggerRowCountDetermination(int token)
@@ -80,6 +125,8 @@ int RowLoader::countRows()
 {
     int retval = -1;
 
+    StatementProfiler::Scope profiling(profiler, tr("Count rows"));
+
     // Use a different approach of determining the row count when a EXPLAIN or a PRAGMA statement is used because a COUNT fails on these queries
     if(query.startsWith("EXPLAIN", Qt::CaseInsensitive) || query.startsWith("PRAGMA", Qt::CaseInsensitive))
     {
@@ -95,8 +142,22 @@ int RowLoader::countRows()
             return retval;
         }
     } else {
-        statement_logger(countQuery);
-        QByteArray utf8Query = countQuery.toUtf8();
+        // If it is a normal query - hopefully starting with SELECT - just do a COUNT on it and return the results. Leave out
+        // everything which isn't needed for counting, like the sorting of the rows. Whether the result columns can be left out
+        // too depends on the aggregate functions which are known to this connection.
+        std::unique_lock<std::mutex> lk(m);
+        QString count_query = countQuery;
+        const QString select = query;
+        lk.unlock();
+        if(count_query.isEmpty())
+        {
+            std::unordered_set<std::string> aggregates;
+            const bool known = aggregateFunctions(pDb.get(), aggregates);
+            count_query = QString::fromStdString(sqlb::Query::buildCountQuery(rtrimChar(select, ';').toStdString(), known ? &aggregates : nullptr));
+        }
+
+        statement_logger(count_query);
+        QByteArray utf8Query = count_query.toUtf8();
 
         sqlite3_stmt* stmt;
         int status = sqlite3_prepare_v2(pDb.get(), utf8Query, utf8Query.size(), &stmt, nullptr);
@@ -110,14 +171,14 @@ int RowLoader::countRows()
             }
             sqlite3_finalize(stmt);
         } else {
-            qWarning() << "Count query failed: " << countQuery;
+            qWarning() << "Count query failed: " << count_query;
         }
     }
 
     return retval;
 }
 
-void RowLoader::triggerFetch (int token, size_t row_begin, size_t row_end)
+void RowLoader::triggerFetch (int token, size_t row_begin, size_t row_end, const QString& projected_query, const std::vector<size_t>& columns)
 {
     std::unique_lock<std::mutex> lk(m);
 
@@ -134,7 +195,7 @@ void RowLoader::triggerFetch (int token, size_t row_begin, size_t row_end)
     nosync_ensureDbAccess();
 
     // (forget a possibly already existing "next task")
-    next_task.reset(new Task{ *this, token, row_begin, row_end });
+    next_task.reset(new Task{ *this, token, row_begin, row_end, projected_query, columns });
 
     lk.unlock();
     cv.notify_all();
@@ -205,13 +266,15 @@ void RowLoader::run ()
 
 void RowLoader::process (Task & t)
 {
+    const QString& task_query = t.query.isEmpty() ? query : t.query;
+
     QString sLimitQuery;
-    if(query.startsWith("PRAGMA", Qt::CaseInsensitive) || query.startsWith("EXPLAIN", Qt::CaseInsensitive))
+    if(task_query.startsWith("PRAGMA", Qt::CaseInsensitive) || task_query.startsWith("EXPLAIN", Qt::CaseInsensitive))
     {
-        sLimitQuery = query;
+        sLimitQuery = task_query;
     } else {
         // Remove trailing trailing semicolon
-        QString queryTemp = rtrimChar(query, ';');
+        QString queryTemp = rtrimChar(task_query, ';');
 
         // If the query ends with a LIMIT statement take it as it is, if not append our own LIMIT part for lazy population
         if(queryTemp.contains(QRegExp("LIMIT\\s+.+\\s*((,|\\b(OFFSET)\\b)\\s*.+\\s*)?$", Qt::CaseInsensitive)))
@@ -221,6 +284,8 @@ void RowLoader::process (Task & t)
     }
     statement_logger(sLimitQuery);
 
+    StatementProfiler::Scope profiling(profiler, tr("Fetch rows"));
+
     QByteArray utf8Query = sLimitQuery.toUtf8();
     sqlite3_stmt *stmt;
 
@@ -230,16 +295,43 @@ void RowLoader::process (Task & t)
 
     if(SQLITE_OK == status)
     {
-        const int num_columns = static_cast<int>(headers.size());
+        const size_t num_columns = headers.size();
+
+        // Map the columns of the result set to the columns of the cache. For a projected query this is the rowid column
+        // followed by the requested columns. Otherwise it's simply all columns.
+        std::vector<size_t> column_map;
+        if(t.columns.empty())
+        {
+            column_map.resize(num_columns);
+            std::iota(column_map.begin(), column_map.end(), 0);
+        } else {
+            column_map.push_back(0);
+            column_map.insert(column_map.end(), t.columns.begin(), t.columns.end());
+        }
+
+        // When there are multiple rowid columns, they come first in the result set and need to be combined into one value
+        const size_t extra_rowid_columns = num_rowid_columns - 1;
+        const int num_result_columns = static_cast<int>(column_map.size() + extra_rowid_columns);
+
+        // The display texts are prepared without holding the lock, so the GUI thread isn't kept waiting for them. The formatter
+        // might be changed at any time though, so use a copy of it and check that it's still the current one when storing a row.
+        CellFormatter row_formatter;
+        {
+            QMutexLocker lk(&cache_mutex);
+            row_formatter = formatter;
+        }
 
         while(!t.cancel && sqlite3_step(stmt) == SQLITE_ROW)
         {
-            // Construct a new row object with the right number of columns
-            Cache::value_type rowdata(static_cast<size_t>(num_columns));
-            for(int i=0;i<num_columns;++i)
+            // Construct a new row object with the right number of columns. Also remember the storage class of each value.
+            std::vector<QByteArray> rowdata(static_cast<size_t>(num_result_columns));
+            std::vector<CellType> types(static_cast<size_t>(num_result_columns));
+            for(int i=0;i<num_result_columns;++i)
             {
                 // No need to do anything for NULL values because we can just use the already default constructed value
-                if(sqlite3_column_type(stmt, i) != SQLITE_NULL)
+                const int type = sqlite3_column_type(stmt, i);
+                types[static_cast<size_t>(i)] = cellType(type);
+                if(type != SQLITE_NULL)
                 {
                     int bytes = sqlite3_column_bytes(stmt, i);
                     if(bytes)
@@ -248,8 +340,59 @@ void RowLoader::process (Task & t)
                         rowdata[static_cast<size_t>(i)] = "";
                 }
             }
+
+            if(extra_rowid_columns)
+            {
+                // The text SQLite returns for floating point values is rounded, so get the exact values for the rowid
+                const auto rowid_end = static_cast<std::ptrdiff_t>(num_rowid_columns);
+                std::vector<QByteArray> rowid_values(rowdata.begin(), rowdata.begin() + rowid_end);
+                for(size_t i=0;i<num_rowid_columns;i++)
+                {
+                    if(types[i] == CellType::Float)
+                        rowid_values[i] = QByteArray::number(sqlite3_column_double(stmt, static_cast<int>(i)), 'g', 17);
+                }
+                rowdata[0] = makeCompositeRowid(rowid_values, std::vector<CellType>(types.begin(), types.begin() + rowid_end));
+                types[0] = CellType::Text;
+                rowdata.erase(rowdata.begin() + 1, rowdata.begin() + rowid_end);
+                types.erase(types.begin() + 1, types.begin() + rowid_end);
+            }
+
+            CachedRow new_row;
+            if(t.columns.empty())
+            {
+                new_row = CachedRow(std::move(rowdata), types, row_formatter);
+            } else {
+                new_row = CachedRow::unloaded(num_columns);
+                for(size_t i=0;i<column_map.size();++i)
+                    new_row.set(column_map[i], std::move(rowdata[i]), types[i], row_formatter);
+            }
+
             QMutexLocker lk(&cache_mutex);
-            cache_data.set(row++, std::move(rowdata));
+            if(row_formatter != formatter)
+            {
+                row_formatter = formatter;
+                new_row.reformat(row_formatter);
+            }
+
+            if(cache_data.count(row))
+            {
+                // Merge the fetched cells of a projected query into the row if it has already been cached before. If the row at
+                // this position belongs to another record by now, e.g. because the data has been changed in the meantime, its
+                // other cells are outdated. So replace it by the new row of which only the fetched cells are loaded. The remaining
+                // cells are fetched again when they are needed. A NULL rowid doesn't identify any record, so it never matches.
+                CachedRow& cached_row = cache_data.at(row);
+                cache_bytes -= cached_row.memoryUsage();
+                if(!t.columns.empty() && cached_row.isLoaded(0) && types[0] != CellType::Null && cached_row.at(0) == new_row.at(0))
+                {
+                    for(size_t column : column_map)
+                        cached_row.take(column, new_row);
+                    cache_bytes += cached_row.memoryUsage();
+                    row++;
+                    continue;
+                }
+            }
+            cache_bytes += new_row.memoryUsage();
+            cache_data.set(row++, std::move(new_row));
         }
 
         sqlite3_finalize(stmt);
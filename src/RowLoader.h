@@ -14,8 +14,10 @@
 #include <QMutex>
 
 #include "RowCache.h"
+#include "CachedRow.h"
 
 struct sqlite3;
+class StatementProfiler;
 
 class RowLoader : public QThread
 {
@@ -24,28 +26,46 @@ class RowLoader : public QThread
     void run() override;
 
 public:
-    using Cache = RowCache<std::vector<QByteArray>>;
+    using Cache = RowCache<CachedRow>;
 
-    /// set up worker thread to handle row loading
+    /// set up worker thread to handle row loading. The \param formatter
+    /// is used for preparing the display texts of the fetched cells and,
+    /// like the cache, is protected by \param cache_mutex. So is
+    /// \param cache_bytes which is kept up to date with the memory usage
+    /// of the cached rows.
     explicit RowLoader (
         std::function<std::shared_ptr<sqlite3>(void)> db_getter,
         std::function<void(QString)> statement_logger,
         std::vector<std::string> & headers,
         QMutex & cache_mutex,
-        Cache & cache_data
+        Cache & cache_data,
+        size_t & cache_bytes,
+        const CellFormatter & formatter
         );
 
-    void setQuery (const QString& new_query, const QString& newCountQuery = QString());
+    /// \param num_rowid_columns is the number of leading result columns
+    /// which make up the rowid. If there is more than one, their values
+    /// are combined into the first column of the cache.
+    void setQuery (const QString& new_query, const QString& newCountQuery = QString(), size_t num_rowid_columns = 1);
 
     void triggerRowCountDetermination (int token);
 
+    /// record the statements executed for fetching rows and counting
+    /// them in \param profiler, which may be nullptr
+    void setProfiler (StatementProfiler* profiler);
+
     /// trigger asynchronous reading of specified row range,
     /// cancelling previous tasks; 'row_end' is exclusive; \param
     /// token is eventually returned through the 'fetched'
     /// signal. depending on how and when tasks are cancelled, not
     /// every triggerFetch() will result in a 'fetched' signal, or the
     /// 'fetched' signal may be for a narrower row range.
-    void triggerFetch (int token, size_t row_begin, size_t row_end);
+    /// \param projected_query if set, this query is used instead of the
+    /// one passed to setQuery(); it must select the rowid column(s)
+    /// followed by the given \param columns only (excluding column 0).
+    /// The fetched cells are merged into rows which are already cached.
+    void triggerFetch (int token, size_t row_begin, size_t row_end,
+                       const QString& projected_query = QString(), const std::vector<size_t>& columns = {});
 
     /// cancel everything
     void cancel ();
@@ -73,12 +93,17 @@ private:
     std::vector<std::string> & headers;
     QMutex & cache_mutex;
     Cache & cache_data;
+    size_t & cache_bytes;
+    const CellFormatter & formatter;
 
     mutable std::mutex m;
     mutable std::condition_variable cv;
 
     QString query;
     QString countQuery;
+    size_t num_rowid_columns;
+
+    std::atomic<StatementProfiler*> profiler;
 
     mutable std::future<void> row_counter;
 
@@ -93,10 +118,12 @@ private:
         int token;
         size_t row_begin;
         size_t row_end; //< exclusive
+        QString query; //< empty for the full query
+        std::vector<size_t> columns; //< cache columns of the result columns after the rowid; empty for all
         std::atomic<bool> cancel;
 
-        Task(RowLoader & row_loader_, int t, size_t a, size_t b)
-            : row_loader(row_loader_), token(t), row_begin(a), row_end(b), cancel(false)
+        Task(RowLoader & row_loader_, int t, size_t a, size_t b, const QString& q, const std::vector<size_t>& c)
+            : row_loader(row_loader_), token(t), row_begin(a), row_end(b), query(q), columns(c), cancel(false)
         {
             row_loader.num_tasks++;
         }
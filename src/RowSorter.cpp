@@ -0,0 +1,175 @@
+#include "RowSorter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <thread>
+
+namespace {
+
+    // Below this number of rows per thread it's not worth starting extra threads
+    const size_t MinRowsPerThread = 20000;
+
+    // The sort key of a single cell. Numbers are parsed once here instead of every time two cells are compared.
+    struct SortKey
+    {
+        CellType type;
+        qint64 integer;
+        double real;
+        const QByteArray* bytes;
+    };
+
+    int typeRank(CellType type)
+    {
+        switch(type)
+        {
+        case CellType::Null: return 0;
+        case CellType::Integer:
+        case CellType::Float: return 1;
+        case CellType::Text: return 2;
+        case CellType::Blob: return 3;
+        }
+        return 0;
+    }
+
+    // Compares an integer to a floating point number without converting the integer to double first, which would lose
+    // precision for large values. This follows sqlite3IntFloatCompare().
+    int compareIntFloat(qint64 i, double r)
+    {
+        if(r < -9223372036854775808.0)
+            return 1;
+        if(r >= 9223372036854775808.0)
+            return -1;
+        const qint64 y = static_cast<qint64>(r);
+        if(i != y)
+            return i < y ? -1 : 1;
+        const double s = static_cast<double>(i);
+        return s < r ? -1 : (s > r ? 1 : 0);
+    }
+
+    int compareKeys(const SortKey& a, const SortKey& b)
+    {
+        const int rank_a = typeRank(a.type);
+        const int rank_b = typeRank(b.type);
+        if(rank_a != rank_b)
+            return rank_a < rank_b ? -1 : 1;
+
+        switch(rank_a)
+        {
+        case 0:
+            return 0;
+        case 1:
+            if(a.type == CellType::Integer && b.type == CellType::Integer)
+                return a.integer < b.integer ? -1 : (a.integer > b.integer ? 1 : 0);
+            if(a.type == CellType::Integer)
+                return compareIntFloat(a.integer, b.real);
+            if(b.type == CellType::Integer)
+                return -compareIntFloat(b.integer, a.real);
+            return a.real < b.real ? -1 : (a.real > b.real ? 1 : 0);
+        default:
+        {
+            // The BINARY collation simply compares the bytes
+            const int size_a = a.bytes->size();
+            const int size_b = b.bytes->size();
+            const int result = std::memcmp(a.bytes->constData(), b.bytes->constData(), static_cast<size_t>(std::min(size_a, size_b)));
+            if(result)
+                return result;
+            return size_a < size_b ? -1 : (size_a > size_b ? 1 : 0);
+        }
+        }
+    }
+
+} // anon ns
+
+RowSorter::RowSorter(const std::vector<sqlb::SortedColumn>& columns)
+    : m_columns(columns)
+{
+}
+
+std::vector<size_t> RowSorter::sort(const std::vector<const CachedRow*>& rows) const
+{
+    const size_t num_keys = m_columns.size();
+
+    // Prepare the sort keys of all rows
+    std::vector<SortKey> keys(rows.size() * num_keys);
+    for(size_t row=0;row<rows.size();row++)
+    {
+        for(size_t i=0;i<num_keys;i++)
+        {
+            const size_t column = m_columns[i].column;
+            SortKey& key = keys[row * num_keys + i];
+            key.type = rows[row]->type(column);
+            key.bytes = &rows[row]->at(column);
+            key.integer = 0;
+            key.real = 0.0;
+            if(key.type == CellType::Integer)
+            {
+                key.integer = key.bytes->toLongLong();
+            } else if(key.type == CellType::Float) {
+                key.real = key.bytes->toDouble();
+            }
+        }
+    }
+
+    const auto less = [this, &keys, num_keys](size_t a, size_t b) {
+        for(size_t i=0;i<num_keys;i++)
+        {
+            const int result = compareKeys(keys[a * num_keys + i], keys[b * num_keys + i]);
+            if(result)
+                return m_columns[i].direction == sqlb::Ascending ? result < 0 : result > 0;
+        }
+        return false;
+    };
+
+    std::vector<size_t> order(rows.size());
+    std::iota(order.begin(), order.end(), 0);
+
+    size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+    num_threads = std::min(num_threads, rows.size() / MinRowsPerThread);
+    if(num_threads <= 1)
+    {
+        std::stable_sort(order.begin(), order.end(), less);
+        return order;
+    }
+
+    // Sort a chunk of the rows in each thread
+    std::vector<size_t> bounds;
+    for(size_t i=0;i<num_threads;i++)
+        bounds.push_back(rows.size() * i / num_threads);
+    bounds.push_back(rows.size());
+
+    std::vector<std::thread> threads;
+    for(size_t i=0;i+1<bounds.size();i++)
+    {
+        threads.emplace_back([&order, &less, &bounds, i]() {
+            std::stable_sort(order.begin() + static_cast<std::ptrdiff_t>(bounds[i]), order.begin() + static_cast<std::ptrdiff_t>(bounds[i+1]), less);
+        });
+    }
+    for(auto& t : threads)
+        t.join();
+
+    // Merge neighbouring chunks until only one is left. The merges of each round are independent of each other, so they run in parallel, too.
+    while(bounds.size() > 2)
+    {
+        threads.clear();
+        std::vector<size_t> merged_bounds;
+        for(size_t i=0;i+1<bounds.size();i+=2)
+        {
+            merged_bounds.push_back(bounds[i]);
+            if(i + 2 < bounds.size())
+            {
+                threads.emplace_back([&order, &less, &bounds, i]() {
+                    std::inplace_merge(order.begin() + static_cast<std::ptrdiff_t>(bounds[i]),
+                                       order.begin() + static_cast<std::ptrdiff_t>(bounds[i+1]),
+                                       order.begin() + static_cast<std::ptrdiff_t>(bounds[i+2]), less);
+                });
+            }
+        }
+        merged_bounds.push_back(rows.size());
+        for(auto& t : threads)
+            t.join();
+        bounds = std::move(merged_bounds);
+    }
+
+    return order;
+}
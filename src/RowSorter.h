@@ -0,0 +1,36 @@
+#ifndef ROW_SORTER_H
+#define ROW_SORTER_H
+
+#include <vector>
+
+#include "CachedRow.h"
+#include "sql/Query.h"
+
+/**
+
+   sorts rows which are completely available in the cache of
+   SqliteTableModel without running the query again.
+
+   values are ordered the same way SQLite orders them when using the
+   BINARY collation: NULL values first, followed by numbers, text and
+   blobs. The sort is stable, i.e. rows which compare equal keep their
+   current order.
+
+   large inputs are split into chunks which are sorted in parallel and
+   merged afterwards.
+
+**/
+class RowSorter
+{
+public:
+    explicit RowSorter(const std::vector<sqlb::SortedColumn>& columns);
+
+    /// \returns the positions of \param rows in sorted order. All sort
+    /// columns must be loaded in each of the rows.
+    std::vector<size_t> sort(const std::vector<const CachedRow*>& rows) const;
+
+private:
+    std::vector<sqlb::SortedColumn> m_columns;
+};
+
+#endif
@@ -2,6 +2,8 @@
 #include "sqlite.h"
 #include "sqlitedb.h"
 #include "sqlitetablemodel.h"
+#include "StatementProfiler.h"
+#include "Settings.h"
 
 #include <chrono>
 #include <QApplication>
@@ -9,10 +11,12 @@
 
 RunSql::RunSql(DBBrowserDB& _db, QString query, int execute_from_position, int _execute_to_position, bool _interrupt_after_statements) :
     db(_db),
+    profiler(nullptr),
     may_continue_with_execution(true),
     interrupt_after_statements(_interrupt_after_statements),
     execute_current_position(execute_from_position),
     execute_to_position(_execute_to_position),
+    full_scan_warning_rows(Settings::getValue("editor", "full_scan_warning").toLongLong()),
     structure_updated(false),
     savepoint_created(false),
     was_dirty(db.getDirty()),
@@ -42,10 +46,13 @@ RunSql::RunSql(DBBrowserDB& _db, QString query, int execute_from_position, int _
 void RunSql::run()
 {
     // Execute statement by statement
-    for(;;)
     {
-        if(!executeNextStatement())
-            break;
+        StatementProfiler::Scope profiling(profiler, tr("Execute SQL"));
+        for(;;)
+        {
+            if(!executeNextStatement())
+                break;
+        }
     }
 
     // Execution finished
@@ -152,6 +159,15 @@ bool RunSql::executeNextStatement()
     tail_length -= static_cast<int>(tail - qbegin);
     int end_of_current_statement_position = execute_current_position + tail_length_before - tail_length;
 
+    // Look at the query plan and ask the user before doing a full scan of a large table
+    if(sql3status == SQLITE_OK && vm && !confirmStatement(queryPart, query_type))
+    {
+        sqlite3_finalize(vm);
+        releaseDbAccess();
+        emit statementErrored(tr("Execution aborted by user"), execute_current_position, end_of_current_statement_position);
+        return false;
+    }
+
     // Save remaining statements
     lk.lock();
     queries_left_to_execute = QByteArray(tail);
@@ -268,6 +284,53 @@ bool RunSql::executeNextStatement()
     return true;
 }
 
+bool RunSql::confirmStatement(const QString& statement, StatementType type)
+{
+    if(full_scan_warning_rows <= 0)
+        return true;
+
+    // Only some statements can scan a table at all. Don't explain the others, this would slow down scripts with lots of
+    // INSERT statements for example. INSERT and REPLACE statements only scan a table when they insert the results of a query
+    // and other statements only when they start with a common table expression.
+    switch(type)
+    {
+    case SelectStatement:
+    case UpdateStatement:
+    case DeleteStatement:
+        break;
+    case InsertStatement:
+    case OtherStatement:
+        if(!statement.contains(QRegExp("\\b(SELECT|WITH)\\b", Qt::CaseInsensitive)))
+            return true;
+        break;
+    default:
+        return true;
+    }
+
+    // The statements needed for this are not part of the execution, so keep them out of the profile
+    StatementProfiler::Scope profiling(nullptr, QString());
+
+    // The table sizes are only read once for all statements. Without any statistics there is no size to warn about.
+    if(!analysed_table_rows)
+        analysed_table_rows.reset(new QueryPlan::TableRows(QueryPlan::analysedTableRows(pDb.get())));
+    if(analysed_table_rows->empty())
+        return true;
+
+    QueryPlan plan;
+    QString error;
+    if(!plan.explain(pDb.get(), statement, error, analysed_table_rows.get()))
+        return true;
+    const QueryPlanStep* scan = plan.largestScan();
+    if(!scan || scan->tableRows < full_scan_warning_rows)
+        return true;
+
+    // Ask the user. This depends on a BlockingQueuedConnection just like confirmSaveBeforePragmaOrVacuum(). The remaining statements are
+    // only cleared when the user decides to abort.
+    emit confirmFullScan(scan->table, scan->tableRows);
+    std::unique_lock<std::mutex> lk(m);
+    return !queries_left_to_execute.isEmpty();
+}
+
 void RunSql::stopExecution()
 {
     queries_left_to_execute.clear();
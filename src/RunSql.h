@@ -6,7 +6,10 @@
 #include <condition_variable>
 #include <QThread>
 
+#include "QueryPlan.h"
+
 class DBBrowserDB;
+class StatementProfiler;
 struct sqlite3;
 
 class RunSql : public QThread
@@ -46,6 +49,9 @@ public:
 
     static StatementType getQueryType(const QString& query);
 
+    /// Record the executed statements in the given profiler. Must be called before the thread is started
+    void setProfiler(StatementProfiler* profiler) { this->profiler = profiler; }
+
     void startNextStatement();
 
     void stop();
@@ -60,9 +66,16 @@ signals:
      */
     void confirmSaveBeforePragmaOrVacuum();
 
+    /**
+     * Emitted before executing a statement which reads all rows of a table which is larger than the limit set in the preferences.
+     * Call stop() to abort the execution. This signal must be connected with a Qt::BlockingQueuedConnection as well.
+     */
+    void confirmFullScan(QString table, qint64 rows);
+
 private:
     DBBrowserDB& db;
     std::shared_ptr<sqlite3> pDb;
+    StatementProfiler* profiler;
 
     mutable std::mutex m;
     mutable std::condition_variable cv;
@@ -73,6 +86,8 @@ private:
     QByteArray queries_left_to_execute;
     int execute_current_position;
     int execute_to_position;
+    qint64 full_scan_warning_rows;
+    std::unique_ptr<QueryPlan::TableRows> analysed_table_rows;  // Read once before checking the first statement
     bool structure_updated;
     bool savepoint_created;
     bool was_dirty;
@@ -80,6 +95,7 @@ private:
 
     void stopExecution();
     bool executeNextStatement();
+    bool confirmStatement(const QString& statement, StatementType type);
 
     void acquireDbAccess();
     void releaseDbAccess();
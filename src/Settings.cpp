@@ -81,6 +81,10 @@ QVariant Settings::getDefaultValue(const std::string& group, const std::string&
     if(group == "db" && name == "prefetchsize")
         return 50000U;
 
+    // db/cachebudget? (in MiB)
+    if(group == "db" && name == "cachebudget")
+        return 512;
+
     // db/defaultsqltext?
     if(group == "db" && name == "defaultsqltext")
         return "";
@@ -295,6 +299,10 @@ QVariant Settings::getDefaultValue(const std::string& group, const std::string&
     if(group == "editor" && name == "horizontal_tiling")
         return false;
 
+    // editor/full_scan_warning?
+    if(group == "editor" && name == "full_scan_warning")
+        return 1000000;
+
     // editor/splitter1_sizes?
     if(group == "editor" && name == "splitter1_sizes")
         return QVariant();
@@ -0,0 +1,453 @@
+#include "SqlCompletionIndex.h"
+
+#include <algorithm>
+#include <cctype>
+#include <set>
+#include <unordered_set>
+#include <utility>
+
+namespace {
+
+struct Token
+{
+    enum Type
+    {
+        Word,
+        QuotedIdentifier,
+        Symbol,
+    };
+
+    Type type;
+    std::string text;       // Quoted identifiers are stored without their quotes
+};
+
+bool isWordCharacter(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '$' ||
+            static_cast<unsigned char>(c) >= 0x80;
+}
+
+// Splits the statement containing the given position into tokens. String literals and comments are skipped. This is a
+// lot more forgiving than the real SQLite tokeniser because the statement is usually incomplete while it is being typed.
+std::vector<Token> tokenizeStatement(const std::string& sql, size_t cursor)
+{
+    std::vector<Token> tokens;
+
+    size_t i = 0;
+    while(i < sql.size())
+    {
+        const char c = sql[i];
+        const char next = i + 1 < sql.size() ? sql[i+1] : '\0';
+
+        if(c == ';')
+        {
+            // Only keep the tokens of the statement the cursor is in
+            if(i >= cursor)
+                break;
+            tokens.clear();
+            i++;
+        } else if(c == '-' && next == '-') {
+            i = sql.find('\n', i);
+        } else if(c == '/' && next == '*') {
+            i = sql.find("*/", i + 2);
+            if(i != std::string::npos)
+                i += 2;
+        } else if(c == '\'' || c == '"' || c == '`' || c == '[') {
+            // Quotes are escaped by doubling them, except for square brackets which can't be escaped at all
+            const char close = c == '[' ? ']' : c;
+            std::string text;
+            for(i++;i<sql.size();i++)
+            {
+                if(sql[i] == close)
+                {
+                    if(close != ']' && i + 1 < sql.size() && sql[i+1] == close)
+                        i++;
+                    else
+                        break;
+                }
+                text.push_back(sql[i]);
+            }
+            if(i < sql.size())
+                i++;
+
+            if(c != '\'')
+                tokens.push_back({Token::QuotedIdentifier, text});
+        } else if(isWordCharacter(c)) {
+            const size_t begin = i;
+            while(i < sql.size() && isWordCharacter(sql[i]))
+                i++;
+            tokens.push_back({Token::Word, sql.substr(begin, i - begin)});
+        } else {
+            if(!isspace(static_cast<unsigned char>(c)))
+                tokens.push_back({Token::Symbol, std::string(1, c)});
+            i++;
+        }
+    }
+
+    return tokens;
+}
+
+bool isKeyword(const Token& token, const char* keyword)
+{
+    return token.type == Token::Word && CompletionTrie::fold(token.text) == keyword;
+}
+
+bool isSymbol(const Token& token, char symbol)
+{
+    return token.type == Token::Symbol && token.text[0] == symbol;
+}
+
+// Checks whether a token can be the name of a table or an alias. Words which can continue the statement after a table
+// reference are not considered names, even though SQLite accepts some of them as unquoted identifiers.
+bool isName(const Token& token)
+{
+    static const std::unordered_set<std::string> keywords = {
+        "as", "cross", "default", "do", "except", "from", "full", "group", "having", "indexed", "inner", "intersect",
+        "join", "left", "limit", "natural", "not", "on", "order", "outer", "returning", "right", "select", "set",
+        "union", "using", "values", "where", "window"
+    };
+
+    if(token.type == Token::QuotedIdentifier)
+        return true;
+    if(token.type != Token::Word || (token.text[0] >= '0' && token.text[0] <= '9'))
+        return false;
+    return keywords.find(CompletionTrie::fold(token.text)) == keywords.end();
+}
+
+// Parses a table reference of the form [schema.]table[(arguments)] [[AS] alias] beginning at the given token and
+// returns the position of the first token after it
+size_t parseTableReference(const std::vector<Token>& tokens, size_t pos, std::vector<SqlCompletionIndex::TableReference>& references)
+{
+    if(pos >= tokens.size() || !isName(tokens[pos]))
+        return pos;
+
+    SqlCompletionIndex::TableReference reference;
+    reference.table = tokens[pos++].text;
+    if(pos + 1 < tokens.size() && isSymbol(tokens[pos], '.') && isName(tokens[pos+1]))
+    {
+        reference.schema = reference.table;
+        reference.table = tokens[pos+1].text;
+        pos += 2;
+    }
+
+    // Skip the arguments of table-valued functions and the column list of INSERT statements
+    if(pos < tokens.size() && isSymbol(tokens[pos], '('))
+    {
+        int depth = 0;
+        for(;pos<tokens.size();pos++)
+        {
+            if(isSymbol(tokens[pos], '('))
+                depth++;
+            else if(isSymbol(tokens[pos], ')') && --depth == 0)
+                break;
+        }
+        pos++;
+    }
+
+    if(pos < tokens.size() && isKeyword(tokens[pos], "as"))
+        pos++;
+    if(pos < tokens.size() && isName(tokens[pos]))
+        reference.alias = tokens[pos++].text;
+
+    references.push_back(reference);
+    return pos;
+}
+
+}
+
+void SqlCompletionIndex::addKeyword(const std::string& keyword)
+{
+    m_keywordTrie.insert(keyword);
+}
+
+void SqlCompletionIndex::addFunction(const std::string& function)
+{
+    m_functionTrie.insert(function);
+}
+
+void SqlCompletionIndex::setTables(const QualifiedTablesMap& tables)
+{
+    std::set<std::string> schemata;
+    for(const auto& it : tables)
+        schemata.insert(CompletionTrie::fold(it.first));
+    removeDetachedSchemata(schemata);
+
+    for(const auto& it : tables)
+    {
+        SchemaEntry& schema = schemaEntry(it.first);
+
+        std::unordered_map<std::string, TablesAndColumnsMap::const_iterator> newTables;
+        for(auto table=it.second.cbegin();table!=it.second.cend();++table)
+            newTables.emplace(CompletionTrie::fold(table->first), table);
+
+        // Remove the tables which have been dropped or changed
+        for(auto table=schema.tables.begin();table!=schema.tables.end();)
+        {
+            auto new_table = newTables.find(table->first);
+            if(new_table == newTables.end() || new_table->second->first != table->second.name || new_table->second->second != table->second.columns)
+            {
+                removeTable(schema, table->second);
+                table = schema.tables.erase(table);
+            } else {
+                ++table;
+            }
+        }
+
+        // Add the tables which have been created or changed
+        for(const auto& new_table : newTables)
+        {
+            if(schema.tables.find(new_table.first) == schema.tables.end())
+                addTable(schema, new_table.first, new_table.second->first, new_table.second->second);
+        }
+    }
+}
+
+void SqlCompletionIndex::setSchemata(const std::vector<std::string>& schemata)
+{
+    std::set<std::string> keys;
+    for(const std::string& name : schemata)
+    {
+        keys.insert(CompletionTrie::fold(name));
+        schemaEntry(name);
+    }
+    removeDetachedSchemata(keys);
+}
+
+void SqlCompletionIndex::setTable(const std::string& schema_name, const std::string& name, const std::vector<std::string>& columns)
+{
+    SchemaEntry& schema = schemaEntry(schema_name);
+    const std::string key = CompletionTrie::fold(name);
+
+    auto it = schema.tables.find(key);
+    if(it != schema.tables.end())
+    {
+        if(it->second.name == name && it->second.columns == columns)
+            return;
+        removeTable(schema, it->second);
+        schema.tables.erase(it);
+    }
+    addTable(schema, key, name, columns);
+}
+
+void SqlCompletionIndex::dropTable(const std::string& schema_name, const std::string& name)
+{
+    auto schema_it = m_schemata.find(CompletionTrie::fold(schema_name));
+    if(schema_it == m_schemata.end())
+        return;
+    SchemaEntry& schema = schema_it->second;
+
+    auto it = schema.tables.find(CompletionTrie::fold(name));
+    if(it != schema.tables.end())
+    {
+        removeTable(schema, it->second);
+        schema.tables.erase(it);
+    }
+}
+
+std::vector<std::string> SqlCompletionIndex::tableNames() const
+{
+    std::vector<std::string> names;
+    for(const auto& schema : m_schemata)
+    {
+        for(const auto& table : schema.second.tables)
+            names.push_back(table.second.name);
+    }
+    return names;
+}
+
+SqlCompletionIndex::SchemaEntry& SqlCompletionIndex::schemaEntry(const std::string& name)
+{
+    const std::string key = CompletionTrie::fold(name);
+    auto it = m_schemata.find(key);
+    if(it == m_schemata.end())
+    {
+        it = m_schemata.emplace(key, SchemaEntry()).first;
+        it->second.name = name;
+        m_schemaTrie.insert(name);
+    }
+    return it->second;
+}
+
+void SqlCompletionIndex::removeDetachedSchemata(const std::set<std::string>& schemata)
+{
+    for(auto it=m_schemata.begin();it!=m_schemata.end();)
+    {
+        if(schemata.find(it->first) == schemata.end())
+        {
+            for(const auto& table : it->second.tables)
+                removeTable(it->second, table.second);
+            m_schemaTrie.remove(it->second.name);
+            it = m_schemata.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void SqlCompletionIndex::removeTable(SchemaEntry& schema, const TableEntry& table)
+{
+    schema.tableTrie.remove(table.name);
+    for(const std::string& column : table.columns)
+        m_columnTrie.remove(column);
+}
+
+void SqlCompletionIndex::addTable(SchemaEntry& schema, const std::string& key, const std::string& name, const std::vector<std::string>& columns)
+{
+    TableEntry& table = schema.tables[key];
+    table.name = name;
+    table.columns = columns;
+    for(const std::string& column : columns)
+    {
+        table.columnTrie.insert(column);
+        m_columnTrie.insert(column);
+    }
+    schema.tableTrie.insert(name);
+}
+
+const SqlCompletionIndex::SchemaEntry* SqlCompletionIndex::findSchema(const std::string& name) const
+{
+    auto it = m_schemata.find(CompletionTrie::fold(name));
+    if(it == m_schemata.end())
+        return nullptr;
+    return &it->second;
+}
+
+const SqlCompletionIndex::TableEntry* SqlCompletionIndex::findTable(const std::string& schema, const std::string& table) const
+{
+    const std::string key = CompletionTrie::fold(table);
+
+    if(!schema.empty())
+    {
+        const SchemaEntry* s = findSchema(schema);
+        if(!s)
+            return nullptr;
+        auto it = s->tables.find(key);
+        return it == s->tables.end() ? nullptr : &it->second;
+    }
+
+    // Without a schema name SQLite looks in the temp schema first, then in the main schema and then in the attached schemata
+    std::vector<const SchemaEntry*> order;
+    if(const SchemaEntry* s = findSchema("temp"))
+        order.push_back(s);
+    if(const SchemaEntry* s = findSchema("main"))
+        order.push_back(s);
+    for(const auto& it : m_schemata)
+    {
+        if(it.first != "temp" && it.first != "main")
+            order.push_back(&it.second);
+    }
+
+    for(const SchemaEntry* s : order)
+    {
+        auto it = s->tables.find(key);
+        if(it != s->tables.end())
+            return &it->second;
+    }
+    return nullptr;
+}
+
+std::vector<SqlCompletionIndex::TableReference> SqlCompletionIndex::referencedTables(const std::string& sql, size_t cursor)
+{
+    const std::vector<Token> tokens = tokenizeStatement(sql, cursor);
+
+    std::vector<TableReference> references;
+    bool index_or_trigger = false;
+    for(size_t i=0;i<tokens.size();i++)
+    {
+        if(tokens[i].type != Token::Word)
+            continue;
+
+        const std::string word = CompletionTrie::fold(tokens[i].text);
+        if(word == "from" || word == "join")
+        {
+            // Subqueries aren't skipped here. Their tables are picked up when the loop continues inside the parentheses
+            size_t pos = parseTableReference(tokens, i + 1, references);
+            while(pos < tokens.size() && isSymbol(tokens[pos], ','))
+                pos = parseTableReference(tokens, pos + 1, references);
+            i = pos - 1;
+        } else if(word == "update" || word == "into") {
+            size_t pos = i + 1;
+            if(pos + 1 < tokens.size() && isKeyword(tokens[pos], "or"))       // UPDATE OR REPLACE etc.
+                pos += 2;
+            i = parseTableReference(tokens, pos, references) - 1;
+        } else if(word == "index" || word == "trigger") {
+            index_or_trigger = true;
+        } else if(word == "on" && index_or_trigger) {
+            // The table of a CREATE INDEX or CREATE TRIGGER statement
+            index_or_trigger = false;
+            i = parseTableReference(tokens, i + 1, references) - 1;
+        }
+    }
+
+    return references;
+}
+
+std::vector<SqlCompletionIndex::Completion> SqlCompletionIndex::complete(const std::vector<std::string>& context, const std::string& sql, size_t cursor, size_t limit) const
+{
+    std::vector<Completion> completions;
+    if(context.empty() || context.size() > 3)
+        return completions;
+
+    const std::string& prefix = context.back();
+    std::set<std::pair<std::string, CompletionType>> seen;
+    std::vector<std::string> words;
+    auto add = [&](const CompletionTrie& trie, CompletionType type) {
+        if(completions.size() >= limit)
+            return;
+        words.clear();
+        trie.complete(prefix, words, limit - completions.size());
+        for(const std::string& word : words)
+        {
+            if(completions.size() < limit && seen.emplace(word, type).second)
+                completions.push_back({word, type});
+        }
+    };
+
+    if(context.size() == 3)
+    {
+        // schema.table.column
+        if(const TableEntry* table = findTable(context[0], context[1]))
+            add(table->columnTrie, Column);
+    } else if(context.size() == 2) {
+        // schema.table or table.column or alias.column
+        if(const SchemaEntry* schema = findSchema(context[0]))
+            add(schema->tableTrie, Table);
+
+        const std::string qualifier = CompletionTrie::fold(context[0]);
+        const TableEntry* table = nullptr;
+        for(const TableReference& reference : referencedTables(sql, cursor))
+        {
+            if(CompletionTrie::fold(reference.alias) == qualifier)
+            {
+                table = findTable(reference.schema, reference.table);
+                break;
+            }
+        }
+        if(!table)
+            table = findTable(std::string(), context[0]);
+        if(table)
+            add(table->columnTrie, Column);
+    } else {
+        // Only offer the columns of the tables used in the statement. If none of them is known, e.g. because the FROM
+        // clause hasn't been typed yet, offer all columns but only after everything else.
+        std::vector<const TableEntry*> tables;
+        for(const TableReference& reference : referencedTables(sql, cursor))
+        {
+            const TableEntry* table = findTable(reference.schema, reference.table);
+            if(table && std::find(tables.begin(), tables.end(), table) == tables.end())
+                tables.push_back(table);
+        }
+
+        for(const TableEntry* table : tables)
+            add(table->columnTrie, Column);
+        for(const auto& schema : m_schemata)
+            add(schema.second.tableTrie, Table);
+        add(m_schemaTrie, Schema);
+        add(m_functionTrie, Function);
+        add(m_keywordTrie, Keyword);
+        if(tables.empty())
+            add(m_columnTrie, Column);
+    }
+
+    return completions;
+}
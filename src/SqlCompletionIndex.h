@@ -0,0 +1,109 @@
+#ifndef SQLCOMPLETIONINDEX_H
+#define SQLCOMPLETIONINDEX_H
+
+#include "CompletionTrie.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief The SqlCompletionIndex class
+ * Holds the words offered for auto completion in the SQL editor: keywords, functions, schemata, tables and columns. There
+ * is one trie of table names per schema and one trie of column names per table, so the columns offered can be limited to
+ * the tables which are used in the statement being edited. When the database structure changes, only the tables which
+ * have been added, removed or changed are updated. They can be updated one by one as well.
+ */
+class SqlCompletionIndex
+{
+public:
+    enum CompletionType
+    {
+        Keyword,
+        Function,
+        Schema,
+        Table,
+        Column,
+    };
+
+    struct Completion
+    {
+        std::string word;
+        CompletionType type;
+    };
+
+    /// A table used in a statement. Schema and alias are empty if they aren't given
+    struct TableReference
+    {
+        std::string schema;
+        std::string table;
+        std::string alias;
+    };
+
+    using TablesAndColumnsMap = std::map<std::string, std::vector<std::string>>;
+    using QualifiedTablesMap = std::map<std::string, TablesAndColumnsMap>;
+
+    void addKeyword(const std::string& keyword);
+    void addFunction(const std::string& function);
+
+    /// Updates the schemata, tables and columns to the given ones. This only touches the tables which have changed
+    void setTables(const QualifiedTablesMap& tables);
+
+    /// Updates the schemata to the given ones. Schemata which aren't in the list anymore are removed along with their tables
+    void setSchemata(const std::vector<std::string>& schemata);
+
+    /// Adds a table or replaces its columns if it is known already. The schema is added if necessary
+    void setTable(const std::string& schema, const std::string& table, const std::vector<std::string>& columns);
+
+    /// Removes a table if it is known
+    void dropTable(const std::string& schema, const std::string& table);
+
+    /// \returns the names of the tables of all schemata
+    std::vector<std::string> tableNames() const;
+
+    /**
+     * @brief complete Looks up the completions for the word being typed
+     * @param context The words preceding the cursor. They are separated by dots in the text, e.g. schema.table.column. The
+     * last word is the partial word being typed.
+     * @param sql The text surrounding the cursor
+     * @param cursor The position of the cursor in sql
+     * @param limit The maximum number of completions
+     */
+    std::vector<Completion> complete(const std::vector<std::string>& context, const std::string& sql, size_t cursor, size_t limit) const;
+
+    /// \returns the tables used in the statement at the given position of sql
+    static std::vector<TableReference> referencedTables(const std::string& sql, size_t cursor);
+
+private:
+    struct TableEntry
+    {
+        std::string name;
+        std::vector<std::string> columns;
+        CompletionTrie columnTrie;
+    };
+
+    struct SchemaEntry
+    {
+        std::string name;
+        CompletionTrie tableTrie;
+        std::unordered_map<std::string, TableEntry> tables;    // Key is the folded table name
+    };
+
+    std::map<std::string, SchemaEntry> m_schemata;              // Key is the folded schema name
+    CompletionTrie m_schemaTrie;
+    CompletionTrie m_columnTrie;                                // Columns of all tables
+    CompletionTrie m_keywordTrie;
+    CompletionTrie m_functionTrie;
+
+    SchemaEntry& schemaEntry(const std::string& name);
+    void removeDetachedSchemata(const std::set<std::string>& schemata);
+    void removeTable(SchemaEntry& schema, const TableEntry& table);
+    void addTable(SchemaEntry& schema, const std::string& key, const std::string& name, const std::vector<std::string>& columns);
+
+    const SchemaEntry* findSchema(const std::string& name) const;
+    const TableEntry* findTable(const std::string& schema, const std::string& table) const;
+};
+
+#endif
@@ -5,11 +5,19 @@
 #include "sqlitedb.h"
 #include "Settings.h"
 #include "ExportDataDialog.h"
+#include "FileDialog.h"
+#include "StatementProfiler.h"
+#include "QueryPlan.h"
 
+#include <QApplication>
 #include <QInputDialog>
 #include <QMessageBox>
 #include <QShortcut>
 #include <QFile>
+#include <QLocale>
+#include <QTreeWidget>
+
+#include <map>
 
 SqlExecutionArea::SqlExecutionArea(DBBrowserDB& _db, QWidget* parent) :
     QWidget(parent),
@@ -26,6 +34,18 @@ SqlExecutionArea::SqlExecutionArea(DBBrowserDB& _db, QWidget* parent) :
     ui->tableResult->setModel(model);
     connect(model, &SqliteTableModel::finishedFetch, this, &SqlExecutionArea::fetchedData);
 
+    // Create profiler. It has to be created after the model because the model's worker thread uses it until the model is deleted
+    profiler = new StatementProfiler(this);
+    model->setProfiler(profiler);
+    ui->tableProfile->setModel(profiler);
+    ui->tableProfile->horizontalHeader()->moveSection(StatementProfiler::ColumnStatement, StatementProfiler::ColumnCount - 1);
+    connect(profiler, &StatementProfiler::rowsInserted, ui->tableProfile, &QTableView::scrollToBottom);
+    connect(ui->checkProfile, &QCheckBox::toggled, profiler, &StatementProfiler::setEnabled);
+    connect(ui->buttonClearProfile, &QToolButton::clicked, profiler, &StatementProfiler::clear);
+    connect(ui->buttonExportProfile, &QToolButton::clicked, this, &SqlExecutionArea::exportProfile);
+
+    connect(ui->buttonExplain, &QToolButton::clicked, this, &SqlExecutionArea::explainStatement);
+
     ui->findFrame->hide();
 
     QShortcut* shortcutHideFind = new QShortcut(QKeySequence("ESC"), ui->findLineEdit);
@@ -75,6 +95,8 @@ void SqlExecutionArea::finishExecution(const QString& result, const bool ok)
     error_state = !ok;
     m_columnsResized = false;
     ui->editErrors->setPlainText(result);
+    if(!ok)
+        ui->tabMessages->setCurrentWidget(ui->tabErrors);
     // Set reddish background when not ok
     if (showErrorIndicators)
     {
@@ -309,3 +331,103 @@ void SqlExecutionArea::saveState() {
     Settings::setValue("editor", "splitter1_sizes", Settings::getValue("editor", "splitter1_sizes"));
     Settings::setValue("editor", "splitter2_sizes", Settings::getValue("editor", "splitter2_sizes"));
 }
+
+void SqlExecutionArea::exportProfile()
+{
+    QString fileName = FileDialog::getSaveFileName(
+                CreateDataFile,
+                this,
+                tr("Choose a filename to export the profile"),
+                QStringList({FILE_FILTER_JSON, FILE_FILTER_ALL}).join(";;"));
+    if(fileName.isEmpty())
+        return;
+
+    // Include the statements which have finished since the last update of the table
+    profiler->flush();
+    if(!profiler->exportJson(fileName))
+        QMessageBox::warning(this, QApplication::applicationName(), tr("Could not open output file: %1").arg(fileName));
+}
+
+void SqlExecutionArea::explainStatement()
+{
+    ui->treePlan->clear();
+    ui->labelPlan->clear();
+    ui->tabMessages->setCurrentWidget(ui->tabPlan);
+
+    // Find the statement at the cursor position. Positions in the editor are byte positions in the UTF-8 text
+    int cursor_line, cursor_index;
+    ui->editEditor->getCursorPosition(&cursor_line, &cursor_index);
+    const QByteArray sql = getSql().toUtf8();
+    int from, to;
+    if(!QueryPlan::statementAt(sql, ui->editEditor->positionFromLineIndex(cursor_line, cursor_index), from, to))
+    {
+        ui->labelPlan->setText(tr("There is no statement at the cursor position."));
+        return;
+    }
+
+    QueryPlan plan;
+    QString error;
+    {
+        auto pDb = db.get(tr("explaining query"));
+        if(!pDb)
+            return;
+        if(!plan.explain(pDb.get(), QString::fromUtf8(sql.mid(from, to - from)), error))
+        {
+            ui->labelPlan->setText(error);
+            return;
+        }
+    }
+
+    // Build the tree of steps and point out the expensive ones. Full scans of tables above the size for which execution needs to be
+    // confirmed are shown like errors.
+    const qint64 warning_rows = Settings::getValue("editor", "full_scan_warning").toLongLong();
+    std::map<int, QTreeWidgetItem*> items;
+    int warnings = 0;
+    for(const QueryPlanStep& step : plan.steps())
+    {
+        auto parent = items.find(step.parent);
+        QTreeWidgetItem* item = parent == items.end() ? new QTreeWidgetItem(ui->treePlan) : new QTreeWidgetItem(parent->second);
+        items[step.id] = item;
+
+        item->setText(0, step.detail);
+        if(step.tableRows >= 0)
+        {
+            item->setText(1, QLocale().toString(step.tableRows));
+            item->setTextAlignment(1, Qt::AlignRight | Qt::AlignVCenter);
+        }
+
+        if(!step.isExpensive())
+            continue;
+        warnings++;
+
+        QString tooltip;
+        if(step.automaticIndex)
+            tooltip = tr("SQLite builds a temporary index for executing this statement. Creating a permanent index would avoid this.");
+        else if(step.operation == QueryPlanStep::TempBTree)
+            tooltip = tr("The rows are collected and sorted in a temporary B-tree. An index matching the order or grouping may avoid this.");
+        else if(step.tableRows < 0)
+            tooltip = tr("All rows of the table are read. The size of the table is unknown until the database is analysed.");
+        else
+            tooltip = tr("All %1 rows of the table are read.").arg(QLocale().toString(step.tableRows));
+        item->setToolTip(0, tooltip);
+
+        QFont font = item->font(0);
+        font.setBold(true);
+        item->setFont(0, font);
+        if(step.operation == QueryPlanStep::Scan && warning_rows > 0 && step.tableRows >= warning_rows)
+        {
+            for(int column=0;column<ui->treePlan->columnCount();column++)
+            {
+                item->setForeground(column, QColor(Qt::white));
+                item->setBackground(column, QColor(255, 102, 102));
+            }
+        }
+    }
+
+    ui->treePlan->expandAll();
+    ui->treePlan->resizeColumnToContents(0);
+    if(warnings)
+        ui->labelPlan->setText(tr("%n expensive step(s), shown in bold", "", warnings));
+    else
+        ui->labelPlan->setText(tr("No full scans, temporary B-trees or automatic indexes"));
+}
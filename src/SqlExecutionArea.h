@@ -8,6 +8,7 @@ class SqlTextEdit;
 class SqliteTableModel;
 class DBBrowserDB;
 class ExtendedTableWidget;
+class StatementProfiler;
 
 class QTextEdit;
 
@@ -33,6 +34,7 @@ public:
     void setFileName(const QString& filename) { sqlFileName = filename; }
 
     SqliteTableModel* getModel() { return model; }
+    StatementProfiler* getProfiler() { return profiler; }
     SqlTextEdit* getEditor();
     ExtendedTableWidget *getTableResult();
     QTextEdit* getStatusEdit();
@@ -54,6 +56,8 @@ private slots:
     void findNext();
     void findLineEdit_textChanged(const QString& text);
     void hideFindFrame();
+    void exportProfile();
+    void explainStatement();
 
     void fileChanged(const QString& filename);
 
@@ -64,6 +68,7 @@ private:
     void find(QString expr, bool forward);
     DBBrowserDB& db;
     SqliteTableModel* model;
+    StatementProfiler* profiler;
     QString sqlFileName;
     QFileSystemWatcher fileSystemWatch;
     Ui::SqlExecutionArea* ui;
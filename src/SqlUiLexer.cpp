@@ -1,17 +1,119 @@
 #include <algorithm>
+#include <map>
+
+#include <QApplication>
 
 #include "SqlUiLexer.h"
-#include "Qsci/qsciapis.h"
+#include "Qsci/qsciabstractapis.h"
+#include "Qsci/qsciscintilla.h"
 #include "Settings.h"
 #include "sqlitedb.h"
 
+/**
+ * @brief The SqlCompletionApi class
+ * Provides the auto completion list and the call tips of the SQL editors. Instead of searching through a list of all
+ * words like QsciAPIs does, it looks up the words in the tries of a SqlCompletionIndex and takes the statement around the
+ * cursor into account.
+ */
+class SqlCompletionApi : public QsciAbstractAPIs
+{
+public:
+    explicit SqlCompletionApi(QsciLexer* lexer) : QsciAbstractAPIs(lexer) {}
+
+    SqlCompletionIndex index;
+    std::map<QString, QStringList> functionTips;    // Key is the lower case function name, values are "(args) description"
+
+    void updateAutoCompletionList(const QStringList& context, QStringList& list) override;
+    QStringList callTips(const QStringList& context, int commas, QsciScintilla::CallTipsStyle style, QList<int>& shifts) override;
+};
+
+void SqlCompletionApi::updateAutoCompletionList(const QStringList& context, QStringList& list)
+{
+    // Longer lists aren't any help and only take long to show
+    const size_t maxCompletions = 1000;
+    // How far the text around the cursor is searched for the boundaries of the current statement
+    const int statementWindow = 64 * 1024;
+
+    // All editors share the same lexer, so the editor the user is typing in is the one with the focus
+    std::string sql;
+    size_t cursor = 0;
+    QsciScintilla* editor = qobject_cast<QsciScintilla*>(QApplication::focusWidget());
+    if(editor && editor->lexer() == lexer())
+    {
+        const int position = static_cast<int>(editor->SendScintilla(QsciScintillaBase::SCI_GETCURRENTPOS));
+        const int begin = std::max(0, position - statementWindow);
+        const int end = std::min(editor->length(), position + statementWindow);
+        sql = std::string(editor->bytes(begin, end).constData(), static_cast<size_t>(end - begin));
+        cursor = static_cast<size_t>(position - begin);
+    }
+
+    std::vector<std::string> words;
+    for(const QString& word : context)
+        words.push_back(word.toStdString());
+
+    const bool upperKeywords = Settings::getValue("editor", "upper_keywords").toBool();
+    const bool upperFunctions = !context.isEmpty() && !context.last().isEmpty() && context.last().at(0).isUpper();
+    for(const SqlCompletionIndex::Completion& completion : index.complete(words, sql, cursor, maxCompletions))
+    {
+        QString word = QString::fromStdString(completion.word);
+        int icon = SqlUiLexer::ApiCompleterIconIdKeyword;
+        switch(completion.type)
+        {
+        case SqlCompletionIndex::Keyword:
+            if(!upperKeywords)
+                word = word.toLower();
+            icon = SqlUiLexer::ApiCompleterIconIdKeyword;
+            break;
+        case SqlCompletionIndex::Function:
+            if(upperFunctions)
+                word = word.toUpper();
+            icon = SqlUiLexer::ApiCompleterIconIdFunction;
+            break;
+        case SqlCompletionIndex::Schema:
+            icon = SqlUiLexer::ApiCompleterIconIdSchema;
+            break;
+        case SqlCompletionIndex::Table:
+            icon = SqlUiLexer::ApiCompleterIconIdTable;
+            break;
+        case SqlCompletionIndex::Column:
+            icon = SqlUiLexer::ApiCompleterIconIdColumn;
+            break;
+        }
+
+        list << word + "?" + QString::number(icon);
+    }
+}
+
+QStringList SqlCompletionApi::callTips(const QStringList& context, int commas, QsciScintilla::CallTipsStyle /*style*/, QList<int>& shifts)
+{
+    // The last word of the context is always empty, the one before it is the function name
+    QStringList tips;
+    if(context.size() < 2)
+        return tips;
+
+    const QString& function = context.at(context.size() - 2);
+    auto it = functionTips.find(function.toLower());
+    if(it == functionTips.end())
+        return tips;
+
+    for(const QString& tip : it->second)
+    {
+        // Only show the variants which take at least as many arguments as have been typed
+        if(tip.left(tip.indexOf(')')).count(',') >= commas)
+        {
+            tips << function + tip;
+            shifts << 0;
+        }
+    }
+    return tips;
+}
+
 SqlUiLexer::SqlUiLexer(QObject* parent) :
     QsciLexerSQL(parent)
 {
     // Setup auto completion
-    autocompleteApi = new QsciAPIs(this);
+    autocompleteApi = new SqlCompletionApi(this);
     setupAutoCompletion();
-    autocompleteApi->prepare();
 
     // Setup folding
     setFoldComments(true);
@@ -50,14 +152,9 @@ void SqlUiLexer::setupAutoCompletion()
             << "WHERE" << "WINDOW" << "WITH" << "WITHOUT"
             // Data types
             << "INT" << "INTEGER" << "REAL" << "TEXT" << "BLOB" << "NUMERIC" << "CHAR";
-    bool upperKeywords = Settings::getValue("editor", "upper_keywords").toBool();
+    // The case of the keywords is chosen according to the settings when they are offered for completion
     for(const QString& keyword : keywordPatterns)
-    {
-        if (upperKeywords)
-            autocompleteApi->add(keyword + "?" + QString::number(ApiCompleterIconIdKeyword));
-        else
-            autocompleteApi->add(keyword.toLower() + "?" + QString::number(ApiCompleterIconIdKeyword));
-    }
+        autocompleteApi->index.addKeyword(keyword.toStdString());
 
     // Functions
     QStringList functionPatterns;
@@ -141,8 +238,8 @@ void SqlUiLexer::setupAutoCompletion()
         QString fn = keyword.left(keyword.indexOf('('));
         QString descr = keyword.mid(keyword.indexOf('('));
 
-        autocompleteApi->add(fn + "?" + QString::number(ApiCompleterIconIdFunction) + descr);
-        autocompleteApi->add(fn.toUpper() + "?" + QString::number(ApiCompleterIconIdFunction) + descr);
+        autocompleteApi->index.addFunction(fn.toStdString());
+        autocompleteApi->functionTips[fn].append(descr);
 
         // Store all function names in order to highlight them in a different colour
         listFunctions.append(fn);
@@ -151,31 +248,24 @@ void SqlUiLexer::setupAutoCompletion()
 
 void SqlUiLexer::setTableNames(const QualifiedTablesMap& tables)
 {
-    // Update list for auto completion
-    autocompleteApi->clear();
-    listTables.clear();
-    setupAutoCompletion();
-    for(const auto& itSchemas : tables)
-    {
-        for(const auto& itTables : itSchemas.second)
-        {
-            // Completion for schema.table
-            autocompleteApi->add(itSchemas.first + "?" + QString::number(SqlUiLexer::ApiCompleterIconIdSchema) + "." +
-                                 itTables.first + "?" + QString::number(SqlUiLexer::ApiCompleterIconIdTable));
-
-            for(const QString& field : itTables.second) {
-                // Completion for table.field
-                autocompleteApi->add(itTables.first + "?" + QString::number(SqlUiLexer::ApiCompleterIconIdTable) + "." +
-                                     field + "?" + QString::number(SqlUiLexer::ApiCompleterIconIdColumn));
-
-                // Completion for isolated field
-                autocompleteApi->add(field + "?" + QString::number(SqlUiLexer::ApiCompleterIconIdColumn));
-            }
-            // Store the table name list in order to highlight them in a different colour
-            listTables.append(itTables.first);
-        }
-    }
-    autocompleteApi->prepare();
+    // Update the tries for auto completion. This only touches the tables which have changed since the last call. The table
+    // names for highlighting are taken from there, too.
+    autocompleteApi->index.setTables(tables);
+}
+
+void SqlUiLexer::setSchemata(const std::vector<std::string>& schemata)
+{
+    autocompleteApi->index.setSchemata(schemata);
+}
+
+void SqlUiLexer::setTable(const std::string& schema, const std::string& table, const std::vector<std::string>& columns)
+{
+    autocompleteApi->index.setTable(schema, table, columns);
+}
+
+void SqlUiLexer::dropTable(const std::string& schema, const std::string& table)
+{
+    autocompleteApi->index.dropTable(schema, table);
 }
 
 const char* SqlUiLexer::keywords(int set) const
@@ -192,6 +282,9 @@ const char* SqlUiLexer::keywords(int set) const
         return sqliteKeywords.c_str();
     } else if(set == 6)     // This corresponds to the QsciLexerSQL::KeywordSet6 style in SqlTextEdit
     {
+        QStringList listTables;
+        for(const std::string& name : autocompleteApi->index.tableNames())
+            listTables.append(QString::fromStdString(name));
         tables = listTables.join(" ").toLower().toUtf8().constData();
         return tables.c_str();
     } else if(set == 7) {   // This corresponds to the QsciLexerSQL::KeywordSet7 style in SqlTextEdit
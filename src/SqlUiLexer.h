@@ -2,10 +2,9 @@
 #define SQLUILEXER_H
 
 #include "Qsci/qscilexersql.h"
+#include "SqlCompletionIndex.h"
 
-#include <map>
-
-class QsciAPIs;
+class SqlCompletionApi;
 
 class SqlUiLexer : public QsciLexerSQL
 {
@@ -23,11 +22,16 @@ public:
         ApiCompleterIconIdSchema,
     };
 
-    using TablesAndColumnsMap = std::map<QString, std::vector<QString>>;
-    using QualifiedTablesMap = std::map<QString, TablesAndColumnsMap>;
+    using TablesAndColumnsMap = SqlCompletionIndex::TablesAndColumnsMap;
+    using QualifiedTablesMap = SqlCompletionIndex::QualifiedTablesMap;
 
     void setTableNames(const QualifiedTablesMap& tables);
 
+    // Update the table names one by one instead of replacing all of them
+    void setSchemata(const std::vector<std::string>& schemata);
+    void setTable(const std::string& schema, const std::string& table, const std::vector<std::string>& columns);
+    void dropTable(const std::string& schema, const std::string& table);
+
     const char* keywords(int set) const override;
 
     QStringList autoCompletionWordSeparators() const override;
@@ -35,11 +39,10 @@ public:
     bool caseSensitive() const override;
 
 private:
-    QsciAPIs* autocompleteApi;
+    SqlCompletionApi* autocompleteApi;
 
     void setupAutoCompletion();
 
-    QStringList listTables;
     QStringList listFunctions;
     QStringList keywordPatterns;
 };
@@ -0,0 +1,263 @@
+#include "StatementProfiler.h"
+#include "sqlite.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QTimer>
+
+#include <json.hpp>
+
+using json = nlohmann::json;
+
+namespace {
+
+// The profiling scope of the current thread
+thread_local StatementProfiler::Scope* currentScope = nullptr;
+
+// The oldest entries are dropped from the history once it grows beyond this
+const size_t maxHistorySize = 10000;
+
+// Time for which finished statements are collected before adding them to the history
+const int flushInterval = 250;
+
+}
+
+StatementProfiler::Scope::Scope(StatementProfiler* profiler, const QString& source) :
+    m_profiler(profiler),
+    m_source(source),
+    m_previous(currentScope)
+{
+    currentScope = this;
+}
+
+StatementProfiler::Scope::~Scope()
+{
+    currentScope = m_previous;
+}
+
+StatementProfiler::StatementProfiler(QObject* parent) :
+    QAbstractTableModel(parent),
+    m_enabled(true),
+    m_flushTimer(new QTimer(this))
+{
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(flushInterval);
+    connect(m_flushTimer, &QTimer::timeout, this, &StatementProfiler::flush);
+
+    // The trace callback is called in whichever thread executes the statement
+    connect(this, &StatementProfiler::profilesPending, this, &StatementProfiler::scheduleFlush, Qt::QueuedConnection);
+}
+
+void StatementProfiler::install(sqlite3* db)
+{
+#if SQLITE_VERSION_NUMBER >= 3014000
+    sqlite3_trace_v2(db, SQLITE_TRACE_PROFILE, &StatementProfiler::traceCallback, nullptr);
+#else
+    Q_UNUSED(db)
+#endif
+}
+
+int StatementProfiler::traceCallback(unsigned int type, void* /*context*/, void* p, void* x)
+{
+#if SQLITE_VERSION_NUMBER >= 3014000
+    if(type != SQLITE_TRACE_PROFILE || !currentScope || !currentScope->m_profiler || !currentScope->m_profiler->m_enabled)
+        return 0;
+
+    // The counters are reset after reading them, so each execution of a statement only gets its own share
+    sqlite3_stmt* stmt = static_cast<sqlite3_stmt*>(p);
+    StatementProfile profile;
+    profile.source = currentScope->m_source;
+    profile.sql = QString::fromUtf8(sqlite3_sql(stmt)).trimmed();
+    profile.finished = QDateTime::currentMSecsSinceEpoch();
+    profile.nanoseconds = *static_cast<sqlite3_int64*>(x);
+    profile.fullScanSteps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+    profile.sortOperations = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 1);
+    profile.autoIndexRows = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+    profile.vmSteps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 1);
+    profile.reprepares = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_REPREPARE, 1);
+#ifdef SQLITE_STMTSTATUS_MEMUSED
+    profile.memoryUsed = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_MEMUSED, 0);
+#endif
+
+    // Only the first profile of a batch needs to wake up the thread of the model
+    StatementProfiler* profiler = currentScope->m_profiler;
+    bool first;
+    {
+        std::lock_guard<std::mutex> lock(profiler->m_pendingMutex);
+        first = profiler->m_pending.empty();
+        profiler->m_pending.push_back(std::move(profile));
+    }
+    if(first)
+        emit profiler->profilesPending();
+#else
+    Q_UNUSED(type)
+    Q_UNUSED(p)
+    Q_UNUSED(x)
+#endif
+
+    return 0;
+}
+
+void StatementProfiler::scheduleFlush()
+{
+    if(!m_flushTimer->isActive())
+        m_flushTimer->start();
+}
+
+void StatementProfiler::flush()
+{
+    m_flushTimer->stop();
+
+    std::vector<StatementProfile> batch;
+    {
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        batch.swap(m_pending);
+    }
+    if(batch.empty())
+        return;
+
+    // Only keep the newest profiles of a batch which doesn't fit into the history at all
+    auto first = batch.begin();
+    if(batch.size() > maxHistorySize)
+        first += static_cast<std::ptrdiff_t>(batch.size() - maxHistorySize);
+    const size_t count = static_cast<size_t>(batch.end() - first);
+
+    if(m_history.size() + count > maxHistorySize)
+    {
+        const size_t drop = m_history.size() + count - maxHistorySize;
+        beginRemoveRows(QModelIndex(), 0, static_cast<int>(drop) - 1);
+        m_history.erase(m_history.begin(), m_history.begin() + static_cast<std::ptrdiff_t>(drop));
+        endRemoveRows();
+    }
+
+    const int row = static_cast<int>(m_history.size());
+    beginInsertRows(QModelIndex(), row, row + static_cast<int>(count) - 1);
+    m_history.insert(m_history.end(), std::make_move_iterator(first), std::make_move_iterator(batch.end()));
+    endInsertRows();
+}
+
+void StatementProfiler::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+}
+
+void StatementProfiler::clear()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        m_pending.clear();
+    }
+
+    beginResetModel();
+    m_history.clear();
+    endResetModel();
+}
+
+int StatementProfiler::rowCount(const QModelIndex& parent) const
+{
+    if(parent.isValid())
+        return 0;
+    return static_cast<int>(m_history.size());
+}
+
+int StatementProfiler::columnCount(const QModelIndex& parent) const
+{
+    if(parent.isValid())
+        return 0;
+    return ColumnCount;
+}
+
+QVariant StatementProfiler::data(const QModelIndex& index, int role) const
+{
+    if(!index.isValid() || index.row() >= rowCount())
+        return QVariant();
+
+    const StatementProfile& profile = m_history.at(static_cast<size_t>(index.row()));
+
+    if(role == Qt::DisplayRole)
+    {
+        switch(index.column())
+        {
+        case ColumnSource: return profile.source;
+        case ColumnStatement: return profile.sql.simplified();
+        case ColumnTime: return QString::number(static_cast<double>(profile.nanoseconds) / 1e6, 'f', 3);
+        case ColumnVmSteps: return profile.vmSteps;
+        case ColumnFullScanSteps: return profile.fullScanSteps;
+        case ColumnSortOperations: return profile.sortOperations;
+        case ColumnAutoIndexRows: return profile.autoIndexRows;
+        case ColumnReprepares: return profile.reprepares;
+        case ColumnMemoryUsed: return profile.memoryUsed >= 0 ? QVariant(profile.memoryUsed) : QVariant();
+        case ColumnFinished: return QDateTime::fromMSecsSinceEpoch(profile.finished).toString("hh:mm:ss.zzz");
+        }
+    } else if(role == Qt::ToolTipRole && index.column() == ColumnStatement) {
+        return profile.sql;
+    } else if(role == Qt::TextAlignmentRole && index.column() >= ColumnTime && index.column() <= ColumnMemoryUsed) {
+        return static_cast<int>(Qt::AlignRight | Qt::AlignVCenter);
+    }
+
+    return QVariant();
+}
+
+QVariant StatementProfiler::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if(orientation == Qt::Vertical)
+        return QAbstractTableModel::headerData(section, orientation, role);
+
+    if(role == Qt::DisplayRole)
+    {
+        switch(section)
+        {
+        case ColumnSource: return tr("Source");
+        case ColumnStatement: return tr("Statement");
+        case ColumnTime: return tr("Time (ms)");
+        case ColumnVmSteps: return tr("VM steps");
+        case ColumnFullScanSteps: return tr("Full scan steps");
+        case ColumnSortOperations: return tr("Sorts");
+        case ColumnAutoIndexRows: return tr("Auto index rows");
+        case ColumnReprepares: return tr("Reprepares");
+        case ColumnMemoryUsed: return tr("Memory (bytes)");
+        case ColumnFinished: return tr("Finished");
+        }
+    } else if(role == Qt::ToolTipRole) {
+        switch(section)
+        {
+        case ColumnVmSteps: return tr("Number of virtual machine operations run by the statement. This is a rough measure of the total work done.");
+        case ColumnFullScanSteps: return tr("Number of times the statement stepped forward in a table as part of a full table scan. "
+                                            "Large numbers may indicate that an index would help.");
+        case ColumnSortOperations: return tr("Number of sort operations. These may be avoided by an index.");
+        case ColumnAutoIndexRows: return tr("Number of rows inserted into automatic indexes. SQLite creates these when there is no suitable "
+                                            "index, so a permanent index may be worth adding.");
+        case ColumnReprepares: return tr("Number of times the statement was prepared again because the schema changed.");
+        case ColumnMemoryUsed: return tr("Memory used by the prepared statement.");
+        }
+    }
+
+    return QVariant();
+}
+
+bool StatementProfiler::exportJson(const QString& filename) const
+{
+    json profiles = json::array();
+    for(const StatementProfile& profile : m_history)
+    {
+        json entry;
+        entry["source"] = profile.source.toStdString();
+        entry["sql"] = profile.sql.toStdString();
+        entry["finished"] = QDateTime::fromMSecsSinceEpoch(profile.finished).toString("yyyy-MM-ddTHH:mm:ss.zzz").toStdString();
+        entry["time_ns"] = profile.nanoseconds;
+        entry["vm_steps"] = profile.vmSteps;
+        entry["fullscan_steps"] = profile.fullScanSteps;
+        entry["sort_operations"] = profile.sortOperations;
+        entry["autoindex_rows"] = profile.autoIndexRows;
+        entry["reprepares"] = profile.reprepares;
+        if(profile.memoryUsed >= 0)
+            entry["memory_used"] = profile.memoryUsed;
+        profiles.push_back(entry);
+    }
+
+    QFile file(filename);
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+    const std::string contents = profiles.dump(4);
+    return file.write(contents.c_str(), static_cast<qint64>(contents.size())) == static_cast<qint64>(contents.size());
+}
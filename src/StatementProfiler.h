@@ -0,0 +1,120 @@
+#ifndef STATEMENTPROFILER_H
+#define STATEMENTPROFILER_H
+
+#include <QAbstractTableModel>
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+struct sqlite3;
+class QTimer;
+
+/// Timing and counters of one execution of a prepared statement as reported by SQLite
+struct StatementProfile
+{
+    QString source;                 // What made the application execute the statement
+    QString sql;
+    qint64 finished = 0;            // Milliseconds since the epoch
+    qint64 nanoseconds = 0;
+    int fullScanSteps = 0;          // SQLITE_STMTSTATUS_FULLSCAN_STEP
+    int sortOperations = 0;         // SQLITE_STMTSTATUS_SORT
+    int autoIndexRows = 0;          // SQLITE_STMTSTATUS_AUTOINDEX
+    int vmSteps = 0;                // SQLITE_STMTSTATUS_VM_STEP
+    int reprepares = 0;             // SQLITE_STMTSTATUS_REPREPARE
+    int memoryUsed = -1;            // SQLITE_STMTSTATUS_MEMUSED, -1 if not supported by the SQLite version
+};
+
+/**
+ * @brief The StatementProfiler class
+ * Keeps a history of the statements executed on behalf of one part of the user interface, along with their run time and
+ * the counters SQLite keeps for each prepared statement. The statements are reported by SQLite's trace callback, which
+ * is installed on the database connection. Because the connection is shared by everything in the application, only the
+ * statements executed by threads which have created a Scope object for a profiler end up in its history.
+ * Executing threads only queue the profiles. They are added to the history in batches a few times per second, so
+ * running many small statements doesn't flood the event loop.
+ */
+class StatementProfiler : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    explicit StatementProfiler(QObject* parent = nullptr);
+
+    /**
+     * @brief The Scope class
+     * While an object of this class exists, all statements finished by the thread which created it are recorded by the
+     * profiler. Scopes can be nested; the innermost one wins. A scope without a profiler disables profiling.
+     */
+    class Scope
+    {
+    public:
+        Scope(StatementProfiler* profiler, const QString& source);
+        ~Scope();
+
+    private:
+        friend class StatementProfiler;
+
+        StatementProfiler* m_profiler;
+        QString m_source;
+        Scope* m_previous;
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    enum Columns
+    {
+        ColumnSource,
+        ColumnStatement,
+        ColumnTime,
+        ColumnVmSteps,
+        ColumnFullScanSteps,
+        ColumnSortOperations,
+        ColumnAutoIndexRows,
+        ColumnReprepares,
+        ColumnMemoryUsed,
+        ColumnFinished,
+        ColumnCount
+    };
+
+    /// Sets up the trace callback for the connection. This needs to be done once for each connection
+    static void install(sqlite3* db);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    bool isEnabled() const { return m_enabled; }
+
+    /// Writes the history to a JSON file. \returns false if the file couldn't be written
+    bool exportJson(const QString& filename) const;
+
+public slots:
+    void setEnabled(bool enabled);
+    void clear();
+
+    /// Adds all queued profiles to the history right away
+    void flush();
+
+signals:
+    // Used for telling the thread of the model that there are queued profiles. Don't connect to this
+    void profilesPending();
+
+private slots:
+    void scheduleFlush();
+
+private:
+    std::deque<StatementProfile> m_history;
+    std::atomic<bool> m_enabled;
+
+    std::mutex m_pendingMutex;
+    std::vector<StatementProfile> m_pending;    // Profiles of finished statements which aren't in the history yet
+    QTimer* m_flushTimer;
+
+    static int traceCallback(unsigned int type, void* context, void* p, void* x);
+};
+
+#endif
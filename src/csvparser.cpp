@@ -4,6 +4,7 @@
 
 CSVParser::CSVParser(bool trimfields, char32_t fieldseparator, char32_t quotechar)
     : m_bTrimFields(trimfields)
+    , m_bQuotesOnlyAtFieldStart(false)
     , m_iNumExtraBytesFieldSeparator(0)
     , m_iNumExtraBytesQuoteChar(0)
     , m_pCSVProgress(nullptr)
@@ -174,7 +175,7 @@ CSVParser::ParserResult CSVParser::parse(csvRowFunction insertFunction, QTextStr
                         it += m_iNumExtraBytesFieldSeparator;
                     }
                 }
-                else if(c == m_cQuoteChar[0])
+                else if(c == m_cQuoteChar[0] && (!m_bQuotesOnlyAtFieldStart || field->buffer_length == 0))
                 {
                     if(!m_iNumExtraBytesQuoteChar || look_ahead(stream, sBuffer, &it, &sBufferEnd, m_cQuoteChar[1]))
                     {
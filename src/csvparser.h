@@ -75,6 +75,12 @@ public:
 
     void setCSVProgress(CSVProgress* csvp) { m_pCSVProgress = csvp; }
 
+    /*!
+     * \brief only treat quote characters at the start of a field as the beginning of a quoted field. Quote characters anywhere
+     *        else in an unquoted field are kept as they are. This is how spreadsheet applications write tab separated values.
+     */
+    void setQuotesOnlyAtFieldStart(bool enabled) { m_bQuotesOnlyAtFieldStart = enabled; }
+
 private:
     enum ParseStates
     {
@@ -85,6 +91,7 @@ private:
 
 private:
     bool m_bTrimFields;
+    bool m_bQuotesOnlyAtFieldStart;
     char m_cFieldSeparator[4];
     char m_cQuoteChar[4];
     int m_iNumExtraBytesFieldSeparator;
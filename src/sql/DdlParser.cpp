@@ -0,0 +1,1139 @@
+#include "DdlParser.h"
+#include "grammar/sqlite3TokenTypes.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+#include <initializer_list>
+
+namespace sqlb {
+
+namespace
+{
+
+struct SyntaxError {};
+
+class TokenSet
+{
+public:
+    TokenSet(std::initializer_list<int> types)
+    {
+        for(int t : types)
+            bits.set(static_cast<size_t>(t));
+    }
+
+    TokenSet operator+(const TokenSet& rhs) const
+    {
+        TokenSet result(*this);
+        result.bits |= rhs.bits;
+        return result;
+    }
+
+    TokenSet operator-(const TokenSet& rhs) const
+    {
+        TokenSet result(*this);
+        result.bits &= ~rhs.bits;
+        return result;
+    }
+
+    bool contains(int type) const
+    {
+        return type >= 0 && static_cast<size_t>(type) < bits.size() && bits.test(static_cast<size_t>(type));
+    }
+
+private:
+    std::bitset<128> bits;
+};
+
+using T = sqlite3TokenTypes;
+
+// The names of the imaginary nodes are the same as in the ANTLR grammar because the tree walkers might look at them
+const char* nodeName(int type)
+{
+    switch(type)
+    {
+    case T::TYPE_NAME: return "TYPE_NAME";
+    case T::COLUMNDEF: return "COLUMNDEF";
+    case T::COLUMNCONSTRAINT: return "COLUMNCONSTRAINT";
+    case T::TABLECONSTRAINT: return "TABLECONSTRAINT";
+    case T::CREATETABLE: return "CREATETABLE";
+    case T::CREATEINDEX: return "CREATEINDEX";
+    case T::INDEXEDCOLUMN: return "INDEXEDCOLUMN";
+    case T::KEYWORDASTABLENAME: return "KEYWORDASTABLENAME";
+    case T::KEYWORDASCOLUMNNAME: return "KEYWORDASCOLUMNNAME";
+    default: return "";
+    }
+}
+
+struct Keyword
+{
+    const char* text;
+    int type;
+};
+
+// Sorted by text for the binary search in keywordType()
+const Keyword keywords[] = {
+    {"ABORT", T::ABORT}, {"ACTION", T::ACTION}, {"AND", T::AND}, {"AS", T::AS}, {"ASC", T::ASC},
+    {"AUTOINCREMENT", T::AUTOINCREMENT}, {"BETWEEN", T::BETWEEN}, {"CASCADE", T::CASCADE}, {"CASE", T::CASE_T},
+    {"CAST", T::CAST}, {"CHECK", T::CHECK}, {"COLLATE", T::COLLATE}, {"CONFLICT", T::CONFLICT},
+    {"CONSTRAINT", T::CONSTRAINT}, {"CREATE", T::CREATE}, {"CURRENT_DATE", T::CURRENT_DATE},
+    {"CURRENT_TIME", T::CURRENT_TIME}, {"CURRENT_TIMESTAMP", T::CURRENT_TIMESTAMP}, {"DEFAULT", T::DEFAULT},
+    {"DEFERRABLE", T::DEFERRABLE}, {"DEFERRED", T::DEFERRED}, {"DELETE", T::DELETE}, {"DESC", T::DESC},
+    {"ELSE", T::ELSE_T}, {"END", T::END}, {"ESCAPE", T::ESCAPE}, {"EXISTS", T::EXISTS}, {"FAIL", T::FAIL},
+    {"FILTER", T::FILTER}, {"FOLLOWING", T::FOLLOWING}, {"FOREIGN", T::FOREIGN}, {"GLOB", T::GLOB}, {"IF", T::IF_T},
+    {"IGNORE", T::IGNORE}, {"IMMEDIATE", T::IMMEDIATE}, {"IN", T::IN}, {"INDEX", T::INDEX},
+    {"INITIALLY", T::INITIALLY}, {"INSERT", T::INSERT}, {"IS", T::IS}, {"KEY", T::KEY}, {"LIKE", T::LIKE},
+    {"MATCH", T::MATCH}, {"NO", T::NO}, {"NOT", T::NOT}, {"NULL", T::NULL_T}, {"ON", T::ON}, {"OR", T::OR},
+    {"OVER", T::OVER}, {"PARTITION", T::PARTITION}, {"PRECEDING", T::PRECEDING}, {"PRIMARY", T::PRIMARY},
+    {"RAISE", T::RAISE}, {"RANGE", T::RANGE}, {"REFERENCES", T::REFERENCES}, {"REGEXP", T::REGEXP},
+    {"REPLACE", T::REPLACE}, {"RESTRICT", T::RESTRICT}, {"ROLLBACK", T::ROLLBACK}, {"ROWID", T::ROWID},
+    {"ROWS", T::ROWS}, {"SET", T::SET}, {"TABLE", T::TABLE}, {"TEMP", T::TEMP}, {"TEMPORARY", T::TEMPORARY},
+    {"THEN", T::THEN}, {"UNBOUNDED", T::UNBOUNDED}, {"UNIQUE", T::UNIQUE}, {"UPDATE", T::UPDATE},
+    {"USING", T::USING}, {"VIRTUAL", T::VIRTUAL}, {"WHEN", T::WHEN}, {"WHERE", T::WHERE}, {"WITHOUT", T::WITHOUT},
+};
+
+int keywordType(const char* word, size_t length)
+{
+    // The longest keyword is CURRENT_TIMESTAMP
+    char upper[18];
+    if(length >= sizeof(upper))
+        return T::ID;
+    for(size_t i=0;i<length;i++)
+        upper[i] = (word[i] >= 'a' && word[i] <= 'z') ? static_cast<char>(word[i] - 'a' + 'A') : word[i];
+    upper[length] = 0;
+
+    auto it = std::lower_bound(std::begin(keywords), std::end(keywords), upper, [](const Keyword& k, const char* w) {
+        return std::strcmp(k.text, w) < 0;
+    });
+    if(it != std::end(keywords) && std::strcmp(it->text, upper) == 0)
+        return it->type;
+    return T::ID;
+}
+
+bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+bool isIdStart(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+bool isIdPart(char c)
+{
+    return isIdStart(c) || isDigit(c) || static_cast<unsigned char>(c) >= 0x80;
+}
+
+// The token sets below are the lookahead sets of the ANTLR parser. Using the same sets makes sure that both parsers
+// accept the same statements and split them up in the same way, even where the grammar is ambiguous.
+
+// id, name
+const TokenSet anyId = {T::ID, T::QUOTEDID, T::QUOTEDLITERAL, T::STRINGLITERAL};
+
+// keywordastablename
+const TokenSet keywordAsTableName = {T::ABORT, T::ACTION, T::ASC, T::CASCADE, T::CAST, T::CONFLICT, T::CURRENT_TIME,
+                                     T::CURRENT_DATE, T::CURRENT_TIMESTAMP, T::DEFERRED, T::DESC, T::ELSE_T, T::END,
+                                     T::FAIL, T::FILTER, T::FOLLOWING, T::GLOB, T::KEY, T::LIKE, T::IGNORE,
+                                     T::INITIALLY, T::IMMEDIATE, T::NO, T::MATCH, T::OVER, T::PARTITION,
+                                     T::PRECEDING, T::RAISE, T::RANGE, T::REGEXP, T::REPLACE, T::RESTRICT,
+                                     T::ROLLBACK, T::ROWID, T::ROWS, T::TEMPORARY, T::TEMP, T::UNBOUNDED, T::VIRTUAL,
+                                     T::WITHOUT};
+
+// keywordascolumnname. Unlike table names, column names can be IF but not ELSE.
+const TokenSet keywordAsColumnName = keywordAsTableName - TokenSet{T::ELSE_T} + TokenSet{T::IF_T};
+
+const TokenSet columnName = anyId + keywordAsColumnName;
+
+const TokenSet literalValue = {T::NUMERIC, T::STRINGLITERAL, T::NULL_T, T::CURRENT_TIME, T::CURRENT_DATE,
+                               T::CURRENT_TIMESTAMP};
+
+const TokenSet likeOperator = {T::LIKE, T::GLOB, T::REGEXP, T::MATCH};
+
+const TokenSet binaryOperator = TokenSet{T::OROP, T::STAR, T::SLASH, T::PERCENT, T::PLUS, T::MINUS, T::BITWISELEFT,
+                                         T::BITWISERIGHT, T::AMPERSAND, T::BITOR, T::LOWER, T::LOWEREQUAL, T::GREATER,
+                                         T::GREATEREQUAL, T::EQUAL, T::EQUAL2, T::UNEQUAL, T::UNEQUAL2, T::IS}
+                                + likeOperator;
+
+const TokenSet columnConstraintStart = {T::CHECK, T::COLLATE, T::CONSTRAINT, T::DEFAULT, T::NOT, T::NULL_T, T::PRIMARY,
+                                        T::REFERENCES, T::UNIQUE};
+
+const TokenSet tableConstraintStart = {T::CHECK, T::CONSTRAINT, T::FOREIGN, T::PRIMARY, T::UNIQUE};
+
+// What can follow a column constraint inside a column definition
+const TokenSet columnConstraintFollow = columnConstraintStart + TokenSet{T::FOREIGN, T::RPAREN, T::COMMA};
+
+// The second token of a column constraint
+const TokenSet columnConstraintSecond = anyId + keywordAsTableName
+                                        + TokenSet{T::CHECK, T::COLLATE, T::CONSTRAINT, T::DEFAULT, T::FOREIGN, T::NOT,
+                                                   T::NULL_T, T::ON, T::PRIMARY, T::REFERENCES, T::UNIQUE, T::NUMERIC,
+                                                   T::LPAREN, T::RPAREN, T::COMMA, T::PLUS, T::MINUS};
+
+// The token after the one following a foreign key clause
+const TokenSet foreignKeyFollowSecond = columnConstraintSecond + TokenSet{T::IF_T, T::SEMI, T::EOF_};
+
+// subexpr and expr
+const TokenSet subexprStart = columnName - TokenSet{T::STRINGLITERAL} + literalValue
+                              + TokenSet{T::CASE_T, T::EXISTS, T::NOT, T::PLUS, T::MINUS, T::TILDE};
+const TokenSet exprStart = subexprStart + TokenSet{T::LPAREN};
+
+// The second token of a row value like (a, b) and of a nested expression
+const TokenSet rowValueSecond = subexprStart + TokenSet{T::BETWEEN, T::COLLATE, T::IN, T::WHEN, T::LPAREN, T::COMMA};
+const TokenSet nestedExprSecond = rowValueSecond - TokenSet{T::COMMA} + binaryOperator
+                                  + TokenSet{T::AND, T::OR, T::RPAREN};
+
+// What can follow a subexpr
+const TokenSet subexprFollow = binaryOperator
+                               + TokenSet{T::AND, T::OR, T::EOF_, T::AUTOINCREMENT, T::AS, T::ASC, T::COLLATE, T::DESC,
+                                          T::ELSE_T, T::END, T::ESCAPE, T::THEN, T::WHEN, T::RPAREN, T::COMMA, T::SEMI};
+const TokenSet subexprFollowSecond = TokenSet{T::DEFERRABLE, T::DELETE, T::TABLE, T::INDEX, T::INSERT, T::SET, T::UPDATE,
+                                              T::USING};     // This one is negated
+const TokenSet termFollow = subexprFollow + TokenSet{T::BETWEEN, T::IN, T::NOT};
+
+const TokenSet suffixStart = likeOperator + TokenSet{T::BETWEEN, T::COLLATE, T::IN, T::NOT};
+const TokenSet suffixSecond = exprStart + TokenSet{T::BETWEEN, T::IN};
+
+} // namespace
+
+/**
+ * @brief The DdlParser::Grammar class
+ * One function per rule of the ANTLR grammar. Each of them appends the nodes it creates to the list passed to it.
+ * The rules which have their own node in the tree first collect their nodes in a separate list and then group them.
+ */
+class DdlParser::Grammar : public sqlite3TokenTypes
+{
+public:
+    explicit Grammar(DdlParser& parser)
+        : p(parser),
+          pos(0)
+    {
+        p.m_nodes.clear();
+        p.m_nodes.reserve(p.m_tokens.size() + p.m_tokens.size() / 2);
+    }
+
+    struct List
+    {
+        int first = -1;
+        int last = -1;
+    };
+
+    // Only semicolons are allowed after the statement
+    void end()
+    {
+        while(LA(1) == SEMI)
+            pos++;
+        if(LA(1) != EOF_)
+            throw SyntaxError();
+    }
+
+    int LA(size_t i) const
+    {
+        size_t index = pos + i - 1;
+        if(index >= p.m_tokens.size())
+            return EOF_;
+        return p.m_tokens[index].type;
+    }
+
+    void append(List& list, int node)
+    {
+        if(list.first < 0)
+            list.first = node;
+        else
+            p.m_nodes[static_cast<size_t>(list.last)].nextSibling = node;
+        list.last = node;
+    }
+
+    void match(List& list, int type)
+    {
+        if(LA(1) != type)
+            throw SyntaxError();
+        p.m_nodes.push_back({type, static_cast<int>(pos), -1, -1});
+        append(list, static_cast<int>(p.m_nodes.size() - 1));
+        pos++;
+    }
+
+    void matchAny(List& list)
+    {
+        match(list, LA(1));
+    }
+
+    void group(List& list, int type, const List& children)
+    {
+        p.m_nodes.push_back({type, -1, children.first, -1});
+        append(list, static_cast<int>(p.m_nodes.size() - 1));
+    }
+
+    void id(List& list)
+    {
+        if(!anyId.contains(LA(1)))
+            throw SyntaxError();
+        matchAny(list);
+    }
+
+    void keywordastablename(List& list)
+    {
+        if(!keywordAsTableName.contains(LA(1)))
+            throw SyntaxError();
+        List l;
+        matchAny(l);
+        group(list, KEYWORDASTABLENAME, l);
+    }
+
+    void keywordascolumnname(List& list)
+    {
+        if(!keywordAsColumnName.contains(LA(1)))
+            throw SyntaxError();
+        List l;
+        matchAny(l);
+        group(list, KEYWORDASCOLUMNNAME, l);
+    }
+
+    void tablenameOrKeyword(List& list)
+    {
+        if(anyId.contains(LA(1)))
+            id(list);
+        else
+            keywordastablename(list);
+    }
+
+    void columnname(List& list)
+    {
+        if(anyId.contains(LA(1)))
+            id(list);
+        else
+            keywordascolumnname(list);
+    }
+
+    void signednumber(List& list)
+    {
+        if(LA(1) == PLUS || LA(1) == MINUS)
+            matchAny(list);
+        match(list, NUMERIC);
+    }
+
+    void ifNotExists(List& list)
+    {
+        if(LA(1) == IF_T)
+        {
+            match(list, IF_T);
+            match(list, NOT);
+            match(list, EXISTS);
+        }
+    }
+
+    void createtable(List& list)
+    {
+        if(LA(1) == CREATE && (LA(2) == TABLE || LA(2) == TEMPORARY || LA(2) == TEMP))
+        {
+            List l;
+            match(l, CREATE);
+            if(LA(1) == TEMP || LA(1) == TEMPORARY)
+                matchAny(l);
+            match(l, TABLE);
+            ifNotExists(l);
+            tablenameOrKeyword(l);
+
+            // CREATE TABLE ... AS SELECT isn't supported by the grammar
+            match(l, LPAREN);
+            columndef(l);
+            while(LA(1) == COMMA && columnName.contains(LA(2)))
+            {
+                match(l, COMMA);
+                columndef(l);
+            }
+            while(LA(1) == COMMA || tableConstraintStart.contains(LA(1)))
+            {
+                if(LA(1) == COMMA)
+                    match(l, COMMA);
+                tableconstraint(l);
+            }
+            match(l, RPAREN);
+            if(LA(1) == WITHOUT)
+            {
+                match(l, WITHOUT);
+                match(l, ROWID);
+            }
+
+            group(list, CREATETABLE, l);
+        } else if(LA(1) == CREATE && LA(2) == VIRTUAL) {
+            // Virtual tables don't get a node of their own
+            match(list, CREATE);
+            match(list, VIRTUAL);
+            match(list, TABLE);
+            ifNotExists(list);
+            tablenameOrKeyword(list);
+            match(list, USING);
+            id(list);
+            if(LA(1) == LPAREN)
+            {
+                match(list, LPAREN);
+                if(exprStart.contains(LA(1)))
+                {
+                    expr(list);
+                    while(LA(1) == COMMA)
+                    {
+                        match(list, COMMA);
+                        expr(list);
+                    }
+                }
+                match(list, RPAREN);
+            }
+        } else {
+            throw SyntaxError();
+        }
+    }
+
+    void createindex(List& list)
+    {
+        List l;
+        match(l, CREATE);
+        if(LA(1) == UNIQUE)
+            match(l, UNIQUE);
+        match(l, INDEX);
+        ifNotExists(l);
+        tablenameOrKeyword(l);
+        match(l, ON);
+        tablenameOrKeyword(l);
+        match(l, LPAREN);
+        indexedcolumn(l);
+        while(LA(1) == COMMA)
+        {
+            match(l, COMMA);
+            indexedcolumn(l);
+        }
+        match(l, RPAREN);
+        if(LA(1) == WHERE)
+        {
+            match(l, WHERE);
+            expr(l);
+        }
+        group(list, CREATEINDEX, l);
+    }
+
+    void columndef(List& list)
+    {
+        List l;
+        columnname(l);
+        if(anyId.contains(LA(1)) || keywordAsTableName.contains(LA(1)))
+            type_name(l);
+        while(columnConstraintStart.contains(LA(1)) && columnConstraintSecond.contains(LA(2)))
+            columnconstraint(l);
+        group(list, COLUMNDEF, l);
+    }
+
+    void type_name(List& list)
+    {
+        List l;
+        do
+        {
+            tablenameOrKeyword(l);
+        } while(anyId.contains(LA(1)) || keywordAsTableName.contains(LA(1)));
+        if(LA(1) == LPAREN)
+        {
+            match(l, LPAREN);
+            signednumber(l);
+            if(LA(1) == COMMA)
+            {
+                match(l, COMMA);
+                signednumber(l);
+            }
+            match(l, RPAREN);
+        }
+        group(list, TYPE_NAME, l);
+    }
+
+    void conflictclause(List& list)
+    {
+        match(list, ON);
+        match(list, CONFLICT);
+        switch(LA(1))
+        {
+        case ROLLBACK:
+        case ABORT:
+        case FAIL:
+        case IGNORE:
+        case REPLACE:
+            matchAny(list);
+            break;
+        default:
+            throw SyntaxError();
+        }
+    }
+
+    void columnconstraint(List& list)
+    {
+        List l;
+        if(LA(1) == CONSTRAINT)
+        {
+            match(l, CONSTRAINT);
+            id(l);
+        }
+
+        switch(LA(1))
+        {
+        case PRIMARY:
+            match(l, PRIMARY);
+            match(l, KEY);
+            if(LA(1) == ASC || LA(1) == DESC)
+                matchAny(l);
+            if(LA(1) == ON)
+                conflictclause(l);
+            if(LA(1) == AUTOINCREMENT)
+                match(l, AUTOINCREMENT);
+            break;
+        case NOT:
+        case NULL_T:
+            if(LA(1) == NOT)
+                match(l, NOT);
+            match(l, NULL_T);
+            if(LA(1) == ON)
+                conflictclause(l);
+            break;
+        case UNIQUE:
+            match(l, UNIQUE);
+            if(LA(1) == ON)
+                conflictclause(l);
+            break;
+        case CHECK:
+            match(l, CHECK);
+            match(l, LPAREN);
+            expr(l);
+            match(l, RPAREN);
+            break;
+        case DEFAULT:
+            match(l, DEFAULT);
+            if(LA(1) == QUOTEDLITERAL || LA(1) == ID)
+            {
+                matchAny(l);
+            } else if(LA(1) == LPAREN) {
+                match(l, LPAREN);
+                expr(l);
+                match(l, RPAREN);
+            } else if(literalValue.contains(LA(1)) && columnConstraintFollow.contains(LA(2))) {
+                matchAny(l);
+            } else if(keywordAsTableName.contains(LA(1)) && columnConstraintFollow.contains(LA(2))) {
+                keywordastablename(l);
+            } else if((LA(1) == NUMERIC || LA(1) == PLUS || LA(1) == MINUS) &&
+                      (LA(2) == NUMERIC || columnConstraintFollow.contains(LA(2)))) {
+                signednumber(l);
+            } else {
+                throw SyntaxError();
+            }
+            break;
+        case COLLATE:
+            match(l, COLLATE);
+            match(l, ID);
+            break;
+        case REFERENCES:
+            foreignkeyclause(l);
+            break;
+        default:
+            throw SyntaxError();
+        }
+
+        group(list, COLUMNCONSTRAINT, l);
+    }
+
+    void tableconstraint(List& list)
+    {
+        List l;
+        if(LA(1) == CONSTRAINT)
+        {
+            match(l, CONSTRAINT);
+            id(l);
+        }
+
+        switch(LA(1))
+        {
+        case PRIMARY:
+        case UNIQUE:
+            if(LA(1) == PRIMARY)
+            {
+                match(l, PRIMARY);
+                match(l, KEY);
+            } else {
+                match(l, UNIQUE);
+            }
+            match(l, LPAREN);
+            indexedcolumn(l);
+            while(LA(1) == COMMA)
+            {
+                match(l, COMMA);
+                indexedcolumn(l);
+            }
+            match(l, RPAREN);
+            if(LA(1) == ON)
+                conflictclause(l);
+            break;
+        case CHECK:
+            match(l, CHECK);
+            match(l, LPAREN);
+            expr(l);
+            match(l, RPAREN);
+            break;
+        case FOREIGN:
+            match(l, FOREIGN);
+            match(l, KEY);
+            match(l, LPAREN);
+            columnname(l);
+            while(LA(1) == COMMA)
+            {
+                match(l, COMMA);
+                columnname(l);
+            }
+            match(l, RPAREN);
+            foreignkeyclause(l);
+            break;
+        default:
+            throw SyntaxError();
+        }
+
+        group(list, TABLECONSTRAINT, l);
+    }
+
+    void foreignkeyclause(List& list)
+    {
+        match(list, REFERENCES);
+        id(list);
+        if(LA(1) == LPAREN)
+        {
+            match(list, LPAREN);
+            columnname(list);
+            while(LA(1) == COMMA)
+            {
+                match(list, COMMA);
+                columnname(list);
+            }
+            match(list, RPAREN);
+        }
+
+        for(;;)
+        {
+            if(LA(1) == ON)
+            {
+                match(list, ON);
+                if(LA(1) != DELETE && LA(1) != UPDATE && LA(1) != INSERT)
+                    throw SyntaxError();
+                matchAny(list);
+                switch(LA(1))
+                {
+                case SET:
+                    match(list, SET);
+                    if(LA(1) != NULL_T && LA(1) != DEFAULT)
+                        throw SyntaxError();
+                    matchAny(list);
+                    break;
+                case CASCADE:
+                case RESTRICT:
+                    matchAny(list);
+                    break;
+                case NO:
+                    match(list, NO);
+                    match(list, ACTION);
+                    break;
+                default:
+                    throw SyntaxError();
+                }
+            } else if(LA(1) == MATCH) {
+                match(list, MATCH);
+                id(list);
+            } else {
+                break;
+            }
+        }
+
+        if(LA(1) == NOT && LA(2) == DEFERRABLE)
+        {
+            match(list, NOT);
+            match(list, DEFERRABLE);
+            if(LA(1) == INITIALLY)
+            {
+                match(list, INITIALLY);
+                if(LA(1) != DEFERRED && LA(1) != IMMEDIATE)
+                    throw SyntaxError();
+                matchAny(list);
+            }
+        } else if(LA(1) == DEFERRABLE) {
+            match(list, DEFERRABLE);
+            match(list, INITIALLY);
+            if(LA(1) != DEFERRED && LA(1) != IMMEDIATE)
+                throw SyntaxError();
+            matchAny(list);
+        } else if(!columnConstraintFollow.contains(LA(1)) || !foreignKeyFollowSecond.contains(LA(2))) {
+            throw SyntaxError();
+        }
+    }
+
+    void indexedcolumn(List& list)
+    {
+        List l;
+        expr(l);
+        if(LA(1) == COLLATE)
+        {
+            match(l, COLLATE);
+            match(l, ID);
+        }
+        if(LA(1) == ASC || LA(1) == DESC)
+            matchAny(l);
+        if(LA(1) == AUTOINCREMENT)
+            match(l, AUTOINCREMENT);
+        group(list, INDEXEDCOLUMN, l);
+    }
+
+    void expr(List& list)
+    {
+        if(LA(1) == LPAREN)
+        {
+            match(list, LPAREN);
+            if(subexprStart.contains(LA(1)) && rowValueSecond.contains(LA(2)))
+            {
+                // Row value comparison: (a, b) = (c, d)
+                rowValue(list);
+                match(list, RPAREN);
+                if(!binaryOperator.contains(LA(1)))
+                    throw SyntaxError();
+                matchAny(list);
+                match(list, LPAREN);
+                rowValue(list);
+            } else if(exprStart.contains(LA(1)) && nestedExprSecond.contains(LA(2))) {
+                expr(list);
+            } else {
+                throw SyntaxError();
+            }
+            match(list, RPAREN);
+
+            while((LA(1) == AND || LA(1) == OR) && exprStart.contains(LA(2)))
+            {
+                matchAny(list);
+                expr(list);
+            }
+        } else if(subexprStart.contains(LA(1))) {
+            subexpr(list);
+            while((binaryOperator.contains(LA(1)) || LA(1) == AND || LA(1) == OR) && subexprStart.contains(LA(2)))
+            {
+                matchAny(list);
+                subexpr(list);
+            }
+        } else {
+            throw SyntaxError();
+        }
+    }
+
+    // subexpr (COMMA subexpr)+
+    void rowValue(List& list)
+    {
+        subexpr(list);
+        if(LA(1) != COMMA)
+            throw SyntaxError();
+        while(LA(1) == COMMA)
+        {
+            match(list, COMMA);
+            subexpr(list);
+        }
+    }
+
+    // (expr (COMMA expr)*)? RPAREN
+    void exprListAndClose(List& list)
+    {
+        if(exprStart.contains(LA(1)))
+        {
+            expr(list);
+            while(LA(1) == COMMA)
+            {
+                match(list, COMMA);
+                expr(list);
+            }
+        }
+        match(list, RPAREN);
+    }
+
+    void subexpr(List& list)
+    {
+        if(LA(1) == MINUS || LA(1) == PLUS || LA(1) == TILDE || LA(1) == NOT)
+            matchAny(list);
+
+        if(LA(1) == EXISTS)
+        {
+            match(list, EXISTS);
+            match(list, LPAREN);
+            if(!exprStart.contains(LA(1)))     // SELECT statements aren't supported by the grammar
+                throw SyntaxError();
+            expr(list);
+            match(list, RPAREN);
+        } else if(LA(1) == CASE_T) {
+            caseexpr(list);
+        } else if(literalValue.contains(LA(1)) && termFollow.contains(LA(2))) {
+            matchAny(list);
+        } else if(columnName.contains(LA(1)) && termFollow.contains(LA(2))) {
+            // Qualified column names aren't supported because the lexer doesn't know about dots
+            columnname(list);
+        } else if(anyId.contains(LA(1)) && LA(2) == LPAREN) {
+            // Function call
+            matchAny(list);
+            match(list, LPAREN);
+            exprListAndClose(list);
+        } else if(LA(1) == CAST && LA(2) == LPAREN) {
+            match(list, CAST);
+            match(list, LPAREN);
+            expr(list);
+            match(list, AS);
+            type_name(list);
+            match(list, RPAREN);
+        } else if(LA(1) == RAISE && LA(2) == LPAREN) {
+            raisefunction(list);
+        } else {
+            throw SyntaxError();
+        }
+
+        if(suffixStart.contains(LA(1)) && suffixSecond.contains(LA(2)))
+            suffixexpr(list);
+        else if(!subexprFollow.contains(LA(1)) || subexprFollowSecond.contains(LA(2)))
+            throw SyntaxError();
+    }
+
+    void caseexpr(List& list)
+    {
+        match(list, CASE_T);
+        if(exprStart.contains(LA(1)))
+            expr(list);
+        if(LA(1) != WHEN)
+            throw SyntaxError();
+        while(LA(1) == WHEN)
+        {
+            match(list, WHEN);
+            expr(list);
+            match(list, THEN);
+            expr(list);
+        }
+        if(LA(1) == ELSE_T)
+        {
+            match(list, ELSE_T);
+            expr(list);
+        }
+        match(list, END);
+    }
+
+    void raisefunction(List& list)
+    {
+        match(list, RAISE);
+        match(list, LPAREN);
+        if(LA(1) == IGNORE)
+        {
+            match(list, IGNORE);
+        } else if(LA(1) == ROLLBACK || LA(1) == ABORT || LA(1) == FAIL) {
+            matchAny(list);
+            match(list, COMMA);
+            match(list, STRINGLITERAL);
+        } else {
+            throw SyntaxError();
+        }
+        match(list, RPAREN);
+    }
+
+    void suffixexpr(List& list)
+    {
+        if(LA(1) == COLLATE)
+        {
+            match(list, COLLATE);
+            match(list, ID);
+            return;
+        }
+
+        if(LA(1) == NOT)
+            match(list, NOT);
+
+        if(LA(1) == BETWEEN)
+        {
+            match(list, BETWEEN);
+            subexpr(list);
+            while(binaryOperator.contains(LA(1)) || LA(1) == OR)
+            {
+                matchAny(list);
+                subexpr(list);
+            }
+            match(list, AND);
+            expr(list);
+        } else if(LA(1) == IN) {
+            match(list, IN);
+            if(LA(1) == LPAREN)
+            {
+                match(list, LPAREN);
+                exprListAndClose(list);
+            } else {
+                id(list);
+            }
+        } else if(likeOperator.contains(LA(1))) {
+            matchAny(list);
+            subexpr(list);
+            if(LA(1) == ESCAPE && subexprStart.contains(LA(2)))
+            {
+                match(list, ESCAPE);
+                subexpr(list);
+            } else if(!subexprFollow.contains(LA(1)) || subexprFollowSecond.contains(LA(2))) {
+                throw SyntaxError();
+            }
+        } else {
+            throw SyntaxError();
+        }
+    }
+
+private:
+    DdlParser& p;
+    size_t pos;
+};
+
+bool DdlParser::tokenize(const std::string& sql)
+{
+    m_sql = &sql;
+    m_tokens.clear();
+    m_tokens.reserve(sql.size() / 4);
+
+    const char* const text = sql.data();
+    const size_t size = sql.size();
+    size_t i = 0;
+
+    auto add = [this, &i](int type, size_t begin) {
+        m_tokens.push_back({type, begin, i - begin});
+    };
+
+    // Reads a quoted string. Two quote characters in a row are an escaped quote unless the closing character is different
+    // from the opening one, like for square brackets.
+    auto quoted = [text, size, &i](char close) {
+        const bool escapable = text[i] == close;
+        for(i++;i<size;i++)
+        {
+            if(text[i] == close)
+            {
+                if(escapable && i + 1 < size && text[i+1] == close)
+                    i++;
+                else
+                    return ++i, true;
+            }
+        }
+        return false;
+    };
+
+    auto digits = [text, size, &i]() {
+        size_t start = i;
+        while(i < size && isDigit(text[i]))
+            i++;
+        return i > start;
+    };
+
+    auto next = [text, size, &i](size_t offset) {
+        return i + offset < size ? text[i + offset] : 0;
+    };
+
+    while(i < size)
+    {
+        const size_t begin = i;
+        const char c = text[i];
+
+        switch(c)
+        {
+        case ' ':
+        case '\t':
+        case '\f':
+        case '\r':
+        case '\n':
+            i++;
+            break;
+        case '-':
+            if(next(1) == '-')
+            {
+                // A single line comment needs to be terminated by a line break
+                while(i < size && text[i] != '\n' && text[i] != '\r')
+                    i++;
+                if(i == size)
+                    return false;
+                i++;
+            } else {
+                i++;
+                add(T::MINUS, begin);
+            }
+            break;
+        case '/':
+            if(next(1) != '*')
+                return false;
+            for(i+=2;;i++)
+            {
+                if(i + 1 >= size)
+                    return false;
+                if(text[i] == '*' && text[i+1] == '/')
+                    break;
+            }
+            i += 2;
+            break;
+        case '`':
+            if(!quoted('`'))
+                return false;
+            add(T::QUOTEDID, begin);
+            break;
+        case '[':
+            if(!quoted(']'))
+                return false;
+            add(T::QUOTEDID, begin);
+            break;
+        case '"':
+            if(!quoted('"'))
+                return false;
+            add(T::QUOTEDLITERAL, begin);
+            break;
+        case '\'':
+            if(!quoted('\''))
+                return false;
+            add(T::STRINGLITERAL, begin);
+            break;
+        case '(': i++; add(T::LPAREN, begin); break;
+        case ')': i++; add(T::RPAREN, begin); break;
+        case ',': i++; add(T::COMMA, begin); break;
+        case ';': i++; add(T::SEMI, begin); break;
+        case '+': i++; add(T::PLUS, begin); break;
+        case '*': i++; add(T::STAR, begin); break;
+        case '~': i++; add(T::TILDE, begin); break;
+        case '&': i++; add(T::AMPERSAND, begin); break;
+        case '|':
+            i += next(1) == '|' ? 2 : 1;
+            add(i - begin == 2 ? T::OROP : T::BITOR, begin);
+            break;
+        case '=':
+            i += next(1) == '=' ? 2 : 1;
+            add(i - begin == 2 ? T::EQUAL2 : T::EQUAL, begin);
+            break;
+        case '!':
+            if(next(1) != '=')
+                return false;
+            i += 2;
+            add(T::UNEQUAL, begin);
+            break;
+        case '<':
+            switch(next(1))
+            {
+            case '=': i += 2; add(T::LOWEREQUAL, begin); break;
+            case '>': i += 2; add(T::UNEQUAL2, begin); break;
+            case '<': i += 2; add(T::BITWISELEFT, begin); break;
+            default: i++; add(T::LOWER, begin);
+            }
+            break;
+        case '>':
+            switch(next(1))
+            {
+            case '=': i += 2; add(T::GREATEREQUAL, begin); break;
+            case '>': i += 2; add(T::BITWISERIGHT, begin); break;
+            default: i++; add(T::GREATER, begin);
+            }
+            break;
+        default:
+            if(isIdStart(c))
+            {
+                while(i < size && isIdPart(text[i]))
+                    i++;
+                add(keywordType(text + begin, i - begin), begin);
+            } else if(isDigit(c) || c == '.') {
+                if(c == '.')
+                {
+                    i++;
+                    if(!digits())
+                        return false;
+                } else {
+                    digits();
+                    if(next(0) == '.')
+                    {
+                        i++;
+                        digits();
+                    }
+                }
+
+                // Once there is an 'e' after the number it has to be an exponent
+                if(next(0) == 'e' || next(0) == 'E')
+                {
+                    i++;
+                    if(next(0) == '+' || next(0) == '-')
+                        i++;
+                    if(!digits())
+                        return false;
+                }
+                add(T::NUMERIC, begin);
+            } else {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool DdlParser::parseCreateTable(const std::string& sql)
+{
+    if(!tokenize(sql))
+        return false;
+
+    try
+    {
+        Grammar g(*this);
+        Grammar::List list;
+        g.createtable(list);
+        g.end();
+        m_root = list.first;
+        return true;
+    } catch(const SyntaxError&) {
+        return false;
+    }
+}
+
+bool DdlParser::parseCreateIndex(const std::string& sql)
+{
+    if(!tokenize(sql))
+        return false;
+
+    try
+    {
+        Grammar g(*this);
+        Grammar::List list;
+        g.createindex(list);
+        g.end();
+        m_root = list.first;
+        return true;
+    } catch(const SyntaxError&) {
+        return false;
+    }
+}
+
+// Like with the ANTLR nodes, calling the accessors of an empty node is an error. But instead of crashing they return an empty
+// node or text then.
+
+int DdlParser::Node::getType() const
+{
+    if(m_index < 0)
+        return 0;
+    return m_parser->m_nodes[static_cast<size_t>(m_index)].type;
+}
+
+std::string DdlParser::Node::getText() const
+{
+    if(m_index < 0)
+        return std::string();
+
+    const NodeData& n = m_parser->m_nodes[static_cast<size_t>(m_index)];
+    if(n.token < 0)
+        return nodeName(n.type);
+
+    const Token& t = m_parser->m_tokens[static_cast<size_t>(n.token)];
+    return m_parser->m_sql->substr(t.begin, t.length);
+}
+
+DdlParser::Node DdlParser::Node::getFirstChild() const
+{
+    if(m_index < 0)
+        return Node();
+    return Node(m_parser, m_parser->m_nodes[static_cast<size_t>(m_index)].firstChild);
+}
+
+DdlParser::Node DdlParser::Node::getNextSibling() const
+{
+    if(m_index < 0)
+        return Node();
+    return Node(m_parser, m_parser->m_nodes[static_cast<size_t>(m_index)].nextSibling);
+}
+
+} //namespace sqlb
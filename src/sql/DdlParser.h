@@ -0,0 +1,96 @@
+#ifndef DDLPARSER_H
+#define DDLPARSER_H
+
+#include <string>
+#include <vector>
+
+namespace sqlb {
+
+/**
+ * @brief The DdlParser class
+ * A hand-written recursive descent parser for CREATE TABLE and CREATE INDEX statements. It accepts exactly the same
+ * statements as the ANTLR grammar in src/grammar/sqlite3.g, takes the same decisions when the grammar is ambiguous, and
+ * builds a syntax tree of the same shape. This way the tree walkers in sqlitetypes.cpp can be used for the output of
+ * both parsers.
+ *
+ * Unlike the ANTLR parser it doesn't allocate anything per token or per node: all tokens and nodes are stored in two
+ * arrays which refer to the text of the statement instead of copying it. It doesn't depend on the current locale either.
+ *
+ * When a statement is rejected, this doesn't mean the ANTLR parser rejects it too. Statements which can't be tokenised
+ * up front or which are followed by anything but semicolons are rejected even though the ANTLR parser, which stops
+ * reading once it is done, might accept them. So the ANTLR parser should be used whenever this one gives up.
+ */
+class DdlParser
+{
+public:
+    /**
+     * @brief The Node class
+     * A reference to a node of the syntax tree. It mimics the parts of the antlr::RefAST interface which are used by
+     * the tree walkers. It is only valid for as long as the parser and the parsed statement exist.
+     */
+    class Node
+    {
+    public:
+        Node() : m_parser(nullptr), m_index(-1) {}
+
+        explicit operator bool() const { return m_index >= 0; }
+        const Node* operator->() const { return this; }
+
+        int getType() const;
+        std::string getText() const;
+        Node getFirstChild() const;
+        Node getNextSibling() const;
+
+    private:
+        friend class DdlParser;
+        Node(const DdlParser* parser, int index) : m_parser(parser), m_index(index) {}
+
+        const DdlParser* m_parser;
+        int m_index;
+    };
+
+    /**
+     * @brief parseCreateTable Parses a CREATE TABLE or CREATE VIRTUAL TABLE statement
+     * @param sql The statement. It must outlive the syntax tree.
+     * @return true if the statement was parsed successfully and the syntax tree can be retrieved using root().
+     */
+    bool parseCreateTable(const std::string& sql);
+
+    /**
+     * @brief parseCreateIndex Parses a CREATE INDEX statement
+     * @param sql The statement. It must outlive the syntax tree.
+     * @return true if the statement was parsed successfully and the syntax tree can be retrieved using root().
+     */
+    bool parseCreateIndex(const std::string& sql);
+
+    Node root() const { return Node(this, m_root); }
+
+private:
+    struct Token
+    {
+        int type;
+        size_t begin;
+        size_t length;
+    };
+
+    struct NodeData
+    {
+        int type;
+        int token;          // -1 for the imaginary nodes which group the nodes of a rule
+        int firstChild;
+        int nextSibling;
+    };
+
+    const std::string* m_sql = nullptr;
+    std::vector<Token> m_tokens;
+    std::vector<NodeData> m_nodes;
+    int m_root = -1;
+
+    bool tokenize(const std::string& sql);
+
+    class Grammar;
+};
+
+} //namespace sqlb
+
+#endif
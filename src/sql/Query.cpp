@@ -1,6 +1,154 @@
 #include "Query.h"
 
 #include <algorithm>
+#include <cctype>
+
+namespace
+{
+
+// A token of an SQL statement. Only words, identifiers and parentheses are of interest for rewriting a statement, so
+// everything else is lumped together.
+struct Token
+{
+    enum Type
+    {
+        Word,           // keywords and unquoted identifiers; the text is converted to lower case
+        Identifier,     // quoted identifiers; the text is unquoted and converted to lower case
+        Literal,        // strings, blobs and numbers
+        OpenParen,
+        CloseParen,
+        Comma,
+        Other           // operators, bind parameters, etc.
+    };
+
+    Type type;
+    std::string text;
+    size_t begin;
+    size_t end;         // exclusive
+    int depth;          // nesting level of parentheses
+};
+
+bool isWordChar(char c)
+{
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$' || static_cast<unsigned char>(c) >= 0x80;
+}
+
+std::string toLower(std::string str)
+{
+    std::transform(str.begin(), str.end(), str.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+    return str;
+}
+
+// Splits the statement into tokens following the lexical rules of SQLite. Returns false if the statement can't be
+// tokenized, e.g. because of an unterminated string.
+bool tokenize(const std::string& sql, std::vector<Token>& tokens)
+{
+    int depth = 0;
+    size_t i = 0;
+    while(i < sql.size())
+    {
+        const char c = sql[i];
+        const size_t begin = i;
+
+        if(std::isspace(static_cast<unsigned char>(c)))
+        {
+            i++;
+            continue;
+        }
+
+        // Comments
+        if(c == '-' && i + 1 < sql.size() && sql[i+1] == '-')
+        {
+            i = sql.find('\n', i);
+            if(i == std::string::npos)
+                i = sql.size();
+            continue;
+        }
+        if(c == '/' && i + 1 < sql.size() && sql[i+1] == '*')
+        {
+            i = sql.find("*/", i + 2);
+            if(i == std::string::npos)
+                return false;
+            i += 2;
+            continue;
+        }
+
+        if(c == '\'' || c == '"' || c == '`' || c == '[')
+        {
+            // Quoted strings and identifiers. Except for brackets, the quote character is escaped by doubling it.
+            const char close = c == '[' ? ']' : c;
+            std::string text;
+            i++;
+            for(;;)
+            {
+                if(i >= sql.size())
+                    return false;
+                if(sql[i] == close)
+                {
+                    if(close != ']' && i + 1 < sql.size() && sql[i+1] == close)
+                    {
+                        text += close;
+                        i += 2;
+                        continue;
+                    }
+                    i++;
+                    break;
+                }
+                text += sql[i++];
+            }
+            tokens.push_back({c == '\'' ? Token::Literal : Token::Identifier, toLower(text), begin, i, depth});
+        } else if(std::isdigit(static_cast<unsigned char>(c)) || (c == '.' && i + 1 < sql.size() && std::isdigit(static_cast<unsigned char>(sql[i+1])))) {
+            while(i < sql.size() && (isWordChar(sql[i]) || sql[i] == '.'))
+                i++;
+            tokens.push_back({Token::Literal, std::string(), begin, i, depth});
+        } else if((c == 'x' || c == 'X') && i + 1 < sql.size() && sql[i+1] == '\'') {
+            // Blob literal
+            i = sql.find('\'', i + 2);
+            if(i == std::string::npos)
+                return false;
+            i++;
+            tokens.push_back({Token::Literal, std::string(), begin, i, depth});
+        } else if(isWordChar(c)) {
+            while(i < sql.size() && isWordChar(sql[i]))
+                i++;
+            tokens.push_back({Token::Word, toLower(sql.substr(begin, i - begin)), begin, i, depth});
+        } else if(c == '?' || c == ':' || c == '@' || c == '$') {
+            // Bind parameters. Their names must not be mistaken for words.
+            i++;
+            while(i < sql.size() && isWordChar(sql[i]))
+                i++;
+            tokens.push_back({Token::Other, std::string(), begin, i, depth});
+        } else if(c == '(') {
+            tokens.push_back({Token::OpenParen, std::string(), begin, ++i, depth++});
+        } else if(c == ')') {
+            if(depth == 0)
+                return false;
+            tokens.push_back({Token::CloseParen, std::string(), begin, ++i, --depth});
+        } else if(c == ',') {
+            tokens.push_back({Token::Comma, std::string(), begin, ++i, depth});
+        } else {
+            tokens.push_back({Token::Other, std::string(1, c), begin, ++i, depth});
+        }
+    }
+
+    return depth == 0;
+}
+
+bool isWord(const std::vector<Token>& tokens, size_t i, const std::string& word)
+{
+    return i < tokens.size() && tokens[i].type == Token::Word && tokens[i].text == word;
+}
+
+// Keywords which may be followed by an opening parenthesis without being a function call
+bool isKeywordBeforeParenthesis(const std::string& word)
+{
+    static const std::vector<std::string> keywords = {
+        "and", "between", "case", "cast", "else", "exists", "in", "is", "not", "or", "then", "when"
+    };
+    return std::find(keywords.begin(), keywords.end(), word) != keywords.end();
+}
+
+} // anon ns
 
 namespace sqlb
 {
@@ -11,6 +159,7 @@ void Query::clear()
     m_rowid_columns = {"_rowid_"};
     m_selected_columns.clear();
     m_where.clear();
+    m_filter_values.clear();
     m_sort.clear();
 }
 
@@ -36,25 +185,47 @@ std::string Query::buildWherePart() const
     return where;
 }
 
+std::string Query::buildRowidPart() const
+{
+    // In case there are multiple rowid columns, all of them are selected as separate columns. It's up to the caller to combine
+    // them into a single value; see rowIdColumns().size() for the number of leading result columns which belong to the rowid.
+    std::string selector;
+    for(size_t i=0;i<m_rowid_columns.size();i++)
+        selector += sqlb::escapeIdentifier(m_rowid_columns.at(i)) + ",";
+    selector.pop_back();    // Remove the last comma
+    return selector;
+}
+
+std::string Query::buildOrderByPart() const
+{
+    std::string order_by;
+    for(const auto& sorted_column : m_sort)
+    {
+        if(sorted_column.column < m_column_names.size())
+            order_by += sqlb::escapeIdentifier(m_column_names.at(sorted_column.column)) + " "
+                    + (sorted_column.direction == sqlb::Ascending ? "ASC" : "DESC") + ",";
+    }
+
+    // Without a unique sort order SQLite may return the rows in a different order for each query, e.g. when a covering index
+    // is used for some of the selected columns only. Because rows are fetched in chunks and only some of the columns at a time,
+    // always sort by the rowid last. This is free for unsorted tables which are scanned in rowid order anyway.
+    for(const auto& rowid : m_rowid_columns)
+        order_by += sqlb::escapeIdentifier(rowid) + " ASC,";
+
+    if(order_by.size())
+    {
+        order_by.pop_back();
+        order_by = "ORDER BY " + order_by;
+    }
+    return order_by;
+}
+
 std::string Query::buildQuery(bool withRowid) const
 {
     // Selector and display formats
     std::string selector;
     if (withRowid)
-    {
-        // We select the rowid data into a JSON array in case there are multiple rowid columns in order to have all values at hand.
-        // If there is only one rowid column, we leave it as is.
-        if(m_rowid_columns.size() == 1)
-        {
-            selector = sqlb::escapeIdentifier(m_rowid_columns.at(0)) + ",";
-        } else {
-            selector += "sqlb_make_single_value(";
-            for(size_t i=0;i<m_rowid_columns.size();i++)
-                selector += sqlb::escapeIdentifier(m_rowid_columns.at(i)) + ",";
-            selector.pop_back();    // Remove the last comma
-            selector += "),";
-        }
-    }
+        selector = buildRowidPart() + ",";
 
     if(m_selected_columns.empty())
     {
@@ -70,24 +241,35 @@ std::string Query::buildQuery(bool withRowid) const
         selector.pop_back();
     }
 
-    // Filter
-    std::string where = buildWherePart();
+    return "SELECT " + selector + " FROM " + m_table.toString() + " " + buildWherePart() + " " + buildOrderByPart();
+}
 
-    // Sorting
-    std::string order_by;
-    for(const auto& sorted_column : m_sort)
-    {
-        if(sorted_column.column < m_column_names.size())
-            order_by += sqlb::escapeIdentifier(m_column_names.at(sorted_column.column)) + " "
-                    + (sorted_column.direction == sqlb::Ascending ? "ASC" : "DESC") + ",";
-    }
-    if(order_by.size())
+std::string Query::buildQuery(bool withRowid, const std::vector<size_t>& columns) const
+{
+    // Only select the requested columns, in the requested order. Display formats are applied the same way as for the full query.
+    std::string selector;
+    if (withRowid)
+        selector = buildRowidPart() + ",";
+
+    for(size_t column : columns)
     {
-        order_by.pop_back();
-        order_by = "ORDER BY " + order_by;
+        // The rowid column is handled separately above
+        if(column == 0 || column >= m_column_names.size())
+            continue;
+
+        const std::string& name = m_column_names.at(column);
+        const auto it = findSelectedColumnByName(name);
+        if(it != m_selected_columns.cend() && it->original_column != it->selector)
+            selector += it->selector + " AS " + sqlb::escapeIdentifier(name) + ",";
+        else
+            selector += sqlb::escapeIdentifier(name) + ",";
     }
+    if(selector.empty())
+        selector = "NULL";
+    else
+        selector.pop_back();
 
-    return "SELECT " + selector + " FROM " + m_table.toString() + " " + where + " " + order_by;
+    return "SELECT " + selector + " FROM " + m_table.toString() + " " + buildWherePart() + " " + buildOrderByPart();
 }
 
 std::string Query::buildCountQuery() const
@@ -96,6 +278,128 @@ std::string Query::buildCountQuery() const
     return "SELECT COUNT(*) FROM " + m_table.toString() + " " + buildWherePart();
 }
 
+std::string Query::buildCountQuery(const std::string& select, const std::unordered_set<std::string>* aggregate_functions)
+{
+    const std::string generic = "SELECT COUNT(*) FROM (" + select + ");";
+
+    std::vector<Token> tokens;
+    if(!tokenize(select, tokens))
+        return generic;
+
+    // Find the SELECT keyword of the main statement, skipping any common table expressions
+    size_t select_pos = 0;
+    while(select_pos < tokens.size() && !(tokens[select_pos].depth == 0 && isWord(tokens, select_pos, "select")))
+        select_pos++;
+    if(select_pos == tokens.size())
+        return generic;
+
+    // Look for the clauses of the main statement
+    size_t from_pos = std::string::npos;
+    size_t order_pos = std::string::npos;
+    size_t limit_pos = std::string::npos;
+    bool compound = false;
+    bool grouped = false;
+    for(size_t i=select_pos+1;i<tokens.size();i++)
+    {
+        if(tokens[i].depth != 0 || tokens[i].type != Token::Word)
+            continue;
+
+        const std::string& word = tokens[i].text;
+        if(word == "from" && from_pos == std::string::npos && !compound)
+            from_pos = i;
+        else if(word == "union" || word == "intersect" || word == "except")
+            compound = true;
+        else if(word == "group" || word == "having" || word == "window")
+            grouped = true;
+        else if(word == "order" && isWord(tokens, i+1, "by"))
+            order_pos = i;
+        else if(word == "limit")
+            limit_pos = i;
+    }
+
+    std::string query = select;
+    bool order_removed = false;
+
+    // The ORDER BY clause doesn't change the number of rows but sorting them might take a lot of time. It is always at the end
+    // of the statement, only followed by the LIMIT clause.
+    if(order_pos != std::string::npos && (limit_pos == std::string::npos || limit_pos > order_pos))
+    {
+        const size_t end = limit_pos == std::string::npos ? select.size() : tokens[limit_pos].begin;
+        query.erase(tokens[order_pos].begin, end - tokens[order_pos].begin);
+        order_removed = true;
+    }
+
+    // Check whether the result columns can be replaced by a constant. This isn't possible if they are needed for determining
+    // which rows are returned.
+    size_t columns_pos = select_pos + 1;
+    const bool distinct = isWord(tokens, columns_pos, "distinct");
+    if(isWord(tokens, columns_pos, "all"))
+        columns_pos++;
+    bool replace_columns = !compound && !grouped && !distinct && from_pos != std::string::npos && columns_pos < from_pos;
+
+    std::vector<std::string> aliases;
+    std::vector<bool> subquery;     // one entry per open parenthesis, telling whether it starts a subquery
+    size_t column_begin = columns_pos;
+    for(size_t i=columns_pos;replace_columns && i<=from_pos;i++)
+    {
+        const Token& t = tokens[i];
+        if(t.type == Token::OpenParen)
+        {
+            subquery.push_back(isWord(tokens, i+1, "select"));
+        } else if(t.type == Token::CloseParen && !subquery.empty()) {
+            subquery.pop_back();
+        } else if(t.type == Token::Word && i + 1 < tokens.size() && tokens[i+1].type == Token::OpenParen && !isKeywordBeforeParenthesis(t.text)) {
+            // There is no way to tell an aggregate function from a scalar function by its name. Extensions and users can define
+            // their own aggregate functions, too. So unless we know the aggregate functions of the connection, any function call
+            // might be one. Aggregate functions in subqueries don't affect the number of rows of the main statement.
+            const bool aggregate = !aggregate_functions || aggregate_functions->count(t.text);
+            if(aggregate && std::find(subquery.begin(), subquery.end(), true) == subquery.end())
+                replace_columns = false;
+        } else if((t.type == Token::Comma && t.depth == 0) || i == from_pos) {
+            // Remember the alias of each result column. The last token of a result column is an alias if it is preceded by
+            // AS or by something which can be the end of an expression.
+            if(i - column_begin >= 2 && (tokens[i-1].type == Token::Word || tokens[i-1].type == Token::Identifier))
+            {
+                const Token& prev = tokens[i-2];
+                if(prev.type == Token::Word || prev.type == Token::Identifier || prev.type == Token::Literal || prev.type == Token::CloseParen)
+                    aliases.push_back(tokens[i-1].text);
+            }
+            column_begin = i + 1;
+        }
+    }
+
+    // SQLite allows using the aliases of result columns in the WHERE clause and the like. The ORDER BY clause has been removed
+    // already, so it doesn't matter whether they are used there.
+    if(replace_columns)
+    {
+        for(size_t i=from_pos+1;i<tokens.size();i++)
+        {
+            if(order_removed && i == order_pos)
+            {
+                if(limit_pos == std::string::npos)
+                    break;
+                i = limit_pos;
+            }
+            if((tokens[i].type == Token::Word || tokens[i].type == Token::Identifier) &&
+               std::find(aliases.begin(), aliases.end(), tokens[i].text) != aliases.end())
+            {
+                replace_columns = false;
+                break;
+            }
+        }
+    }
+
+    if(replace_columns)
+    {
+        const size_t begin = tokens[columns_pos].begin;
+        query.replace(begin, tokens[from_pos].begin - begin, "1 ");
+    } else if(!order_removed) {
+        return generic;
+    }
+
+    return "SELECT COUNT(*) FROM (" + query + ");";
+}
+
 std::vector<SelectedColumn>::iterator Query::findSelectedColumnByName(const std::string& name)
 {
     return std::find_if(m_selected_columns.begin(), m_selected_columns.end(), [name](const SelectedColumn& c) {
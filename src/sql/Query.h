@@ -5,6 +5,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace sqlb
@@ -52,9 +53,22 @@ public:
     {}
 
     void clear();
+    // Builds the query for browsing the table. If withRowid is set, the result starts with the rowid columns, one result
+    // column per entry in rowIdColumns().
     std::string buildQuery(bool withRowid) const;
+
+    // Builds a query which only selects the given columns (using the indices of the column names) instead of all columns.
+    // The rowid column (index 0) is selected depending on the withRowid parameter only.
+    std::string buildQuery(bool withRowid, const std::vector<size_t>& columns) const;
     std::string buildCountQuery() const;
 
+    // Builds a query which counts the rows returned by the given SELECT statement. Like for the table browsing query above, the
+    // parts of the statement which don't affect the number of rows are left out: the ORDER BY clause is always removed and the
+    // result columns are replaced by a constant if the statement has no DISTINCT, grouping or aggregate function. The names of
+    // the aggregate and window functions of the connection can be passed in lower case in aggregate_functions. If they are not
+    // known, any function call in the result columns is assumed to be an aggregate function.
+    static std::string buildCountQuery(const std::string& select, const std::unordered_set<std::string>* aggregate_functions = nullptr);
+
     void setColumNames(const std::vector<std::string>& column_names) { m_column_names = column_names; }
     std::vector<std::string> columnNames() const { return m_column_names; }
 
@@ -72,6 +86,10 @@ public:
     const std::unordered_map<size_t, std::string>& where() const { return m_where; }
     std::unordered_map<size_t, std::string>& where() { return m_where; }
 
+    // The filters as they have been entered by the user. The conditions in where() are generated from them.
+    const std::unordered_map<size_t, std::string>& filterValues() const { return m_filter_values; }
+    std::unordered_map<size_t, std::string>& filterValues() { return m_filter_values; }
+
     const std::vector<SortedColumn>& orderBy() const { return m_sort; }
     std::vector<SortedColumn>& orderBy() { return m_sort; }
     void setOrderBy(const std::vector<SortedColumn>& columns) { m_sort = columns; }
@@ -82,11 +100,14 @@ private:
     std::vector<std::string> m_rowid_columns;
     std::vector<SelectedColumn> m_selected_columns;
     std::unordered_map<size_t, std::string> m_where;
+    std::unordered_map<size_t, std::string> m_filter_values;
     std::vector<SortedColumn> m_sort;
 
     std::vector<SelectedColumn>::iterator findSelectedColumnByName(const std::string& name);
     std::vector<SelectedColumn>::const_iterator findSelectedColumnByName(const std::string& name) const;
     std::string buildWherePart() const;
+    std::string buildRowidPart() const;
+    std::string buildOrderByPart() const;
 };
 
 }
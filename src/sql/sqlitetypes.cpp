@@ -1,11 +1,13 @@
 #include "sqlitetypes.h"
 #include "ObjectIdentifier.h"
+#include "DdlParser.h"
 #include "grammar/Sqlite3Lexer.hpp"
 #include "grammar/Sqlite3Parser.hpp"
 
 #include <clocale>          // This include seems to only be necessary for the Windows build
 #include <iostream>
 #include <iterator>
+#include <mutex>
 #include <numeric>
 #include <sstream>
 
@@ -43,68 +45,88 @@ std::string joinStringVector(const StringVector& vec, const std::string& delim)
  * string comparison which because it is case-independent relies on the current locale. However, when parsind SQL
  * statements we don't want the locale to interfere here. Especially the Turkish locale is problematic here because
  * of the dotted I problem.
+ * The locale is global for the whole process, so when statements are parsed in several threads at once, only the first
+ * instance changes it and only the last one to be destroyed resets it.
  */
 class SetLocaleToC
 {
 public:
     SetLocaleToC()
-        : oldLocale(std::setlocale(LC_CTYPE, nullptr))      // Query current locale and save it
     {
-        // Set locale for standard library functions
-        std::setlocale(LC_CTYPE, "C.UTF-8");
+        std::lock_guard<std::mutex> lk(mutex);
+        if(users++ == 0)
+        {
+            // Query current locale and save it
+            oldLocale = std::setlocale(LC_CTYPE, nullptr);
+
+            // Set locale for standard library functions
+            std::setlocale(LC_CTYPE, "C.UTF-8");
+        }
     }
 
     ~SetLocaleToC()
     {
         // Reset old locale
-        std::setlocale(LC_CTYPE, oldLocale.c_str());
+        std::lock_guard<std::mutex> lk(mutex);
+        if(--users == 0)
+            std::setlocale(LC_CTYPE, oldLocale.c_str());
     }
 
 private:
-    std::string oldLocale;
+    static std::mutex mutex;
+    static unsigned int users;
+    static std::string oldLocale;
 };
 
+std::mutex SetLocaleToC::mutex;
+unsigned int SetLocaleToC::users = 0;
+std::string SetLocaleToC::oldLocale;
+
 /**
  * @brief The CreateTableWalker class
  * Goes trough the createtable AST and returns
- * Table object.
+ * Table object. The AST can be produced by the
+ * ANTLR parser or by the DdlParser.
  */
+template<typename Node>
 class CreateTableWalker
 {
 public:
-    explicit CreateTableWalker(antlr::RefAST r)
+    explicit CreateTableWalker(Node r)
         : m_root(r)
     {}
 
     TablePtr table();
 
 private:
-    void parsecolumn(Table* table, antlr::RefAST c);
-    std::string parseConflictClause(antlr::RefAST c);
+    void parsecolumn(Table* table, Node c);
+    std::string parseConflictClause(Node c);
 
 private:
-    antlr::RefAST m_root;
+    Node m_root;
 };
 
 /**
  * @brief The CreateIndexWalker class
  * Goes trough the createtable AST and returns
- * Index object.
+ * Index object. The AST can be produced by the
+ * ANTLR parser or by the DdlParser.
  */
+template<typename Node>
 class CreateIndexWalker
 {
 public:
-    explicit CreateIndexWalker(antlr::RefAST r)
+    explicit CreateIndexWalker(Node r)
         : m_root(r)
     {}
 
     IndexPtr index();
 
 private:
-    void parsecolumn(Index* index, antlr::RefAST c);
+    void parsecolumn(Index* index, Node c);
 
 private:
-    antlr::RefAST m_root;
+    Node m_root;
 };
 
 bool Object::operator==(const Object& rhs) const
@@ -412,8 +434,32 @@ bool Table::hasAutoIncrement() const
     return std::any_of(fields.begin(), fields.end(), [](const Field& f) {return f.autoIncrement(); });
 }
 
-TablePtr Table::parseSQL(const std::string& sSQL)
+TablePtr Table::parseSQL(const std::string& sSQL, ParserType parserType)
 {
+    // Try the hand-written parser first. It is a lot faster and doesn't need the locale to be changed.
+    if(parserType != ParserType::Antlr)
+    {
+        DdlParser ddl;
+        if(ddl.parseCreateTable(sSQL))
+        {
+            try
+            {
+                CreateTableWalker<DdlParser::Node> ctw(ddl.root());
+
+                auto t = ctw.table();
+                t->setOriginalSql(sSQL);
+                return t;
+            }
+            catch(...)
+            {
+                std::cerr << "Sqlite parse error: " << sSQL << std::endl;
+                return TablePtr(new Table(""));
+            }
+        } else if(parserType == ParserType::HandWritten) {
+            return nullptr;
+        }
+    }
+
     SetLocaleToC locale;
 
     std::stringstream s;
@@ -435,7 +481,7 @@ TablePtr Table::parseSQL(const std::string& sSQL)
         }
 
         parser.createtable();
-        CreateTableWalker ctw(parser.getAST());
+        CreateTableWalker<antlr::RefAST> ctw(parser.getAST());
 
         auto t = ctw.table();
         t->setOriginalSql(sSQL);
@@ -637,7 +683,8 @@ std::string unescape_identifier(std::string str, char quote_char)
     return str;
 }
 
-std::string identifier(antlr::RefAST ident)
+template<typename Node>
+std::string identifier(Node ident)
 {
     std::string sident = ident->getText();
     if(ident->getType() == sqlite3TokenTypes::QUOTEDID ||
@@ -660,20 +707,22 @@ std::string identifier(antlr::RefAST ident)
     return sident;
 }
 
-std::string textAST(antlr::RefAST t)
+template<typename Node>
+std::string textAST(Node t)
 {
     // When this is called for a KEYWORDASTABLENAME token, we must take the child's content to get the actual value
     // instead of 'KEYWORDASTABLENAME' as a string. The same applies for  KEYWORDASCOLUMNNAME tokens.
-    if(t != antlr::nullAST && (t->getType() == sqlite3TokenTypes::KEYWORDASTABLENAME || t->getType() == sqlite3TokenTypes::KEYWORDASCOLUMNNAME))
+    if(t && (t->getType() == sqlite3TokenTypes::KEYWORDASTABLENAME || t->getType() == sqlite3TokenTypes::KEYWORDASCOLUMNNAME))
         return t->getFirstChild()->getText();
     else
         return t->getText();
 }
 
-std::string concatTextAST(antlr::RefAST t, bool withspace = false)
+template<typename Node>
+std::string concatTextAST(Node t, bool withspace = false)
 {
     StringVector stext;
-    while(t != antlr::nullAST)
+    while(t)
     {
         stext.push_back(textAST(t));
         t = t->getNextSibling();
@@ -681,7 +730,8 @@ std::string concatTextAST(antlr::RefAST t, bool withspace = false)
     return joinStringVector(stext, withspace ? " " : "");
 }
 
-std::string concatExprAST(antlr::RefAST t)
+template<typename Node>
+std::string concatExprAST(Node t)
 {
     std::string expr;
 
@@ -724,14 +774,16 @@ std::string concatExprAST(antlr::RefAST t)
 }
 
 namespace {
-std::string tablename(const antlr::RefAST& n)
+template<typename Node>
+std::string tablename(const Node& n)
 {
     if(n->getType() == sqlite3TokenTypes::KEYWORDASTABLENAME)
         return concatTextAST(n->getFirstChild());
     else
         return identifier(n);
 }
-std::string columnname(const antlr::RefAST& n)
+template<typename Node>
+std::string columnname(const Node& n)
 {
     if(n->getType() == sqlite3TokenTypes::KEYWORDASCOLUMNNAME)
         return concatTextAST(n->getFirstChild());
@@ -742,17 +794,18 @@ std::string columnname(const antlr::RefAST& n)
 }
 }
 
-TablePtr CreateTableWalker::table()
+template<typename Node>
+TablePtr CreateTableWalker<Node>::table()
 {
     Table* tab = new Table("");
     tab->setFullyParsed(true);
 
     if( m_root ) //CREATE TABLE
     {
-        antlr::RefAST s = m_root->getFirstChild();
+        Node s = m_root->getFirstChild();
 
         // If the primary tree isn't filled, this isn't a normal CREATE TABLE statement. Switch to the next alternative tree.
-        if(s == nullptr)
+        if(!s)
             s = m_root->getNextSibling();
 
         // Skip to table name
@@ -788,9 +841,9 @@ TablePtr CreateTableWalker::table()
         // This is a normal table, not a virtual one
         s = s->getNextSibling(); // LPAREN
         s = s->getNextSibling(); // first column name
-        antlr::RefAST column = s;
+        Node column = s;
         // loop columndefs
-        while(column != antlr::nullAST && column->getType() == sqlite3TokenTypes::COLUMNDEF)
+        while(column && column->getType() == sqlite3TokenTypes::COLUMNDEF)
         {
             parsecolumn(tab, column->getFirstChild());
             column = column->getNextSibling(); //COMMA or RPAREN
@@ -801,14 +854,14 @@ TablePtr CreateTableWalker::table()
         }
 
         // now we are finished or it is a tableconstraint
-        while(s != antlr::nullAST)
+        while(s)
         {
             // Is this a 'without rowid' definiton?
             if(s->getType() != sqlite3TokenTypes::WITHOUT)
             {
                 // It's not, so treat this as table constraints
 
-                antlr::RefAST tc = s->getFirstChild();
+                Node tc = s->getFirstChild();
 
                 // Extract constraint name, if there is any
                 std::string constraint_name;
@@ -832,13 +885,13 @@ TablePtr CreateTableWalker::table()
                     StringVector fields;
                     do
                     {
-                        antlr::RefAST indexed_column = tc->getFirstChild();
+                        Node indexed_column = tc->getFirstChild();
 
                         std::string col = columnname(indexed_column);
                         fields.push_back(col);
 
                         indexed_column = indexed_column->getNextSibling();
-                        if(indexed_column != antlr::nullAST
+                        if(indexed_column
                                 && (indexed_column->getType() == sqlite3TokenTypes::ASC
                                     || indexed_column->getType() == sqlite3TokenTypes::DESC))
                         {
@@ -847,7 +900,7 @@ TablePtr CreateTableWalker::table()
                             indexed_column = indexed_column->getNextSibling();
                         }
 
-                        if(indexed_column != antlr::nullAST && indexed_column->getType() == sqlite3TokenTypes::COLLATE)
+                        if(indexed_column && indexed_column->getType() == sqlite3TokenTypes::COLLATE)
                         {
                             indexed_column = indexed_column->getNextSibling();      // COLLATE
                             // TODO save collation name
@@ -855,7 +908,7 @@ TablePtr CreateTableWalker::table()
                             indexed_column = indexed_column->getNextSibling();      // collation name
                         }
 
-                        if(indexed_column != antlr::nullAST && indexed_column->getType() == sqlite3TokenTypes::AUTOINCREMENT)
+                        if(indexed_column && indexed_column->getType() == sqlite3TokenTypes::AUTOINCREMENT)
                         {
                             auto field = findField(tab, col);
                             field->setAutoIncrement(true);
@@ -864,11 +917,11 @@ TablePtr CreateTableWalker::table()
 
                         tc = tc->getNextSibling();      // indexed column
 
-                        while(tc != antlr::nullAST && tc->getType() == sqlite3TokenTypes::COMMA)
+                        while(tc && tc->getType() == sqlite3TokenTypes::COMMA)
                         {
                             tc = tc->getNextSibling(); // skip ident and comma
                         }
-                    } while(tc != antlr::nullAST && tc->getType() != sqlite3TokenTypes::RPAREN);
+                    } while(tc && tc->getType() != sqlite3TokenTypes::RPAREN);
 
                     // We're either done now or there is a conflict clause
                     tc = tc->getNextSibling();          // skip RPAREN
@@ -887,14 +940,14 @@ TablePtr CreateTableWalker::table()
                     StringVector fields;
                     do
                     {
-                        antlr::RefAST indexed_column = tc->getFirstChild();
+                        Node indexed_column = tc->getFirstChild();
 
                         std::string col = columnname(indexed_column);
                         auto field = findField(tab, col);
                         fields.push_back(field->name());
 
                         indexed_column = indexed_column->getNextSibling();
-                        if(indexed_column != antlr::nullAST
+                        if(indexed_column
                                 && (indexed_column->getType() == sqlite3TokenTypes::ASC
                                     || indexed_column->getType() == sqlite3TokenTypes::DESC))
                         {
@@ -903,7 +956,7 @@ TablePtr CreateTableWalker::table()
                             indexed_column = indexed_column->getNextSibling();
                         }
 
-                        if(indexed_column != antlr::nullAST && indexed_column->getType() == sqlite3TokenTypes::COLLATE)
+                        if(indexed_column && indexed_column->getType() == sqlite3TokenTypes::COLLATE)
                         {
                             indexed_column = indexed_column->getNextSibling();      // COLLATE
                             // TODO save collation name
@@ -913,11 +966,11 @@ TablePtr CreateTableWalker::table()
 
                         tc = tc->getNextSibling();      // indexed column
 
-                        while(tc != antlr::nullAST && tc->getType() == sqlite3TokenTypes::COMMA)
+                        while(tc && tc->getType() == sqlite3TokenTypes::COMMA)
                         {
                             tc = tc->getNextSibling(); // skip ident and comma
                         }
-                    } while(tc != antlr::nullAST && tc->getType() != sqlite3TokenTypes::RPAREN);
+                    } while(tc && tc->getType() != sqlite3TokenTypes::RPAREN);
 
                     if(fields.size() == 1 && constraint_name.empty())
                     {
@@ -945,9 +998,9 @@ TablePtr CreateTableWalker::table()
 
                         tc = tc->getNextSibling();
 
-                        while(tc != antlr::nullAST && tc->getType() == sqlite3TokenTypes::COMMA)
+                        while(tc && tc->getType() == sqlite3TokenTypes::COMMA)
                             tc = tc->getNextSibling(); // skip ident and comma
-                    } while(tc != antlr::nullAST && tc->getType() != sqlite3TokenTypes::RPAREN);
+                    } while(tc && tc->getType() != sqlite3TokenTypes::RPAREN);
 
                     tc = tc->getNextSibling();
                     tc = tc->getNextSibling();  // REFERENCES
@@ -955,12 +1008,12 @@ TablePtr CreateTableWalker::table()
                     fk->setTable(identifier(tc));
                     tc = tc->getNextSibling();       // identifier
 
-                    if(tc != antlr::nullAST && tc->getType() == sqlite3TokenTypes::LPAREN)
+                    if(tc && tc->getType() == sqlite3TokenTypes::LPAREN)
                     {
                         tc = tc->getNextSibling();  // LPAREN
 
                         StringVector fk_cols;
-                        while(tc != antlr::nullAST && tc->getType() != sqlite3TokenTypes::RPAREN)
+                        while(tc && tc->getType() != sqlite3TokenTypes::RPAREN)
                         {
                             if(tc->getType() != sqlite3TokenTypes::COMMA)
                                 fk_cols.push_back(identifier(tc));
@@ -1012,7 +1065,8 @@ TablePtr CreateTableWalker::table()
     return TablePtr(tab);
 }
 
-void CreateTableWalker::parsecolumn(Table* table, antlr::RefAST c)
+template<typename Node>
+void CreateTableWalker<Node>::parsecolumn(Table* table, Node c)
 {
     std::string colname;
     std::string type = "TEXT";
@@ -1027,21 +1081,21 @@ void CreateTableWalker::parsecolumn(Table* table, antlr::RefAST c)
 
     colname = columnname(c);
     c = c->getNextSibling(); //type?
-    if(c != antlr::nullAST && c->getType() == sqlite3TokenTypes::TYPE_NAME)
+    if(c && c->getType() == sqlite3TokenTypes::TYPE_NAME)
     {
-        antlr::RefAST t = c->getFirstChild();
+        Node t = c->getFirstChild();
 
-        if(t != antlr::nullAST)
+        if(t)
         {
             type.clear();
         }
 
-        while(t != antlr::nullAST)
+        while(t)
         {
             int thisType = t->getType();
             type += textAST(t);
             t = t->getNextSibling();
-            if(t != antlr::nullAST)
+            if(t)
             {
                 int nextType = t->getType();
                 if(nextType != sqlite3TokenTypes::LPAREN && nextType != sqlite3TokenTypes::RPAREN &&
@@ -1056,9 +1110,9 @@ void CreateTableWalker::parsecolumn(Table* table, antlr::RefAST c)
 
     // finished with type parsing
     // now columnconstraints
-    while(c != antlr::nullAST)
+    while(c)
     {
-        antlr::RefAST con = c->getFirstChild();
+        Node con = c->getFirstChild();
 
         // Extract constraint name, if there is any
         std::string constraint_name;
@@ -1082,7 +1136,7 @@ void CreateTableWalker::parsecolumn(Table* table, antlr::RefAST c)
             primaryKey->setName(constraint_name);
 
             con = con->getNextSibling()->getNextSibling(); // skip KEY
-            if(con != antlr::nullAST && (con->getType() == sqlite3TokenTypes::ASC
+            if(con && (con->getType() == sqlite3TokenTypes::ASC
                                          || con->getType() == sqlite3TokenTypes::DESC))
             {
                 table->setFullyParsed(false);
@@ -1091,7 +1145,7 @@ void CreateTableWalker::parsecolumn(Table* table, antlr::RefAST c)
 
             primaryKey->setConflictAction(parseConflictClause(con));
 
-            if(con != antlr::nullAST && con->getType() == sqlite3TokenTypes::AUTOINCREMENT)
+            if(con && con->getType() == sqlite3TokenTypes::AUTOINCREMENT)
                 autoincrement = true;
         }
         break;
@@ -1154,12 +1208,12 @@ void CreateTableWalker::parsecolumn(Table* table, antlr::RefAST c)
             foreignKey->setName(constraint_name);
             con = con->getNextSibling();    // identifier
 
-            if(con != antlr::nullAST && con->getType() == sqlite3TokenTypes::LPAREN)
+            if(con && con->getType() == sqlite3TokenTypes::LPAREN)
             {
                 con = con->getNextSibling();    // LPAREN
 
                 StringVector fk_cols;
-                while(con != antlr::nullAST && con->getType() != sqlite3TokenTypes::RPAREN)
+                while(con && con->getType() != sqlite3TokenTypes::RPAREN)
                 {
                     if(con->getType() != sqlite3TokenTypes::COMMA)
                         fk_cols.push_back(identifier(con));
@@ -1213,11 +1267,12 @@ void CreateTableWalker::parsecolumn(Table* table, antlr::RefAST c)
     }
 }
 
-std::string CreateTableWalker::parseConflictClause(antlr::RefAST c)
+template<typename Node>
+std::string CreateTableWalker<Node>::parseConflictClause(Node c)
 {
     std::string conflictAction;
 
-    if(c != antlr::nullAST && c->getType() == sqlite3TokenTypes::ON && c->getNextSibling()->getType() == sqlite3TokenTypes::CONFLICT)
+    if(c && c->getType() == sqlite3TokenTypes::ON && c->getNextSibling()->getType() == sqlite3TokenTypes::CONFLICT)
     {
         c = c->getNextSibling();      // skip ON
         c = c->getNextSibling();      // skip CONFLICT
@@ -1297,8 +1352,32 @@ FieldInfoList Index::fieldInformation() const
     return result;
 }
 
-IndexPtr Index::parseSQL(const std::string& sSQL)
+IndexPtr Index::parseSQL(const std::string& sSQL, ParserType parserType)
 {
+    // Try the hand-written parser first. It is a lot faster and doesn't need the locale to be changed.
+    if(parserType != ParserType::Antlr)
+    {
+        DdlParser ddl;
+        if(ddl.parseCreateIndex(sSQL))
+        {
+            try
+            {
+                CreateIndexWalker<DdlParser::Node> ctw(ddl.root());
+
+                auto i = ctw.index();
+                i->setOriginalSql(sSQL);
+                return i;
+            }
+            catch(...)
+            {
+                std::cerr << "Sqlite parse error: " << sSQL << std::endl;
+                return IndexPtr(new Index(""));
+            }
+        } else if(parserType == ParserType::HandWritten) {
+            return nullptr;
+        }
+    }
+
     SetLocaleToC locale;
 
     std::stringstream s;
@@ -1314,7 +1393,7 @@ IndexPtr Index::parseSQL(const std::string& sSQL)
     try
     {
         parser.createindex();
-        CreateIndexWalker ctw(parser.getAST());
+        CreateIndexWalker<antlr::RefAST> ctw(parser.getAST());
 
         auto i = ctw.index();
         i->setOriginalSql(sSQL);
@@ -1332,14 +1411,15 @@ IndexPtr Index::parseSQL(const std::string& sSQL)
     return IndexPtr(new Index(""));
 }
 
-IndexPtr CreateIndexWalker::index()
+template<typename Node>
+IndexPtr CreateIndexWalker<Node>::index()
 {
     Index* index = new Index("");
     index->setFullyParsed(true);
 
     if(m_root)  // CREATE INDEX
     {
-        antlr::RefAST s = m_root->getFirstChild();
+        Node s = m_root->getFirstChild();
 
         // Skip to index name
         while(s->getType() != Sqlite3Lexer::ID &&
@@ -1365,9 +1445,9 @@ IndexPtr CreateIndexWalker::index()
 
         s = s->getNextSibling(); // LPAREN
         s = s->getNextSibling(); // first column name
-        antlr::RefAST column = s;
+        Node column = s;
         // loop columndefs
-        while(column != antlr::nullAST && column->getType() == sqlite3TokenTypes::INDEXEDCOLUMN)
+        while(column && column->getType() == sqlite3TokenTypes::INDEXEDCOLUMN)
         {
             parsecolumn(index, column->getFirstChild());
             column = column->getNextSibling(); // COMMA or RPAREN
@@ -1378,7 +1458,7 @@ IndexPtr CreateIndexWalker::index()
         }
 
         // Now we are finished or it is a partial index
-        if(s != antlr::nullAST)
+        if(s)
         {
             // This should be a 'where' then
             if(s->getType() != sqlite3TokenTypes::WHERE)
@@ -1395,7 +1475,8 @@ IndexPtr CreateIndexWalker::index()
     return IndexPtr(index);
 }
 
-void CreateIndexWalker::parsecolumn(Index* index, antlr::RefAST c)
+template<typename Node>
+void CreateIndexWalker<Node>::parsecolumn(Index* index, Node c)
 {
     std::string name;
     bool isExpression;
@@ -1406,8 +1487,8 @@ void CreateIndexWalker::parsecolumn(Index* index, antlr::RefAST c)
     // Then see how many items there are: if it's one it's a normal index column with only a column name. In this case get the identifier.
     // If it's more than one item it's an expression. In this case get all the items as they are.
     int number_of_name_items = 0;
-    antlr::RefAST n = c;
-    while(n != antlr::nullAST
+    Node n = c;
+    while(n
           && n->getType() != sqlite3TokenTypes::COLLATE
           && n->getType() != sqlite3TokenTypes::ASC
           && n->getType() != sqlite3TokenTypes::DESC
@@ -1433,7 +1514,7 @@ void CreateIndexWalker::parsecolumn(Index* index, antlr::RefAST c)
     }
 
     // Parse the rest of the column definition
-    while(c != antlr::nullAST)
+    while(c)
     {
         switch(c->getType())
         {
@@ -69,6 +69,18 @@ using IndexedColumnVector = std::vector<IndexedColumn>;
 using ConstraintMap = std::unordered_multimap<StringVector, ConstraintPtr, StringVectorHash>;
 using FieldInfoList = std::vector<FieldInfo>;
 
+/**
+ * @brief The ParserType enum
+ * Selects the parser used for CREATE TABLE and CREATE INDEX statements. The default is to try the fast hand-written
+ * parser first and to only use the ANTLR parser for the statements it gives up on.
+ */
+enum class ParserType
+{
+    Default,
+    Antlr,
+    HandWritten,        // Returns nullptr for statements the hand-written parser doesn't accept
+};
+
 struct FieldInfo
 {
     FieldInfo(const std::string& name_, const std::string& type_, const std::string& sql_)
@@ -350,9 +362,10 @@ public:
     /**
      * @brief parseSQL Parses the create Table statement in sSQL.
      * @param sSQL The create table statement.
+     * @param parser The parser to use. This is only of interest for testing.
      * @return The table object. The table object may be empty if parsing failed.
      */
-    static TablePtr parseSQL(const std::string& sSQL);
+    static TablePtr parseSQL(const std::string& sSQL, ParserType parser = ParserType::Default);
 private:
     StringVector fieldList() const;
     bool hasAutoIncrement() const;
@@ -422,9 +435,10 @@ public:
     /**
      * @brief parseSQL Parses the CREATE INDEX statement in sSQL.
      * @param sSQL The create index statement.
+     * @param parser The parser to use. This is only of interest for testing.
      * @return The index object. The index object may be empty if the parsing failed.
      */
-    static IndexPtr parseSQL(const std::string& sSQL);
+    static IndexPtr parseSQL(const std::string& sSQL, ParserType parser = ParserType::Default);
 
     FieldInfoList fieldInformation() const override;
 
@@ -5,6 +5,7 @@
 #include "CipherSettings.h"
 #include "DotenvFormat.h"
 #include "Settings.h"
+#include "StatementProfiler.h"
 
 #include <QFile>
 #include <QMessageBox>
@@ -16,6 +17,8 @@
 #include <QDateTime>
 #include <QDebug>
 #include <QThread>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QMetaObject>
 #include <functional>
 #include <atomic>
 #include <algorithm>
@@ -71,22 +74,6 @@ static int sqlite_compare_utf16ci( void* /*arg*/,int size1, const void *str1, in
     return QString::compare(string1, string2, Qt::CaseInsensitive);
 }
 
-static void sqlite_make_single_value(sqlite3_context* ctx, int num_arguments, sqlite3_value* arguments[])
-{
-    json array;
-    for(int i=0;i<num_arguments;i++)
-        array.push_back(reinterpret_cast<const char*>(sqlite3_value_text(arguments[i])));
-
-    std::string output = array.dump();
-    char* output_str = new char[output.size()+1];
-    std::strcpy(output_str, output.c_str());
-
-    sqlite3_result_text(ctx, output_str, static_cast<int>(output.length()), [](void* ptr) {
-        char* cptr = static_cast<char*>(ptr);
-        delete cptr;
-    });
-}
-
 void DBBrowserDB::collationNeeded(void* /*pData*/, sqlite3* /*db*/, int eTextRep, const char* sCollationName)
 {
     QString name(sCollationName);
@@ -127,6 +114,61 @@ static void regexp(sqlite3_context* ctx, int /*argc*/, sqlite3_value* argv[])
     sqlite3_result_int(ctx, arg1.indexIn(arg2) >= 0);
 }
 
+// Builds the condition for looking up a row by the values of its primary key columns. For a single column this is a simple comparison,
+// for multiple columns a row value is compared. In both cases the values are passed as parameters, so SQLite can use the primary key index.
+static QString rowidCondition(const sqlb::StringVector& pks)
+{
+    if(pks.size() == 1)
+        return QString::fromStdString(sqlb::escapeIdentifier(pks.front())) + "=?";
+
+    QString placeholders = QString("?,").repeated(static_cast<int>(pks.size()));
+    placeholders.chop(1);
+    return QString("(%1)=(%2)").arg(QString::fromStdString(sqlb::joinStringVector(sqlb::escapeIdentifier(pks), ","))).arg(placeholders);
+}
+
+// Binds the primary key values in rowid to the parameters of the statement, starting at first_parameter. For multiple primary key columns
+// the rowid is a JSON array as created by makeCompositeRowid(). Returns false if the rowid doesn't contain one value per primary key column.
+static bool bindRowid(sqlite3_stmt* stmt, int first_parameter, const QString& rowid, size_t num_pks)
+{
+    if(num_pks == 1)
+    {
+        const QByteArray value = rowid.toUtf8();
+        return sqlite3_bind_text(stmt, first_parameter, value.constData(), value.size(), SQLITE_TRANSIENT) == SQLITE_OK;
+    }
+
+    json values = json::parse(rowid.toStdString(), nullptr, false);
+    if(!values.is_array() || values.size() != num_pks)
+        return false;
+
+    int param = first_parameter;
+    for(const auto& value : values)
+    {
+        int status;
+        if(value.is_null())
+        {
+            status = sqlite3_bind_null(stmt, param);
+        } else if(value.is_number_integer()) {
+            status = sqlite3_bind_int64(stmt, param, value.get<sqlite3_int64>());
+        } else if(value.is_number_float()) {
+            status = sqlite3_bind_double(stmt, param, value.get<double>());
+        } else if(value.is_string()) {
+            const std::string text = value.get<std::string>();
+            status = sqlite3_bind_text(stmt, param, text.c_str(), static_cast<int>(text.size()), SQLITE_TRANSIENT);
+        } else if(value.is_object() && value.count("blob") && value["blob"].is_string()) {
+            const QByteArray blob = QByteArray::fromHex(QByteArray::fromStdString(value["blob"].get<std::string>()));
+            status = sqlite3_bind_blob(stmt, param, blob.constData(), blob.size(), SQLITE_TRANSIENT);
+        } else {
+            return false;
+        }
+
+        if(status != SQLITE_OK)
+            return false;
+        param++;
+    }
+
+    return true;
+}
+
 bool DBBrowserDB::isOpen ( ) const
 {
     return _db != nullptr;
@@ -195,18 +237,8 @@ bool DBBrowserDB::open(const QString& db, bool readOnly)
         if(Settings::getValue("extensions", "disableregex").toBool() == false)
             sqlite3_create_function(_db, "REGEXP", 2, SQLITE_UTF8, nullptr, regexp, nullptr, nullptr);
 
-        // Register our internal helper function for putting multiple values into a single column
-        sqlite3_create_function_v2(
-            _db,
-            "sqlb_make_single_value",
-            -1,
-            SQLITE_UTF8 | SQLITE_DETERMINISTIC,
-            nullptr,
-            sqlite_make_single_value,
-            nullptr,
-            nullptr,
-            nullptr
-        );
+        // Report the executed statements to the statement profilers
+        StatementProfiler::install(_db);
 
         // Check if file is read only. In-memory databases are never read only
         if(db == ":memory:")
@@ -542,13 +574,18 @@ bool DBBrowserDB::releaseSavepoint(const QString& pointname)
         // the operation should be successfull
         return true;
 
+    // Releasing the outermost savepoint commits the transaction. Session indexes must not end up in the file,
+    // no matter which code path commits, so drop them while they can still be removed inside the transaction.
+    int point_index = savepointList.lastIndexOf(pointname);
+    if(point_index == 0)
+        dropSessionIndexes();
+
     QString query = QString("RELEASE %1;").arg(sqlb::escapeIdentifier(pointname));
     if(!executeSQL(query, false, true))
         return false;
     // SQLite releases all savepoints that were created between
     // creation of given savepoint and releasing of it,
     // so we should too
-    int point_index = savepointList.lastIndexOf(pointname);
     savepointList.erase(savepointList.begin()+point_index, savepointList.end());
     emit dbChanged(getDirty());
 
@@ -560,6 +597,13 @@ bool DBBrowserDB::revertToSavepoint(const QString& pointname)
     if(!isOpen() || savepointList.contains(pointname) == false)
         return false;
 
+    // Rolling back isn't reflected by the SQLite counters used in dataVersion(), so make sure cached data isn't reused
+    generation++;
+
+    // Rolling back also restores the old schema version. Make sure the next schema update doesn't rely on it.
+    for(auto& state : schemaStates)
+        state.second.version = -1;
+
     QString query = QString("ROLLBACK TO SAVEPOINT %1;").arg(sqlb::escapeIdentifier(pointname));
     executeSQL(query, false, true);
     query = QString("RELEASE %1;").arg(sqlb::escapeIdentifier(pointname));
@@ -569,6 +613,8 @@ bool DBBrowserDB::revertToSavepoint(const QString& pointname)
     // so we should too
     int point_index = savepointList.lastIndexOf(pointname);
     savepointList.erase(savepointList.begin()+point_index, savepointList.end());
+    if(point_index == 0)
+        sessionIndexes.clear();     // Rolled back together with everything else
     emit dbChanged(getDirty());
 
     return true;
@@ -601,9 +647,27 @@ bool DBBrowserDB::revertAll()
         if(!revertToSavepoint(point))
             return false;
     }
+    sessionIndexes.clear();
+    return true;
+}
+
+bool DBBrowserDB::createSessionIndex(const std::string& schema, const sqlb::Index& index)
+{
+    if(!executeSQL(QString::fromStdString(index.sql(schema)), true, true))
+        return false;
+
+    sessionIndexes.emplace_back(schema, index.name());
     return true;
 }
 
+void DBBrowserDB::dropSessionIndexes()
+{
+    // This runs inside the transaction which is about to be committed, so don't open another savepoint for it
+    for(const auto& index : sessionIndexes)
+        executeSQL("DROP INDEX IF EXISTS " + QString::fromStdString(index.toString()) + ";", false, true);
+    sessionIndexes.clear();
+}
+
 bool DBBrowserDB::create ( const QString & db)
 {
     if (isOpen())
@@ -686,8 +750,17 @@ bool DBBrowserDB::close()
         _db = nullptr;
     }
 
+    backgroundParser.cancel();
+    backgroundParser.waitForFinished();
+    backgroundJobs.clear();
+    backgroundParseRequested = false;
+
+    generation++;
     schemata.clear();
+    schemaStates.clear();
+    objectIndex.clear();
     savepointList.clear();
+    sessionIndexes.clear();
     emit dbChanged(getDirty());
     emit structureUpdated();
 
@@ -762,6 +835,7 @@ bool DBBrowserDB::dump(const QString& filePath,
 
         // Count the total number of all records in all tables for the progress dialog
         size_t numRecordsTotal = 0;
+        ensureAllParsed("main");
         objectMap objMap = schemata["main"];            // We only always export the main database, not the attached databases
         std::vector<sqlb::ObjectPtr> tables;
         auto all_tables = objMap.equal_range("table");
@@ -1181,30 +1255,61 @@ QByteArray DBBrowserDB::querySingleValueFromDb(const QString& sql, bool log, Cho
     return retval;
 }
 
-bool DBBrowserDB::getRow(const sqlb::ObjectIdentifier& table, const QString& rowid, std::vector<QByteArray>& rowdata)
+QString DBBrowserDB::dataVersion(const std::string& schema)
+{
+    // Don't wait for other users of the database here. The statements below are fast, so just keep the lock while running them.
+    std::lock_guard<std::mutex> lk(m);
+    if(!_db || db_used)
+        return QString();
+
+    const std::string schema_name = schema.empty() ? "main" : schema;
+    const auto pragmaValue = [this, &schema_name](const std::string& pragma) -> qint64 {
+        const std::string sql = "PRAGMA " + sqlb::escapeIdentifier(schema_name) + "." + pragma + ";";
+        qint64 value = -1;
+        sqlite3_stmt* stmt;
+        if(sqlite3_prepare_v2(_db, sql.c_str(), static_cast<int>(sql.size()), &stmt, nullptr) == SQLITE_OK)
+        {
+            if(sqlite3_step(stmt) == SQLITE_ROW)
+                value = sqlite3_column_int64(stmt, 0);
+            sqlite3_finalize(stmt);
+        }
+        return value;
+    };
+
+    // The data version changes when another connection commits changes to the file, the schema version
+    // when the structure changes, and the total changes counter when we modify any data ourselves.
+    const qint64 data_version = pragmaValue("data_version");
+    const qint64 schema_version = pragmaValue("schema_version");
+    if(data_version < 0 || schema_version < 0)
+        return QString();
+
+    const char* filename = sqlite3_db_filename(_db, schema_name.c_str());
+    return QString("%1:%2:%3:%4:%5")
+            .arg(generation)
+            .arg(QString::fromUtf8(filename ? filename : ""))
+            .arg(data_version)
+            .arg(schema_version)
+            .arg(sqlite3_total_changes(_db));
+}
+
+bool DBBrowserDB::getRow(const sqlb::ObjectIdentifier& table, const QString& rowid, std::vector<QByteArray>& rowdata, const sqlb::StringVector& pseudo_pk)
 {
     waitForDbRelease();
     if(!_db)
         return false;
 
-    QString sQuery = QString("SELECT * FROM %1 WHERE ")
-            .arg(QString::fromStdString(table.toString()));
+    sqlb::StringVector pks = primaryKeyForEditing(table, pseudo_pk);
+    if(pks.empty())
+        return false;
 
-    // For a single rowid column we can use a simple WHERE condition, for multiple rowid columns we have to use sqlb_make_single_value to decode the composed rowid values.
-    sqlb::StringVector pks = getObjectByName<sqlb::Table>(table)->rowidColumns();
-    if(pks.size() == 1)
-    {
-        sQuery += QString("%1='%2;").arg(QString::fromStdString(sqlb::escapeIdentifier(pks.front()))).arg(rowid);
-    } else {
-        sQuery += QString("sqlb_make_single_value(%1)='%2';")
-                .arg(QString::fromStdString(sqlb::joinStringVector(sqlb::escapeIdentifier(pks), ",")))
-                .arg(QString(rowid).replace("'", "''"));
-    }
+    QString sQuery = QString("SELECT * FROM %1 WHERE %2;")
+            .arg(QString::fromStdString(table.toString()))
+            .arg(rowidCondition(pks));
 
     QByteArray utf8Query = sQuery.toUtf8();
     sqlite3_stmt *stmt;
     bool ret = false;
-    if(sqlite3_prepare_v2(_db, utf8Query, utf8Query.size(), &stmt, nullptr) == SQLITE_OK)
+    if(sqlite3_prepare_v2(_db, utf8Query, utf8Query.size(), &stmt, nullptr) == SQLITE_OK && bindRowid(stmt, 1, rowid, pks.size()))
     {
         // even this is a while loop, the statement should always only return 1 row
         while(sqlite3_step(stmt) == SQLITE_ROW)
@@ -1347,6 +1452,7 @@ QString DBBrowserDB::addRecord(const sqlb::ObjectIdentifier& tablename)
 
 bool DBBrowserDB::deleteRecords(const sqlb::ObjectIdentifier& table, const QStringList& rowids, const sqlb::StringVector& pseudo_pk)
 {
+    waitForDbRelease();
     if (!isOpen()) return false;
 
     // Get primary key of the object to edit.
@@ -1357,35 +1463,102 @@ bool DBBrowserDB::deleteRecords(const sqlb::ObjectIdentifier& table, const QStri
         return false;
     }
 
-    // Quote all values in advance
-    QStringList quoted_rowids;
-    for(QString rowid : rowids)
-        quoted_rowids.append("'" + rowid.replace("'", "''") + "'");
+    // The primary key values are passed as parameters. For a single rowid column this is a simple pk IN (?,?,...) condition, for multiple
+    // rowid columns the row values are compared using (pk1,pk2) IN (VALUES (?,?),...). Both allow SQLite to use the primary key index.
+    // Because the number of parameters per statement is limited, the rows are deleted in batches.
+    const int max_parameters = sqlite3_limit(_db, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+    const int rows_per_statement = std::max(1, max_parameters / static_cast<int>(pks.size()));
+    const QString pk_list = QString::fromStdString(sqlb::joinStringVector(sqlb::escapeIdentifier(pks), ","));
+    QString row_placeholders = QString("?,").repeated(static_cast<int>(pks.size()));
+    row_placeholders.chop(1);
 
-    // For a single rowid column we can use a SELECT ... IN(...) statement which is faster.
-    // For multiple rowid columns we have to use sqlb_make_single_value to decode the composed rowid values.
-    QString statement;
-    if(pks.size() == 1)
+    // Delete all batches within one savepoint so we can undo the earlier ones if a later one fails
+    setSavepoint();
+    const QString savepoint_name = generateSavepointName("deleterecords");
+    setSavepoint(savepoint_name);
+
+    for(int begin=0;begin<rowids.size();begin+=rows_per_statement)
     {
-        statement = QString("DELETE FROM %1 WHERE %2 IN (%3);")
-                .arg(QString::fromStdString(table.toString()))
-                .arg(QString::fromStdString(pks.at(0)))
-                .arg(quoted_rowids.join(", "));
-    } else {
-        statement = QString("DELETE FROM %1 WHERE ").arg(QString::fromStdString(table.toString()));
+        const int count = std::min(rows_per_statement, rowids.size() - begin);
 
-        statement += "sqlb_make_single_value(";
-        for(const auto& pk : pks)
-            statement += QString::fromStdString(sqlb::escapeIdentifier(pk)) + ",";
-        statement.chop(1);
-        statement += QString(") IN (%1)").arg(quoted_rowids.join(", "));
+        QString statement;
+        if(pks.size() == 1)
+        {
+            QString placeholders = QString("?,").repeated(count);
+            placeholders.chop(1);
+            statement = QString("DELETE FROM %1 WHERE %2 IN (%3);")
+                    .arg(QString::fromStdString(table.toString()))
+                    .arg(pk_list)
+                    .arg(placeholders);
+        } else {
+            QString placeholders = QString("(%1),").arg(row_placeholders).repeated(count);
+            placeholders.chop(1);
+            statement = QString("DELETE FROM %1 WHERE (%2) IN (VALUES %3);")
+                    .arg(QString::fromStdString(table.toString()))
+                    .arg(pk_list)
+                    .arg(placeholders);
+        }
+        logSQL(statement, kLogMsg_App);
+
+        sqlite3_stmt* stmt;
+        bool success = sqlite3_prepare_v2(_db, statement.toUtf8(), -1, &stmt, nullptr) == SQLITE_OK;
+        if(success)
+        {
+            for(int i=0;i<count && success;i++)
+            {
+                success = bindRowid(stmt, i * static_cast<int>(pks.size()) + 1, rowids.at(begin + i), pks.size());
+                if(!success)
+                    lastErrorMessage = tr("Invalid primary key value: %1").arg(rowids.at(begin + i));
+            }
+            if(success && sqlite3_step(stmt) != SQLITE_DONE)
+            {
+                success = false;
+                lastErrorMessage = sqlite3_errmsg(_db);
+            }
+            sqlite3_finalize(stmt);
+        } else {
+            lastErrorMessage = sqlite3_errmsg(_db);
+        }
+
+        if(!success)
+        {
+            qWarning() << "deleteRecord: " << lastErrorMessage;
+            revertToSavepoint(savepoint_name);
+            return false;
+        }
     }
 
+    releaseSavepoint(savepoint_name);
+    return true;
+}
+
+bool DBBrowserDB::deleteRecordsFromQuery(const sqlb::ObjectIdentifier& table, const QString& rowid_query, const sqlb::StringVector& pseudo_pk)
+{
+    waitForDbRelease();
+    if (!isOpen()) return false;
+
+    // Get primary key of the object to edit.
+    sqlb::StringVector pks = primaryKeyForEditing(table, pseudo_pk);
+    if(pks.empty())
+    {
+        lastErrorMessage = tr("Cannot delete this object");
+        return false;
+    }
+
+    // SQLite evaluates the subquery into a temporary index first and then uses the primary key index for finding the rows to delete
+    QString pk_list = QString::fromStdString(sqlb::joinStringVector(sqlb::escapeIdentifier(pks), ","));
+    if(pks.size() > 1)
+        pk_list = "(" + pk_list + ")";
+    QString statement = QString("DELETE FROM %1 WHERE %2 IN (%3);")
+            .arg(QString::fromStdString(table.toString()))
+            .arg(pk_list)
+            .arg(rowid_query.trimmed());
+
     if(executeSQL(statement))
     {
         return true;
     } else {
-        qWarning() << "deleteRecord: " << lastErrorMessage;
+        qWarning() << "deleteRecordsFromQuery: " << lastErrorMessage;
         return false;
     }
 }
@@ -1408,17 +1581,8 @@ bool DBBrowserDB::updateRecord(const sqlb::ObjectIdentifier& table, const std::s
             .arg(QString::fromStdString(table.toString()))
             .arg(QString::fromStdString(sqlb::escapeIdentifier(column)));
 
-    // For a single rowid column we can use a simple WHERE condition, for multiple rowid columns we have to use sqlb_make_single_value to decode the composed rowid values.
-    if(pks.size() == 1)
-    {
-        sql += QString("%1='%2';")
-                .arg(QString::fromStdString(sqlb::escapeIdentifier(pks.front())))
-                .arg(QString(rowid).replace("'", "''"));
-    } else {
-        sql += QString("sqlb_make_single_value(%1)='%2';")
-                .arg(QString::fromStdString(sqlb::joinStringVector(sqlb::escapeIdentifier(pks), ",")))
-                .arg(QString(rowid).replace("'", "''"));
-    }
+    // The primary key values are bound as parameters, too. This way SQLite can use the primary key index to find the row.
+    sql += rowidCondition(pks) + ";";
 
     logSQL(sql, kLogMsg_App);
     setSavepoint();
@@ -1442,6 +1606,8 @@ bool DBBrowserDB::updateRecord(const sqlb::ObjectIdentifier& table, const std::s
             if(sqlite3_bind_text(stmt, 1, rawValue, value.length(), SQLITE_STATIC))
                 success = -1;
         }
+        if(success == 1 && !bindRowid(stmt, 2, rowid, pks.size()))
+            success = -1;
     }
     if(success == 1 && sqlite3_step(stmt) != SQLITE_DONE)
         success = -1;
@@ -1458,6 +1624,70 @@ bool DBBrowserDB::updateRecord(const sqlb::ObjectIdentifier& table, const std::s
     }
 }
 
+bool DBBrowserDB::updateRecords(const sqlb::ObjectIdentifier& table, const std::vector<RecordUpdates>& updates, const sqlb::StringVector& pseudo_pk)
+{
+    waitForDbRelease();
+    if (!isOpen()) return false;
+
+    // Get primary key of the object to edit.
+    sqlb::StringVector pks = primaryKeyForEditing(table, pseudo_pk);
+    if(pks.empty())
+    {
+        lastErrorMessage = tr("Cannot set data on this object");
+        return false;
+    }
+
+    // Make all changes within one savepoint so we can undo all of them if one fails
+    setSavepoint();
+    const QString savepoint_name = generateSavepointName("updaterecords");
+    setSavepoint(savepoint_name);
+
+    for(const auto& update : updates)
+    {
+        QString assignments;
+        for(const auto& column : update.columns)
+            assignments += QString::fromStdString(sqlb::escapeIdentifier(column)) + "=?,";
+        assignments.chop(1);
+
+        QString sql = QString("UPDATE %1 SET %2 WHERE %3;")
+                .arg(QString::fromStdString(table.toString()))
+                .arg(assignments)
+                .arg(rowidCondition(pks));
+        logSQL(sql, kLogMsg_App);
+
+        // Prepare the statement once and execute it for every row
+        sqlite3_stmt* stmt;
+        bool success = sqlite3_prepare_v2(_db, sql.toUtf8(), -1, &stmt, nullptr) == SQLITE_OK;
+        for(int row=0;success && row<update.rowids.size();row++)
+        {
+            const auto& row_values = update.values.at(static_cast<size_t>(row));
+            for(size_t i=0;success && i<row_values.size();i++)
+            {
+                // A NULL QByteArray is bound as NULL value
+                const QByteArray& value = row_values.at(i);
+                success = sqlite3_bind_text(stmt, static_cast<int>(i) + 1, value.isNull() ? nullptr : value.constData(), value.size(), SQLITE_STATIC) == SQLITE_OK;
+            }
+            success = success && bindRowid(stmt, static_cast<int>(update.columns.size()) + 1, update.rowids.at(row), pks.size());
+            success = success && sqlite3_step(stmt) == SQLITE_DONE;
+            sqlite3_reset(stmt);
+        }
+
+        if(!success)
+        {
+            lastErrorMessage = sqlite3_errmsg(_db);
+            sqlite3_finalize(stmt);
+            qWarning() << "updateRecords: " << lastErrorMessage;
+
+            revertToSavepoint(savepoint_name);
+            return false;
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    releaseSavepoint(savepoint_name);
+    return true;
+}
+
 sqlb::StringVector DBBrowserDB::primaryKeyForEditing(const sqlb::ObjectIdentifier& table, const sqlb::StringVector& pseudo_pk) const
 {
     // This function returns the primary key of the object to edit. For views we support 'pseudo' primary keys which must be specified manually.
@@ -1740,7 +1970,9 @@ bool DBBrowserDB::alterTable(const sqlb::ObjectIdentifier& tablename, const sqlb
             // error later on when we try to recreate it.
             if(it->type() == sqlb::Object::Types::Index)
             {
-                sqlb::IndexPtr idx = std::dynamic_pointer_cast<sqlb::Index>(it);
+                // Work on a copy because the index object belongs to our schema representation
+                ensureParsed(tablename.schema(), it);
+                sqlb::IndexPtr idx = std::make_shared<sqlb::Index>(*std::dynamic_pointer_cast<sqlb::Index>(it));
 
                 // Loop through all changes to the table schema. For indices only the column names are relevant, so it suffices to look at the
                 // list of tracked columns
@@ -1908,15 +2140,58 @@ void DBBrowserDB::logSQL(QString statement, LogMessageType msgtype)
     emit sqlExecuted(statement, msgtype);
 }
 
+// Returns true if the columns of the object are queried from SQLite instead of being taken from its CREATE statement
+static bool hasQueriedColumns(const sqlb::ObjectPtr& object)
+{
+    if(object->type() == sqlb::Object::Types::View)
+        return true;
+    if(object->type() == sqlb::Object::Types::Table)
+        return std::dynamic_pointer_cast<sqlb::Table>(object)->isVirtual();
+    return false;
+}
+
+static sqlb::ObjectPtr makeStub(const std::string& type, const std::string& name, const std::string& sql, const std::string& tbl_name)
+{
+    if(type == "table")
+    {
+        sqlb::TablePtr table = std::make_shared<sqlb::Table>(name);
+        table->setOriginalSql(sql);
+        return table;
+    } else {
+        sqlb::IndexPtr index = std::make_shared<sqlb::Index>(name);
+        index->setOriginalSql(sql);
+        index->setTable(tbl_name);
+        return index;
+    }
+}
+
+static bool sameColumns(const sqlb::ObjectPtr& a, const sqlb::ObjectPtr& b)
+{
+    if(a->type() != b->type())
+        return false;
+    if(a->type() == sqlb::Object::Types::View)
+        return std::dynamic_pointer_cast<sqlb::View>(a)->fields == std::dynamic_pointer_cast<sqlb::View>(b)->fields;
+    if(a->type() == sqlb::Object::Types::Table)
+        return std::dynamic_pointer_cast<sqlb::Table>(a)->fields == std::dynamic_pointer_cast<sqlb::Table>(b)->fields;
+    return true;
+}
+
 void DBBrowserDB::updateSchema()
 {
     waitForDbRelease();
 
-    schemata.clear();
-
     // Exit here is no DB is opened
     if(!isOpen())
+    {
+        schemata.clear();
+        schemaStates.clear();
+        objectIndex.clear();
         return;
+    }
+
+    SchemaChanges changes;
+    bool schemas_changed = false;
+    std::vector<std::string> schema_names;
 
     // Get a list of all databases. This list always includes the main and the temp database but can include more items if there are attached databases
     QString db_statement = "PRAGMA database_list;";
@@ -1930,78 +2205,37 @@ void DBBrowserDB::updateSchema()
         {
             // Get the schema name which is in column 1 (counting starts with 0). 0 contains an ID and 2 the file path.
             std::string schema_name = reinterpret_cast<const char*>(sqlite3_column_text(db_vm, 1));
+            const char* schema_file = reinterpret_cast<const char*>(sqlite3_column_text(db_vm, 2));
+            schema_names.push_back(schema_name);
 
             // Always add the schema to the map. This makes sure it's even then added when there are no objects in the database
-            schemata[schema_name] = objectMap();
-
-            // Get a list of all the tables for the current database schema. We need to do this differently for normal databases and the temporary schema
-            // because SQLite doesn't understand the "temp.sqlite_master" notation.
-            QString statement;
-            if(schema_name == "temp")
-                statement = QString("SELECT type,name,sql,tbl_name FROM sqlite_temp_master;");
-            else
-                statement = QString("SELECT type,name,sql,tbl_name FROM %1.sqlite_master;").arg(QString::fromStdString(sqlb::escapeIdentifier(schema_name)));
-            QByteArray utf8Statement = statement.toUtf8();
-            logSQL(statement, kLogMsg_App);
-
-            sqlite3_stmt* vm;
-            int err = sqlite3_prepare_v2(_db, utf8Statement, utf8Statement.length(), &vm, nullptr);
-            if(err == SQLITE_OK)
+            if(schemata.find(schema_name) == schemata.end())
             {
-                while(sqlite3_step(vm) == SQLITE_ROW)
-                {
-                    std::string val_type = reinterpret_cast<const char*>(sqlite3_column_text(vm, 0));
-                    std::string val_name = reinterpret_cast<const char*>(sqlite3_column_text(vm, 1));
-                    QString val_sql = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(vm, 2)));
-                    std::string val_tblname = reinterpret_cast<const char*>(sqlite3_column_text(vm, 3));
-                    val_sql = val_sql.replace("\r", "");
-
-                    if(!val_sql.isEmpty())
-                    {
-                        sqlb::ObjectPtr object;
-                        if(val_type == "table")
-                            object = sqlb::Table::parseSQL(val_sql.toStdString());
-                        else if(val_type == "index")
-                            object = sqlb::Index::parseSQL(val_sql.toStdString());
-                        else if(val_type == "trigger")
-                            object = sqlb::Trigger::parseSQL(val_sql.toStdString());
-                        else if(val_type == "view")
-                            object = sqlb::View::parseSQL(val_sql.toStdString());
-                        else
-                            continue;
-
-                        // If parsing wasn't successful set the object name manually, so that at least the name is going to be correct
-                        if(!object->fullyParsed())
-                            object->setName(val_name);
+                schemata[schema_name] = objectMap();
+                schemas_changed = true;
+            }
 
-                        // For virtual tables and views query the column list using the SQLite pragma because for both we can't yet rely on our grammar parser
-                        if((object->type() == sqlb::Object::Types::Table && std::dynamic_pointer_cast<sqlb::Table>(object)->isVirtual()) || object->type() == sqlb::Object::Types::View)
-                        {
-                            auto columns = queryColumnInformation(schema_name, val_name);
+            // The schema version is incremented by SQLite whenever the structure of a database changes. So if it is still the same
+            // as last time and the same file is attached under this name, there is nothing to do for this schema.
+            QString version_statement = QString("PRAGMA %1.schema_version;").arg(QString::fromStdString(sqlb::escapeIdentifier(schema_name)));
+            QByteArray version_utf8Statement = version_statement.toUtf8();
+            int version = -1;
+            sqlite3_stmt* version_vm;
+            if(sqlite3_prepare_v2(_db, version_utf8Statement, version_utf8Statement.length(), &version_vm, nullptr) == SQLITE_OK)
+            {
+                if(sqlite3_step(version_vm) == SQLITE_ROW)
+                    version = sqlite3_column_int(version_vm, 0);
+                sqlite3_finalize(version_vm);
+            }
 
-                            if(object->type() == sqlb::Object::Types::Table)
-                            {
-                                sqlb::TablePtr tab = std::dynamic_pointer_cast<sqlb::Table>(object);
-                                for(const auto& column : columns)
-                                    tab->fields.emplace_back(column.first, column.second);
-                            } else {
-                                sqlb::ViewPtr view = std::dynamic_pointer_cast<sqlb::View>(object);
-                                for(const auto& column : columns)
-                                    view->fields.emplace_back(column.first, column.second);
-                            }
-                        } else if(object->type() == sqlb::Object::Types::Trigger) {
-                            // For triggers set the name of the table the trigger operates on here because we don't have a parser for trigger statements yet.
-                            sqlb::TriggerPtr trg = std::dynamic_pointer_cast<sqlb::Trigger>(object);
-                            trg->setTable(val_tblname);
-                        }
+            SchemaState& state = schemaStates[schema_name];
+            const std::string file = schema_file ? schema_file : "";
+            if(version >= 0 && state.version == version && state.file == file)
+                continue;
+            state.version = version;
+            state.file = file;
 
-                        schemata[schema_name].insert({val_type, object});
-                    }
-                }
-                sqlite3_finalize(vm);
-            } else {
-                qWarning() << tr("could not get list of db objects: %1, %2").arg(err).arg(sqlite3_errmsg(_db));
-            }
+            updateSchemaObjects(schema_name, state, changes);
         }
 
         sqlite3_finalize(db_vm);
@@ -2009,7 +2243,349 @@ void DBBrowserDB::updateSchema()
         qWarning() << tr("could not get list of databases: %1").arg(sqlite3_errmsg(_db));
     }
 
-    emit structureUpdated();
+    // Remove the schemas which have been detached since the last update
+    for(auto it=schemata.begin();it!=schemata.end();)
+    {
+        if(std::find(schema_names.begin(), schema_names.end(), it->first) == schema_names.end())
+        {
+            for(const auto& obj : it->second)
+                changes.removed.emplace_back(it->first, obj.second);
+            schemaStates.erase(it->first);
+            objectIndex.erase(it->first);
+            it = schemata.erase(it);
+            schemas_changed = true;
+        } else {
+            ++it;
+        }
+    }
+
+    // Only notify others when the schema is complete again
+    for(const auto& obj : changes.removed)
+        emit objectRemoved(obj.first, obj.second);
+    for(const auto& obj : changes.changed)
+        emit objectChanged(obj.first, obj.second);
+    for(const auto& obj : changes.added)
+        emit objectAdded(obj.first, obj.second);
+
+    if(schemas_changed || !changes.added.empty() || !changes.removed.empty() || !changes.changed.empty())
+        emit structureUpdated();
+
+    // Parse the new stubs when there is time for it. This might have been called from a different thread, so make sure the
+    // parsing is started from the thread this object lives in.
+    if(!changes.added.empty() || !changes.changed.empty())
+        QMetaObject::invokeMethod(this, "parseStubsInBackground", Qt::QueuedConnection);
+}
+
+void DBBrowserDB::updateSchemaObjects(const std::string& schema_name, SchemaState& state, SchemaChanges& changes)
+{
+    // Get a list of all the tables for the current database schema. We need to do this differently for normal databases and the temporary schema
+    // because SQLite doesn't understand the "temp.sqlite_master" notation.
+    QString statement;
+    if(schema_name == "temp")
+        statement = QString("SELECT type,name,sql,tbl_name FROM sqlite_temp_master;");
+    else
+        statement = QString("SELECT type,name,sql,tbl_name FROM %1.sqlite_master;").arg(QString::fromStdString(sqlb::escapeIdentifier(schema_name)));
+    QByteArray utf8Statement = statement.toUtf8();
+    logSQL(statement, kLogMsg_App);
+
+    struct MasterRow
+    {
+        std::string type;
+        std::string name;
+        std::string sql;
+        std::string tbl_name;
+        size_t hash;
+        bool stub;
+        sqlb::ObjectPtr object;
+    };
+    std::vector<MasterRow> rows;
+
+    sqlite3_stmt* vm;
+    int err = sqlite3_prepare_v2(_db, utf8Statement, utf8Statement.length(), &vm, nullptr);
+    if(err == SQLITE_OK)
+    {
+        while(sqlite3_step(vm) == SQLITE_ROW)
+        {
+            std::string val_type = reinterpret_cast<const char*>(sqlite3_column_text(vm, 0));
+            std::string val_name = reinterpret_cast<const char*>(sqlite3_column_text(vm, 1));
+            QString val_sql = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(vm, 2)));
+            std::string val_tblname = reinterpret_cast<const char*>(sqlite3_column_text(vm, 3));
+            val_sql = val_sql.replace("\r", "");
+
+            if(val_sql.isEmpty())
+                continue;
+
+            // Parsing tables and indices takes time, so only stubs are created for them here. See ensureParsed(). Virtual tables
+            // are the exception because their columns have to be queried from the database right away.
+            const bool stub = val_type == "index" ||
+                    (val_type == "table" && !val_sql.left(64).simplified().startsWith("CREATE VIRTUAL ", Qt::CaseInsensitive));
+
+            const std::string sql = val_sql.toStdString();
+            rows.push_back({val_type, val_name, sql, val_tblname, std::hash<std::string>()(sql), stub, nullptr});
+        }
+        sqlite3_finalize(vm);
+    } else {
+        qWarning() << tr("could not get list of db objects: %1, %2").arg(err).arg(sqlite3_errmsg(_db));
+
+        // Try again next time
+        state.version = -1;
+    }
+
+    // Reuse the objects from the last update if their statements are still the same. The exceptions are views and virtual
+    // tables because their columns are queried from SQLite and these can change when other objects are modified.
+    std::vector<MasterRow*> parse_rows;
+    for(auto& row : rows)
+    {
+        auto known = state.objects.find({row.type, row.name});
+        if(known != state.objects.end() && known->second.hash == row.hash && !hasQueriedColumns(known->second.object))
+        {
+            row.object = known->second.object;
+            row.stub = !known->second.parsed;
+        } else if(row.stub) {
+            row.object = makeStub(row.type, row.name, row.sql, row.tbl_name);
+        } else {
+            parse_rows.push_back(&row);
+        }
+    }
+
+    // Parsing the remaining statements doesn't need the database, so it's done in parallel
+    QtConcurrent::blockingMap(parse_rows, [](MasterRow* row) {
+        row->object = parseObject(row->type, row->name, row->sql);
+    });
+
+    objectMap objects;
+    std::map<std::pair<std::string, std::string>, SchemaState::KnownObject> known_objects;
+    for(const auto& row : rows)
+    {
+        if(!row.object)
+            continue;
+
+        const auto key = std::make_pair(row.type, row.name);
+        auto known = state.objects.find(key);
+        if(known == state.objects.end() || row.object != known->second.object)
+        {
+            // The remaining information is taken from the database which can only be done here in this thread
+            if(!row.stub)
+                completeSchemaObject(schema_name, row.object, row.name, row.tbl_name);
+
+            if(known == state.objects.end())
+                changes.added.emplace_back(schema_name, row.object);
+            else if(known->second.hash != row.hash || !sameColumns(known->second.object, row.object))
+                changes.changed.emplace_back(schema_name, row.object);
+        }
+
+        objects.insert({row.type, row.object});
+        known_objects[key] = {row.hash, row.object, !row.stub};
+    }
+
+    // Everything we haven't seen this time has been dropped
+    for(const auto& it : state.objects)
+    {
+        if(known_objects.find(it.first) == known_objects.end())
+            changes.removed.emplace_back(schema_name, it.second.object);
+    }
+
+    state.objects = std::move(known_objects);
+    schemata[schema_name] = std::move(objects);
+    updateObjectIndex(schema_name);
+}
+
+void DBBrowserDB::updateObjectIndex(const std::string& schema)
+{
+    auto& index = objectIndex[schema];
+    index.clear();
+
+    const objectMap& objects = schemata[schema];
+    index.reserve(objects.size());
+    for(const auto& it : objects)
+        index[it.second->name()].push_back(it.second);
+}
+
+const std::vector<sqlb::ObjectPtr>& DBBrowserDB::getObjectsByName(const sqlb::ObjectIdentifier& name) const
+{
+    static const std::vector<sqlb::ObjectPtr> none;
+
+    auto schema = objectIndex.find(name.schema());
+    if(schema == objectIndex.end())
+        return none;
+
+    auto objects = schema->second.find(name.name());
+    if(objects == schema->second.end())
+        return none;
+
+    return objects->second;
+}
+
+sqlb::ObjectPtr DBBrowserDB::parseObject(const std::string& type, const std::string& name, const std::string& sql)
+{
+    sqlb::ObjectPtr object;
+    if(type == "table")
+        object = sqlb::Table::parseSQL(sql);
+    else if(type == "index")
+        object = sqlb::Index::parseSQL(sql);
+    else if(type == "trigger")
+        object = sqlb::Trigger::parseSQL(sql);
+    else if(type == "view")
+        object = sqlb::View::parseSQL(sql);
+    else
+        return nullptr;
+
+    // If parsing wasn't successful set the object name manually, so that at least the name is going to be correct
+    if(!object->fullyParsed())
+        object->setName(name);
+
+    return object;
+}
+
+void DBBrowserDB::completeSchemaObject(const std::string& schema_name, const sqlb::ObjectPtr& object, const std::string& name,
+                                       const std::string& tbl_name)
+{
+    // For virtual tables and views query the column list using the SQLite pragma because for both we can't yet rely on our grammar parser
+    if(hasQueriedColumns(object))
+    {
+        auto columns = queryColumnInformation(schema_name, name);
+
+        if(object->type() == sqlb::Object::Types::Table)
+        {
+            sqlb::TablePtr tab = std::dynamic_pointer_cast<sqlb::Table>(object);
+            for(const auto& column : columns)
+                tab->fields.emplace_back(column.first, column.second);
+        } else {
+            sqlb::ViewPtr view = std::dynamic_pointer_cast<sqlb::View>(object);
+            for(const auto& column : columns)
+                view->fields.emplace_back(column.first, column.second);
+        }
+    } else if(object->type() == sqlb::Object::Types::Trigger) {
+        // For triggers set the name of the table the trigger operates on here because we don't have a parser for trigger statements yet.
+        sqlb::TriggerPtr trg = std::dynamic_pointer_cast<sqlb::Trigger>(object);
+        trg->setTable(tbl_name);
+    }
+}
+
+DBBrowserDB::SchemaState::KnownObject* DBBrowserDB::findStub(const std::string& schema, const sqlb::ObjectPtr& object) const
+{
+    auto state = schemaStates.find(schema);
+    if(state == schemaStates.end())
+        return nullptr;
+
+    auto known = state->second.objects.find({sqlb::Object::typeToString(object->type()), object->name()});
+    if(known == state->second.objects.end() || known->second.parsed || known->second.object != object)
+        return nullptr;
+
+    return &known->second;
+}
+
+void DBBrowserDB::applyParsedObject(SchemaState::KnownObject& stub, const sqlb::ObjectPtr& parsed)
+{
+    // Everyone holding a pointer to the stub gets to see the parsed object this way. Keep the name as it is because the
+    // object index relies on it.
+    if(parsed && parsed->type() == stub.object->type())
+    {
+        const std::string name = stub.object->name();
+        if(parsed->type() == sqlb::Object::Types::Table)
+            *std::static_pointer_cast<sqlb::Table>(stub.object) = *std::static_pointer_cast<sqlb::Table>(parsed);
+        else if(parsed->type() == sqlb::Object::Types::Index)
+            *std::static_pointer_cast<sqlb::Index>(stub.object) = *std::static_pointer_cast<sqlb::Index>(parsed);
+        stub.object->setName(name);
+    }
+
+    stub.parsed = true;
+}
+
+void DBBrowserDB::ensureParsed(const std::string& schema, const sqlb::ObjectPtr& object) const
+{
+    if(!object)
+        return;
+
+    SchemaState::KnownObject* stub = findStub(schema, object);
+    if(stub)
+        applyParsedObject(*stub, parseObject(sqlb::Object::typeToString(object->type()), object->name(), object->originalSql()));
+}
+
+void DBBrowserDB::ensureAllParsed(const std::string& schema, const std::string& type) const
+{
+    std::vector<std::pair<SchemaState::KnownObject*, sqlb::ObjectPtr>> stubs;
+    for(auto& state : schemaStates)
+    {
+        if(!schema.empty() && state.first != schema)
+            continue;
+
+        for(auto& it : state.second.objects)
+        {
+            if(!it.second.parsed && (type.empty() || it.first.first == type))
+                stubs.push_back({&it.second, nullptr});
+        }
+    }
+
+    QtConcurrent::blockingMap(stubs, [](std::pair<SchemaState::KnownObject*, sqlb::ObjectPtr>& stub) {
+        const sqlb::ObjectPtr& object = stub.first->object;
+        stub.second = parseObject(sqlb::Object::typeToString(object->type()), object->name(), object->originalSql());
+    });
+
+    for(const auto& stub : stubs)
+        applyParsedObject(*stub.first, stub.second);
+}
+
+bool DBBrowserDB::isParsed(const std::string& schema, const sqlb::ObjectPtr& object) const
+{
+    return findStub(schema, object) == nullptr;
+}
+
+void DBBrowserDB::parseStubsInBackground()
+{
+    // Only one batch at a time. Stubs which are created in the meantime are picked up afterwards.
+    if(backgroundParser.isRunning())
+    {
+        backgroundParseRequested = true;
+        return;
+    }
+
+    backgroundJobs.clear();
+    for(const auto& state : schemaStates)
+    {
+        for(const auto& it : state.second.objects)
+        {
+            if(!it.second.parsed)
+                backgroundJobs.push_back({state.first, it.second.object, it.first.first, it.first.second, it.second.object->originalSql(), nullptr});
+        }
+    }
+
+    if(!backgroundJobs.empty())
+    {
+        backgroundParser.setFuture(QtConcurrent::map(backgroundJobs, [](StubJob& job) {
+            job.parsed = parseObject(job.type, job.name, job.sql);
+        }));
+    }
+}
+
+void DBBrowserDB::backgroundParsingFinished()
+{
+    // Some of the stubs might have been parsed on demand or even been dropped since
+    std::vector<std::pair<std::string, sqlb::ObjectPtr>> parsed;
+    if(!backgroundParser.isCanceled())
+    {
+        for(const auto& job : backgroundJobs)
+        {
+            SchemaState::KnownObject* stub = findStub(job.schema, job.stub);
+            if(stub)
+            {
+                applyParsedObject(*stub, job.parsed);
+                parsed.emplace_back(job.schema, job.stub);
+            }
+        }
+    }
+    backgroundJobs.clear();
+
+    for(const auto& obj : parsed)
+        emit objectChanged(obj.first, obj.second);
+    if(!parsed.empty())
+        emit structureUpdated();
+
+    if(backgroundParseRequested)
+    {
+        backgroundParseRequested = false;
+        parseStubsInBackground();
+    }
 }
 
 QString DBBrowserDB::getPragma(const QString& pragma)
@@ -10,8 +10,10 @@
 #include <functional>
 #include <vector>
 #include <map>
+#include <unordered_map>
 
 #include <QObject>
+#include <QFutureWatcher>
 #include <QByteArray>
 #include <QStringList>
 
@@ -65,8 +67,11 @@ private:
 
 public:
 
-    explicit DBBrowserDB () : _db(nullptr), db_used(false), isEncrypted(false), isReadOnly(false), dontCheckForStructureUpdates(false) {}
-    ~DBBrowserDB () override {}
+    explicit DBBrowserDB () : _db(nullptr), db_used(false), isEncrypted(false), isReadOnly(false), generation(0), backgroundParseRequested(false), dontCheckForStructureUpdates(false)
+    {
+        connect(&backgroundParser, &QFutureWatcher<void>::finished, this, &DBBrowserDB::backgroundParsingFinished);
+    }
+    ~DBBrowserDB () override { backgroundParser.waitForFinished(); }
 
     bool open(const QString& db, bool readOnly = false);
     bool attach(const QString& filename, QString attach_as = "");
@@ -107,6 +112,16 @@ public:
     bool releaseAllSavepoints();
     bool revertAll();
 
+    /**
+     * @brief createSessionIndex Creates an index which is only kept until the changes are written or reverted
+     * SQLite doesn't allow temporary indexes on tables which aren't temporary, so the index is created like any other
+     * change and dropped again right before the outermost savepoint is released, whichever code path does that.
+     * @param schema The schema of the indexed table
+     * @param index The index to create
+     * @return true on success. Otherwise lastError() holds the error message
+     */
+    bool createSessionIndex(const std::string& schema, const sqlb::Index& index);
+
     bool dump(const QString& filename, const QStringList& tablesToDump, bool insertColNames, bool insertNew, bool exportSchema, bool exportData, bool keepOldSchema);
 
     enum ChoiceOnUse
@@ -131,6 +146,15 @@ public:
 
     const QString& lastError() const { return lastErrorMessage; }
 
+    /**
+     * @brief dataVersion Returns a token which changes whenever the data or the structure of the given schema
+     * might have changed, either by this connection or by another one. This is used for checking whether cached
+     * data is still up to date. The database isn't waited for; if it is currently busy an empty string is returned.
+     * @param schema The schema to check
+     * @return A version token or an empty string if it can't be determined right now
+     */
+    QString dataVersion(const std::string& schema);
+
     /**
      * @brief getRow Executes a sqlite statement to get the rowdata(columns)
      *        for the given rowid.
@@ -138,9 +162,10 @@ public:
      * @param sTableName Table to query.
      * @param rowid The rowid to fetch.
      * @param rowdata A list of QByteArray containing the row data.
+     * @param pseudo_pk The primary key to use for views; see deleteRecords() and updateRecord().
      * @return true if statement execution was ok, else false.
      */
-    bool getRow(const sqlb::ObjectIdentifier& table, const QString& rowid, std::vector<QByteArray>& rowdata);
+    bool getRow(const sqlb::ObjectIdentifier& table, const QString& rowid, std::vector<QByteArray>& rowdata, const sqlb::StringVector& pseudo_pk = {});
 
     /**
      * @brief Interrupts the currenty running statement as soon as possible.
@@ -173,8 +198,24 @@ private:
 public:
     QString addRecord(const sqlb::ObjectIdentifier& tablename);
     bool deleteRecords(const sqlb::ObjectIdentifier& table, const QStringList& rowids, const sqlb::StringVector& pseudo_pk = {});
+
+    // Deletes all records whose primary key values are returned by the rowid_query. The query needs to return one column per primary key column.
+    bool deleteRecordsFromQuery(const sqlb::ObjectIdentifier& table, const QString& rowid_query, const sqlb::StringVector& pseudo_pk = {});
     bool updateRecord(const sqlb::ObjectIdentifier& table, const std::string& column, const QString& rowid, const QByteArray& value, bool itsBlob, const sqlb::StringVector& pseudo_pk = {});
 
+    // New values for the same set of columns in a number of rows. The values vector has one entry per rowid which in turn contains
+    // one value per column.
+    struct RecordUpdates
+    {
+        std::vector<std::string> columns;
+        QStringList rowids;
+        std::vector<std::vector<QByteArray>> values;
+    };
+
+    // Updates multiple rows using one prepared statement per set of columns. All changes are made within a single savepoint, so
+    // if one of the rows can't be updated none of the changes is applied.
+    bool updateRecords(const sqlb::ObjectIdentifier& table, const std::vector<RecordUpdates>& updates, const sqlb::StringVector& pseudo_pk = {});
+
     bool createTable(const sqlb::ObjectIdentifier& name, const sqlb::FieldVector& structure);
     bool renameTable(const std::string& schema, const std::string& from_table, const std::string& to_table);
     bool addColumn(const sqlb::ObjectIdentifier& tablename, const sqlb::Field& field);
@@ -205,14 +246,45 @@ public:
     template<typename T = sqlb::Object>
     const std::shared_ptr<T> getObjectByName(const sqlb::ObjectIdentifier& name) const
     {
-        for(auto& it : schemata.at(name.schema()))
+        // Triggers don't share their namespace with the other object types, so there can be more than one object of the same
+        // name. Return the first one which is of the requested type.
+        for(const auto& object : getObjectsByName(name))
         {
-            if(it.second->name() == name.name())
-                return std::dynamic_pointer_cast<T>(it.second);
+            std::shared_ptr<T> result = std::dynamic_pointer_cast<T>(object);
+            if(result)
+            {
+                ensureParsed(name.schema(), object);
+                return result;
+            }
         }
         return std::shared_ptr<T>();
     }
 
+    /// \returns all objects of the given name, ordered by type in the same way as in the objectMap. The objects aren't parsed
+    /// by this; see ensureParsed().
+    const std::vector<sqlb::ObjectPtr>& getObjectsByName(const sqlb::ObjectIdentifier& name) const;
+
+    /**
+     * @brief ensureParsed Parses an object if only a stub has been created for it so far.
+     * Most objects of a big schema are never looked at, so updateSchema() only creates stubs for tables and indices which just
+     * contain the name and the CREATE statement. They are parsed when they are first accessed through getObjectByName() and
+     * in the background. Code which goes through the schemata directly needs to call this before looking at any details of an
+     * object like its fields or constraints. The object is updated in place.
+     * @param schema The schema the object belongs to
+     * @param object The object to parse
+     */
+    void ensureParsed(const std::string& schema, const sqlb::ObjectPtr& object) const;
+
+    /**
+     * @brief ensureAllParsed Parses all stubs of a schema. See ensureParsed().
+     * @param schema The schema to parse or an empty string for all schemata
+     * @param type The type of the objects to parse, e.g. "table", or an empty string for all types
+     */
+    void ensureAllParsed(const std::string& schema = std::string(), const std::string& type = std::string()) const;
+
+    /// \returns false if \param object is a stub which hasn't been parsed yet
+    bool isParsed(const std::string& schema, const sqlb::ObjectPtr& object) const;
+
     bool isOpen() const;
     bool encrypted() const { return isEncrypted; }
     bool readOnly() const { return isReadOnly; }
@@ -247,6 +319,12 @@ signals:
     void sqlExecuted(QString sql, int msgtype);
     void dbChanged(bool dirty);
     void structureUpdated();
+
+    /// emitted by updateSchema() for each object which has been added, removed or changed since the last update. They
+    /// are emitted once the schema has been updated completely. If any of them has been emitted, structureUpdated() follows.
+    void objectAdded(const std::string& schema, sqlb::ObjectPtr object);
+    void objectRemoved(const std::string& schema, sqlb::ObjectPtr object);
+    void objectChanged(const std::string& schema, sqlb::ObjectPtr object);
     void requestCollation(QString name, int eTextRep);
     void databaseInUseChanged(bool busy, QString user);
 
@@ -263,12 +341,85 @@ private:
     /// message box.
     void waitForDbRelease(ChoiceOnUse choice = Ask);
 
+    /// drop the indexes created by createSessionIndex() right before the outermost savepoint is released
+    void dropSessionIndexes();
+
     QString curDBFilename;
     QString lastErrorMessage;
     QStringList savepointList;
+    std::vector<sqlb::ObjectIdentifier> sessionIndexes;
     bool isEncrypted;
     bool isReadOnly;
 
+    /// incremented whenever changes are undone or the database is closed,
+    /// because neither of these is reflected by the SQLite counters used
+    /// in dataVersion()
+    unsigned int generation;
+
+    /// what updateSchema() has seen of each schema the last time it was called. Schemas whose schema_version hasn't changed
+    /// since are skipped and of the other schemas only those objects are parsed again whose CREATE statement has changed.
+    struct SchemaState
+    {
+        struct KnownObject
+        {
+            size_t hash;                // hash of the CREATE statement
+            sqlb::ObjectPtr object;
+            bool parsed;                // false if the object is just a stub so far
+        };
+
+        std::string file;
+        int version = -1;
+        std::map<std::pair<std::string, std::string>, KnownObject> objects;    // (type, name) -> object
+    };
+    mutable std::map<std::string, SchemaState> schemaStates;
+
+    /// maps from the schema name and the object name to the objects of that name. This is kept up to date alongside the
+    /// schemata for looking up objects by name in constant time.
+    std::map<std::string, std::unordered_map<std::string, std::vector<sqlb::ObjectPtr>>> objectIndex;
+    void updateObjectIndex(const std::string& schema);
+
+    struct SchemaChanges
+    {
+        std::vector<std::pair<std::string, sqlb::ObjectPtr>> added;
+        std::vector<std::pair<std::string, sqlb::ObjectPtr>> removed;
+        std::vector<std::pair<std::string, sqlb::ObjectPtr>> changed;
+    };
+    void updateSchemaObjects(const std::string& schema_name, SchemaState& state, SchemaChanges& changes);
+
+    /// parses the CREATE statement of an object. This doesn't access the database, so it's safe to call from any thread
+    static sqlb::ObjectPtr parseObject(const std::string& type, const std::string& name, const std::string& sql);
+
+    /// adds the information to a parsed object which can only be taken from the database
+    void completeSchemaObject(const std::string& schema_name, const sqlb::ObjectPtr& object, const std::string& name,
+                              const std::string& tbl_name);
+
+    /// \returns the state of \param object if it is still an unparsed stub of \param schema or nullptr otherwise
+    SchemaState::KnownObject* findStub(const std::string& schema, const sqlb::ObjectPtr& object) const;
+
+    /// copies \param parsed into the stub and marks it as parsed
+    static void applyParsedObject(SchemaState::KnownObject& stub, const sqlb::ObjectPtr& parsed);
+
+    /// the stubs which are currently being parsed in the background. They carry copies of everything needed for parsing
+    /// because the stubs themselves might be parsed on demand at the same time.
+    struct StubJob
+    {
+        std::string schema;
+        sqlb::ObjectPtr stub;
+        std::string type;
+        std::string name;
+        std::string sql;
+        sqlb::ObjectPtr parsed;
+    };
+    std::vector<StubJob> backgroundJobs;
+    QFutureWatcher<void> backgroundParser;
+    bool backgroundParseRequested;
+
+private slots:
+    void parseStubsInBackground();
+    void backgroundParsingFinished();
+
+private:
+
     sqlb::StringVector primaryKeyForEditing(const sqlb::ObjectIdentifier& table, const sqlb::StringVector& pseudo_pk) const;
 
     // SQLite Callbacks
@@ -4,6 +4,7 @@
 #include "Settings.h"
 #include "Data.h"
 #include "CondFormat.h"
+#include "CacheGovernor.h"
 
 #include <QMessageBox>
 #include <QApplication>
@@ -13,24 +14,29 @@
 #include <QUrl>
 #include <QtConcurrent/QtConcurrentRun>
 #include <QProgressDialog>
-#include <json.hpp>
+#include <QDebug>
+#include <algorithm>
+#include <limits>
 
 #include "RowLoader.h"
-
-using json = nlohmann::json;
+#include "RowSorter.h"
 
 SqliteTableModel::SqliteTableModel(DBBrowserDB& db, QObject* parent, size_t chunkSize, const QString& encoding)
     : QAbstractTableModel(parent)
     , m_db(db)
     , m_lifeCounter(0)
     , m_currentRowCount(0)
+    , m_sortedInMemory(false)
+    , m_cacheBytes(0)
     , m_chunkSize(chunkSize)
     , m_encoding(encoding)
+    , m_cacheBudget(0)
+    , m_isTable(false)
 {
     worker = new RowLoader(
         [this](){ return m_db.get(tr("reading rows")); },
         [this](QString stmt){ return m_db.logSQL(stmt, kLogMsg_App); },
-        m_headers, m_mutexDataCache, m_cache
+        m_headers, m_mutexDataCache, m_cache, m_cacheBytes, m_formatter
         );
 
     worker->start();
@@ -39,11 +45,16 @@ SqliteTableModel::SqliteTableModel(DBBrowserDB& db, QObject* parent, size_t chun
     connect(worker, &RowLoader::fetched, this, &SqliteTableModel::handleFinishedFetch, Qt::QueuedConnection);
     connect(worker, &RowLoader::rowCountComplete, this, &SqliteTableModel::handleRowCountComplete, Qt::QueuedConnection);
 
+    CacheGovernor::instance().registerModel(this);
+
+    reloadSettings();
     reset();
 }
 
 SqliteTableModel::~SqliteTableModel()
 {
+    CacheGovernor::instance().unregisterModel(this);
+
     worker->stop();
     worker->wait();
     worker->disconnect();
@@ -85,6 +96,8 @@ void SqliteTableModel::handleFinishedFetch (int life_id, unsigned int fetched_ro
     if(m_rowCountAvailable != RowCount::Complete)
         m_rowCountAvailable = RowCount::Partial;
 
+    updateMemoryUsage();
+
     emit finishedFetch(static_cast<int>(fetched_row_begin), static_cast<int>(fetched_row_end));
 }
 
@@ -109,6 +122,8 @@ void SqliteTableModel::reset()
     m_headers.clear();
     m_vDataTypes.clear();
     m_mCondFormats.clear();
+    m_visibleColumns.clear();
+    m_isTable = false;
 
     endResetModel();
 }
@@ -118,6 +133,11 @@ void SqliteTableModel::setChunkSize(size_t chunksize)
     m_chunkSize = chunksize;
 }
 
+void SqliteTableModel::setProfiler(StatementProfiler* profiler)
+{
+    worker->setProfiler(profiler);
+}
+
 void SqliteTableModel::setQuery(const sqlb::Query& query)
 {
     // Unset all previous settings. When setting a table all information on the previously browsed data set is removed first.
@@ -156,6 +176,7 @@ void SqliteTableModel::setQuery(const sqlb::Query& query)
                 m_vDataTypes.push_back(colType);
             }
             allOk = true;
+            m_isTable = true;
         }
     }
 
@@ -193,8 +214,12 @@ void SqliteTableModel::setQuery(const QString& sQuery, const QString& sCountQuer
     m_sQuery = sQuery.trimmed();
     removeCommentsFromQuery(m_sQuery);
 
-    worker->setQuery(m_sQuery, sCountQuery);
-    worker->triggerRowCountDetermination(m_lifeCounter);
+    worker->setQuery(m_sQuery, sCountQuery, m_query.rowIdColumns().size());
+
+    // When switching back to a table which has been browsed before, its rows might still be available. In this
+    // case the row count is known already and only missing rows are fetched.
+    if(!dontClearHeaders || !restoreCache())
+        worker->triggerRowCountDetermination(m_lifeCounter);
 
     if(!dontClearHeaders)
     {
@@ -297,23 +322,16 @@ QVariant SqliteTableModel::data(const QModelIndex &index, int role) const
     if (index.row() >= rowCount())
         return QVariant();
 
-    QMutexLocker lock(&m_mutexDataCache);
+    CacheGovernor::instance().touch(this);
 
-    Row blank_data;
-    bool row_available;
+    QMutexLocker lock(&m_mutexDataCache);
 
-    const Row * cached_row;
     const size_t row = static_cast<size_t>(index.row());
     const size_t column = static_cast<size_t>(index.column());
-    if(m_cache.count(row))
-    {
+    const Row* cached_row = nullptr;
+    if(m_cache.count(row) && m_cache.at(row).isLoaded(column))
         cached_row = &m_cache.at(row);
-        row_available = true;
-    } else {
-        blank_data = makeDefaultCacheEntry();
-        cached_row = &blank_data;
-        row_available = false;
-    }
+    const bool row_available = cached_row != nullptr;
 
     if(role == Qt::DisplayRole || role == Qt::EditRole)
     {
@@ -321,33 +339,27 @@ QVariant SqliteTableModel::data(const QModelIndex &index, int role) const
             return tr("loading...");
         if(role == Qt::DisplayRole && cached_row->at(column).isNull())
         {
-            return Settings::getValue("databrowser", "null_text").toString();
-        } else if(role == Qt::DisplayRole && nosync_isBinary(index)) {
-            return Settings::getValue("databrowser", "blob_text").toString();
+            return m_displaySettings.nullText;
+        } else if(role == Qt::DisplayRole && cached_row->isBinary(column)) {
+            return m_displaySettings.blobText;
         } else if(role == Qt::DisplayRole) {
-            int limit = Settings::getValue("databrowser", "symbol_limit").toInt();
-            QByteArray displayText = cached_row->at(column);
-            if (displayText.length() > limit) {
-                // Add "..." to the end of truncated strings
-                return decode(displayText.left(limit).append(" ..."));
-            } else {
-                return decode(displayText);
-            }
+            // The display text has already been decoded and truncated when fetching the cell
+            return cached_row->display[column];
         } else {
             return decode(cached_row->at(column));
         }
     } else if(role == Qt::FontRole) {
         QFont font;
-        if(!row_available || cached_row->at(column).isNull() || nosync_isBinary(index))
+        if(!row_available || cached_row->at(column).isNull() || cached_row->isBinary(column))
             font.setItalic(true);
         return font;
     } else if(role == Qt::ForegroundRole) {
         if(!row_available)
             return QColor(100, 100, 100);
         if(cached_row->at(column).isNull())
-            return QColor(Settings::getValue("databrowser", "null_fg_colour").toString());
-        else if (nosync_isBinary(index))
-            return QColor(Settings::getValue("databrowser", "bin_fg_colour").toString());
+            return m_displaySettings.nullFgColour;
+        else if (cached_row->isBinary(column))
+            return m_displaySettings.binFgColour;
         else if (m_mCondFormats.find(index.column()) != m_mCondFormats.end()) {
             QString value = cached_row->at(column);
             // Unlock before querying from DB
@@ -357,14 +369,14 @@ QVariant SqliteTableModel::data(const QModelIndex &index, int role) const
                 return condFormatColor;
             }
         // Regular case (not null, not binary and no matching conditional format)
-        return QColor(Settings::getValue("databrowser", "reg_fg_colour").toString());
+        return m_displaySettings.regFgColour;
     } else if (role == Qt::BackgroundRole) {
         if(!row_available)
             return QColor(255, 200, 200);
         if(cached_row->at(column).isNull())
-            return QColor(Settings::getValue("databrowser", "null_bg_colour").toString());
-        else if (nosync_isBinary(index))
-            return QColor(Settings::getValue("databrowser", "bin_bg_colour").toString());
+            return m_displaySettings.nullBgColour;
+        else if (cached_row->isBinary(column))
+            return m_displaySettings.binBgColour;
         else if (m_mCondFormats.find(index.column()) != m_mCondFormats.end()) {
             QString value = cached_row->at(column);
             // Unlock before querying from DB
@@ -374,7 +386,7 @@ QVariant SqliteTableModel::data(const QModelIndex &index, int role) const
                 return condFormatColor;
         }
         // Regular case (not null, not binary and no matching conditional format)
-        return QColor(Settings::getValue("databrowser", "reg_bg_colour").toString());
+        return m_displaySettings.regBgColour;
     } else if(role == Qt::ToolTipRole) {
         sqlb::ForeignKeyClause fk = getForeignKeyClause(index.column()-1);
         if(fk.isSet())
@@ -445,22 +457,9 @@ bool SqliteTableModel::setTypedData(const QModelIndex& index, bool isBlob, const
         auto & cached_row = m_cache.at(static_cast<size_t>(index.row()));
         const size_t column = static_cast<size_t>(index.column());
 
-        QByteArray newValue = encode(value.toByteArray());
+        QByteArray newValue = prepareValueForColumn(column, encode(value.toByteArray()));
         QByteArray oldValue = cached_row.at(column);
 
-        // Special handling for integer columns: instead of setting an integer column to an empty string, set it to '0' when it is also
-        // used in a primary key. Otherwise SQLite will always output an 'datatype mismatch' error.
-        if(newValue == "" && !newValue.isNull())
-        {
-            sqlb::TablePtr table = m_db.getObjectByName<sqlb::Table>(m_query.table());
-            if(table)
-            {
-                auto field = sqlb::findField(table, m_headers.at(column));
-                if(contains(table->primaryKey(), field->name()) && field->isInteger())
-                    newValue = "0";
-            }
-        }
-
         // Don't do anything if the data hasn't changed
         // To differentiate NULL and empty byte arrays, we also compare the NULL flag
         if(oldValue == newValue && oldValue.isNull() == newValue.isNull())
@@ -468,27 +467,14 @@ bool SqliteTableModel::setTypedData(const QModelIndex& index, bool isBlob, const
 
         if(m_db.updateRecord(m_query.table(), m_headers.at(column), cached_row.at(0), newValue, isBlob, m_query.rowIdColumns()))
         {
-            cached_row[column] = newValue;
+            m_cacheBytes -= cached_row.memoryUsage();
+            cached_row.set(column, newValue, guessCellType(column, newValue, isBlob), m_formatter);
+            m_cacheBytes += cached_row.memoryUsage();
 
             // After updating the value itself in the cache, we need to check if we need to update the rowid too.
             if(contains(m_query.rowIdColumns(), m_headers.at(column)))
             {
-                // When the cached rowid column needs to be updated as well, we need to distinguish between single-column and multi-column primary keys.
-                // For the former ones, we can just overwrite the existing value with the new value.
-                // For the latter ones, we need to make a new JSON object of the values of all primary key columns, not just the updated one.
-                if(m_query.rowIdColumns().size() == 1)
-                {
-                    cached_row[0] = newValue;
-                } else {
-                    json array;
-                    assert(m_headers.size() == cached_row.size());
-                    for(size_t i=0;i<m_query.rowIdColumns().size();i++)
-                    {
-                        auto it = std::find(m_headers.begin()+1, m_headers.end(), m_query.rowIdColumns().at(i));    // +1 in order to omit the rowid column itself
-                        array.push_back(cached_row[static_cast<size_t>(std::distance(m_headers.begin(), it))]);
-                    }
-                    cached_row[0] = QByteArray::fromStdString(array.dump());
-                }
+                nosync_updateRowid(cached_row, {column});
                 const QModelIndex& rowidIndex = index.sibling(index.row(), 0);
                 lock.unlock();
                 emit dataChanged(rowidIndex, rowidIndex);
@@ -507,6 +493,209 @@ bool SqliteTableModel::setTypedData(const QModelIndex& index, bool isBlob, const
     return false;
 }
 
+bool SqliteTableModel::setMultipleData(const QModelIndexList& indices, const std::vector<QByteArray>& values)
+{
+    if(!isEditable() || indices.empty() || indices.size() != static_cast<int>(values.size()))
+        return false;
+
+    // We need the rowids of all affected rows, so make sure they are in the cache
+    int first_row = indices.front().row();
+    int last_row = first_row;
+    int first_column = indices.front().column();
+    int last_column = first_column;
+    for(const auto& index : indices)
+    {
+        first_row = std::min(first_row, index.row());
+        last_row = std::max(last_row, index.row());
+        first_column = std::min(first_column, index.column());
+        last_column = std::max(last_column, index.column());
+    }
+    if(!loadRows(first_row, last_row + 1))
+        return false;
+
+    QMutexLocker lock(&m_mutexDataCache);
+
+    // Group the cells by row and skip all cells whose value doesn't change
+    std::map<int, std::map<size_t, QByteArray>> rows;
+    for(int i=0;i<indices.size();i++)
+    {
+        const auto row = indices.at(i).row();
+        const auto column = static_cast<size_t>(indices.at(i).column());
+        if(column == 0 || column >= m_headers.size())
+            continue;
+
+        QByteArray newValue = prepareValueForColumn(column, encode(values.at(static_cast<size_t>(i))));
+        const Row& cached_row = m_cache.at(static_cast<size_t>(row));
+        if(cached_row.isLoaded(column) && cached_row.at(column) == newValue && cached_row.at(column).isNull() == newValue.isNull())
+            continue;
+
+        rows[row][column] = newValue;
+    }
+    if(rows.empty())
+        return true;
+
+    // Rows in which the same columns are changed can be updated using the same statement
+    std::map<std::vector<size_t>, DBBrowserDB::RecordUpdates> updates;
+    for(const auto& row : rows)
+    {
+        std::vector<size_t> columns;
+        std::vector<QByteArray> row_values;
+        for(const auto& cell : row.second)
+        {
+            columns.push_back(cell.first);
+            row_values.push_back(cell.second);
+        }
+
+        auto& update = updates[columns];
+        if(update.columns.empty())
+        {
+            for(size_t column : columns)
+                update.columns.push_back(m_headers.at(column));
+        }
+        update.rowids.push_back(m_cache.at(static_cast<size_t>(row.first)).at(0));
+        update.values.push_back(std::move(row_values));
+    }
+    lock.unlock();
+
+    std::vector<DBBrowserDB::RecordUpdates> update_list;
+    for(auto& update : updates)
+        update_list.push_back(std::move(update.second));
+    if(!m_db.updateRecords(m_query.table(), update_list, m_query.rowIdColumns()))
+    {
+        QMessageBox::warning(nullptr, qApp->applicationName(), tr("Error changing data:\n%1").arg(m_db.lastError()));
+        return false;
+    }
+
+    // Update the cache
+    lock.relock();
+    bool rowid_changed = false;
+    for(const auto& row : rows)
+    {
+        Row& cached_row = m_cache.at(static_cast<size_t>(row.first));
+        std::vector<size_t> changed_pk_columns;
+        m_cacheBytes -= cached_row.memoryUsage();
+        for(const auto& cell : row.second)
+        {
+            cached_row.set(cell.first, cell.second, guessCellType(cell.first, cell.second, false), m_formatter);
+            if(contains(m_query.rowIdColumns(), m_headers.at(cell.first)))
+                changed_pk_columns.push_back(cell.first);
+        }
+        m_cacheBytes += cached_row.memoryUsage();
+        if(!changed_pk_columns.empty())
+        {
+            nosync_updateRowid(cached_row, changed_pk_columns);
+            rowid_changed = true;
+        }
+    }
+    lock.unlock();
+
+    updateMemoryUsage();
+
+    emit dataChanged(index(rows.begin()->first, rowid_changed ? 0 : first_column), index(rows.rbegin()->first, last_column));
+    return true;
+}
+
+QByteArray SqliteTableModel::prepareValueForColumn(size_t column, const QByteArray& value) const
+{
+    // Special handling for integer columns: instead of setting an integer column to an empty string, set it to '0' when it is also
+    // used in a primary key. Otherwise SQLite will always output an 'datatype mismatch' error.
+    if(value == "" && !value.isNull())
+    {
+        sqlb::TablePtr table = m_db.getObjectByName<sqlb::Table>(m_query.table());
+        if(table)
+        {
+            auto field = sqlb::findField(table, m_headers.at(column));
+            if(field != table->fields.end() && contains(table->primaryKey(), field->name()) && field->isInteger())
+                return "0";
+        }
+    }
+
+    return value;
+}
+
+void SqliteTableModel::nosync_updateRowid(Row& row, const std::vector<size_t>& changed_columns) const
+{
+    // When the cached rowid column needs to be updated as well, we need to distinguish between single-column and multi-column primary keys.
+    // For the former ones, we can just overwrite the existing value with the value of the primary key column.
+    // For the latter ones, we need to replace the changed values in the combined rowid. The values of the other columns are kept as they
+    // are because the cached cells only hold the rounded text of floating point values.
+    assert(m_headers.size() == row.size());
+    const auto rowid_columns = m_query.rowIdColumns();
+    std::vector<size_t> pk_columns;
+    for(const auto& rowid_column : rowid_columns)
+    {
+        auto it = std::find(m_headers.begin()+1, m_headers.end(), rowid_column);    // +1 in order to omit the rowid column itself
+        if(it == m_headers.end())
+            return;
+        pk_columns.push_back(static_cast<size_t>(std::distance(m_headers.begin(), it)));
+    }
+
+    if(pk_columns.size() == 1)
+    {
+        row.set(0, row.at(pk_columns.front()), row.type(pk_columns.front()), m_formatter);
+        return;
+    }
+
+    QByteArray rowid = row.at(0);
+    for(size_t i=0;i<pk_columns.size() && !rowid.isNull();i++)
+    {
+        if(contains(changed_columns, pk_columns[i]))
+            rowid = replaceCompositeRowidValue(rowid, i, row.at(pk_columns[i]), row.type(pk_columns[i]));
+    }
+
+    // If the old rowid can't be used, combine the values of all primary key columns again
+    if(rowid.isNull())
+    {
+        std::vector<QByteArray> values;
+        std::vector<CellType> types;
+        for(size_t pk_column : pk_columns)
+        {
+            values.push_back(row.at(pk_column));
+            types.push_back(row.type(pk_column));
+        }
+        rowid = makeCompositeRowid(values, types);
+    }
+    row.set(0, rowid, CellType::Text, m_formatter);
+}
+
+bool SqliteTableModel::loadRows(int row_begin, int row_end) const
+{
+    waitUntilIdle();
+
+    // Nothing to do if all rows are cached already
+    size_t fetch_begin = static_cast<size_t>(row_begin);
+    size_t fetch_end = static_cast<size_t>(row_end);
+    {
+        QMutexLocker lock(&m_mutexDataCache);
+        m_cache.smallestNonAvailableRange(fetch_begin, fetch_end);
+    }
+    if(fetch_begin == fetch_end)
+        return true;
+
+    // Loading many rows can take a while. Show a progress dialog then and give the user the chance to cancel, like completeCache() does.
+    QProgressDialog progress(tr("Fetching data..."), tr("Cancel"), static_cast<int>(fetch_begin), static_cast<int>(fetch_end));
+    progress.setWindowModality(Qt::ApplicationModal);
+    progress.setMinimumDuration(500);
+
+    // Fetch all missing rows chunk by chunk
+    for(int row=static_cast<int>(fetch_begin);row<static_cast<int>(fetch_end);row+=static_cast<int>(m_chunkSize))
+    {
+        progress.setValue(row);
+        qApp->processEvents();
+        if(progress.wasCanceled())
+            return false;
+
+        triggerChunkLoad(row + static_cast<int>(m_chunkSize / 2), static_cast<size_t>(row), static_cast<size_t>(row) + m_chunkSize);
+        worker->waitUntilIdle();
+    }
+
+    QMutexLocker lock(&m_mutexDataCache);
+    fetch_begin = static_cast<size_t>(row_begin);
+    fetch_end = static_cast<size_t>(row_end);
+    m_cache.smallestNonAvailableRange(fetch_begin, fetch_end);
+    return fetch_begin == fetch_end;
+}
+
 Qt::ItemFlags SqliteTableModel::flags(const QModelIndex& index) const
 {
     if(!index.isValid())
@@ -541,6 +730,10 @@ void SqliteTableModel::sort(const std::vector<sqlb::SortedColumn>& columns)
     if(m_query.orderBy() == columns)
         return;
 
+    // If all rows are cached there is no need to run the query again
+    if(sortCache(columns))
+        return;
+
     // Save sort order
     m_query.orderBy() = columns;
 
@@ -549,14 +742,91 @@ void SqliteTableModel::sort(const std::vector<sqlb::SortedColumn>& columns)
         buildQuery();
 }
 
-SqliteTableModel::Row SqliteTableModel::makeDefaultCacheEntry () const
+bool SqliteTableModel::canUseCache() const
 {
-    Row blank_data;
+    return m_rowCountAvailable == RowCount::Complete && m_currentRowCount > 0 && isCacheComplete();
+}
 
-    for(size_t i=0; i < m_headers.size(); ++i)
-        blank_data.emplace_back("");
+bool SqliteTableModel::sortCache(const std::vector<sqlb::SortedColumn>& columns)
+{
+    if(columns.empty() || !canUseCache())
+        return false;
 
-    return blank_data;
+    // The query sorts rows which compare equal by their rowid columns (see sqlb::Query::buildOrderByPart()). Do the same here,
+    // so each row ends up at the same position as when running the query. Custom queries are never sorted by SQLite and simply
+    // keep the order of the query for equal rows.
+    std::vector<sqlb::SortedColumn> sort_columns = columns;
+    if(!m_query.table().isEmpty())
+    {
+        for(const auto& rowid_column : m_query.rowIdColumns())
+        {
+            // Use the table column for each part of a composite key. The combined value in the first column isn't sorted like that.
+            auto it = std::find(m_headers.begin()+1, m_headers.end(), rowid_column);    // +1 in order to omit the rowid column itself
+            if(it != m_headers.end())
+                sort_columns.emplace_back(static_cast<size_t>(std::distance(m_headers.begin(), it)), sqlb::Ascending);
+            else if(m_query.rowIdColumns().size() == 1)
+                sort_columns.emplace_back(0, sqlb::Ascending);
+            else
+                return false;
+        }
+    }
+
+    // We can only sort in memory if we sort the same way SQLite does. So check that no other collation than BINARY is used
+    // for any of the columns.
+    sqlb::TablePtr table = m_query.table().isEmpty() ? nullptr : m_db.getObjectByName<sqlb::Table>(m_query.table());
+    for(const auto& sorted_column : sort_columns)
+    {
+        if(sorted_column.column >= m_headers.size())
+            return false;
+
+        if(m_query.table().isEmpty() || sorted_column.column == 0)
+            continue;
+        if(!table)
+            return false;
+        auto field = sqlb::findField(table, m_headers.at(sorted_column.column));
+        if(field == table->fields.end() || (!field->collation().empty() && QString::fromStdString(field->collation()).compare("BINARY", Qt::CaseInsensitive)))
+            return false;
+    }
+
+    QMutexLocker lock(&m_mutexDataCache);
+    std::vector<const Row*> rows;
+    rows.reserve(m_currentRowCount);
+    for(size_t i=0;i<m_currentRowCount;i++)
+        rows.push_back(&m_cache.at(i));
+    const std::vector<size_t> order = RowSorter(sort_columns).sort(rows);
+    lock.unlock();
+
+    emit layoutAboutToBeChanged();
+
+    lock.relock();
+    RowCache<Row> sorted;
+    std::vector<int> new_position(order.size());
+    for(size_t i=0;i<order.size();i++)
+    {
+        sorted.set(i, std::move(m_cache.at(order[i])));
+        new_position[order[i]] = static_cast<int>(i);
+    }
+    m_cache = std::move(sorted);
+    m_sortedInMemory = true;
+    lock.unlock();
+
+    // Keep the selection and the current index on the same rows
+    const QModelIndexList persistent = persistentIndexList();
+    for(const auto& idx : persistent)
+        changePersistentIndex(idx, index(new_position[static_cast<size_t>(idx.row())], idx.column()));
+
+    m_query.orderBy() = columns;
+    if(!m_query.table().isEmpty())
+        applyQueryToWorker();
+
+    emit layoutChanged();
+
+    return true;
+}
+
+SqliteTableModel::Row SqliteTableModel::makeDefaultCacheEntry () const
+{
+    return Row(std::vector<QByteArray>(m_headers.size(), ""), std::vector<CellType>(m_headers.size(), CellType::Text), m_formatter);
 }
 
 bool SqliteTableModel::readingData() const
@@ -585,27 +855,32 @@ bool SqliteTableModel::insertRows(int row, int count, const QModelIndex& parent)
             return false;
         }
         tempList.emplace_back(blank_data);
-        tempList.back()[0] = rowid.toUtf8();
+        tempList.back().set(0, rowid.toUtf8(), guessCellType(0, rowid.toUtf8(), false), m_formatter);
 
         // update column with default values
-        Row rowdata;
-        if(m_db.getRow(m_query.table(), rowid, rowdata))
+        std::vector<QByteArray> rowdata;
+        if(m_db.getRow(m_query.table(), rowid, rowdata, m_query.rowIdColumns()))
         {
             for(size_t j=1; j < m_headers.size(); ++j)
             {
-                tempList.back()[j] = rowdata[j - 1];
+                tempList.back().set(j, rowdata[j - 1], guessCellType(j, rowdata[j - 1], false), m_formatter);
             }
         }
     }
 
     beginInsertRows(parent, row, row + count - 1);
+    QMutexLocker lock(&m_mutexDataCache);
     for(size_t i = 0; i < tempList.size(); ++i)
     {
         m_cache.insert(i + static_cast<size_t>(row), std::move(tempList.at(i)));
         m_currentRowCount++;
     }
+    nosync_recountCacheBytes();
+    lock.unlock();
     endInsertRows();
 
+    updateMemoryUsage();
+
     return true;
 }
 
@@ -619,26 +894,57 @@ bool SqliteTableModel::removeRows(int row, int count, const QModelIndex& parent)
         return false;
     }
 
-    QStringList rowids;
-    for(int i=count-1;i>=0;i--)
+    if(count <= 0)
+        return false;
+
+    const size_t row_begin = static_cast<size_t>(row);
+    const size_t row_end = static_cast<size_t>(row + count);
+
+    // If all rows are cached we know their rowids and can delete them directly. Otherwise we let SQLite select the rows to
+    // delete by their position in the current result set. This way we don't need to fetch large ranges of rows before deleting them.
+    // The browse query always sorts by the rowid last, so the rows at these positions are the same ones which are shown. This
+    // doesn't hold when the rows have been sorted in memory, so they are always deleted by their cached rowids then. Sorting
+    // in memory needs all rows to be cached and they are only ever dropped all at once, so this is always possible.
+    QMutexLocker lock(&m_mutexDataCache);
+    size_t missing_begin = row_begin;
+    size_t missing_end = row_end;
+    m_cache.smallestNonAvailableRange(missing_begin, missing_end);
+
+    bool ok;
+    if(missing_begin == missing_end || m_sortedInMemory)
     {
-        if(m_cache.count(static_cast<size_t>(row+i))) {
-            rowids.append(m_cache.at(static_cast<size_t>(row + i)).at(0));
-        }
-    }
+        if(missing_begin != missing_end)
+            return false;
 
-    bool ok = m_db.deleteRecords(m_query.table(), rowids, m_query.rowIdColumns());
+        QStringList rowids;
+        rowids.reserve(count);
+        for(size_t i=row_begin;i<row_end;i++)
+            rowids.append(m_cache.at(i).at(0));
+        lock.unlock();
+
+        ok = m_db.deleteRecords(m_query.table(), rowids, m_query.rowIdColumns());
+    } else {
+        lock.unlock();
+
+        const QString rowid_query = QString("%1 LIMIT %2 OFFSET %3")
+                .arg(QString::fromStdString(m_query.buildQuery(true, {})))
+                .arg(count)
+                .arg(row);
+        ok = m_db.deleteRecordsFromQuery(m_query.table(), rowid_query, m_query.rowIdColumns());
+    }
 
     if (ok) {
         beginRemoveRows(parent, row, row + count - 1);
 
-        for(int i=count-1;i>=0;i--)
-        {
-            m_cache.erase(static_cast<size_t>(row + i));
-            m_currentRowCount--;
-        }
+        lock.relock();
+        m_cache.erase(row_begin, row_end);
+        nosync_recountCacheBytes();
+        lock.unlock();
+        m_currentRowCount -= static_cast<unsigned int>(count);
 
         endRemoveRows();
+
+        updateMemoryUsage();
     }
     return ok;
 }
@@ -648,6 +954,28 @@ QModelIndex SqliteTableModel::dittoRecord(int old_row)
     if(!isEditable())
         return QModelIndex();
 
+    // When only some of the columns have been fetched, fetch the rest of the row to copy first
+    QString old_rowid;
+    {
+        QMutexLocker lock(&m_mutexDataCache);
+        if(m_cache.count(static_cast<size_t>(old_row)) && !m_cache.at(static_cast<size_t>(old_row)).isComplete())
+            old_rowid = m_cache.at(static_cast<size_t>(old_row)).at(0);
+    }
+    if(!old_rowid.isNull())
+    {
+        std::vector<QByteArray> rowdata;
+        if(m_db.getRow(m_query.table(), old_rowid, rowdata, m_query.rowIdColumns()))
+        {
+            QMutexLocker lock(&m_mutexDataCache);
+            auto& cached_row = m_cache.at(static_cast<size_t>(old_row));
+            for(size_t j=1; j < m_headers.size() && j <= rowdata.size(); ++j)
+            {
+                if(!cached_row.isLoaded(j))
+                    cached_row.set(j, rowdata[j - 1], guessCellType(j, rowdata[j - 1], false), m_formatter);
+            }
+        }
+    }
+
     if (!insertRow(rowCount()))
         return QModelIndex();
 
@@ -775,20 +1103,150 @@ void SqliteTableModel::setCondFormats(int column, const std::vector<CondFormat>&
     emit layoutChanged();
 }
 
+QString SqliteTableModel::filterValue(size_t column) const
+{
+    const auto it = m_query.filterValues().find(column);
+    return it == m_query.filterValues().end() ? QString() : QString::fromStdString(it->second);
+}
+
 void SqliteTableModel::updateFilter(int column, const QString& value)
 {
     QString whereClause = CondFormat::filterToSqlCondition(value, m_encoding);
 
+    const auto old_condition = m_query.where().find(static_cast<size_t>(column));
+    const std::string oldClause = old_condition == m_query.where().end() ? std::string() : old_condition->second;
+
     // If the value was set to an empty string remove any filter for this column. Otherwise insert a new filter rule or replace the old one if there is already one
     if(whereClause.isEmpty())
         m_query.where().erase(static_cast<size_t>(column));
     else
         m_query.where()[static_cast<size_t>(column)] = whereClause.toStdString();
+    if(value.isEmpty())
+        m_query.filterValues().erase(static_cast<size_t>(column));
+    else
+        m_query.filterValues()[static_cast<size_t>(column)] = value.toStdString();
+
+    // If the new filter only narrows down the current result and all rows are cached, we can just filter the cached rows
+    if(filterCache(static_cast<size_t>(column), oldClause, whereClause.toStdString()))
+        return;
 
     // Build the new query
     buildQuery();
 }
 
+// Checks whether every value matching the filter condition new_condition also matches old_condition. This is only
+// checked for conditions which can be evaluated for a single value without knowing the type affinity of the column,
+// i.e. for the LIKE and REGEXP operators.
+static bool isNarrowingFilter(const std::string& old_condition, const std::string& new_condition)
+{
+    const QString new_cond = QString::fromStdString(new_condition);
+    if(!new_cond.startsWith("LIKE ") && !new_cond.startsWith("REGEXP "))
+        return false;
+
+    // Adding a filter to a column which wasn't filtered before always narrows down the result
+    if(old_condition.empty())
+        return true;
+
+    // Both conditions need to be of the form LIKE '%value%' as created for plain filter values. If the new value
+    // contains the old value, every matching row matches the old filter, too.
+    QRegExp rx("^LIKE '%(.*)%' (.*)$");
+    if(rx.indexIn(new_cond) == -1)
+        return false;
+    const QString new_value = rx.cap(1);
+    const QString new_escape = rx.cap(2);
+    if(rx.indexIn(QString::fromStdString(old_condition)) == -1)
+        return false;
+    const QString old_value = rx.cap(1);
+    const QString old_escape = rx.cap(2);
+
+    // Don't try to interpret any escape characters
+    if(new_escape != old_escape || new_value.contains('%') || old_value.contains('%'))
+        return false;
+    QRegExp rxEscape("^ESCAPE '(.*)'$");
+    if(rxEscape.indexIn(new_escape) != -1 && (new_value.contains(rxEscape.cap(1)) || old_value.contains(rxEscape.cap(1))))
+        return false;
+
+    return new_value.contains(old_value);
+}
+
+bool SqliteTableModel::filterCache(size_t column, const std::string& old_condition, const std::string& new_condition)
+{
+    if(m_query.table().isEmpty() || !isNarrowingFilter(old_condition, new_condition) || !canUseCache())
+        return false;
+
+    // Let SQLite evaluate the filter condition for each of the cached values. This makes sure we get the same results as when
+    // executing the query.
+    auto pDb = m_db.get(tr("filtering rows"));
+    if(!pDb)
+        return false;
+    sqlite3_stmt* stmt;
+    const QByteArray sql = QString("SELECT ? %1;").arg(QString::fromStdString(new_condition)).toUtf8();
+    if(sqlite3_prepare_v2(pDb.get(), sql, sql.size(), &stmt, nullptr) != SQLITE_OK)
+        return false;
+
+    QMutexLocker lock(&m_mutexDataCache);
+
+    std::vector<size_t> matching;
+    for(size_t row=0;row<m_currentRowCount;row++)
+    {
+        const Row& cached_row = m_cache.at(row);
+        const QByteArray& value = cached_row.at(column);
+        switch(cached_row.type(column))
+        {
+        case CellType::Null:
+            sqlite3_bind_null(stmt, 1);
+            break;
+        case CellType::Blob:
+            sqlite3_bind_blob(stmt, 1, value.constData(), value.size(), SQLITE_STATIC);
+            break;
+        default:
+            // Both LIKE and REGEXP compare the text representation of numbers
+            sqlite3_bind_text(stmt, 1, value.constData(), value.size(), SQLITE_STATIC);
+            break;
+        }
+
+        if(sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0))
+            matching.push_back(row);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    pDb = nullptr;
+    lock.unlock();
+
+    // Remove all rows and insert the remaining ones again, just like when the query is executed
+    beginRemoveRows(QModelIndex(), 0, static_cast<int>(m_currentRowCount - 1));
+    lock.relock();
+    RowCache<Row> filtered;
+    for(size_t i=0;i<matching.size();i++)
+        filtered.set(i, std::move(m_cache.at(matching[i])));
+    m_cache = std::move(filtered);
+    nosync_recountCacheBytes();
+    lock.unlock();
+    m_currentRowCount = 0;
+    endRemoveRows();
+
+    if(!matching.empty())
+    {
+        beginInsertRows(QModelIndex(), 0, static_cast<int>(matching.size() - 1));
+        m_currentRowCount = static_cast<unsigned int>(matching.size());
+        endInsertRows();
+    }
+
+    applyQueryToWorker();
+    updateMemoryUsage();
+
+    emit layoutChanged();
+    emit finishedFetch(0, static_cast<int>(m_currentRowCount));
+
+    return true;
+}
+
+void SqliteTableModel::applyQueryToWorker()
+{
+    m_sQuery = QString::fromStdString(m_query.buildQuery(true)).trimmed();
+    worker->setQuery(m_sQuery, QString::fromStdString(m_query.buildCountQuery()), m_query.rowIdColumns().size());
+}
+
 void SqliteTableModel::clearCache()
 {
     m_lifeCounter++;
@@ -798,6 +1256,8 @@ void SqliteTableModel::clearCache()
         worker->waitUntilIdle();
     }
 
+    retainCache();
+
     if(m_currentRowCount > 0)
     {
         beginRemoveRows(QModelIndex(), 0, static_cast<int>(m_currentRowCount - 1));
@@ -805,8 +1265,157 @@ void SqliteTableModel::clearCache()
     }
 
     m_cache.clear();
+    m_cacheBytes = 0;
     m_currentRowCount = 0;
     m_rowCountAvailable = RowCount::Unknown;
+    m_sortedInMemory = false;
+
+    updateMemoryUsage();
+}
+
+void SqliteTableModel::retainCache()
+{
+    // Only the data of tables and views is kept. Query results are usually not looked at again.
+    if(m_query.table().isEmpty() || m_sQuery.isEmpty() || m_rowCountAvailable != RowCount::Complete || m_cacheBudget == 0)
+        return;
+
+    const QString version = m_db.dataVersion(m_query.table().schema());
+    if(version.isEmpty())
+        return;
+
+    RetainedCache entry;
+    entry.query = m_sQuery;
+    entry.headers = m_headers;
+    entry.dataVersion = version;
+    entry.rowCount = m_currentRowCount;
+    entry.sortedInMemory = m_sortedInMemory;
+
+    QMutexLocker lock(&m_mutexDataCache);
+    entry.bytes = m_cacheBytes;
+    if(entry.bytes > m_cacheBudget)
+        return;
+    entry.cache = std::move(m_cache);
+    entry.formatter = m_formatter;
+    m_cache.clear();
+    m_cacheBytes = 0;
+    lock.unlock();
+
+    m_retainedCaches.remove_if([this](const RetainedCache& c) { return c.query == m_sQuery; });
+    m_retainedCaches.push_front(std::move(entry));
+
+    // Drop the least recently used caches until we are within the budget again
+    size_t total = 0;
+    for(auto it=m_retainedCaches.begin();it!=m_retainedCaches.end();)
+    {
+        total += it->bytes;
+        if(total > m_cacheBudget)
+        {
+            total -= it->bytes;
+            it = m_retainedCaches.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool SqliteTableModel::restoreCache()
+{
+    auto it = std::find_if(m_retainedCaches.begin(), m_retainedCaches.end(), [this](const RetainedCache& c) {
+        return c.query == m_sQuery && c.headers == m_headers;
+    });
+    if(it == m_retainedCaches.end())
+        return false;
+
+    RetainedCache entry = std::move(*it);
+    m_retainedCaches.erase(it);
+
+    // Outdated caches are simply dropped
+    if(entry.dataVersion != m_db.dataVersion(m_query.table().schema()))
+        return false;
+
+    QMutexLocker lock(&m_mutexDataCache);
+    m_cache = std::move(entry.cache);
+    m_cacheBytes = entry.bytes;
+    m_sortedInMemory = entry.sortedInMemory;
+    if(entry.formatter.encoding() != m_formatter.encoding() || entry.formatter.symbolLimit() != m_formatter.symbolLimit())
+        nosync_reformatCache();
+    lock.unlock();
+
+    // The row count is known already, so there is no need for running the count query again
+    handleRowCountComplete(m_lifeCounter, static_cast<int>(entry.rowCount));
+    return true;
+}
+
+void SqliteTableModel::clearRetainedCaches()
+{
+    m_retainedCaches.clear();
+    updateMemoryUsage();
+}
+
+size_t SqliteTableModel::memoryUsage() const
+{
+    QMutexLocker lock(&m_mutexDataCache);
+    size_t bytes = m_cacheBytes;
+    lock.unlock();
+
+    for(const auto& c : m_retainedCaches)
+        bytes += c.bytes;
+    return bytes;
+}
+
+void SqliteTableModel::releaseCache(bool keep_current_rows)
+{
+    m_retainedCaches.clear();
+
+    // The results of PRAGMA and EXPLAIN statements can't be fetched again in parts, so keep them. They are small anyway.
+    if(!keep_current_rows && !m_sQuery.startsWith("PRAGMA", Qt::CaseInsensitive) && !m_sQuery.startsWith("EXPLAIN", Qt::CaseInsensitive))
+    {
+        // The results of custom queries which have been sorted in memory can't be fetched again in this order. Drop the sort
+        // order instead of keeping the rows, so they don't take up memory for good. The rows are fetched again in the order of
+        // the query then.
+        const bool sorted_in_memory = m_query.table().isEmpty() && !m_query.orderBy().empty();
+        if(sorted_in_memory)
+        {
+            beginResetModel();
+            m_query.orderBy().clear();
+        }
+
+        // The row count stays the same, so the rows are simply fetched again when they are needed
+        QMutexLocker lock(&m_mutexDataCache);
+        m_cache.clear();
+        m_cacheBytes = 0;
+        m_sortedInMemory = false;
+        lock.unlock();
+
+        if(sorted_in_memory)
+            endResetModel();
+    }
+
+    updateMemoryUsage();
+}
+
+QString SqliteTableModel::description() const
+{
+    if(!m_query.table().isEmpty())
+        return QString::fromStdString(m_query.table().toDisplayString());
+
+    QString query = m_sQuery.simplified();
+    if(query.size() > 60)
+        query = query.left(60) + "...";
+    return query;
+}
+
+void SqliteTableModel::updateMemoryUsage()
+{
+    CacheGovernor::instance().reportUsage(this, memoryUsage());
+}
+
+void SqliteTableModel::nosync_recountCacheBytes()
+{
+    m_cacheBytes = 0;
+    m_cache.forEach([this](size_t, Row& row) {
+        m_cacheBytes += row.memoryUsage();
+    });
 }
 
 bool SqliteTableModel::isBinary(const QModelIndex& index) const
@@ -822,8 +1431,104 @@ bool SqliteTableModel::nosync_isBinary(const QModelIndex& index) const
         return false;
 
     const auto & cached_row = m_cache.at(row);
+    const size_t column = static_cast<size_t>(index.column());
+    if(!cached_row.isLoaded(column))
+        return false;
+
+    return cached_row.isBinary(column);
+}
+
+CellType SqliteTableModel::cellType(const QModelIndex& index) const
+{
+    QMutexLocker lock(&m_mutexDataCache);
 
-    return !isTextOnly(cached_row.at(static_cast<size_t>(index.column())), m_encoding, true);
+    const size_t row = static_cast<size_t>(index.row());
+    const size_t column = static_cast<size_t>(index.column());
+    if(!m_cache.count(row) || !m_cache.at(row).isLoaded(column))
+        return CellType::Text;
+
+    return m_cache.at(row).type(column);
+}
+
+CellType SqliteTableModel::guessCellType(size_t column, const QByteArray& value, bool isBlob) const
+{
+    // When we modify a cell ourselves we don't know which storage class SQLite chose for the new value. So guess it
+    // using the declared type of the column, similar to the type affinity rules of SQLite.
+    if(value.isNull())
+        return CellType::Null;
+    if(isBlob)
+        return CellType::Blob;
+
+    if(column < m_vDataTypes.size() && (m_vDataTypes.at(column) == SQLITE_INTEGER || m_vDataTypes.at(column) == SQLITE_FLOAT))
+    {
+        bool ok;
+        value.toLongLong(&ok);
+        if(ok)
+            return CellType::Integer;
+        value.toDouble(&ok);
+        if(ok)
+            return CellType::Float;
+    }
+
+    return CellType::Text;
+}
+
+void SqliteTableModel::setEncoding(const QString& encoding)
+{
+    if(encoding == m_encoding)
+        return;
+
+    QMutexLocker lock(&m_mutexDataCache);
+    m_encoding = encoding;
+    m_formatter = CellFormatter(m_encoding, m_displaySettings.symbolLimit);
+    nosync_reformatCache();
+    lock.unlock();
+
+    if(m_currentRowCount && columnCount())
+        emit dataChanged(index(0, 0), index(static_cast<int>(m_currentRowCount) - 1, columnCount() - 1));
+}
+
+void SqliteTableModel::reloadSettings()
+{
+    const DisplaySettings old_settings = m_displaySettings;
+    m_displaySettings.symbolLimit = Settings::getValue("databrowser", "symbol_limit").toInt();
+    m_displaySettings.nullText = Settings::getValue("databrowser", "null_text").toString();
+    m_displaySettings.blobText = Settings::getValue("databrowser", "blob_text").toString();
+    m_displaySettings.nullFgColour = QColor(Settings::getValue("databrowser", "null_fg_colour").toString());
+    m_displaySettings.nullBgColour = QColor(Settings::getValue("databrowser", "null_bg_colour").toString());
+    m_displaySettings.binFgColour = QColor(Settings::getValue("databrowser", "bin_fg_colour").toString());
+    m_displaySettings.binBgColour = QColor(Settings::getValue("databrowser", "bin_bg_colour").toString());
+    m_displaySettings.regFgColour = QColor(Settings::getValue("databrowser", "reg_fg_colour").toString());
+    m_displaySettings.regBgColour = QColor(Settings::getValue("databrowser", "reg_bg_colour").toString());
+    m_cacheBudget = static_cast<size_t>(Settings::getValue("db", "cachebudget").toUInt()) * 1024 * 1024;
+    CacheGovernor::instance().setBudget(m_cacheBudget);
+    if(m_cacheBudget == 0)
+        clearRetainedCaches();
+
+    // The cached display texts depend on the symbol limit
+    QMutexLocker lock(&m_mutexDataCache);
+    if(m_formatter.symbolLimit() != m_displaySettings.symbolLimit || m_formatter.encoding() != m_encoding)
+    {
+        m_formatter = CellFormatter(m_encoding, m_displaySettings.symbolLimit);
+        nosync_reformatCache();
+    }
+    lock.unlock();
+
+    // Most settings don't affect the table, so only repaint all cells when one of those which do has changed
+    if(m_displaySettings == old_settings)
+        return;
+    if(m_currentRowCount && columnCount())
+        emit dataChanged(index(0, 0), index(static_cast<int>(m_currentRowCount) - 1, columnCount() - 1));
+}
+
+void SqliteTableModel::nosync_reformatCache()
+{
+    // The display texts change their size, so count the memory usage again along the way
+    m_cacheBytes = 0;
+    m_cache.forEach([this](size_t, Row& row) {
+        row.reformat(m_formatter);
+        m_cacheBytes += row.memoryUsage();
+    });
 }
 
 QByteArray SqliteTableModel::encode(const QByteArray& str) const
@@ -891,6 +1596,19 @@ bool SqliteTableModel::isEditable() const
 }
 
 void SqliteTableModel::triggerCacheLoad (int row) const
+{
+    triggerChunkLoad(row, static_cast<size_t>(row), static_cast<size_t>(row) + 1);
+}
+
+void SqliteTableModel::triggerCacheLoad (int row_begin, int row_end) const
+{
+    if(row_end == row_begin)
+        return;
+
+    triggerChunkLoad((row_begin + row_end) / 2, static_cast<size_t>(row_begin), static_cast<size_t>(row_end));
+}
+
+void SqliteTableModel::triggerChunkLoad (int row, size_t check_begin, size_t check_end, bool all_columns) const
 {
     int halfChunk = static_cast<int>( m_chunkSize / 2);
     size_t row_begin = static_cast<std::size_t>(std::max(0, row - halfChunk));
@@ -903,20 +1621,100 @@ void SqliteTableModel::triggerCacheLoad (int row) const
         // will be truncated by reader
     }
 
-    // avoid re-fetching data
+    check_begin = std::max(check_begin, row_begin);
+    check_end = std::min(check_end, row_end);
+
+    const std::vector<size_t> columns = all_columns ? std::vector<size_t>() : columnsToFetch();
+    const auto projectedQuery = [this](const std::vector<size_t>& c) {
+        return c.empty() ? QString() : QString::fromStdString(m_query.buildQuery(true, c));
+    };
+
     QMutexLocker lk(&m_mutexDataCache);
-    m_cache.smallestNonAvailableRange(row_begin, row_end);
 
-    if(row_end != row_begin)
-        worker->triggerFetch(m_lifeCounter, row_begin, row_end);
+    // Rows which have been fetched before might be lacking some of the columns we need now, e.g. because the user has
+    // scrolled horizontally or unhidden a column in the meantime.
+    const auto missing = nosync_missingColumns(columns, check_begin, check_end);
+
+    // avoid re-fetching data
+    size_t fetch_begin = row_begin;
+    size_t fetch_end = row_end;
+    m_cache.smallestNonAvailableRange(fetch_begin, fetch_end);
+
+    if(!missing.empty())
+    {
+        // If all rows are there, just fetch the missing cells. Otherwise fetch the missing rows and the rows with missing
+        // cells in one go.
+        if(fetch_begin == fetch_end)
+            worker->triggerFetch(m_lifeCounter, check_begin, row_end, projectedQuery(missing), missing);
+        else
+            worker->triggerFetch(m_lifeCounter, std::min(fetch_begin, check_begin), row_end, projectedQuery(columns), columns);
+    } else if(fetch_end != fetch_begin) {
+        worker->triggerFetch(m_lifeCounter, fetch_begin, fetch_end, projectedQuery(columns), columns);
+    }
 }
 
-void SqliteTableModel::triggerCacheLoad (int row_begin, int row_end) const
+void SqliteTableModel::setVisibleColumns(const std::vector<bool>& columns)
 {
-    if(row_end == row_begin)
-        return;
+    m_visibleColumns = columns;
+}
+
+std::vector<size_t> SqliteTableModel::columnsToFetch() const
+{
+    // Projections are only supported when browsing a table or view. For custom queries all columns are fetched.
+    if(m_query.table().isEmpty() || m_visibleColumns.size() != m_headers.size())
+        return {};
+
+    // Partly fetched rows are merged with the cached rows by their rowid, so this only works if the rowid columns are a real
+    // unique key. That is the case for tables and for views with a pseudo primary key but not for the _rowid_ of other views,
+    // which is always NULL.
+    if(!m_isTable && !m_query.hasCustomRowIdColumn())
+        return {};
+
+    std::vector<size_t> columns;
+    const auto rowid_columns = m_query.rowIdColumns();
+    for(size_t i=1;i<m_headers.size();i++)
+    {
+        // The primary key columns are always needed for updating the rowid value after editing one of them
+        if(m_visibleColumns[i] || contains(rowid_columns, m_headers[i]))
+            columns.push_back(i);
+    }
+
+    // No need for a projection when all columns are needed anyway
+    if(columns.size() == m_headers.size() - 1)
+        return {};
 
-    triggerCacheLoad((row_begin + row_end) / 2);
+    return columns;
+}
+
+std::vector<size_t> SqliteTableModel::nosync_missingColumns(const std::vector<size_t>& columns, size_t row_begin, size_t row_end) const
+{
+    std::vector<bool> missing(m_headers.size(), false);
+    for(size_t row=row_begin;row<row_end;row++)
+    {
+        if(!m_cache.count(row))
+            continue;
+
+        const auto& cached_row = m_cache.at(row);
+        if(cached_row.isComplete())
+            continue;
+
+        if(columns.empty())
+        {
+            for(size_t i=1;i<cached_row.size();i++)
+                missing[i] = missing[i] || !cached_row.isLoaded(i);
+        } else {
+            for(size_t i : columns)
+                missing[i] = missing[i] || !cached_row.isLoaded(i);
+        }
+    }
+
+    std::vector<size_t> result;
+    for(size_t i=1;i<missing.size();i++)
+    {
+        if(missing[i])
+            result.push_back(i);
+    }
+    return result;
 }
 
 bool SqliteTableModel::completeCache () const
@@ -938,19 +1736,115 @@ bool SqliteTableModel::completeCache () const
         if(progress.wasCanceled())
             return false;
 
-        triggerCacheLoad(i);
+        triggerChunkLoad(i, 0, std::numeric_limits<size_t>::max(), true);
         worker->waitUntilIdle();
     }
 
     return true;
 }
 
+QString SqliteTableModel::rangeQuery(int row_begin, int row_end, const std::vector<int>& columns) const
+{
+    // PRAGMA and EXPLAIN statements can't be limited to a range of rows
+    if(m_sQuery.startsWith("PRAGMA", Qt::CaseInsensitive) || m_sQuery.startsWith("EXPLAIN", Qt::CaseInsensitive))
+        return QString();
+
+    // When there are multiple rowid columns, the rowid is combined by the worker. We don't do this here.
+    const size_t num_rowid_columns = std::max(m_query.rowIdColumns().size(), size_t(1));
+    if(num_rowid_columns > 1 && std::find(columns.begin(), columns.end(), 0) != columns.end())
+        return QString();
+
+    // Select the rows the same way the worker does it, so we get the rows which are shown in the view. Only queries which come
+    // with their own LIMIT clause need to be wrapped in a subquery first.
+    QString query = m_sQuery;
+    while(query.endsWith(';'))
+        query = query.left(query.size() - 1).trimmed();
+    if(query.contains(QRegExp("LIMIT\\s+.+\\s*((,|\\b(OFFSET)\\b)\\s*.+\\s*)?$", Qt::CaseInsensitive)))
+        query = QString("SELECT * FROM (%1)").arg(query);
+    query.append(QString(" LIMIT %1, %2;").arg(row_begin).arg(row_end - row_begin));
+    return query;
+}
+
+bool SqliteTableModel::readRows(sqlite3* pDb, const QString& query, const std::vector<int>& columns,
+                                const std::function<bool(const std::vector<QByteArray>&, const std::vector<bool>&)>& callback) const
+{
+    const size_t num_rowid_columns = std::max(m_query.rowIdColumns().size(), size_t(1));
+
+    QByteArray utf8Query = query.toUtf8();
+    sqlite3_stmt* stmt;
+    if(sqlite3_prepare_v2(pDb, utf8Query, utf8Query.size(), &stmt, nullptr) != SQLITE_OK)
+    {
+        qWarning() << "Reading rows failed: " << query << sqlite3_errmsg(pDb);
+        return false;
+    }
+
+    std::vector<QByteArray> values(columns.size());
+    std::vector<bool> binary(columns.size());
+    int status;
+    while((status = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        for(size_t i=0;i<columns.size();i++)
+        {
+            const int column = columns[i] == 0 ? 0 : columns[i] + static_cast<int>(num_rowid_columns) - 1;
+            const int type = sqlite3_column_type(stmt, column);
+
+            QByteArray value;
+            if(type != SQLITE_NULL)
+            {
+                const int bytes = sqlite3_column_bytes(stmt, column);
+                value = bytes ? QByteArray(static_cast<const char*>(sqlite3_column_blob(stmt, column)), bytes) : QByteArray("");
+            }
+
+            binary[i] = (type == SQLITE_TEXT || type == SQLITE_BLOB) && !isTextOnly(value, m_encoding, true);
+            values[i] = binary[i] ? value : decode(value);
+        }
+
+        if(!callback(values, binary))
+            break;
+    }
+    sqlite3_finalize(stmt);
+
+    return status == SQLITE_ROW || status == SQLITE_DONE;
+}
+
 bool SqliteTableModel::isCacheComplete () const
 {
     if(readingData())
         return false;
     QMutexLocker lock(&m_mutexDataCache);
-    return m_cache.numSet() == m_currentRowCount;
+    if(m_cache.numSet() != m_currentRowCount)
+        return false;
+
+    // When only some of the columns have been fetched, check that there are no rows with missing cells
+    if(!m_visibleColumns.empty())
+    {
+        for(size_t row=0;row<m_currentRowCount;row++)
+        {
+            if(!m_cache.at(row).isComplete())
+                return false;
+        }
+    }
+    return true;
+}
+
+bool SqliteTableModel::isRangeCached (int row_begin, int row_end, const std::vector<int>& columns) const
+{
+    QMutexLocker lock(&m_mutexDataCache);
+    for(size_t row=static_cast<size_t>(row_begin);row<static_cast<size_t>(row_end);row++)
+    {
+        if(!m_cache.count(row))
+            return false;
+
+        const Row& cached_row = m_cache.at(row);
+        if(cached_row.isComplete())
+            continue;
+        for(int column : columns)
+        {
+            if(!cached_row.isLoaded(static_cast<size_t>(column)))
+                return false;
+        }
+    }
+    return true;
 }
 
 void SqliteTableModel::waitUntilIdle () const
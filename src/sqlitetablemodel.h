@@ -4,17 +4,21 @@
 #include <QAbstractTableModel>
 #include <QMutex>
 #include <QColor>
+#include <functional>
 #include <memory>
 #include <vector>
 #include <map>
+#include <list>
 
 #include "RowCache.h"
+#include "CachedRow.h"
 #include "sql/Query.h"
 #include "sql/sqlitetypes.h"
 
 struct sqlite3;
 class DBBrowserDB;
 class CondFormat;
+class StatementProfiler;
 
 class SqliteTableModel : public QAbstractTableModel
 {
@@ -36,11 +40,19 @@ public:
 
     int columnCount(const QModelIndex &parent = QModelIndex()) const override;
     size_t filterCount() const;
+    /// \returns the filter of \param column as it has been entered by
+    /// the user or an empty string if the column isn't filtered
+    QString filterValue(size_t column) const;
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     bool setData(const QModelIndex& index, const QVariant& value, int role = Qt::EditRole) override;
     bool setTypedData(const QModelIndex& index, bool isBlob, const QVariant& value, int role = Qt::EditRole);
 
+    /// sets the values of multiple cells at once. \param values contains one
+    /// value per index. The changes are written to the database in a
+    /// single savepoint, so either all of them succeed or none.
+    bool setMultipleData(const QModelIndexList& indices, const std::vector<QByteArray>& values);
+
     enum class RowCount
     {
         Unknown,  //< still finding out in background...
@@ -66,12 +78,45 @@ public:
     /// load all rows into cache, return when done. Returns true if all data was loaded, false if the loading was cancelled.
     bool completeCache() const;
 
+    /// \returns the statement for reading the given \param columns of the
+    /// rows between \param row_begin and \param row_end (exclusive) straight
+    /// from the database instead of going through the cache, or a null
+    /// string if the rows can't be read this way. The rows are the ones
+    /// shown in the view unless they have been sorted in memory.
+    QString rangeQuery(int row_begin, int row_end, const std::vector<int>& columns) const;
+
+    /// run a \param query returned by rangeQuery() for the same \param
+    /// columns. For each row \param callback is called with the decoded
+    /// values and a flag for each of them telling whether it is binary;
+    /// returning false from it stops reading. The connection \param pDb
+    /// has to be obtained by the caller, so this can be run on a worker
+    /// thread as long as the query isn't changed in the meantime. Nothing
+    /// is logged here. \returns false if reading the rows failed.
+    bool readRows(sqlite3* pDb, const QString& query, const std::vector<int>& columns,
+                  const std::function<bool(const std::vector<QByteArray>&, const std::vector<bool>&)>& callback) const;
+
+    /// returns true if the cached rows have been sorted in memory, so their
+    /// order differs from the one the query returns them in
+    bool isSortedInMemory() const { return m_sortedInMemory; }
+
     /// returns true if all rows are currently available in cache
     /// [NOTE: potentially unsafe in case we have a limited-size
     /// cache, where entries can vanish again -- however we can't do
     /// this for the current implementation of the PlotDock]
     bool isCacheComplete () const;
 
+    /// returns true if the given \param columns of the rows between
+    /// \param row_begin and \param row_end (exclusive) are currently
+    /// available in cache
+    bool isRangeCached (int row_begin, int row_end, const std::vector<int>& columns) const;
+
+    /// set the columns which are currently visible in the view. When
+    /// browsing a table only these columns (plus the primary key) are
+    /// fetched; all other cells are loaded lazily once they become
+    /// visible. \param columns has one entry per column; an empty
+    /// vector means that all columns are fetched.
+    void setVisibleColumns(const std::vector<bool>& columns);
+
     bool insertRows(int row, int count, const QModelIndex& parent = QModelIndex()) override;
     bool removeRows(int row, int count, const QModelIndex& parent = QModelIndex()) override;
 
@@ -82,11 +127,15 @@ public:
 
     QString query() const { return m_sQuery; }
     QString customQuery(bool withRowid) const { return QString::fromStdString(m_query.buildQuery(withRowid)); }
+    const sqlb::Query& tableQuery() const { return m_query; }
 
     /// configure for browsing specified table
     void setQuery(const sqlb::Query& query);
 
     void setChunkSize(size_t chunksize);
+
+    /// record the statements executed for fetching the data in the given profiler
+    void setProfiler(StatementProfiler* profiler);
     size_t chunkSize() { return m_chunkSize; }
     void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
     void sort(const std::vector<sqlb::SortedColumn>& columns);
@@ -95,8 +144,11 @@ public:
     Qt::ItemFlags flags(const QModelIndex& index) const override;
 
     bool isBinary(const QModelIndex& index) const;
+    /// \returns the storage class of the cell at \param index as reported
+    /// by SQLite. Cells which haven't been fetched yet are reported as text.
+    CellType cellType(const QModelIndex& index) const;
 
-    void setEncoding(const QString& encoding) { m_encoding = encoding; }
+    void setEncoding(const QString& encoding);
     QString encoding() const { return m_encoding; }
 
     // The pseudo-primary key is exclusively for editing views
@@ -119,6 +171,28 @@ public:
 
     DBBrowserDB& db() { return m_db; }
 
+    /// update the copy of the display settings
+    void reloadSettings();
+
+    /// drop the caches which are kept for previously browsed tables
+    void clearRetainedCaches();
+
+    /// \returns the approximate number of bytes used by the cached rows,
+    /// including the caches kept for previously browsed tables
+    size_t memoryUsage() const;
+
+    /// free the memory used by the cache. The retained caches are always
+    /// dropped; the rows of the current query are only dropped if
+    /// \param keep_current_rows isn't set. They are fetched again once
+    /// they are needed. Custom queries which have been sorted in memory
+    /// go back to the order of the query because the sort order only
+    /// exists in the cache.
+    void releaseCache(bool keep_current_rows);
+
+    /// \returns a short text saying what is shown in this model, e.g. for
+    /// listing the memory usage of all models
+    QString description() const;
+
 public slots:
     void updateFilter(int column, const QString& value);
 
@@ -143,6 +217,40 @@ private:
 
     void buildQuery();
 
+    /// When all rows of the current query are in the cache, sorting and narrowing a filter
+    /// can be done on the cached rows instead of running the query again.
+    /// \returns true if the cache is complete and can be used for this
+    bool canUseCache() const;
+
+    /// sort the cached rows by \param columns. \returns false if this
+    /// isn't possible and the query needs to be executed instead
+    bool sortCache(const std::vector<sqlb::SortedColumn>& columns);
+
+    /// remove all cached rows which don't match the filter condition
+    /// \param new_condition on \param column. \returns false if this isn't
+    /// possible, e.g. because the new condition is not more restrictive
+    /// than \param old_condition
+    bool filterCache(size_t column, const std::string& old_condition, const std::string& new_condition);
+
+    /// keep the cache of the current table around so it can be shown again
+    /// when switching back to the table later. Only complete row counts
+    /// are kept and the total size is limited by m_cacheBudget.
+    void retainCache();
+
+    /// use a previously retained cache for the current query if the data
+    /// hasn't changed since. \returns true if a cache was restored
+    bool restoreCache();
+
+    /// tell the CacheGovernor about the current memory usage
+    void updateMemoryUsage();
+
+    /// count the memory used by the cached rows again
+    void nosync_recountCacheBytes();
+
+    /// pass the current query to the worker without fetching any data.
+    /// This is used after sorting or filtering the cached rows.
+    void applyQueryToWorker();
+
     /// \param pDb connection to query; if null, obtains it from 'm_db'.
     std::vector<std::string> getColumns(std::shared_ptr<sqlite3> pDb, const QString& sQuery, std::vector<int>& fieldsTypes);
 
@@ -168,19 +276,65 @@ private:
     RowCount m_rowCountAvailable;
     unsigned int m_currentRowCount;
 
+    /// true if the cached rows have been sorted by sortCache() instead
+    /// of being fetched in the order of the query
+    bool m_sortedInMemory;
+
     std::vector<std::string> m_headers;
 
     /// reading something in background right now? (either counting
     /// rows or actually loading data, doesn't matter)
     bool readingData() const;
 
-    using Row = std::vector<QByteArray>;
+    using Row = CachedRow;
     mutable RowCache<Row> m_cache;
 
+    /// approximate memory usage of the rows in m_cache. Protected by
+    /// m_mutexDataCache because the worker thread updates it, too.
+    size_t m_cacheBytes;
+
     Row makeDefaultCacheEntry () const;
 
+    /// columns of interest as set by setVisibleColumns()
+    std::vector<bool> m_visibleColumns;
+
+    /// true if a table is browsed, false for views and custom queries
+    bool m_isTable;
+
+    /// \returns the columns to fetch for the current projection (excluding
+    /// the rowid column) or an empty vector if all columns are needed
+    std::vector<size_t> columnsToFetch() const;
+
+    /// \returns the columns out of \param columns (all columns if empty)
+    /// which are missing in at least one of the cached rows in the range
+    std::vector<size_t> nosync_missingColumns(const std::vector<size_t>& columns, size_t row_begin, size_t row_end) const;
+
+    /// trigger loading of the chunk around \param row. Only the rows
+    /// between \param check_begin and \param check_end are checked for
+    /// missing cells. If \param all_columns is set the projection is
+    /// ignored and all columns are fetched.
+    void triggerChunkLoad(int row, size_t check_begin, size_t check_end, bool all_columns = false) const;
+
     bool nosync_isBinary(const QModelIndex& index) const;
 
+    /// \returns the value to actually write into the specified column
+    QByteArray prepareValueForColumn(size_t column, const QByteArray& value) const;
+
+    /// set the rowid of the row again after the primary key columns in
+    /// \param changed_columns have been changed
+    void nosync_updateRowid(Row& row, const std::vector<size_t>& changed_columns) const;
+
+    /// fetch the rows between \param row_begin and \param row_end
+    /// (exclusive) into the cache and wait until they are loaded. The
+    /// missing rows are loaded chunk by chunk while showing a progress
+    /// dialog. \returns false if not all rows could be loaded or the
+    /// user cancelled.
+    bool loadRows(int row_begin, int row_end) const;
+
+    /// \returns the most likely storage class of a value we have written
+    /// to the database ourselves
+    CellType guessCellType(size_t column, const QByteArray& value, bool isBlob) const;
+
     QString m_sQuery;
     std::vector<int> m_vDataTypes;
     std::map<int, std::vector<CondFormat>> m_mCondFormats;
@@ -198,6 +352,58 @@ private:
 
     QString m_encoding;
 
+    /// display settings which are needed for each call of data(). They
+    /// are copied from the Settings once instead of being looked up for
+    /// every cell; see reloadSettings().
+    struct DisplaySettings
+    {
+        int symbolLimit = 0;
+        QString nullText;
+        QString blobText;
+        QColor nullFgColour;
+        QColor nullBgColour;
+        QColor binFgColour;
+        QColor binBgColour;
+        QColor regFgColour;
+        QColor regBgColour;
+
+        bool operator==(const DisplaySettings& other) const
+        {
+            return symbolLimit == other.symbolLimit && nullText == other.nullText && blobText == other.blobText &&
+                    nullFgColour == other.nullFgColour && nullBgColour == other.nullBgColour &&
+                    binFgColour == other.binFgColour && binBgColour == other.binBgColour &&
+                    regFgColour == other.regFgColour && regBgColour == other.regBgColour;
+        }
+    };
+    DisplaySettings m_displaySettings;
+
+    /// prepares the display texts of the cached cells. Protected by
+    /// m_mutexDataCache because it's used by the worker thread, too.
+    CellFormatter m_formatter;
+
+    /// prepare the display texts of all cached cells again
+    void nosync_reformatCache();
+
+    /// the cache of a previously browsed table along with everything
+    /// which is needed to check whether it can be shown again
+    struct RetainedCache
+    {
+        QString query;
+        std::vector<std::string> headers;
+        QString dataVersion;
+        RowCache<Row> cache;
+        unsigned int rowCount;
+        bool sortedInMemory;
+        CellFormatter formatter;
+        size_t bytes;
+    };
+
+    /// retained caches, most recently used first
+    std::list<RetainedCache> m_retainedCaches;
+
+    /// maximum number of bytes the retained caches may take up
+    size_t m_cacheBudget;
+
     /**
      * These are used for multi-threaded population of the table
      */
@@ -55,7 +55,7 @@ void SqlTextEdit::reloadSettings()
     if(Settings::getValue("editor", "auto_completion").toBool())
     {
         setAutoCompletionThreshold(3);
-        setAutoCompletionCaseSensitivity(true);
+        setAutoCompletionCaseSensitivity(false);
         setAutoCompletionShowSingle(true);
         setAutoCompletionSource(QsciScintilla::AcsAPIs);
     } else {
@@ -15,8 +15,8 @@ QMAKE_CXXFLAGS += -std=c++11
 CONFIG(unittest) {
   QT += testlib
 
-  HEADERS += tests/testsqlobjects.h tests/TestImport.h tests/TestRegex.h tests/TestRowCache.h
-  SOURCES += tests/testsqlobjects.cpp tests/TestImport.cpp tests/TestRegex.cpp tests/TestRowCache.cpp
+  HEADERS += tests/testsqlobjects.h tests/TestImport.h tests/TestRegex.h tests/TestRowCache.h tests/TestCompletionTrie.h tests/TestStatementProfiler.h
+  SOURCES += tests/testsqlobjects.cpp tests/TestImport.cpp tests/TestRegex.cpp tests/TestRowCache.cpp tests/TestCompletionTrie.cpp tests/TestStatementProfiler.cpp
 } else {
   SOURCES += main.cpp
 }
@@ -42,17 +42,26 @@ HEADERS += \
     grammar/sqlite3TokenTypes.hpp \
     sqlitetablemodel.h \
     RowCache.h \
+    CachedRow.h \
+    RowSorter.h \
+    CacheGovernor.h \
     RowLoader.h \
+    StatementProfiler.h \
     FilterTableHeader.h \
     version.h \
     SqlExecutionArea.h \
     VacuumDialog.h \
+    IndexAdvisorDialog.h \
     DbStructureModel.h \
     Application.h \
     sqlite.h \
     CipherDialog.h \
     ExportSqlDialog.h \
     SqlUiLexer.h \
+    CompletionTrie.h \
+    SqlCompletionIndex.h \
+    QueryPlan.h \
+    IndexAdvisor.h \
     FileDialog.h \
     ColumnDisplayFormatDialog.h \
     FilterLineEdit.h \
@@ -75,6 +84,7 @@ HEADERS += \
     sql/Query.h \
     RunSql.h \
     sql/ObjectIdentifier.h \
+    sql/DdlParser.h \
     ProxyDialog.h
 
 SOURCES += \
@@ -97,14 +107,22 @@ SOURCES += \
     grammar/Sqlite3Parser.cpp \
     sqlitetablemodel.cpp \
     RowLoader.cpp \
+    StatementProfiler.cpp \
+    RowSorter.cpp \
+    CacheGovernor.cpp \
     FilterTableHeader.cpp \
     SqlExecutionArea.cpp \
     VacuumDialog.cpp \
+    IndexAdvisorDialog.cpp \
     DbStructureModel.cpp \
     Application.cpp \
     CipherDialog.cpp \
     ExportSqlDialog.cpp \
     SqlUiLexer.cpp \
+    CompletionTrie.cpp \
+    SqlCompletionIndex.cpp \
+    QueryPlan.cpp \
+    IndexAdvisor.cpp \
     FileDialog.cpp \
     ColumnDisplayFormatDialog.cpp \
     FilterLineEdit.cpp \
@@ -127,6 +145,7 @@ SOURCES += \
     sql/Query.cpp \
     RunSql.cpp \
     sql/ObjectIdentifier.cpp \
+    sql/DdlParser.cpp \
     ProxyDialog.cpp
 
 RESOURCES += icons/icons.qrc \
@@ -147,6 +166,7 @@ FORMS += \
     ImportCsvDialog.ui \
     SqlExecutionArea.ui \
     VacuumDialog.ui \
+    IndexAdvisorDialog.ui \
     CipherDialog.ui \
     ExportSqlDialog.ui \
     ColumnDisplayFormatDialog.ui \
@@ -0,0 +1,213 @@
+#include <QtTest/QTest>
+
+#include "TestCompletionTrie.h"
+#include "../CompletionTrie.h"
+#include "../SqlCompletionIndex.h"
+
+QTEST_APPLESS_MAIN(TestCompletionTrie)
+
+using Words = std::vector<std::string>;
+using Index = SqlCompletionIndex;
+
+namespace {
+
+Words complete(const CompletionTrie& trie, const std::string& prefix, size_t limit = 100)
+{
+    Words words;
+    trie.complete(prefix, words, limit);
+    return words;
+}
+
+// Turns the completions into words with a suffix for their type, so they can be compared easily
+Words complete(const Index& index, const Words& context, const std::string& sql = std::string())
+{
+    Words words;
+    for(const auto& c : index.complete(context, sql, sql.size(), 100))
+        words.push_back(c.word + (c.type == Index::Table ? ":table" : (c.type == Index::Column ? ":column" : (c.type == Index::Schema ? ":schema" : ":other"))));
+    return words;
+}
+
+}
+
+void TestCompletionTrie::insertComplete()
+{
+    CompletionTrie trie;
+    QVERIFY(trie.empty());
+
+    // Inserting these splits the edge "se" several times
+    trie.insert("set");
+    trie.insert("select");
+    trie.insert("selection");
+    trie.insert("delete");
+    QCOMPARE(trie.size(), static_cast<size_t>(4));
+
+    // Words are returned in alphabetical order of their folded form, shorter words first
+    QCOMPARE(complete(trie, "se"), (Words{"select", "selection", "set"}));
+    QCOMPARE(complete(trie, "sel"), (Words{"select", "selection"}));
+    QCOMPARE(complete(trie, "selection"), (Words{"selection"}));
+    QCOMPARE(complete(trie, ""), (Words{"delete", "select", "selection", "set"}));
+    QCOMPARE(complete(trie, "sex"), Words{});
+    QCOMPARE(complete(trie, "selections"), Words{});
+
+    // The number of results is limited
+    QCOMPARE(complete(trie, "se", 2), (Words{"select", "selection"}));
+
+    trie.clear();
+    QVERIFY(trie.empty());
+    QCOMPARE(complete(trie, ""), Words{});
+}
+
+void TestCompletionTrie::remove()
+{
+    CompletionTrie trie;
+    trie.insert("select");
+    trie.insert("selection");
+    trie.insert("set");
+
+    QVERIFY(trie.remove("select"));
+    QCOMPARE(trie.size(), static_cast<size_t>(2));
+    QCOMPARE(complete(trie, "se"), (Words{"selection", "set"}));
+
+    // Words which aren't in the trie or only are a prefix of one can't be removed
+    QVERIFY(!trie.remove("select"));
+    QVERIFY(!trie.remove("sel"));
+    QVERIFY(!trie.remove("update"));
+
+    // Removed words can be inserted again
+    trie.insert("select");
+    QCOMPARE(complete(trie, "se"), (Words{"select", "selection", "set"}));
+}
+
+void TestCompletionTrie::caseFolding()
+{
+    QCOMPARE(CompletionTrie::fold("MiXeD_Case1"), std::string("mixed_case1"));
+
+    // Lookups ignore the case but all spellings are kept
+    CompletionTrie trie;
+    trie.insert("Customers");
+    trie.insert("customers");
+    trie.insert("CustomerID");
+    QCOMPARE(trie.size(), static_cast<size_t>(3));
+    QCOMPARE(complete(trie, "CUST"), (Words{"CustomerID", "Customers", "customers"}));
+    QCOMPARE(complete(trie, "customers"), (Words{"Customers", "customers"}));
+
+    // Removing needs the exact spelling
+    QVERIFY(!trie.remove("CUSTOMERS"));
+    QVERIFY(trie.remove("customers"));
+    QCOMPARE(complete(trie, "customers"), (Words{"Customers"}));
+}
+
+void TestCompletionTrie::referenceCounting()
+{
+    CompletionTrie trie;
+    trie.insert("id");
+    trie.insert("id");
+    QCOMPARE(trie.size(), static_cast<size_t>(1));
+
+    // The word stays until it has been removed as often as it was inserted
+    QVERIFY(trie.remove("id"));
+    QCOMPARE(complete(trie, "i"), (Words{"id"}));
+    QVERIFY(trie.remove("id"));
+    QCOMPARE(complete(trie, "i"), Words{});
+    QVERIFY(trie.empty());
+    QVERIFY(!trie.remove("id"));
+}
+
+void TestCompletionTrie::compaction()
+{
+    CompletionTrie trie;
+    for(int i=0;i<200;i++)
+        trie.insert("word" + std::to_string(i));
+
+    // Removing most of the words rebuilds the trie. The remaining words need to survive this with their references,
+    // so word7 which is inserted twice is still there after being removed once.
+    trie.insert("word7");
+    for(int i=0;i<200;i++)
+    {
+        if(i % 4)
+            QVERIFY(trie.remove("word" + std::to_string(i)));
+    }
+    QCOMPARE(trie.size(), static_cast<size_t>(51));
+    QCOMPARE(complete(trie, "word1"), (Words{"word100", "word104", "word108", "word112", "word116", "word12", "word120", "word124",
+                                             "word128", "word132", "word136", "word140", "word144", "word148", "word152", "word156",
+                                             "word16", "word160", "word164", "word168", "word172", "word176", "word180", "word184",
+                                             "word188", "word192", "word196"}));
+    QCOMPARE(complete(trie, "word7"), (Words{"word7", "word72", "word76"}));
+    QVERIFY(trie.remove("word7"));
+    QCOMPARE(complete(trie, "word7"), (Words{"word72", "word76"}));
+    QVERIFY(!trie.remove("word7"));
+
+    // Removed words can be inserted again after compacting
+    trie.insert("word1");
+    QCOMPARE(complete(trie, "word1", 1), (Words{"word1"}));
+    QCOMPARE(trie.size(), static_cast<size_t>(51));
+}
+
+void TestCompletionTrie::indexUpdates()
+{
+    Index index;
+    index.setTables({{"main", {{"users", {"id", "name"}}, {"orders", {"id", "user_id"}}}}});
+
+    // Without any table in the statement, all columns are offered after the tables
+    QCOMPARE(complete(index, {"us"}), (Words{"users:table", "user_id:column"}));
+    QCOMPARE(complete(index, {"users", "n"}), (Words{"name:column"}));
+    QCOMPARE(complete(index, {"main", "o"}), (Words{"orders:table"}));
+
+    // Only the columns of the tables in the statement are offered. Aliases are resolved.
+    QCOMPARE(complete(index, {"u", "i"}, "SELECT * FROM users AS u WHERE u.i"), (Words{"id:column"}));
+    QCOMPARE(complete(index, {"n"}, "SELECT n FROM users"), (Words{"name:column"}));
+    QCOMPARE(complete(index, {"u"}, "SELECT u FROM users"), (Words{"users:table"}));
+
+    // Change a table, drop another one and attach a schema
+    index.setTables({{"main", {{"users", {"id", "email"}}}}, {"temp", {{"t1", {"x"}}}}});
+    QCOMPARE(complete(index, {"users", "n"}), Words{});
+    QCOMPARE(complete(index, {"users", "e"}), (Words{"email:column"}));
+    QCOMPARE(complete(index, {"us"}), (Words{"users:table"}));
+    QCOMPARE(complete(index, {"o"}), Words{});
+    QCOMPARE(complete(index, {"te"}), (Words{"temp:schema"}));
+    QCOMPARE(complete(index, {"temp", "t"}), (Words{"t1:table"}));
+    QCOMPARE(complete(index, {"temp", "t1", "x"}), (Words{"x:column"}));
+
+    // Columns of tables which are unchanged are kept
+    QCOMPARE(complete(index, {"i"}), (Words{"id:column"}));
+
+    // Detach the schema again
+    index.setTables({{"main", {{"users", {"id", "email"}}}}});
+    QCOMPARE(complete(index, {"te"}), Words{});
+    QCOMPARE(complete(index, {"x"}), Words{});
+    QCOMPARE(complete(index, {"e"}), (Words{"email:column"}));
+}
+
+void TestCompletionTrie::singleTableUpdates()
+{
+    Index index;
+    index.setTable("main", "users", {"id", "name"});
+    index.setTable("main", "orders", {"id", "user_id"});
+    QCOMPARE(complete(index, {"us"}), (Words{"users:table", "user_id:column"}));
+    QCOMPARE(complete(index, {"ma"}), (Words{"main:schema"}));
+
+    // Changing the columns replaces them
+    index.setTable("main", "Users", {"id", "email"});
+    QCOMPARE(complete(index, {"users", "n"}), Words{});
+    QCOMPARE(complete(index, {"users", "e"}), (Words{"email:column"}));
+    QCOMPARE(complete(index, {"us"}), (Words{"Users:table", "user_id:column"}));
+
+    // Columns shared with other tables are kept when dropping a table
+    index.dropTable("MAIN", "orders");
+    index.dropTable("main", "unknown");
+    index.dropTable("unknown", "users");
+    QCOMPARE(complete(index, {"o"}), Words{});
+    QCOMPARE(complete(index, {"i"}), (Words{"id:column"}));
+    QCOMPARE(index.tableNames(), (Words{"Users"}));
+
+    // Attach an empty schema and one with a table, then detach them again
+    index.setSchemata({"main", "aux"});
+    index.setTable("temp", "t1", {"x"});
+    QCOMPARE(complete(index, {"a"}), (Words{"aux:schema"}));
+    QCOMPARE(complete(index, {"temp", "t"}), (Words{"t1:table"}));
+    index.setSchemata({"main"});
+    QCOMPARE(complete(index, {"a"}), Words{});
+    QCOMPARE(complete(index, {"te"}), Words{});
+    QCOMPARE(complete(index, {"x"}), Words{});
+    QCOMPARE(complete(index, {"e"}), (Words{"email:column"}));
+}
@@ -0,0 +1,20 @@
+#ifndef TESTCOMPLETIONTRIE_H
+#define TESTCOMPLETIONTRIE_H
+
+#include <QObject>
+
+class TestCompletionTrie : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void insertComplete();
+    void remove();
+    void caseFolding();
+    void referenceCounting();
+    void compaction();
+    void indexUpdates();
+    void singleTableUpdates();
+};
+
+#endif
@@ -176,3 +176,30 @@ void TestImport::csvImport_data()
                                << 3
                                << result;
 }
+
+void TestImport::tsvQuotesOnlyAtFieldStart()
+{
+    // Tab separated values as they are put into the clipboard by spreadsheet applications
+    QString tsv = "12\" ruler\t\"a\tb\"\n\"multi\nline\"\tsay \"hi\"\n\t\"quote \"\"x\"\"\"\n";
+
+    CSVParser csvparser(false, '\t', '"');
+    csvparser.setQuotesOnlyAtFieldStart(true);
+    QTextStream tstream(&tsv, QIODevice::ReadOnly);
+
+    std::vector<std::vector<QByteArray>> parsedTsv;
+    CSVParser::ParserResult parseResult = csvparser.parse([&parsedTsv](size_t /*rowNum*/, const CSVRow& data) -> bool {
+        std::vector<QByteArray> row;
+        for(size_t i=0;i<data.num_fields;i++)
+            row.push_back(QByteArray(data.fields[i].data, data.fields[i].data_length));
+        parsedTsv.push_back(row);
+        return true;
+    }, tstream);
+
+    std::vector<std::vector<QByteArray>> result{
+        {"12\" ruler", "a\tb"},
+        {"multi\nline", "say \"hi\""},
+        {"", "quote \"x\""}
+    };
+    QCOMPARE(parseResult, CSVParser::ParserResultSuccess);
+    QCOMPARE(parsedTsv, result);
+}
@@ -14,6 +14,7 @@ public:
 private slots:
     void csvImport();
     void csvImport_data();
+    void tsvQuotesOnlyAtFieldStart();
 };
 
 #endif
@@ -2,6 +2,7 @@
 
 #include "TestRowCache.h"
 #include "../RowCache.h"
+#include "../CachedRow.h"
 
 QTEST_APPLESS_MAIN(TestRowCache)
 
@@ -187,3 +188,119 @@ void TestRowCache::smallestNonAvailableRange()
     QCOMPARE(test( 9,10), P( 9,10));
     QCOMPARE(test(10,10), P(10,10));
 }
+
+void TestRowCache::eraseRange()
+{
+    C c;
+    c.set(0, 0);
+    c.set(1, 10);
+    c.set(2, 20);
+    c.set(5, 50);
+    c.set(6, 60);
+    c.set(9, 90);
+    QCOMPARE(c.numSet(), static_cast<size_t>(6));
+    QCOMPARE(c.numSegments(), static_cast<size_t>(3));
+
+    // erase empty range
+    c.erase(4, 4);
+    QCOMPARE(c.numSet(), static_cast<size_t>(6));
+    QCOMPARE(c.numSegments(), static_cast<size_t>(3));
+
+    // erase range spanning the end of a segment, a gap and the start of the next segment
+    c.erase(2, 6);
+    QCOMPARE(c.numSet(), static_cast<size_t>(4));
+    QCOMPARE(c.numSegments(), static_cast<size_t>(2));
+    QCOMPARE(c.at(0), 0);
+    QCOMPARE(c.at(1), 10);
+    QCOMPARE(c.at(2), 60);
+    QCOMPARE(c.count(3), static_cast<size_t>(0));
+    QCOMPARE(c.at(5), 90);
+
+    // erase range covering a whole segment and the gap before it
+    c.erase(3, 6);
+    QCOMPARE(c.numSet(), static_cast<size_t>(3));
+    QCOMPARE(c.numSegments(), static_cast<size_t>(1));
+    QCOMPARE(c.at(2), 60);
+
+    // erase everything
+    c.erase(0, 100);
+    QCOMPARE(c.numSet(), static_cast<size_t>(0));
+    QCOMPARE(c.numSegments(), static_cast<size_t>(0));
+
+    QVERIFY_EXCEPTION_THROWN(c.erase(2, 1), std::invalid_argument);
+}
+
+void TestRowCache::forEach()
+{
+    C c;
+    c.set(1, 10);
+    c.set(2, 20);
+    c.set(7, 70);
+    c.set(5, 50);
+
+    std::vector<size_t> positions;
+    c.forEach([&positions](size_t pos, int & value) {
+        positions.push_back(pos);
+        value++;
+    });
+
+    QCOMPARE(positions, std::vector<size_t>({1, 2, 5, 7}));
+    QCOMPARE(c.at(1), 11);
+    QCOMPARE(c.at(2), 21);
+    QCOMPARE(c.at(5), 51);
+    QCOMPARE(c.at(7), 71);
+}
+
+void TestRowCache::cachedRowTags()
+{
+    // Use an odd number of cells, so the last byte of the tags is only half used
+    const QByteArray binary("\x89PNG\r\n\x1a\n\0\0", 10);
+    const CellFormatter formatter;
+    CachedRow row({QByteArray(), "1", "2.5", "text", binary},
+                  {CellType::Null, CellType::Integer, CellType::Float, CellType::Text, CellType::Blob},
+                  formatter);
+
+    QCOMPARE(row.tags.size(), static_cast<size_t>(3));
+    QVERIFY(row.type(0) == CellType::Null);
+    QVERIFY(row.type(1) == CellType::Integer);
+    QVERIFY(row.type(2) == CellType::Float);
+    QVERIFY(row.type(3) == CellType::Text);
+    QVERIFY(row.type(4) == CellType::Blob);
+    QCOMPARE(row.isBinary(0), false);
+    QCOMPARE(row.isBinary(3), false);
+    QCOMPARE(row.isBinary(4), true);
+
+    // Changing a cell leaves the other cell in the same byte alone
+    row.set(3, binary, CellType::Blob, formatter);
+    QVERIFY(row.type(2) == CellType::Float);
+    QCOMPARE(row.isBinary(2), false);
+    QVERIFY(row.type(3) == CellType::Blob);
+    QCOMPARE(row.isBinary(3), true);
+
+    row.set(2, QByteArray(), CellType::Null, formatter);
+    QVERIFY(row.type(2) == CellType::Null);
+    QVERIFY(row.type(3) == CellType::Blob);
+    QCOMPARE(row.isBinary(3), true);
+
+    // Text in a blob isn't binary
+    row.set(3, "text", CellType::Blob, formatter);
+    QVERIFY(row.type(3) == CellType::Blob);
+    QCOMPARE(row.isBinary(3), false);
+
+    // The tag is taken along with the cell
+    CachedRow other = CachedRow::unloaded(5);
+    other.take(4, row);
+    QCOMPARE(other.isLoaded(4), true);
+    QCOMPARE(other.isLoaded(3), false);
+    QVERIFY(other.type(4) == CellType::Blob);
+    QCOMPARE(other.isBinary(4), true);
+    QVERIFY(other.type(3) == CellType::Null);
+
+    // Reformatting keeps the types
+    row.reformat(CellFormatter(QString(), 2));
+    QVERIFY(row.type(0) == CellType::Null);
+    QVERIFY(row.type(1) == CellType::Integer);
+    QVERIFY(row.type(2) == CellType::Null);
+    QVERIFY(row.type(3) == CellType::Blob);
+    QCOMPARE(row.display.at(3), QString("te ..."));
+}
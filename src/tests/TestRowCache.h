@@ -16,7 +16,10 @@ private slots:
     void setGet();
     void insert();
     void erase();
+    void eraseRange();
     void smallestNonAvailableRange();
+    void forEach();
+    void cachedRowTags();
 };
 
 #endif
@@ -0,0 +1,154 @@
+#include <QtTest/QTest>
+#include <QDateTime>
+#include <QTemporaryDir>
+#include <QFile>
+
+#include "TestStatementProfiler.h"
+#include "../StatementProfiler.h"
+#include "../sqlite.h"
+
+#include <json.hpp>
+
+using json = nlohmann::json;
+
+QTEST_APPLESS_MAIN(TestStatementProfiler)
+
+namespace {
+
+const char* createTable = "CREATE TABLE t(a, b);";
+const char* fillTable = "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x+1 FROM c WHERE x<100) INSERT INTO t SELECT x, x%7 FROM c;";
+const char* sortTable = "SELECT b FROM t ORDER BY b;";
+
+QVariant value(const StatementProfiler& profiler, int row, int column)
+{
+    return profiler.data(profiler.index(row, column));
+}
+
+}
+
+void TestStatementProfiler::init()
+{
+    QCOMPARE(sqlite3_open(":memory:", &db), SQLITE_OK);
+    StatementProfiler::install(db);
+}
+
+void TestStatementProfiler::cleanup()
+{
+    sqlite3_close(db);
+}
+
+void TestStatementProfiler::exec(const char* sql)
+{
+    QCOMPARE(sqlite3_exec(db, sql, nullptr, nullptr, nullptr), SQLITE_OK);
+}
+
+void TestStatementProfiler::counters()
+{
+    StatementProfiler profiler;
+    {
+        StatementProfiler::Scope scope(&profiler, "Test");
+        exec(createTable);
+        exec(fillTable);
+        exec(sortTable);
+    }
+
+    // Nothing shows up before the queued profiles are added to the history
+    QCOMPARE(profiler.rowCount(), 0);
+    profiler.flush();
+    QCOMPARE(profiler.rowCount(), 3);
+
+    QCOMPARE(value(profiler, 0, StatementProfiler::ColumnSource).toString(), QString("Test"));
+    QCOMPARE(value(profiler, 0, StatementProfiler::ColumnStatement).toString(), QString(createTable));
+    QCOMPARE(value(profiler, 2, StatementProfiler::ColumnStatement).toString(), QString(sortTable));
+
+    // Ordering the table by a column without an index takes a full scan and a sort
+    QCOMPARE(value(profiler, 2, StatementProfiler::ColumnFullScanSteps).toInt(), 99);
+    QCOMPARE(value(profiler, 2, StatementProfiler::ColumnSortOperations).toInt(), 1);
+    QVERIFY(value(profiler, 2, StatementProfiler::ColumnVmSteps).toInt() > 0);
+    QCOMPARE(value(profiler, 0, StatementProfiler::ColumnSortOperations).toInt(), 0);
+
+    // Joining on a column without an index makes SQLite build an automatic one
+    {
+        StatementProfiler::Scope scope(&profiler, "Test");
+        exec("SELECT count(*) FROM t t1, t t2 WHERE t1.b = t2.a;");
+    }
+    profiler.flush();
+    QCOMPARE(profiler.rowCount(), 4);
+    QVERIFY(value(profiler, 3, StatementProfiler::ColumnAutoIndexRows).toInt() > 0);
+
+    profiler.clear();
+    QCOMPARE(profiler.rowCount(), 0);
+}
+
+void TestStatementProfiler::scopes()
+{
+    StatementProfiler profiler;
+    StatementProfiler other;
+
+    // Statements outside of a scope aren't recorded
+    exec(createTable);
+
+    {
+        StatementProfiler::Scope outer(&profiler, "Outer");
+        exec(fillTable);
+
+        // The innermost scope wins, including one which disables profiling
+        {
+            StatementProfiler::Scope inner(&other, "Inner");
+            exec(sortTable);
+        }
+        {
+            StatementProfiler::Scope disabled(nullptr, QString());
+            exec(sortTable);
+        }
+
+        profiler.setEnabled(false);
+        exec(sortTable);
+        profiler.setEnabled(true);
+    }
+
+    profiler.flush();
+    other.flush();
+    QCOMPARE(profiler.rowCount(), 1);
+    QCOMPARE(value(profiler, 0, StatementProfiler::ColumnSource).toString(), QString("Outer"));
+    QCOMPARE(value(profiler, 0, StatementProfiler::ColumnStatement).toString(), QString(fillTable));
+    QCOMPARE(other.rowCount(), 1);
+    QCOMPARE(value(other, 0, StatementProfiler::ColumnSource).toString(), QString("Inner"));
+}
+
+void TestStatementProfiler::exportJson()
+{
+    StatementProfiler profiler;
+    {
+        StatementProfiler::Scope scope(&profiler, "Test");
+        exec(createTable);
+        exec(fillTable);
+        exec(sortTable);
+    }
+    profiler.flush();
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString filename = dir.filePath("profile.json");
+    QVERIFY(profiler.exportJson(filename));
+
+    QFile file(filename);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const json profiles = json::parse(file.readAll().toStdString());
+
+    QVERIFY(profiles.is_array());
+    QCOMPARE(profiles.size(), static_cast<size_t>(3));
+
+    const json& sort = profiles.at(2);
+    QCOMPARE(QString::fromStdString(sort.at("source").get<std::string>()), QString("Test"));
+    QCOMPARE(QString::fromStdString(sort.at("sql").get<std::string>()), QString(sortTable));
+    QCOMPARE(sort.at("fullscan_steps").get<int>(), 99);
+    QCOMPARE(sort.at("sort_operations").get<int>(), 1);
+    QCOMPARE(sort.at("autoindex_rows").get<int>(), 0);
+    QVERIFY(sort.at("vm_steps").get<int>() > 0);
+    QVERIFY(sort.at("time_ns").get<qint64>() >= 0);
+
+    // The time stamp is written in ISO format
+    const QDateTime finished = QDateTime::fromString(QString::fromStdString(sort.at("finished").get<std::string>()), "yyyy-MM-ddTHH:mm:ss.zzz");
+    QVERIFY(finished.isValid());
+}
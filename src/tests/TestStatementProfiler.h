@@ -0,0 +1,26 @@
+#ifndef TESTSTATEMENTPROFILER_H
+#define TESTSTATEMENTPROFILER_H
+
+#include <QObject>
+
+struct sqlite3;
+
+class TestStatementProfiler : public QObject
+{
+    Q_OBJECT
+
+private:
+    sqlite3* db;
+
+    void exec(const char* sql);
+
+private slots:
+    void init();
+    void cleanup();
+
+    void counters();
+    void scopes();
+    void exportJson();
+};
+
+#endif
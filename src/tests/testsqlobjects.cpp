@@ -1,9 +1,16 @@
 #include "testsqlobjects.h"
 #include "../sql/ObjectIdentifier.h"
 #include "../sql/sqlitetypes.h"
+#include "../sql/Query.h"
+#include "../QueryPlan.h"
+#include "../Data.h"
+#include "../sqlitedb.h"
+#include "../IndexAdvisor.h"
 
 #include <QtTest/QtTest>
 
+#include <random>
+
 QTEST_APPLESS_MAIN(TestTable)
 
 using namespace sqlb;
@@ -488,3 +495,846 @@ void TestTable::datetimeExpression()
     QCOMPARE(tab.fields.at(0).type(), "INTEGER");
     QCOMPARE(tab.fields.at(0).defaultValue(), "(DATETIME(CURRENT_TIMESTAMP,'LOCALTIME'))");
 }
+
+void TestTable::handWrittenParser()
+{
+    // These statements need to be accepted by the hand-written parser and must produce the same objects as the ANTLR parser
+    std::vector<std::string> tables = {
+        "create TABLE hero (id integer PRIMARY KEY AUTOINCREMENT, name text NOT NULL DEFAULT 'xxxx', info VARCHAR(255) CHECK (info == 'x'));",
+        "CREATE TEMP TABLE IF NOT EXISTS [a [b] (`c``d` \"e f\"\"g\" DEFAULT -1.5e3, 'h' key unique on conflict replace) WITHOUT ROWID",
+        "CREATE TABLE t(a, b, CONSTRAINT pk PRIMARY KEY(a COLLATE nocase DESC, b) ON CONFLICT ABORT CHECK((a, b) = (1, 2)))",
+        "CREATE TABLE t(a INTEGER REFERENCES u(x) ON DELETE SET NULL ON UPDATE NO ACTION MATCH simple NOT DEFERRABLE, b, "
+            "FOREIGN KEY(a, b) REFERENCES u(x, y) DEFERRABLE INITIALLY DEFERRED)",
+        "CREATE TABLE t( -- comment\n a /* comment */ INT CHECK(a NOT BETWEEN 1 AND 5 OR a IN (7, 8) OR CASE a WHEN 1 THEN 0 ELSE 1 END))",
+        "CREATE TABLE Größe(wert_ä text DEFAULT (datetime(CURRENT_TIMESTAMP, 'localtime')), b CHECK(CAST(b AS unsigned big int) > 0))",
+        "CREATE VIRTUAL TABLE IF NOT EXISTS ft USING fts5(a, b, tokenize = 'porter');",
+    };
+    for(const auto& sql : tables)
+    {
+        TablePtr hand = Table::parseSQL(sql, ParserType::HandWritten);
+        QVERIFY2(hand != nullptr, sql.c_str());
+        TablePtr antlr = Table::parseSQL(sql, ParserType::Antlr);
+        QVERIFY2(*hand == *antlr, sql.c_str());
+        QCOMPARE(hand->sql(), antlr->sql());
+        QCOMPARE(hand->virtualUsing(), antlr->virtualUsing());
+    }
+
+    std::vector<std::string> indices = {
+        "CREATE UNIQUE INDEX IF NOT EXISTS \"i\" ON [t] (a COLLATE nocase, `b` DESC, lower(c)) WHERE a IS NOT NULL;",
+        "create index key on replace(x ASC)",
+    };
+    for(const auto& sql : indices)
+    {
+        IndexPtr hand = Index::parseSQL(sql, ParserType::HandWritten);
+        QVERIFY2(hand != nullptr, sql.c_str());
+        IndexPtr antlr = Index::parseSQL(sql, ParserType::Antlr);
+        QCOMPARE(hand->name(), antlr->name());
+        QCOMPARE(hand->sql(), antlr->sql());
+        QCOMPARE(hand->fullyParsed(), antlr->fullyParsed());
+    }
+
+    // The hand-written parser gives up on anything following the statement. The default is to use the ANTLR parser then.
+    std::string sql = "CREATE TABLE a(b); SELECT 1";
+    QVERIFY(Table::parseSQL(sql, ParserType::HandWritten) == nullptr);
+    TablePtr tab = Table::parseSQL(sql);
+    QCOMPARE(tab->name(), "a");
+    QCOMPARE(tab->fields.size(), 1);
+}
+
+namespace
+{
+// Produces random CREATE TABLE and CREATE INDEX statements. Most of them are valid but some of them run into the limitations
+// of the grammar. This doesn't matter because both parsers only need to agree with each other.
+class StatementGenerator
+{
+public:
+    explicit StatementGenerator(unsigned int seed) : rng(seed), has_primary_key(false) {}
+
+    std::string table()
+    {
+        tokens.clear();
+        columns.clear();
+        has_primary_key = false;
+
+        keyword("CREATE");
+        if(chance(50))
+        {
+            if(chance(10))
+                keyword(chance(50) ? "TEMP" : "TEMPORARY");
+            keyword("TABLE");
+            ifNotExists();
+            add(name(false));
+            add("(");
+
+            size_t num_columns = 1 + random(5);
+            for(size_t i=0;i<num_columns;i++)
+            {
+                if(i)
+                    add(",");
+                columndef();
+            }
+            size_t num_constraints = random(4);
+            for(size_t i=0;i<num_constraints;i++)
+            {
+                // The comma is optional between table constraints. The table walker needs it before the first one though.
+                if(i == 0 || chance(80))
+                    add(",");
+                tableconstraint();
+            }
+            add(")");
+            if(chance(10))
+            {
+                keyword("WITHOUT");
+                keyword("ROWID");
+            }
+        } else {
+            keyword("VIRTUAL");
+            keyword("TABLE");
+            ifNotExists();
+            add(name(false));
+            keyword("USING");
+            add(pick({"fts5", "rtree", "\"csv\""}));
+            if(chance(80))
+            {
+                add("(");
+                for(size_t i=random(4);i>0;i--)
+                {
+                    expr(1);
+                    if(i > 1)
+                        add(",");
+                }
+                add(")");
+            }
+        }
+        if(chance(30))
+            add(";");
+
+        return join();
+    }
+
+    std::string index()
+    {
+        tokens.clear();
+        columns.clear();
+
+        keyword("CREATE");
+        if(chance(30))
+            keyword("UNIQUE");
+        keyword("INDEX");
+        ifNotExists();
+        add(name(false));
+        keyword("ON");
+        add(name(false));
+        add("(");
+        for(size_t i=1+random(3);i>0;i--)
+        {
+            indexedcolumn();
+            if(i > 1)
+                add(",");
+        }
+        add(")");
+        if(chance(30))
+        {
+            keyword("WHERE");
+            expr(2);
+        }
+        return join();
+    }
+
+private:
+    std::mt19937 rng;
+    std::vector<std::string> tokens;
+    std::vector<std::string> columns;
+    bool has_primary_key;
+
+    size_t random(size_t n)
+    {
+        return std::uniform_int_distribution<size_t>(0, n - 1)(rng);
+    }
+
+    bool chance(size_t percent)
+    {
+        return random(100) < percent;
+    }
+
+    std::string pick(const std::vector<std::string>& v)
+    {
+        return v.at(random(v.size()));
+    }
+
+    void add(const std::string& token)
+    {
+        tokens.push_back(token);
+    }
+
+    void keyword(std::string word)
+    {
+        if(chance(20))
+            std::transform(word.begin(), word.end(), word.begin(), ::tolower);
+        add(word);
+    }
+
+    std::string join()
+    {
+        std::string sql = tokens.front();
+        for(size_t i=1;i<tokens.size();i++)
+        {
+            // Leave out the whitespace next to some of the punctuation
+            const std::string& a = tokens.at(i-1);
+            const std::string& b = tokens.at(i);
+            bool punctuation = a == "(" || a == ")" || a == "," || b == "(" || b == ")" || b == ",";
+            if(!punctuation || chance(50))
+                sql += chance(5) ? pick({"\n", "\t", " /* comment */ ", " -- comment\n"}) : " ";
+            sql += b;
+        }
+        return sql;
+    }
+
+    std::string name(bool column)
+    {
+        std::string n = pick({"id", "name", "Größe", "_x1", "key", "desc", "replace", "temp", "rowid", "action",
+                              "\"my name\"", "\"a\"\"b\"", "`my name`", "`a``b`", "[my name]", "'my name'"});
+        if(column && chance(5))
+            n = "if";
+        else if(!column && chance(5))
+            n = "else";
+        return n;
+    }
+
+    void ifNotExists()
+    {
+        if(chance(20))
+        {
+            keyword("IF");
+            keyword("NOT");
+            keyword("EXISTS");
+        }
+    }
+
+    void conflictclause()
+    {
+        if(chance(20))
+        {
+            keyword("ON");
+            keyword("CONFLICT");
+            keyword(pick({"ROLLBACK", "ABORT", "FAIL", "IGNORE", "REPLACE"}));
+        }
+    }
+
+    void type_name()
+    {
+        switch(random(5))
+        {
+        case 0: add(pick({"INTEGER", "text", "blob", "\"custom type\"", "key"})); break;
+        case 1: add("unsigned"); add("big"); add("int"); break;
+        case 2: add("VARCHAR"); add("("); add("255"); add(")"); break;
+        case 3: add("DECIMAL"); add("("); add("10"); add(","); add(pick({"2", "+2", "-2"})); add(")"); break;
+        case 4: add("CURRENT_TIME"); break;
+        }
+    }
+
+    void columndef()
+    {
+        // Keep the column names unique because the table constraints look them up
+        std::string column;
+        do
+        {
+            column = name(true);
+        } while(std::find(columns.begin(), columns.end(), column) != columns.end());
+        columns.push_back(column);
+
+        add(column);
+        if(chance(70))
+            type_name();
+        for(size_t i=random(4);i>0;i--)
+            columnconstraint();
+    }
+
+    std::string existingColumn()
+    {
+        return columns.at(random(columns.size()));
+    }
+
+    void columnconstraint()
+    {
+        if(chance(10))
+        {
+            keyword("CONSTRAINT");
+            add(pick({"c1", "\"c 2\""}));
+        }
+
+        switch(random(8))
+        {
+        case 0:
+            // There can only be one primary key
+            if(has_primary_key)
+            {
+                keyword("UNIQUE");
+                break;
+            }
+            has_primary_key = true;
+
+            keyword("PRIMARY");
+            keyword("KEY");
+            if(chance(30))
+                keyword(pick({"ASC", "DESC"}));
+            conflictclause();
+            if(chance(30))
+                keyword("AUTOINCREMENT");
+            break;
+        case 1:
+            if(chance(70))
+                keyword("NOT");
+            keyword("NULL");
+            conflictclause();
+            break;
+        case 2:
+            keyword("UNIQUE");
+            conflictclause();
+            break;
+        case 3:
+            keyword("CHECK");
+            add("(");
+            expr(3);
+            add(")");
+            break;
+        case 4:
+        case 5:
+            keyword("DEFAULT");
+            switch(random(6))
+            {
+            case 0: add("("); expr(2); add(")"); break;
+            case 1: add("-"); add(pick({"1", "1.5"})); break;
+            case 2: add(pick({"\"quoted\"", "true", "replace"})); break;
+            default: literal();
+            }
+            break;
+        case 6:
+            keyword("COLLATE");
+            add(pick({"NOCASE", "binary"}));
+            break;
+        case 7:
+            foreignkeyclause(1);
+            break;
+        }
+    }
+
+    void tableconstraint()
+    {
+        if(chance(20))
+        {
+            keyword("CONSTRAINT");
+            add(pick({"c1", "\"c 2\""}));
+        }
+
+        switch(random(4))
+        {
+        case 0:
+        case 1:
+            if(!has_primary_key && chance(50))
+            {
+                has_primary_key = true;
+                keyword("PRIMARY");
+                keyword("KEY");
+            } else {
+                keyword("UNIQUE");
+            }
+            add("(");
+            for(size_t i=1+random(2);i>0;i--)
+            {
+                add(existingColumn());
+                if(chance(20))
+                {
+                    keyword("COLLATE");
+                    add("NOCASE");
+                }
+                if(chance(20))
+                    keyword(pick({"ASC", "DESC"}));
+                if(i > 1)
+                    add(",");
+            }
+            add(")");
+            conflictclause();
+            break;
+        case 2:
+            keyword("CHECK");
+            add("(");
+            expr(3);
+            add(")");
+            break;
+        case 3:
+        {
+            keyword("FOREIGN");
+            keyword("KEY");
+            add("(");
+            size_t num = 1 + random(2);
+            for(size_t i=num;i>0;i--)
+            {
+                add(existingColumn());
+                if(i > 1)
+                    add(",");
+            }
+            add(")");
+            foreignkeyclause(num);
+            break;
+        }
+        }
+    }
+
+    void foreignkeyclause(size_t num_columns)
+    {
+        keyword("REFERENCES");
+        add(pick({"other", "\"other table\""}));
+        if(chance(70))
+        {
+            add("(");
+            for(size_t i=num_columns;i>0;i--)
+            {
+                add(pick({"x", "y", "key", "`z`"}));
+                if(i > 1)
+                    add(",");
+            }
+            add(")");
+        }
+        for(size_t i=random(3);i>0;i--)
+        {
+            if(chance(80))
+            {
+                keyword("ON");
+                keyword(pick({"DELETE", "UPDATE"}));
+                switch(random(4))
+                {
+                case 0: keyword("SET"); keyword(pick({"NULL", "DEFAULT"})); break;
+                case 1: keyword("CASCADE"); break;
+                case 2: keyword("RESTRICT"); break;
+                case 3: keyword("NO"); keyword("ACTION"); break;
+                }
+            } else {
+                keyword("MATCH");
+                add("simple");
+            }
+        }
+        switch(random(3))
+        {
+        case 0:
+            keyword("NOT");
+            keyword("DEFERRABLE");
+            if(chance(50))
+            {
+                keyword("INITIALLY");
+                keyword(pick({"DEFERRED", "IMMEDIATE"}));
+            }
+            break;
+        case 1:
+            keyword("DEFERRABLE");
+            keyword("INITIALLY");
+            keyword(pick({"DEFERRED", "IMMEDIATE"}));
+            break;
+        }
+    }
+
+    void indexedcolumn()
+    {
+        if(chance(70))
+            add(name(true));
+        else
+            expr(2);
+        if(chance(20))
+        {
+            keyword("COLLATE");
+            add("NOCASE");
+        }
+        if(chance(30))
+            keyword(pick({"ASC", "DESC"}));
+    }
+
+    void literal()
+    {
+        switch(random(4))
+        {
+        case 0: add(pick({"1", "0", "1.5", ".5", "1e10", "2E-3", "7."})); break;
+        case 1: add(pick({"'text'", "'it''s'", "''"})); break;
+        case 2: keyword("NULL"); break;
+        case 3: keyword(pick({"CURRENT_TIME", "CURRENT_DATE", "CURRENT_TIMESTAMP"})); break;
+        }
+    }
+
+    void expr(int depth)
+    {
+        if(depth > 0 && chance(15))
+        {
+            add("(");
+            expr(depth - 1);
+            add(")");
+            while(chance(20))
+            {
+                keyword(pick({"AND", "OR"}));
+                expr(depth - 1);
+            }
+        } else if(depth > 0 && chance(5)) {
+            add("(");
+            subexpr(0);
+            add(",");
+            subexpr(0);
+            add(")");
+            add(pick({"=", "<>", "<"}));
+            add("(");
+            subexpr(0);
+            add(",");
+            subexpr(0);
+            add(")");
+        } else {
+            subexpr(depth);
+            while(chance(30))
+            {
+                if(chance(30))
+                    keyword(pick({"AND", "OR", "IS", "LIKE", "GLOB"}));
+                else
+                    add(pick({"+", "-", "*", "||", "=", "==", "!=", "<>", "<", "<=", ">", ">=", "<<", ">>", "&", "|"}));
+                subexpr(depth);
+            }
+        }
+    }
+
+    void subexpr(int depth)
+    {
+        if(chance(10))
+            add(pick({"-", "+", "~", "NOT"}));
+
+        switch(depth > 0 ? random(10) : random(2))
+        {
+        case 0: literal(); break;
+        case 1: add(columns.empty() ? name(true) : existingColumn()); break;
+        case 2:
+            add(pick({"abs", "lower", "datetime"}));
+            add("(");
+            for(size_t i=random(3);i>0;i--)
+            {
+                expr(depth - 1);
+                if(i > 1)
+                    add(",");
+            }
+            add(")");
+            break;
+        case 3:
+            keyword("CAST");
+            add("(");
+            expr(depth - 1);
+            keyword("AS");
+            type_name();
+            add(")");
+            break;
+        case 4:
+            keyword("CASE");
+            if(chance(50))
+                expr(depth - 1);
+            for(size_t i=1+random(2);i>0;i--)
+            {
+                keyword("WHEN");
+                expr(depth - 1);
+                keyword("THEN");
+                expr(depth - 1);
+            }
+            if(chance(50))
+            {
+                keyword("ELSE");
+                expr(depth - 1);
+            }
+            keyword("END");
+            break;
+        case 5:
+            keyword("EXISTS");
+            add("(");
+            expr(depth - 1);
+            add(")");
+            break;
+        case 6:
+            keyword("RAISE");
+            add("(");
+            if(chance(50))
+            {
+                keyword("IGNORE");
+            } else {
+                keyword(pick({"ROLLBACK", "ABORT", "FAIL"}));
+                add(",");
+                add("'error'");
+            }
+            add(")");
+            break;
+        default:
+            literal();
+        }
+
+        if(depth > 0 && chance(20))
+        {
+            switch(random(4))
+            {
+            case 0:
+                keyword("COLLATE");
+                add("NOCASE");
+                break;
+            case 1:
+                if(chance(30))
+                    keyword("NOT");
+                keyword("BETWEEN");
+                subexpr(depth - 1);
+                keyword("AND");
+                expr(depth - 1);
+                break;
+            case 2:
+                if(chance(30))
+                    keyword("NOT");
+                keyword("IN");
+                add("(");
+                for(size_t i=random(3);i>0;i--)
+                {
+                    expr(depth - 1);
+                    if(i > 1)
+                        add(",");
+                }
+                add(")");
+                break;
+            case 3:
+                if(chance(30))
+                    keyword("NOT");
+                keyword(pick({"LIKE", "GLOB", "MATCH", "REGEXP"}));
+                subexpr(depth - 1);
+                if(chance(30))
+                {
+                    keyword("ESCAPE");
+                    add("'!'");
+                }
+                break;
+            }
+        }
+    }
+};
+}
+
+void TestTable::compareParsers()
+{
+    // Both parsers need to agree on all statements the hand-written parser accepts. It shouldn't give up on any statement the
+    // ANTLR parser accepts either because nothing but semicolons follow the generated statements.
+    StatementGenerator generator(4711);
+    size_t accepted = 0;
+    const size_t iterations = 1000;
+
+    for(size_t i=0;i<iterations;i++)
+    {
+        std::string sql = generator.table();
+        TablePtr hand = Table::parseSQL(sql, ParserType::HandWritten);
+        TablePtr antlr = Table::parseSQL(sql, ParserType::Antlr);
+        QVERIFY2((hand != nullptr) == !antlr->name().empty(), sql.c_str());
+        if(hand)
+        {
+            accepted++;
+            QVERIFY2(*hand == *antlr, sql.c_str());
+            QCOMPARE(hand->sql(), antlr->sql());
+            QCOMPARE(hand->virtualUsing(), antlr->virtualUsing());
+        }
+
+        sql = generator.index();
+        IndexPtr hand_index = Index::parseSQL(sql, ParserType::HandWritten);
+        IndexPtr antlr_index = Index::parseSQL(sql, ParserType::Antlr);
+        QVERIFY2((hand_index != nullptr) == !antlr_index->name().empty(), sql.c_str());
+        if(hand_index)
+        {
+            accepted++;
+            QCOMPARE(hand_index->name(), antlr_index->name());
+            QCOMPARE(hand_index->sql(), antlr_index->sql());
+            QCOMPARE(hand_index->fullyParsed(), antlr_index->fullyParsed());
+        }
+    }
+
+    // Make sure the generated statements aren't rejected by both parsers most of the time
+    QVERIFY(accepted > iterations);
+}
+
+void TestTable::countQuery()
+{
+    const std::unordered_set<std::string> aggregates = {"count", "max", "jsonb_group_array"};
+
+    // Sorting and result columns are left out
+    QCOMPARE(Query::buildCountQuery("SELECT a, datetime(b) AS d FROM t WHERE a > 1 ORDER BY d DESC LIMIT 10", &aggregates),
+             "SELECT COUNT(*) FROM (SELECT 1 FROM t WHERE a > 1 LIMIT 10);");
+    QCOMPARE(Query::buildCountQuery("SELECT a, (SELECT count(*) FROM u WHERE u.x = t.a) AS n FROM t ORDER BY n"),
+             "SELECT COUNT(*) FROM (SELECT 1 FROM t );");
+
+    // The result columns are needed when they change the number of rows or are referenced elsewhere
+    QCOMPARE(Query::buildCountQuery("SELECT DISTINCT a FROM t ORDER BY a"), "SELECT COUNT(*) FROM (SELECT DISTINCT a FROM t );");
+    QCOMPARE(Query::buildCountQuery("SELECT count(*) FROM t"), "SELECT COUNT(*) FROM (SELECT count(*) FROM t);");
+    QCOMPARE(Query::buildCountQuery("SELECT jsonb_group_array(a) FROM t", &aggregates), "SELECT COUNT(*) FROM (SELECT jsonb_group_array(a) FROM t);");
+
+    // Without knowing the aggregate functions, any function might be one
+    QCOMPARE(Query::buildCountQuery("SELECT my_aggregate(a) FROM t ORDER BY 1"), "SELECT COUNT(*) FROM (SELECT my_aggregate(a) FROM t );");
+    QCOMPARE(Query::buildCountQuery("SELECT CAST(a AS TEXT) FROM t WHERE a IN (1, 2)"), "SELECT COUNT(*) FROM (SELECT 1 FROM t WHERE a IN (1, 2));");
+    QCOMPARE(Query::buildCountQuery("SELECT a FROM t GROUP BY a"), "SELECT COUNT(*) FROM (SELECT a FROM t GROUP BY a);");
+    QCOMPARE(Query::buildCountQuery("SELECT a+b AS s FROM t WHERE s > 5"), "SELECT COUNT(*) FROM (SELECT a+b AS s FROM t WHERE s > 5);");
+    QCOMPARE(Query::buildCountQuery("SELECT a FROM t UNION SELECT b FROM u ORDER BY 1"),
+             "SELECT COUNT(*) FROM (SELECT a FROM t UNION SELECT b FROM u );");
+
+    // Keywords in strings, identifiers and parameters are ignored
+    QCOMPARE(Query::buildCountQuery("SELECT 'order by' AS x, \"from\" FROM t WHERE y = :from"),
+             "SELECT COUNT(*) FROM (SELECT 1 FROM t WHERE y = :from);");
+    QCOMPARE(Query::buildCountQuery("WITH c AS (SELECT * FROM t ORDER BY x) SELECT * FROM c ORDER BY y"),
+             "SELECT COUNT(*) FROM (WITH c AS (SELECT * FROM t ORDER BY x) SELECT 1 FROM c );");
+}
+
+void TestTable::queryPlanDetails()
+{
+    // Both the old and the new format of the table names are understood
+    QueryPlanStep step = QueryPlan::parseDetail("SCAN TABLE t AS a USING COVERING INDEX i");
+    QCOMPARE(step.operation, QueryPlanStep::Scan);
+    QCOMPARE(step.table, QString("t"));
+    QCOMPARE(step.index, QString("i"));
+    QVERIFY(step.coveringIndex);
+    QVERIFY(step.isExpensive());
+
+    step = QueryPlan::parseDetail("SEARCH my table USING INDEX my index (a=? AND b>?)");
+    QCOMPARE(step.operation, QueryPlanStep::Search);
+    QCOMPARE(step.table, QString("my table"));
+    QCOMPARE(step.index, QString("my index"));
+    QVERIFY(!step.isExpensive());
+
+    step = QueryPlan::parseDetail("SEARCH t USING INTEGER PRIMARY KEY (rowid=?)");
+    QCOMPARE(step.table, QString("t"));
+    QVERIFY(step.index.isEmpty());
+    QVERIFY(!step.isExpensive());
+
+    step = QueryPlan::parseDetail("SEARCH u USING AUTOMATIC COVERING INDEX (x=?)");
+    QCOMPARE(step.table, QString("u"));
+    QVERIFY(step.automaticIndex);
+    QVERIFY(step.isExpensive());
+
+    QCOMPARE(QueryPlan::parseDetail("USE TEMP B-TREE FOR ORDER BY").operation, QueryPlanStep::TempBTree);
+    QVERIFY(QueryPlan::parseDetail("SCAN SUBQUERY 1").table.isEmpty());
+    QVERIFY(QueryPlan::parseDetail("SCAN CONSTANT ROW").table.isEmpty());
+    QVERIFY(!QueryPlan::parseDetail("SCAN (subquery-1)").isExpensive());
+
+    // Semicolons in strings, comments and trigger bodies don't end a statement
+    const QByteArray sql = "SELECT ';'; -- ;\nCREATE TRIGGER x AFTER INSERT ON t BEGIN DELETE FROM u; END;\n\nSELECT 2";
+    int from, to;
+    QVERIFY(QueryPlan::statementAt(sql, 3, from, to));
+    QCOMPARE(sql.mid(from, to - from), QByteArray("SELECT ';';"));
+    QVERIFY(QueryPlan::statementAt(sql, 11, from, to));
+    QCOMPARE(sql.mid(from, to - from), QByteArray("SELECT ';';"));
+    QVERIFY(QueryPlan::statementAt(sql, sql.indexOf("DELETE"), from, to));
+    QCOMPARE(sql.mid(from, to - from).trimmed(), QByteArray("-- ;\nCREATE TRIGGER x AFTER INSERT ON t BEGIN DELETE FROM u; END;"));
+    QVERIFY(QueryPlan::statementAt(sql, sql.size(), from, to));
+    QCOMPARE(sql.mid(from, to - from).trimmed(), QByteArray("SELECT 2"));
+    QVERIFY(!QueryPlan::statementAt("SELECT 1;\n\n", 11, from, to));
+}
+
+void TestTable::compositeRowids()
+{
+    // Each value keeps its storage class. Blobs are hex encoded.
+    const QByteArray blob("\x00\xff\x01", 3);
+    QCOMPARE(makeCompositeRowid({"1", "2.5", "abc", blob, QByteArray()},
+                                {CellType::Integer, CellType::Float, CellType::Text, CellType::Blob, CellType::Null}),
+             QByteArray("[1,2.5,\"abc\",{\"blob\":\"00ff01\"},null]"));
+    QCOMPARE(replaceCompositeRowidValue("[1,2.5]", 1, "x", CellType::Text), QByteArray("[1,\"x\"]"));
+    QVERIFY(replaceCompositeRowidValue("[1,2.5]", 2, "x", CellType::Text).isNull());
+    QVERIFY(replaceCompositeRowidValue("1", 0, "x", CellType::Text).isNull());
+
+    DBBrowserDB db;
+    QVERIFY(db.open(":memory:"));
+    QVERIFY(db.executeSQL("CREATE TABLE t(r REAL, b BLOB, v TEXT, PRIMARY KEY(r, b)) WITHOUT ROWID;"));
+    QVERIFY(db.executeSQL("INSERT INTO t VALUES(0.1 + 0.2, X'00FF01', 'first'), (0.3, X'00FF01', 'second'), (0.1 + 0.2, '1', 'third');"));
+    db.updateSchema();
+    const sqlb::ObjectIdentifier table("main", "t");
+
+    // The REAL value needs all of its digits to be found. SQLite's own text for it is rounded to 0.3, which is the key of another row.
+    const QByteArray exact = QByteArray::number(0.1 + 0.2, 'g', 17);
+    const QString first = makeCompositeRowid({exact, blob}, {CellType::Float, CellType::Blob});
+    std::vector<QByteArray> rowdata;
+    QVERIFY(db.getRow(table, first, rowdata));
+    QCOMPARE(rowdata.size(), static_cast<size_t>(3));
+    QCOMPARE(rowdata.at(2), QByteArray("first"));
+
+    // A blob doesn't match text with the same bytes and vice versa
+    rowdata.clear();
+    QVERIFY(!db.getRow(table, makeCompositeRowid({exact, "1"}, {CellType::Float, CellType::Blob}), rowdata));
+    QVERIFY(db.getRow(table, makeCompositeRowid({exact, "1"}, {CellType::Float, CellType::Text}), rowdata));
+    QCOMPARE(rowdata.at(2), QByteArray("third"));
+
+    // Updating and deleting find the same rows
+    QVERIFY(db.updateRecord(table, "v", first, "changed", false));
+    QCOMPARE(db.querySingleValueFromDb("SELECT v FROM t WHERE r = 0.1 + 0.2 AND b = X'00FF01';", false), QByteArray("changed"));
+    QVERIFY(db.deleteRecords(table, {first}));
+    QCOMPARE(db.querySingleValueFromDb("SELECT group_concat(v) FROM (SELECT v FROM t ORDER BY v);", false), QByteArray("second,third"));
+
+    // Closing a database with uncommitted changes asks whether to save them
+    QVERIFY(db.revertAll());
+    QVERIFY(db.close());
+}
+
+void TestTable::indexAdvisor()
+{
+    DBBrowserDB db;
+    QVERIFY(db.open(":memory:"));
+    QVERIFY(db.executeSQL("CREATE TABLE t(id INTEGER PRIMARY KEY, a, b, c);"));
+    QVERIFY(db.executeSQL("CREATE TABLE u(x, y);"));
+    QVERIFY(db.executeSQL("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i+1 FROM n WHERE i<1000) INSERT INTO t(a, b, c) SELECT i % 10, i, i FROM n;"));
+    QVERIFY(db.executeSQL("INSERT INTO u SELECT a, b FROM t;"));
+    QVERIFY(db.executeSQL("ANALYZE;"));
+    db.updateSchema();
+
+    auto analyse = [&db](const QString& statements) {
+        IndexAdvisor advisor(db);
+        auto pDb = db.get("testing");
+        advisor.analyseStatements(pDb.get(), statements);
+        return advisor.suggestions();
+    };
+    auto columns = [](const IndexSuggestion& suggestion) {
+        std::string result;
+        for(const auto& column : suggestion.columns)
+            result += (result.empty() ? "" : ",") + column.name() + (column.order().empty() ? "" : " " + column.order());
+        return result;
+    };
+
+    // Equality constraints come before the range constraint. Repeated statements are counted
+    std::vector<IndexSuggestion> suggestions = analyse("SELECT * FROM t WHERE a = 1 AND b > 5;\nSELECT * FROM t WHERE b > 5 AND a = 2;");
+    QCOMPARE(suggestions.size(), static_cast<size_t>(1));
+    QCOMPARE(suggestions.at(0).table, sqlb::ObjectIdentifier("main", "t"));
+    QCOMPARE(columns(suggestions.at(0)), "a,b");
+    QVERIFY(suggestions.at(0).avoidsScan);
+    QVERIFY(!suggestions.at(0).avoidsSort);
+    QVERIFY(!suggestions.at(0).automaticIndex);
+    QCOMPARE(suggestions.at(0).tableRows, static_cast<qint64>(1000));
+    QCOMPARE(suggestions.at(0).estimatedRows, static_cast<qint64>(10));
+    QCOMPARE(suggestions.at(0).statements, 2);
+
+    // The sort order is kept. With an equality constraint the index avoids the scan as well
+    suggestions = analyse("SELECT * FROM t ORDER BY c DESC;");
+    QCOMPARE(suggestions.size(), static_cast<size_t>(1));
+    QCOMPARE(columns(suggestions.at(0)), "c DESC");
+    QVERIFY(suggestions.at(0).avoidsSort);
+    QVERIFY(!suggestions.at(0).avoidsScan);
+    suggestions = analyse("SELECT * FROM t WHERE a = 1 ORDER BY b DESC;");
+    QCOMPARE(suggestions.size(), static_cast<size_t>(1));
+    QCOMPARE(columns(suggestions.at(0)), "a,b DESC");
+    QVERIFY(suggestions.at(0).avoidsSort);
+    QVERIFY(suggestions.at(0).avoidsScan);
+
+    // Conditions combined by OR can't be looked up in one index
+    QVERIFY(analyse("SELECT * FROM t WHERE a = 1 OR b > 5;").empty());
+
+    // SQLite builds an automatic index for joining on a column without an index
+    suggestions = analyse("SELECT * FROM t, u WHERE u.x = t.c;");
+    QCOMPARE(suggestions.size(), static_cast<size_t>(1));
+    QCOMPARE(suggestions.at(0).table, sqlb::ObjectIdentifier("main", "u"));
+    QCOMPARE(columns(suggestions.at(0)), "x");
+    QVERIFY(suggestions.at(0).automaticIndex);
+    QCOMPARE(suggestions.at(0).tableRows, static_cast<qint64>(1000));
+
+    // An existing index which starts with the suggested columns covers them. The statement has to bypass the index to
+    // make SQLite scan the table.
+    QVERIFY(db.executeSQL("CREATE INDEX idx_abc ON t(a, b, c);"));
+    db.updateSchema();
+    suggestions = analyse("SELECT * FROM t NOT INDEXED WHERE a = 1 AND b > 5;\nSELECT * FROM t NOT INDEXED ORDER BY c DESC;");
+    QCOMPARE(suggestions.size(), static_cast<size_t>(1));
+    QCOMPARE(columns(suggestions.at(0)), "c DESC");
+
+    QVERIFY(db.revertAll());
+    QVERIFY(db.close());
+}
@@ -36,6 +36,12 @@ private slots:
     void rowValues();
     void complexExpressions();
     void datetimeExpression();
+    void handWrittenParser();
+    void compareParsers();
+    void countQuery();
+    void queryPlanDetails();
+    void compositeRowids();
+    void indexAdvisor();
 };
 
 #endif